@@ -2080,6 +2080,82 @@ std::string zip_llsd(LLSD& data)
 	return result;
 }
 
+//inflate a zlib block from provided istream into a reusable buffer, see llsdserialize.h
+S32 unzip_block(std::istream& is, S32 size, U8** buffer, U32* capacity)
+{
+	if (size <= 0)
+	{
+		return -1;
+	}
+
+	const U32 CHUNK = 16384;
+	U8 in[CHUNK];
+
+	z_stream strm;
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	strm.avail_in = 0;
+	strm.next_in = Z_NULL;
+
+	if (inflateInit(&strm) != Z_OK)
+	{
+		return -1;
+	}
+
+	U32 cur_size = 0;
+	S32 remaining = size;
+	S32 ret = Z_OK;
+	while (ret != Z_STREAM_END)
+	{
+		if (strm.avail_in == 0)
+		{
+			if (remaining <= 0)
+			{
+				break; // truncated
+			}
+			U32 count = llmin((U32)remaining, CHUNK);
+			is.read((char*) in, count);
+			if ((U32)is.gcount() != count)
+			{
+				break;
+			}
+			remaining -= count;
+			strm.next_in = in;
+			strm.avail_in = count;
+		}
+
+		if (cur_size == *capacity)
+		{
+			U32 new_capacity = llmax(*capacity * 2, (U32)size * 4);
+			U8* new_buffer = (U8*) realloc(*buffer, new_capacity);
+			if (!new_buffer)
+			{
+				break;
+			}
+			*buffer = new_buffer;
+			*capacity = new_capacity;
+		}
+
+		strm.next_out = *buffer + cur_size;
+		strm.avail_out = *capacity - cur_size;
+		ret = inflate(&strm, Z_NO_FLUSH);
+		cur_size = *capacity - strm.avail_out;
+
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+		{
+			break;
+		}
+	}
+
+	inflateEnd(&strm);
+	if (remaining > 0)
+	{
+		is.ignore(remaining); // leave the stream after the block like unzip_llsd
+	}
+	return ret == Z_STREAM_END ? (S32)cur_size : -1;
+}
+
 //decompress a block of LLSD from provided istream
 // not very efficient -- creats a copy of decompressed LLSD block in memory
 // and deserializes from that copy using LLSDSerialize
@@ -791,4 +791,8 @@ public:
 //dirty little zip functions -- yell at davep
 LL_COMMON_API std::string zip_llsd(LLSD& data);
 LL_COMMON_API bool unzip_llsd(LLSD& data, std::istream& is, S32 size);
+// Inflates size bytes of zlib data from is into *buffer, which is malloc'd and
+// grown with realloc as needed (*capacity bytes) so that callers unpacking many
+// blocks can keep reusing it. Returns the inflated size, or -1 on failure.
+LL_COMMON_API S32 unzip_block(std::istream& is, S32 size, U8** buffer, U32* capacity);
 #endif // LL_LLSDSERIALIZE_H
@@ -33,6 +33,201 @@
 
 #include "llimagedxt.h"
 
+namespace
+{
+	inline U16 pack565(const U8* color)
+	{
+		return (U16)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+	}
+
+	inline void unpack565(U16 packed, S32* color)
+	{
+		S32 r = (packed >> 11) & 0x1f;
+		S32 g = (packed >> 5) & 0x3f;
+		S32 b = packed & 0x1f;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Encodes the colors of a 4x4 block of RGBA pixels as a DXT1 color block.
+	// The end points are the colors that project furthest along the principal
+	// axis of the block, found by power iteration on the covariance matrix.
+	void compress_color_block(const U8* block, U8* out)
+	{
+		F32 mean[3] = { 0.f, 0.f, 0.f };
+		for (S32 i = 0; i < 16; ++i)
+		{
+			for (S32 c = 0; c < 3; ++c)
+			{
+				mean[c] += block[i * 4 + c];
+			}
+		}
+		for (S32 c = 0; c < 3; ++c)
+		{
+			mean[c] /= 16.f;
+		}
+
+		F32 cov[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f }; // rr rg rb gg gb bb
+		for (S32 i = 0; i < 16; ++i)
+		{
+			F32 r = block[i * 4 + 0] - mean[0];
+			F32 g = block[i * 4 + 1] - mean[1];
+			F32 b = block[i * 4 + 2] - mean[2];
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		// Start from the channel with the largest variance
+		F32 axis[3] = { 0.f, 0.f, 0.f };
+		if (cov[0] >= cov[3] && cov[0] >= cov[5])
+		{
+			axis[0] = 1.f;
+		}
+		else if (cov[3] >= cov[5])
+		{
+			axis[1] = 1.f;
+		}
+		else
+		{
+			axis[2] = 1.f;
+		}
+		for (S32 iter = 0; iter < 4; ++iter)
+		{
+			F32 x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+			F32 y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+			F32 z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+			F32 norm = llmax(llmax((F32)fabs(x), (F32)fabs(y)), (F32)fabs(z));
+			if (norm < 1e-6f)
+			{
+				break; // flat block
+			}
+			axis[0] = x / norm;
+			axis[1] = y / norm;
+			axis[2] = z / norm;
+		}
+
+		S32 min_idx = 0;
+		S32 max_idx = 0;
+		F32 min_dot = F32_MAX;
+		F32 max_dot = -F32_MAX;
+		for (S32 i = 0; i < 16; ++i)
+		{
+			F32 dot = block[i * 4 + 0] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+			if (dot < min_dot)
+			{
+				min_dot = dot;
+				min_idx = i;
+			}
+			if (dot > max_dot)
+			{
+				max_dot = dot;
+				max_idx = i;
+			}
+		}
+
+		// color0 > color1 selects the four color mode
+		U16 color0 = pack565(block + max_idx * 4);
+		U16 color1 = pack565(block + min_idx * 4);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		U32 indices = 0;
+		if (color0 != color1)
+		{
+			S32 palette[4][3];
+			unpack565(color0, palette[0]);
+			unpack565(color1, palette[1]);
+			for (S32 c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (S32 i = 0; i < 16; ++i)
+			{
+				S32 best = 0;
+				S32 best_dist = S32_MAX;
+				for (S32 p = 0; p < 4; ++p)
+				{
+					S32 dr = block[i * 4 + 0] - palette[p][0];
+					S32 dg = block[i * 4 + 1] - palette[p][1];
+					S32 db = block[i * 4 + 2] - palette[p][2];
+					S32 dist = dr * dr + dg * dg + db * db;
+					if (dist < best_dist)
+					{
+						best_dist = dist;
+						best = p;
+					}
+				}
+				indices |= (U32)best << (2 * i);
+			}
+		}
+
+		out[0] = color0 & 0xff;
+		out[1] = color0 >> 8;
+		out[2] = color1 & 0xff;
+		out[3] = color1 >> 8;
+		for (S32 b = 0; b < 4; ++b)
+		{
+			out[4 + b] = (indices >> (8 * b)) & 0xff;
+		}
+	}
+
+	// Encodes the alpha of a 4x4 block of RGBA pixels as a DXT5 alpha block.
+	void compress_alpha_block(const U8* block, U8* out)
+	{
+		U8 alpha0 = 0;
+		U8 alpha1 = 255;
+		for (S32 i = 0; i < 16; ++i)
+		{
+			alpha0 = llmax(alpha0, block[i * 4 + 3]);
+			alpha1 = llmin(alpha1, block[i * 4 + 3]);
+		}
+
+		U64 indices = 0;
+		if (alpha0 > alpha1)
+		{
+			// alpha0 > alpha1 selects the eight alpha mode
+			S32 palette[8];
+			palette[0] = alpha0;
+			palette[1] = alpha1;
+			for (S32 p = 1; p < 7; ++p)
+			{
+				palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+			}
+			for (S32 i = 0; i < 16; ++i)
+			{
+				S32 best = 0;
+				S32 best_dist = S32_MAX;
+				for (S32 p = 0; p < 8; ++p)
+				{
+					S32 dist = block[i * 4 + 3] - palette[p];
+					dist *= dist;
+					if (dist < best_dist)
+					{
+						best_dist = dist;
+						best = p;
+					}
+				}
+				indices |= (U64)best << (3 * i);
+			}
+		}
+
+		out[0] = alpha0;
+		out[1] = alpha1;
+		for (S32 b = 0; b < 6; ++b)
+		{
+			out[2 + b] = (U8)((indices >> (8 * b)) & 0xff);
+		}
+	}
+}
+
 //static
 void LLImageDXT::checkMinWidthHeight(EFileFormat format, S32& width, S32& height)
 {
@@ -409,6 +604,86 @@ BOOL LLImageDXT::encode(const LLImageRaw* raw_image, F32 time)
 	return encodeDXT(raw_image, time, false);
 }
 
+BOOL LLImageDXT::encodeS3TC(const LLImageRaw* raw_image)
+{
+	llassert_always(raw_image);
+
+	S32 ncomponents = raw_image->getComponents();
+	S32 width = raw_image->getWidth();
+	S32 height = raw_image->getHeight();
+	if ((ncomponents != 3 && ncomponents != 4) ||
+		width <= 0 || (width & (width - 1)) || height <= 0 || (height & (height - 1)))
+	{
+		return FALSE;
+	}
+	EFileFormat format = ncomponents == 4 ? FORMAT_DXR5 : FORMAT_DXR1;
+
+	setSize(width, height, ncomponents);
+	mHeaderSize = sizeof(dxtfile_header_t);
+	mFileFormat = format;
+
+	S32 nmips = calcNumMips(width, height);
+	S32 w = width;
+	S32 h = height;
+
+	S32 totbytes = mHeaderSize;
+	for (S32 mip=0; mip<nmips; mip++)
+	{
+		totbytes += formatBytes(format,w,h);
+		w >>= 1;
+		h >>= 1;
+	}
+
+	U8* data = allocateData(totbytes);
+	if (!data)
+	{
+		return FALSE;
+	}
+
+	dxtfile_header_t* header = (dxtfile_header_t*)data;
+	memset(header, 0, mHeaderSize);
+	header->fourcc = 0x20534444;
+	header->pixel_fmt.fourcc = getFourCC(format);
+	header->num_mips = nmips;
+	header->maxwidth = width;
+	header->maxheight = height;
+
+	// Each mip is made from the uncompressed level above it
+	const U8* mipdata = raw_image->getData();
+	U8* prev_mipdata = NULL;
+	w = width, h = height;
+	for (S32 mip=0; mip<nmips; mip++)
+	{
+		if (mip > 0)
+		{
+			U8* newdata = new U8[w * h * ncomponents];
+			generateMip(mipdata, newdata, w, h, ncomponents);
+			delete[] prev_mipdata;
+			prev_mipdata = newdata;
+			mipdata = newdata;
+		}
+		compressS3TC(mipdata, data + getMipOffset(mip), w, h, ncomponents);
+		w >>= 1;
+		h >>= 1;
+	}
+	delete[] prev_mipdata;
+
+	return TRUE;
+}
+
+S32 LLImageDXT::getMipLevel(S32 width, S32 height)
+{
+	S32 nmips = calcNumMips(getWidth(), getHeight());
+	for (S32 mip = 0; mip < nmips; mip++)
+	{
+		if ((getWidth() >> mip) == width && (getHeight() >> mip) == height)
+		{
+			return mip;
+		}
+	}
+	return -1;
+}
+
 // virtual
 bool LLImageDXT::convertToDXR()
 {
@@ -509,3 +784,37 @@ void LLImageDXT::extractMip(const U8 *indata, U8* mipdata, int width, int height
 }
 
 //============================================================================
+
+//static
+void LLImageDXT::compressS3TC(const U8* indata, U8* outdata, S32 width, S32 height, S32 ncomponents)
+{
+	U8 block[16 * 4];
+	for (S32 by = 0; by < height; by += 4)
+	{
+		for (S32 bx = 0; bx < width; bx += 4)
+		{
+			// Mips smaller than a block repeat their edge pixels
+			for (S32 y = 0; y < 4; y++)
+			{
+				S32 sy = llmin(by + y, height - 1);
+				for (S32 x = 0; x < 4; x++)
+				{
+					S32 sx = llmin(bx + x, width - 1);
+					const U8* pixel = indata + (sy * width + sx) * ncomponents;
+					U8* dest = block + (y * 4 + x) * 4;
+					dest[0] = pixel[0];
+					dest[1] = pixel[1];
+					dest[2] = pixel[2];
+					dest[3] = ncomponents == 4 ? pixel[3] : 255;
+				}
+			}
+			if (ncomponents == 4)
+			{
+				compress_alpha_block(block, outdata);
+				outdata += 8;
+			}
+			compress_color_block(block, outdata);
+			outdata += 8;
+		}
+	}
+}
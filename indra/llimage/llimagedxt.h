@@ -114,6 +114,14 @@ public:
 	/*virtual*/ S32 calcDataSize(S32 discard_level = 0);
 
 	BOOL getMipData(LLPointer<LLImageRaw>& raw, S32 discard=-1);
+
+	// Compresses a power of two RGB (DXT1) or RGBA (DXT5) image with its mips,
+	// stored smallest mip first (DXR) as LLImageGL expects them. Non-square
+	// images are fine: like LLImageGL's max discard level, the mips stop once
+	// the shorter side is down to one pixel, and blocks past the edge repeat it.
+	BOOL encodeS3TC(const LLImageRaw* raw_image);
+	// Returns the mip level of the given size, or -1 if there is none.
+	S32 getMipLevel(S32 width, S32 height);
 	
 	void setFormat();
 	S32 getMipOffset(S32 discard);
@@ -138,6 +146,7 @@ public:
 private:
 	static void extractMip(const U8 *indata, U8* mipdata, int width, int height,
 						   int mip_width, int mip_height, EFileFormat format);
+	static void compressS3TC(const U8* indata, U8* outdata, S32 width, S32 height, S32 ncomponents);
 	
 private:
 	EFileFormat mFileFormat;
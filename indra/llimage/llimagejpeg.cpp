@@ -36,7 +36,7 @@
 
 #include "llerror.h"
 
-jmp_buf	LLImageJPEG::sSetjmpBuffer ;
+ll_thread_local jmp_buf	LLImageJPEG::sSetjmpBuffer ;
 LLImageJPEG::LLImageJPEG(S32 quality) 
 	:
 	LLImageFormatted(IMG_CODEC_JPEG),
@@ -86,7 +86,7 @@ protected:
 
 	S32				mEncodeQuality;		// on a scale from 1 to 100
 private:
-	static jmp_buf	sSetjmpBuffer;		// To allow the library to abort.
+	static ll_thread_local jmp_buf	sSetjmpBuffer;		// To allow the library to abort. Per thread: images are encoded off the main thread too.
 };
 
 #endif  // LL_LLIMAGEJPEG_H
@@ -34,6 +34,7 @@
 
 #include "llimageworker.h"
 #include "llimagedxt.h"
+#include "llimagej2c.h"
 
 //----------------------------------------------------------------------------
 
@@ -181,3 +182,81 @@ bool LLImageDecodeThread::ImageRequest::tut_isOK()
 {
 	return mResponder.notNull();
 }
+
+//----------------------------------------------------------------------------
+
+// MAIN THREAD
+LLImageEncodeThread::LLImageEncodeThread(bool threaded)
+	: LLQueuedThread("imageencode", threaded)
+{
+}
+
+//virtual
+LLImageEncodeThread::~LLImageEncodeThread()
+{
+}
+
+// MAIN THREAD
+LLImageEncodeThread::handle_t LLImageEncodeThread::encodeImage(LLImageRaw* raw, LLImageFormatted* image,
+	U32 priority, Responder* responder, const std::string& comment)
+{
+	handle_t handle = generateHandle();
+	EncodeRequest* req = new EncodeRequest(handle, raw, image, priority, comment, responder);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLImageEncodeThread shut down" << llendl;
+	}
+	return handle;
+}
+
+LLImageEncodeThread::Responder::~Responder()
+{
+}
+
+//----------------------------------------------------------------------------
+
+LLImageEncodeThread::EncodeRequest::EncodeRequest(handle_t handle, LLImageRaw* raw, LLImageFormatted* image,
+												  U32 priority, const std::string& comment,
+												  LLImageEncodeThread::Responder* responder)
+	: LLQueuedThread::QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+	  mRawImage(raw),
+	  mComment(comment),
+	  mFormattedImage(image),
+	  mEncoded(FALSE),
+	  mResponder(responder)
+{
+}
+
+LLImageEncodeThread::EncodeRequest::~EncodeRequest()
+{
+	mRawImage = NULL;
+	mFormattedImage = NULL;
+}
+
+// Returns true when done, whether or not the encode was successful.
+bool LLImageEncodeThread::EncodeRequest::processRequest()
+{
+	if (mRawImage.notNull() && mFormattedImage.notNull())
+	{
+		// None of the encoders are time sliced off the main thread: encode in one go.
+		if (mFormattedImage->getCodec() == IMG_CODEC_J2C)
+		{
+			mEncoded = ((LLImageJ2C*)mFormattedImage.get())->encode(mRawImage, mComment.empty() ? NULL : mComment.c_str());
+		}
+		else
+		{
+			mEncoded = mFormattedImage->encode(mRawImage, 0.f);
+		}
+	}
+	return true;
+}
+
+void LLImageEncodeThread::EncodeRequest::finishRequest(bool completed)
+{
+	if (mResponder.notNull())
+	{
+		bool success = completed && mEncoded && mFormattedImage->getDataSize() > 0;
+		mResponder->completed(success, mFormattedImage);
+	}
+	// Will automatically be deleted
+}
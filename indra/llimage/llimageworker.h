@@ -107,4 +107,51 @@ private:
 	LLMutex mCreationMutex;
 };
 
+// Encodes raw images into a formatted image (JPEG, PNG, ...) off the main thread,
+// so that large snapshots do not freeze the viewer while they are compressed.
+class LLImageEncodeThread : public LLQueuedThread
+{
+public:
+	class Responder : public LLThreadSafeRefCount
+	{
+	protected:
+		virtual ~Responder();
+	public:
+		// Called from the encode thread.
+		virtual void completed(bool success, LLImageFormatted* image) = 0;
+	};
+
+	class EncodeRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~EncodeRequest(); // use deleteRequest()
+
+	public:
+		EncodeRequest(handle_t handle, LLImageRaw* raw, LLImageFormatted* image,
+					  U32 priority, const std::string& comment, LLImageEncodeThread::Responder* responder);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+	private:
+		// input
+		LLPointer<LLImageRaw> mRawImage;
+		std::string mComment; // J2C only
+		// output
+		LLPointer<LLImageFormatted> mFormattedImage;
+		BOOL mEncoded;
+		LLPointer<LLImageEncodeThread::Responder> mResponder;
+	};
+
+public:
+	LLImageEncodeThread(bool threaded = true);
+	virtual ~LLImageEncodeThread();
+
+	// The encode thread owns raw until the responder is called: the caller must not modify it.
+	// comment is written into the code stream of J2C images and ignored by other codecs.
+	handle_t encodeImage(LLImageRaw* raw, LLImageFormatted* image,
+						 U32 priority, Responder* responder,
+						 const std::string& comment = LLStringUtil::null);
+};
+
 #endif
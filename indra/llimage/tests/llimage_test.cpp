@@ -0,0 +1,417 @@
+/** 
+ * @file llimage_test.cpp
+ * @brief Codec round trips and encode benchmarks for the image library.
+ * 
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimage.h"
+#include "../llimagedxt.h"
+#include "../llimagej2c.h"
+#include "../llimagejpeg.h"
+#include "../llimagepng.h"
+#include "../llimageworker.h"
+
+#include "../../llxml/llcontrol.h"
+#include "llmemory.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: LLImageJ2C reads its size settings through LLCachedControl, which uses the
+// viewer's global control group.
+
+LLControlGroup gSavedSettings("Global");
+
+// -------------------------------------------------------------------------------------------
+
+// The benchmarks log their timings at INFO level: run the test with --debug to see them.
+
+namespace
+{
+	void init_image_library()
+	{
+		static bool initialized = false;
+		if (!initialized)
+		{
+			LLPrivateMemoryPoolManager::initClass(FALSE, 0);
+			LLImage::initClass();
+			initialized = true;
+		}
+	}
+
+	// Smooth gradients with a little noise, closer to a snapshot than a flat color or pure noise.
+	LLPointer<LLImageRaw> make_test_image(U16 width, U16 height, S8 components)
+	{
+		LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+		U8* data = raw->getData();
+		U32 seed = 12345;
+		for (U32 y = 0; y < height; ++y)
+		{
+			for (U32 x = 0; x < width; ++x)
+			{
+				seed = seed * 1664525 + 1013904223;
+				U8 noise = seed >> 30;
+				for (S32 c = 0; c < components; ++c)
+				{
+					U32 value = c & 1 ? x * 255 / width : y * 255 / height;
+					*data++ = (U8) llmin(value + noise, (U32) 255);
+				}
+			}
+		}
+		return raw;
+	}
+
+	LLPointer<LLImageRaw> decode_image(LLImageFormatted* image)
+	{
+		if (!image->updateData())
+		{
+			return NULL;
+		}
+		// J2C guesses the discard level from the data size, decode it all
+		image->setDiscardLevel(0);
+		LLPointer<LLImageRaw> raw = new LLImageRaw(image->getWidth(), image->getHeight(), image->getComponents());
+		if (!image->decode(raw, 0.f))
+		{
+			return NULL;
+		}
+		return raw;
+	}
+
+	// Mean absolute difference per channel, or -1 when the images don't match in size.
+	F32 mean_error(LLImageRaw* a, LLImageRaw* b)
+	{
+		if (a->getWidth() != b->getWidth() || a->getHeight() != b->getHeight() ||
+			a->getComponents() != b->getComponents())
+		{
+			return -1.f;
+		}
+		S32 size = a->getWidth() * a->getHeight() * a->getComponents();
+		const U8* pa = a->getData();
+		const U8* pb = b->getData();
+		F64 error = 0.0;
+		for (S32 i = 0; i < size; ++i)
+		{
+			error += llabs((S32) pa[i] - (S32) pb[i]);
+		}
+		return (F32) (error / size);
+	}
+
+	class encode_responder : public LLImageEncodeThread::Responder
+	{
+	public:
+		encode_responder(volatile bool* done, volatile bool* success)
+			: mDone(done), mSuccess(success)
+		{
+			*mDone = false;
+			*mSuccess = false;
+		}
+		virtual void completed(bool success, LLImageFormatted* image)
+		{
+			*mSuccess = success;
+			*mDone = true;
+		}
+	private:
+		volatile bool* mDone;
+		volatile bool* mSuccess;
+	};
+
+	// Encodes raw into image on the encode thread. main_seconds is the time encodeImage() blocked
+	// the calling thread, total_seconds the time until the responder was called.
+	bool encode_on_thread(LLImageEncodeThread* thread, LLImageRaw* raw, LLImageFormatted* image,
+						  F64& main_seconds, F64& total_seconds)
+	{
+		volatile bool done = false;
+		volatile bool success = false;
+		LLTimer timer;
+		thread->encodeImage(raw, image, LLQueuedThread::PRIORITY_NORMAL, new encode_responder(&done, &success));
+		main_seconds = timer.getElapsedTimeF64();
+		thread->update(1);
+		while (!done)
+		{
+			ms_sleep(1);
+			thread->update(1);
+		}
+		total_seconds = timer.getElapsedTimeF64();
+		return success;
+	}
+
+	void unpack565(U16 packed, U8* color)
+	{
+		U32 r = (packed >> 11) & 0x1f;
+		U32 g = (packed >> 5) & 0x3f;
+		U32 b = packed & 0x1f;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Reference S3TC decoder for the top mip of a DXT1 (RGB) or DXT5 (RGBA) image,
+	// as the GL driver would expand it.
+	LLPointer<LLImageRaw> decode_s3tc(LLImageDXT* dxt)
+	{
+		S32 width = dxt->getWidth();
+		S32 height = dxt->getHeight();
+		S32 components = dxt->getComponents();
+		LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+		const U8* block = dxt->getData() + dxt->getMipOffset(0);
+		for (S32 by = 0; by < height; by += 4)
+		{
+			for (S32 bx = 0; bx < width; bx += 4)
+			{
+				U8 alpha[8];
+				U64 alpha_indices = 0;
+				if (components == 4)
+				{
+					alpha[0] = block[0];
+					alpha[1] = block[1];
+					for (S32 p = 1; p < 7; ++p)
+					{
+						alpha[p + 1] = alpha[0] > alpha[1] ? ((7 - p) * alpha[0] + p * alpha[1]) / 7
+														   : (p < 5 ? ((5 - p) * alpha[0] + p * alpha[1]) / 5 : (p == 5 ? 0 : 255));
+					}
+					for (S32 b = 0; b < 6; ++b)
+					{
+						alpha_indices |= (U64) block[2 + b] << (8 * b);
+					}
+					block += 8;
+				}
+
+				U16 color0 = block[0] | (block[1] << 8);
+				U16 color1 = block[2] | (block[3] << 8);
+				U8 palette[4][3];
+				unpack565(color0, palette[0]);
+				unpack565(color1, palette[1]);
+				for (S32 c = 0; c < 3; ++c)
+				{
+					if (color0 > color1)
+					{
+						palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+						palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+					}
+					else
+					{
+						palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+						palette[3][c] = 0;
+					}
+				}
+				U32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | (block[7] << 24);
+				block += 8;
+
+				for (S32 i = 0; i < 16; ++i)
+				{
+					S32 x = bx + (i & 3);
+					S32 y = by + (i >> 2);
+					if (x >= width || y >= height)
+					{
+						continue;
+					}
+					U8* pixel = raw->getData() + (y * width + x) * components;
+					const U8* color = palette[(indices >> (2 * i)) & 3];
+					pixel[0] = color[0];
+					pixel[1] = color[1];
+					pixel[2] = color[2];
+					if (components == 4)
+					{
+						pixel[3] = alpha[(alpha_indices >> (3 * i)) & 7];
+					}
+				}
+			}
+		}
+		return raw;
+	}
+
+	struct test_size
+	{
+		U16 mWidth;
+		U16 mHeight;
+	};
+
+	// From a small preview up to a high resolution snapshot
+	const test_size SNAPSHOT_SIZES[] = { { 256, 256 }, { 1024, 768 }, { 2048, 1536 }, { 6144, 4096 } };
+	const S32 NUM_SNAPSHOT_SIZES = sizeof(SNAPSHOT_SIZES) / sizeof(SNAPSHOT_SIZES[0]);
+
+	// Texture and bake uploads
+	const test_size TEXTURE_SIZES[] = { { 256, 256 }, { 512, 512 }, { 1024, 1024 }, { 2048, 2048 } };
+	const S32 NUM_TEXTURE_SIZES = sizeof(TEXTURE_SIZES) / sizeof(TEXTURE_SIZES[0]);
+}
+
+namespace tut
+{
+	struct image_test
+	{
+		LLImageEncodeThread* mEncodeThread;
+
+		image_test()
+		{
+			init_image_library();
+			mEncodeThread = new LLImageEncodeThread(true);
+		}
+		~image_test()
+		{
+			delete mEncodeThread;
+		}
+	};
+	typedef test_group<image_test> image_test_t;
+	typedef image_test_t::object image_test_object_t;
+	tut::image_test_t tut_image_test("LLImage");
+
+	// JPEG snapshots encode on the encode thread, by resolution
+	template<> template<>
+	void image_test_object_t::test<1>()
+	{
+		for (S32 i = 0; i < NUM_SNAPSHOT_SIZES; ++i)
+		{
+			const test_size& size = SNAPSHOT_SIZES[i];
+			LLPointer<LLImageRaw> raw = make_test_image(size.mWidth, size.mHeight, 3);
+			LLPointer<LLImageJPEG> jpeg = new LLImageJPEG(75);
+
+			F64 main_seconds, total_seconds;
+			ensure("JPEG encoded", encode_on_thread(mEncodeThread, raw, jpeg, main_seconds, total_seconds));
+			llinfos << "JPEG " << size.mWidth << "x" << size.mHeight << ": " << jpeg->getDataSize() << " bytes, encode "
+					<< total_seconds * 1000.0 << " ms, main thread " << main_seconds * 1000.0 << " ms" << llendl;
+
+			LLPointer<LLImageRaw> decoded = decode_image(jpeg);
+			ensure("JPEG decoded", decoded.notNull());
+			F32 error = mean_error(raw, decoded);
+			ensure("JPEG size kept", error >= 0.f);
+			ensure("JPEG quality", error < 4.f);
+		}
+	}
+
+	// PNG snapshots encode on the encode thread, by resolution, and stay lossless
+	template<> template<>
+	void image_test_object_t::test<2>()
+	{
+		for (S32 i = 0; i < NUM_SNAPSHOT_SIZES; ++i)
+		{
+			const test_size& size = SNAPSHOT_SIZES[i];
+			LLPointer<LLImageRaw> raw = make_test_image(size.mWidth, size.mHeight, 3);
+			LLPointer<LLImagePNG> png = new LLImagePNG();
+
+			F64 main_seconds, total_seconds;
+			ensure("PNG encoded", encode_on_thread(mEncodeThread, raw, png, main_seconds, total_seconds));
+			llinfos << "PNG " << size.mWidth << "x" << size.mHeight << ": " << png->getDataSize() << " bytes, encode "
+					<< total_seconds * 1000.0 << " ms, main thread " << main_seconds * 1000.0 << " ms" << llendl;
+
+			LLPointer<LLImageRaw> decoded = decode_image(png);
+			ensure("PNG decoded", decoded.notNull());
+			ensure_equals("PNG lossless", mean_error(raw, decoded), 0.f);
+		}
+	}
+
+	// J2C texture uploads encode on the encode thread, by resolution
+	template<> template<>
+	void image_test_object_t::test<3>()
+	{
+		for (S32 i = 0; i < NUM_TEXTURE_SIZES; ++i)
+		{
+			const test_size& size = TEXTURE_SIZES[i];
+			LLPointer<LLImageRaw> raw = make_test_image(size.mWidth, size.mHeight, 3);
+			LLPointer<LLImageJ2C> j2c = new LLImageJ2C();
+
+			F64 main_seconds, total_seconds;
+			ensure("J2C encoded", encode_on_thread(mEncodeThread, raw, j2c, main_seconds, total_seconds));
+			llinfos << "J2C " << size.mWidth << "x" << size.mHeight << ": " << j2c->getDataSize() << " bytes, encode "
+					<< total_seconds * 1000.0 << " ms, main thread " << main_seconds * 1000.0 << " ms" << llendl;
+
+			LLPointer<LLImageRaw> decoded = decode_image(j2c);
+			ensure("J2C decoded", decoded.notNull());
+			F32 error = mean_error(raw, decoded);
+			ensure("J2C size kept", error >= 0.f);
+			ensure("J2C quality", error < 4.f);
+		}
+	}
+
+	// reversible J2C stays lossless through the encode thread
+	template<> template<>
+	void image_test_object_t::test<4>()
+	{
+		LLPointer<LLImageRaw> raw = make_test_image(256, 256, 4);
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C();
+		j2c->setReversible(TRUE);
+
+		F64 main_seconds, total_seconds;
+		ensure("J2C encoded", encode_on_thread(mEncodeThread, raw, j2c, main_seconds, total_seconds));
+		LLPointer<LLImageRaw> decoded = decode_image(j2c);
+		ensure("J2C decoded", decoded.notNull());
+		ensure_equals("J2C lossless", mean_error(raw, decoded), 0.f);
+	}
+
+	// DXT1 compression of fetched RGB textures, by resolution
+	template<> template<>
+	void image_test_object_t::test<5>()
+	{
+		for (S32 i = 0; i < NUM_TEXTURE_SIZES; ++i)
+		{
+			const test_size& size = TEXTURE_SIZES[i];
+			LLPointer<LLImageRaw> raw = make_test_image(size.mWidth, size.mHeight, 3);
+			LLPointer<LLImageDXT> dxt = new LLImageDXT();
+
+			LLTimer timer;
+			ensure("DXT1 encoded", dxt->encodeS3TC(raw));
+			F64 seconds = timer.getElapsedTimeF64();
+			llinfos << "DXT1 " << size.mWidth << "x" << size.mHeight << ": " << dxt->getDataSize() << " bytes, encode "
+					<< seconds * 1000.0 << " ms" << llendl;
+
+			ensure_equals("DXT1 format", dxt->getFileFormat(), LLImageDXT::FORMAT_DXR1);
+			ensure_equals("top mip", dxt->getMipLevel(size.mWidth, size.mHeight), 0);
+			ensure_equals("last mip", dxt->getMipLevel(1, 1), LLImageDXT::calcNumMips(size.mWidth, size.mHeight) - 1);
+			// 4 bits per pixel, a third more for the mips
+			ensure("DXT1 size", dxt->getDataSize() * 6 < raw->getDataSize() * 4 / 3 + 1024);
+
+			F32 error = mean_error(raw, decode_s3tc(dxt));
+			llinfos << "DXT1 " << size.mWidth << "x" << size.mHeight << ": mean error " << error << llendl;
+			ensure("DXT1 quality", error >= 0.f && error < 4.f);
+		}
+	}
+
+	// DXT5 keeps the alpha channel of RGBA textures, and non-square textures take it too
+	template<> template<>
+	void image_test_object_t::test<6>()
+	{
+		LLPointer<LLImageRaw> raw = make_test_image(512, 128, 4);
+		LLPointer<LLImageDXT> dxt = new LLImageDXT();
+
+		ensure("DXT5 encoded", dxt->encodeS3TC(raw));
+		ensure_equals("DXT5 format", dxt->getFileFormat(), LLImageDXT::FORMAT_DXR5);
+		ensure_equals("top mip", dxt->getMipLevel(512, 128), 0);
+		ensure_equals("smallest mip", dxt->getMipLevel(4, 1), LLImageDXT::calcNumMips(512, 128) - 1);
+
+		F32 error = mean_error(raw, decode_s3tc(dxt));
+		ensure("DXT5 quality", error >= 0.f && error < 4.f);
+
+		// not a power of two
+		LLPointer<LLImageRaw> odd = make_test_image(100, 100, 3);
+		LLPointer<LLImageDXT> odd_dxt = new LLImageDXT();
+		ensure("non power of two refused", !odd_dxt->encodeS3TC(odd));
+	}
+}
@@ -38,6 +38,7 @@
 #include <algorithm>
 // Class to test
 #include "../llimageworker.h"
+#include "../llimagej2c.h"
 // For timer class
 #include "../llcommon/lltimer.h"
 // Tut header
@@ -51,7 +52,7 @@
 // * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
 // * A simulator for a class can be implemented here. Please comment and document thoroughly.
 
-LLImageBase::LLImageBase() {}
+LLImageBase::LLImageBase() : mMemType(LLMemType::MTYPE_IMAGEBASE) {}
 LLImageBase::~LLImageBase() {}
 void LLImageBase::dump() { }
 void LLImageBase::sanityCheck() { }
@@ -65,6 +66,42 @@ void LLImageRaw::deleteData() { }
 U8* LLImageRaw::allocateData(S32 size) { return NULL; }
 U8* LLImageRaw::reallocateData(S32 size) { return NULL; }
 
+LLImageFormatted::LLImageFormatted(S8 codec) : mCodec(codec) { }
+LLImageFormatted::~LLImageFormatted() { }
+void LLImageFormatted::deleteData() { }
+U8* LLImageFormatted::allocateData(S32 size) { return NULL; }
+U8* LLImageFormatted::reallocateData(S32 size) { return NULL; }
+void LLImageFormatted::dump() { }
+void LLImageFormatted::sanityCheck() { }
+S32 LLImageFormatted::calcDataSize(S32 discard_level) { return 0; }
+S32 LLImageFormatted::calcDiscardLevelBytes(S32 bytes) { return 0; }
+BOOL LLImageFormatted::decodeChannels(LLImageRaw* raw_image, F32 decode_time, S32 first_channel, S32 max_channel) { return FALSE; }
+void LLImageFormatted::resetLastError() { }
+void LLImageFormatted::setLastError(const std::string& message, const std::string& filename) { }
+S8 LLImageFormatted::getCodec() const { return mCodec; }
+
+BOOL LLImageJ2C::encode(const LLImageRaw *raw_imagep, const char* comment_text, F32 encode_time) { return FALSE; }
+
+// Simulator for a formatted image: encode() records that it ran and leaves one byte of
+// "compressed" data behind, so that the encode thread reports a successful encode.
+class LLImageFormattedTest : public LLImageFormatted
+{
+public:
+	LLImageFormattedTest() : LLImageFormatted(IMG_CODEC_PNG), mEncodeCalls(0), mByte(0) { }
+	/*virtual*/ std::string getExtension() { return std::string("png"); }
+	/*virtual*/ BOOL updateData() { return FALSE; }
+	/*virtual*/ BOOL decode(LLImageRaw* raw_image, F32 decode_time) { return FALSE; }
+	/*virtual*/ BOOL encode(const LLImageRaw* raw_image, F32 encode_time)
+	{
+		++mEncodeCalls;
+		setDataAndSize(&mByte, 1);
+		return TRUE;
+	}
+	S32 mEncodeCalls;
+private:
+	U8 mByte;
+};
+
 // End Stubbing
 // -------------------------------------------------------------------------------------------
 
@@ -105,6 +142,27 @@ namespace tut
 			bool* done;
 	};
 
+	// Same minimal responder for the encode thread, also recording whether the encode succeeded
+	class encode_responder_test : public LLImageEncodeThread::Responder
+	{
+		public:
+			encode_responder_test(bool* res, bool* success)
+			{
+				done = res;
+				succeeded = success;
+				*done = false;
+				*succeeded = false;
+			}
+			virtual void completed(bool success, LLImageFormatted* image)
+			{
+				*succeeded = success;
+				*done = true;
+			}
+		private:
+			bool* done;
+			bool* succeeded;
+	};
+
 	// Test wrapper declaration : decode thread
 	struct imagedecodethread_test
 	{
@@ -122,6 +180,23 @@ namespace tut
 		}
 	};
 
+	// Test wrapper declaration : encode thread
+	struct imageencodethread_test
+	{
+		// Instance to be tested
+		LLImageEncodeThread* mThread;
+
+		// Constructor and destructor of the test wrapper
+		imageencodethread_test()
+		{
+			mThread = NULL;
+		}
+		~imageencodethread_test()
+		{
+			delete mThread;
+		}
+	};
+
 	// Test wrapper declaration : image worker
 	// Note: this class is not meant to be instantiated outside an LLImageDecodeThread instance
 	// but it's not a bad idea to get its public API a good shake as part of a thorough unit test set.
@@ -153,6 +228,10 @@ namespace tut
 	typedef imagedecodethread_t::object imagedecodethread_object_t;
 	tut::imagedecodethread_t tut_imagedecodethread("imagedecodethread");
 
+	typedef test_group<imageencodethread_test> imageencodethread_t;
+	typedef imageencodethread_t::object imageencodethread_object_t;
+	tut::imageencodethread_t tut_imageencodethread("imageencodethread");
+
 	typedef test_group<imagerequest_test> imagerequest_t;
 	typedef imagerequest_t::object imagerequest_object_t;
 	tut::imagerequest_t tut_imagerequest("imagerequest");
@@ -239,6 +318,58 @@ namespace tut
 		ensure("LLImageDecodeThread: threaded work unit not processed", done == true);
 	}
 
+	// ---------------------------------------------------------------------------------------
+	// Test the LLImageEncodeThread interface
+	// ---------------------------------------------------------------------------------------
+
+	template<> template<>
+	void imageencodethread_object_t::test<1>()
+	{
+		// Test a *non threaded* instance of the class
+		mThread = new LLImageEncodeThread(false);
+		ensure("LLImageEncodeThread: non threaded constructor failed", mThread != NULL);
+		// Queue a request that has nothing to encode
+		bool done = false;
+		bool success = false;
+		LLImageEncodeThread::handle_t encodeHandle = mThread->encodeImage(NULL, NULL, LLQueuedThread::PRIORITY_NORMAL, new encode_responder_test(&done, &success));
+		ensure("LLImageEncodeThread: non threaded encodeImage(), returned handle is null", encodeHandle != 0);
+		ensure("LLImageEncodeThread: non threaded request processed before update()", done == false);
+		// Trigger queue handling "manually"
+		S32 res = mThread->update(0);
+		ensure("LLImageEncodeThread: non threaded update() list handling test failed", res == 0);
+		// The responder is called, and reports the failure
+		ensure("LLImageEncodeThread: non threaded work unit not processed", done == true);
+		ensure("LLImageEncodeThread: encode without input reported as successful", success == false);
+	}
+
+	template<> template<>
+	void imageencodethread_object_t::test<2>()
+	{
+		// Test a *threaded* instance of the class
+		mThread = new LLImageEncodeThread(true);
+		ensure("LLImageEncodeThread: threaded constructor failed", mThread != NULL);
+		LLPointer<LLImageRaw> raw = new LLImageRaw(4, 4, 3);
+		LLPointer<LLImageFormattedTest> image = new LLImageFormattedTest();
+		bool done = false;
+		bool success = false;
+		LLImageEncodeThread::handle_t encodeHandle = mThread->encodeImage(raw, image, LLQueuedThread::PRIORITY_NORMAL, new encode_responder_test(&done, &success));
+		ensure("LLImageEncodeThread: threaded encodeImage(), returned handle is null", encodeHandle != 0);
+		// Wake the thread up and wait till it has handled the work order
+		mThread->update(1);
+		const U32 INCREMENT_TIME = 500;				// 500 milliseconds
+		const U32 MAX_TIME = 20 * INCREMENT_TIME;	// Do the loop 20 times max, i.e. wait 10 seconds but no more
+		U32 total_time = 0;
+		while ((done == false) && (total_time < MAX_TIME))
+		{
+			ms_sleep(INCREMENT_TIME);
+			total_time += INCREMENT_TIME;
+		}
+		ensure("LLImageEncodeThread: threaded work unit not processed", done == true);
+		// The codec of the formatted image is used, once, and its output is reported as a success
+		ensure_equals("LLImageEncodeThread: formatted image encode() calls", image->mEncodeCalls, 1);
+		ensure("LLImageEncodeThread: threaded encode not reported as successful", success == true);
+	}
+
 	// ---------------------------------------------------------------------------------------
 	// Test the LLImageDecodeThread::ImageRequest interface
 	// ---------------------------------------------------------------------------------------
@@ -391,6 +391,9 @@ BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 	if (!bSuccess)
 	{
 		opj_cio_close(cio);
+		opj_destroy_compress(cinfo);
+		if(parameters.cp_matrice) free(parameters.cp_matrice);
+		opj_image_destroy(image);
 		llinfos << "Failed to encode image." << llendl;
 		return FALSE;
 	}
@@ -34,6 +34,7 @@
 #include "llmath.h"
 
 #include <set>
+#include <sstream>
 
 #include "llerror.h"
 #include "llmemtype.h"
@@ -49,6 +50,7 @@
 #include "lldarray.h"
 #include "llvolume.h"
 #include "llvolumeoctree.h"
+#include "llvolumebvh.h"
 #include "llstl.h"
 #include "llsdserialize.h"
 #include "llvector4a.h"
@@ -2068,7 +2070,7 @@ LLProfile::~LLProfile()
 }
 
 
-S32 LLVolume::sNumMeshPoints = 0;
+LLAtomicS32 LLVolume::sNumMeshPoints(0);
 
 LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
 	: mParams(params)
@@ -2403,19 +2405,499 @@ bool LLVolumeFace::VertexData::compareNormal(const LLVolumeFace::VertexData& rhs
 	return retval;
 }
 
+namespace
+{
+	// One face of a mesh LOD block. The binaries point either into the
+	// inflated block or into mOwned when it came through LLSD.
+	struct LLMeshFaceBlock
+	{
+		enum
+		{
+			POSITION = 0,
+			NORMAL,
+			TEXCOORD0,
+			TRIANGLE_LIST,
+			WEIGHTS,
+			NUM_BINARIES
+		};
+
+		LLMeshFaceBlock()
+			: mNoGeometry(false),
+			  mHasWeights(false)
+		{
+			for (S32 i = 0; i < NUM_BINARIES; i++)
+			{
+				mData[i] = NULL;
+				mSize[i] = 0;
+			}
+		}
+
+		void setOwned(S32 i, const LLSD& sd)
+		{
+			mOwned[i] = sd.asBinary();
+			mData[i] = mOwned[i].empty() ? NULL : &mOwned[i][0];
+			mSize[i] = mOwned[i].size();
+		}
+
+		bool mNoGeometry;
+		bool mHasWeights;
+		const U8* mData[NUM_BINARIES];
+		U32 mSize[NUM_BINARIES];
+		LLSD::Binary mOwned[NUM_BINARIES];
+		LLVector3 mMinPos, mMaxPos;
+		LLVector2 mMinTC, mMaxTC;
+	};
+
+	// Walks an inflated mesh LOD block in place (binary LLSD, see LLSDBinaryParser)
+	// and picks out the face fields without building an LLSD tree.
+	// Anything it does not expect makes it bail out to the LLSD parser.
+	class LLMeshLODReader
+	{
+	public:
+		LLMeshLODReader(const U8* data, U32 size)
+			: mCur(data),
+			  mEnd(data + size)
+		{
+		}
+
+		bool readFaces(std::vector<LLMeshFaceBlock>& blocks)
+		{
+			U32 count;
+			if (!readType('[') || !readU32(count) || count > (U32)(mEnd - mCur))
+			{
+				return false;
+			}
+			blocks.resize(count);
+			for (U32 i = 0; i < count; ++i)
+			{
+				if (!readFace(blocks[i]))
+				{
+					return false;
+				}
+			}
+			return readType(']');
+		}
+
+	private:
+		bool readFace(LLMeshFaceBlock& block)
+		{
+			U32 count;
+			if (!readType('{') || !readU32(count))
+			{
+				return false;
+			}
+			for (U32 i = 0; i < count; ++i)
+			{
+				const char* key;
+				U32 len;
+				if (!readKey(key, len))
+				{
+					return false;
+				}
+
+				std::string name(key, len);
+				S32 binary = -1;
+				if (name == "Position")
+				{
+					binary = LLMeshFaceBlock::POSITION;
+				}
+				else if (name == "Normal")
+				{
+					binary = LLMeshFaceBlock::NORMAL;
+				}
+				else if (name == "TexCoord0")
+				{
+					binary = LLMeshFaceBlock::TEXCOORD0;
+				}
+				else if (name == "TriangleList")
+				{
+					binary = LLMeshFaceBlock::TRIANGLE_LIST;
+				}
+				else if (name == "Weights")
+				{
+					binary = LLMeshFaceBlock::WEIGHTS;
+					block.mHasWeights = true;
+				}
+
+				bool ok;
+				if (binary >= 0)
+				{
+					ok = readBinary(block.mData[binary], block.mSize[binary]);
+				}
+				else if (name == "PositionDomain")
+				{
+					ok = readDomain(block.mMinPos.mV, block.mMaxPos.mV, 3);
+				}
+				else if (name == "TexCoord0Domain")
+				{
+					ok = readDomain(block.mMinTC.mV, block.mMaxTC.mV, 2);
+				}
+				else
+				{
+					block.mNoGeometry = block.mNoGeometry || name == "NoGeometry";
+					ok = skipValue();
+				}
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return readType('}');
+		}
+
+		bool readDomain(F32* min, F32* max, U32 components)
+		{
+			U32 count;
+			if (!readType('{') || !readU32(count))
+			{
+				return false;
+			}
+			for (U32 i = 0; i < count; ++i)
+			{
+				const char* key;
+				U32 len;
+				if (!readKey(key, len))
+				{
+					return false;
+				}
+				std::string name(key, len);
+				bool ok;
+				if (name == "Min")
+				{
+					ok = readReals(min, components);
+				}
+				else if (name == "Max")
+				{
+					ok = readReals(max, components);
+				}
+				else
+				{
+					ok = skipValue();
+				}
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return readType('}');
+		}
+
+		bool readReals(F32* values, U32 components)
+		{
+			U32 count;
+			if (!readType('[') || !readU32(count) || count < components)
+			{
+				return false;
+			}
+			for (U32 i = 0; i < count; ++i)
+			{
+				if (i < components)
+				{
+					if (!readReal(values[i]))
+					{
+						return false;
+					}
+				}
+				else if (!skipValue())
+				{
+					return false;
+				}
+			}
+			return readType(']');
+		}
+
+		bool readReal(F32& value)
+		{
+			if (mCur >= mEnd)
+			{
+				return false;
+			}
+			U8 type = *mCur++;
+			if (type == 'r')
+			{
+				if (mEnd - mCur < 8)
+				{
+					return false;
+				}
+				U8 bytes[8];
+				for (S32 i = 0; i < 8; ++i)
+				{
+					bytes[i] = mCur[7 - i]; // network byte order
+				}
+				F64 real;
+				memcpy(&real, bytes, 8);
+				value = (F32) real;
+				mCur += 8;
+				return true;
+			}
+			if (type == 'i')
+			{
+				U32 integer;
+				if (!readU32(integer))
+				{
+					return false;
+				}
+				value = (F32)(S32) integer;
+				return true;
+			}
+			return false;
+		}
+
+		bool readKey(const char*& key, U32& len)
+		{
+			if (!readType('k') || !readU32(len) || len > (U32)(mEnd - mCur))
+			{
+				return false;
+			}
+			key = (const char*) mCur;
+			mCur += len;
+			return true;
+		}
+
+		bool readBinary(const U8*& data, U32& size)
+		{
+			if (!readType('b') || !readU32(size) || size > (U32)(mEnd - mCur))
+			{
+				return false;
+			}
+			data = size ? mCur : NULL;
+			mCur += size;
+			return true;
+		}
+
+		bool skipValue()
+		{
+			if (mCur >= mEnd)
+			{
+				return false;
+			}
+			U32 count;
+			switch (*mCur++)
+			{
+			case '!':
+			case '1':
+			case '0':
+				return true;
+			case 'i':
+				return skip(4);
+			case 'r':
+			case 'd':
+				return skip(8);
+			case 'u':
+				return skip(16);
+			case 'b':
+			case 's':
+			case 'l':
+				return readU32(count) && skip(count);
+			case '[':
+				if (!readU32(count))
+				{
+					return false;
+				}
+				for (U32 i = 0; i < count; ++i)
+				{
+					if (!skipValue())
+					{
+						return false;
+					}
+				}
+				return readType(']');
+			case '{':
+				if (!readU32(count))
+				{
+					return false;
+				}
+				for (U32 i = 0; i < count; ++i)
+				{
+					const char* key;
+					U32 len;
+					if (!readKey(key, len) || !skipValue())
+					{
+						return false;
+					}
+				}
+				return readType('}');
+			default:
+				return false;
+			}
+		}
+
+		bool readType(U8 type)
+		{
+			if (mCur >= mEnd || *mCur != type)
+			{
+				return false;
+			}
+			++mCur;
+			return true;
+		}
+
+		bool readU32(U32& value)
+		{
+			if (mEnd - mCur < 4)
+			{
+				return false;
+			}
+			value = ((U32) mCur[0] << 24) | ((U32) mCur[1] << 16) | ((U32) mCur[2] << 8) | (U32) mCur[3];
+			mCur += 4;
+			return true;
+		}
+
+		bool skip(U32 bytes)
+		{
+			if ((U32)(mEnd - mCur) < bytes)
+			{
+				return false;
+			}
+			mCur += bytes;
+			return true;
+		}
+
+		const U8* mCur;
+		const U8* mEnd;
+	};
+
+	void read_mesh_face_llsd(const LLSD& sd, LLMeshFaceBlock& block)
+	{
+		if (sd.has("NoGeometry"))
+		{
+			block.mNoGeometry = true;
+			return;
+		}
+
+		block.setOwned(LLMeshFaceBlock::POSITION, sd["Position"]);
+		block.setOwned(LLMeshFaceBlock::NORMAL, sd["Normal"]);
+		block.setOwned(LLMeshFaceBlock::TEXCOORD0, sd["TexCoord0"]);
+		block.setOwned(LLMeshFaceBlock::TRIANGLE_LIST, sd["TriangleList"]);
+		if (sd.has("Weights"))
+		{
+			block.mHasWeights = true;
+			block.setOwned(LLMeshFaceBlock::WEIGHTS, sd["Weights"]);
+		}
+
+		block.mMinPos.setValue(sd["PositionDomain"]["Min"]);
+		block.mMaxPos.setValue(sd["PositionDomain"]["Max"]);
+		// LLVector2::setValue() takes a non-const LLSD
+		LLSD tc_domain = sd["TexCoord0Domain"];
+		block.mMinTC.setValue(tc_domain["Min"]);
+		block.mMaxTC.setValue(tc_domain["Max"]);
+	}
+
+	// Dequantizes count points of 3 U16s into out as offset + q * scale,
+	// converting a whole point per SSE2 op.
+	void dequantize_u16x3(LLVector4a* out, const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		U32 i = 0;
+		// 8 byte loads read the first U16 of the next point, do the last one by hand
+		for (; i + 1 < count; ++i)
+		{
+			__m128i q = _mm_loadl_epi64((const __m128i*) (in + i * 6));
+			LLVector4a v;
+			v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(q, zero));
+			out[i].setMul(v, scale);
+			out[i].add(offset);
+		}
+		if (i < count)
+		{
+			const U16* q = (const U16*) (in + i * 6);
+			out[i].set((F32) q[0], (F32) q[1], (F32) q[2]);
+			out[i].mul(scale);
+			out[i].add(offset);
+		}
+	}
+
+	// Same for count texture coordinates of 2 U16s, two per LLVector4a.
+	void dequantize_u16x2(LLVector2* tc, const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		LLVector4a* out = (LLVector4a*) tc;
+		U32 i = 0;
+		for (; i + 2 <= count; i += 2, ++out)
+		{
+			__m128i q = _mm_loadl_epi64((const __m128i*) (in + i * 4));
+			LLVector4a v;
+			v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(q, zero));
+			out->setMul(v, scale);
+			out->add(offset);
+		}
+		if (i < count)
+		{
+			const U16* q = (const U16*) (in + i * 4);
+			out->set((F32) q[0], (F32) q[1], 0.f, 0.f);
+			out->mul(scale);
+			out->add(offset);
+		}
+	}
+}
+
+// one per thread (the mesh thread does most of the decoding), grows to the largest LOD block.
+// Thread locals can't free themselves when their thread exits, so one that grew past
+// MESH_LOD_BUFFER_KEEP for an unusually large block is released again right away.
+static ll_thread_local U8* sMeshLODBuffer = NULL;
+static ll_thread_local U32 sMeshLODBufferSize = 0;
+static const U32 MESH_LOD_BUFFER_KEEP = 4 * 1024 * 1024;
+
+class LLMeshLODBufferTrim
+{
+public:
+	~LLMeshLODBufferTrim()
+	{
+		if (sMeshLODBufferSize > MESH_LOD_BUFFER_KEEP)
+		{
+			free(sMeshLODBuffer);
+			sMeshLODBuffer = NULL;
+			sMeshLODBufferSize = 0;
+		}
+	}
+};
+
 bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 {
+	LLMeshLODBufferTrim trim; // after the faces are copied out of the buffer
+
 	//input stream is now pointing at a zlib compressed block of LLSD
 	//decompress block
-	LLSD mdl;
-	if (!unzip_llsd(mdl, is, size))
+	S32 data_size = unzip_block(is, size, &sMeshLODBuffer, &sMeshLODBufferSize);
+	if (data_size < 0)
 	{
 		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD, will probably fetch from sim again." << llendl;
 		return false;
 	}
+
+	const U8* data = sMeshLODBuffer;
+	const char DEPRECATED_HEADER[] = "<? LLSD/Binary ?>";
+	const S32 DEPRECATED_HEADER_SIZE = sizeof(DEPRECATED_HEADER) - 1;
+	if (data_size > DEPRECATED_HEADER_SIZE && !memcmp(data, DEPRECATED_HEADER, DEPRECATED_HEADER_SIZE))
+	{
+		data += DEPRECATED_HEADER_SIZE + 1;
+		data_size -= DEPRECATED_HEADER_SIZE + 1;
+	}
+
+	std::vector<LLMeshFaceBlock> blocks;
+	LLMeshLODReader reader(data, data_size);
+	if (!reader.readFaces(blocks))
+	{
+		// not laid out the way the reader expects, go through LLSD
+		LLSD mdl;
+		std::string res_str((const char*) data, data_size);
+		std::istringstream istr(res_str);
+		if (!LLSDSerialize::fromBinary(mdl, istr, data_size))
+		{
+			LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD, will probably fetch from sim again." << llendl;
+			return false;
+		}
+
+		blocks.clear();
+		blocks.resize(mdl.size());
+		for (U32 i = 0; i < blocks.size(); ++i)
+		{
+			read_mesh_face_llsd(mdl[i], blocks[i]);
+		}
+	}
 	
 	{
-		U32 face_count = mdl.size();
+		U32 face_count = blocks.size();
 
 		if (face_count == 0)
 		{ //no faces unpacked, treat as failed decode
@@ -2428,8 +2910,9 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 		for (U32 i = 0; i < face_count; ++i)
 		{
 			LLVolumeFace& face = mVolumeFaces[i];
+			const LLMeshFaceBlock& block = blocks[i];
 
-			if (mdl[i].has("NoGeometry"))
+			if (block.mNoGeometry)
 			{ //face has no geometry, continue
 				face.resizeIndices(3);
 				face.resizeVertices(1);
@@ -2440,132 +2923,76 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 				continue;
 			}
 
-			LLSD::Binary pos = mdl[i]["Position"];
-			LLSD::Binary norm = mdl[i]["Normal"];
-			LLSD::Binary tc = mdl[i]["TexCoord0"];
-			LLSD::Binary idx = mdl[i]["TriangleList"];
-
-			
+			const U8* pos = block.mData[LLMeshFaceBlock::POSITION];
+			const U8* norm = block.mData[LLMeshFaceBlock::NORMAL];
+			const U8* tc = block.mData[LLMeshFaceBlock::TEXCOORD0];
+			const U8* idx = block.mData[LLMeshFaceBlock::TRIANGLE_LIST];
+			U32 idx_size = block.mSize[LLMeshFaceBlock::TRIANGLE_LIST];
 
 			//copy out indices
-			face.resizeIndices(idx.size()/2);
+			face.resizeIndices(idx_size/2);
 			
-			if (idx.empty() || face.mNumIndices < 3)
+			if (!idx || face.mNumIndices < 3)
 			{ //why is there an empty index list?
 				llwarns <<"Empty face present!" << llendl;
 				continue;
 			}
 
-			U16* indices = (U16*) &(idx[0]);
-			U32 count = idx.size()/2;
-			for (U32 j = 0; j < count; ++j)
-			{
-				face.mIndices[j] = indices[j];
-			}
+			memcpy(face.mIndices, idx, (idx_size/2)*sizeof(U16));
 
 			//copy out vertices
-			U32 num_verts = pos.size()/(3*2);
+			U32 num_verts = block.mSize[LLMeshFaceBlock::POSITION]/(3*2);
 			face.resizeVertices(num_verts);
 
-			LLVector3 minp;
-			LLVector3 maxp;
-			LLVector2 min_tc; 
-			LLVector2 max_tc; 
-		
-			minp.setValue(mdl[i]["PositionDomain"]["Min"]);
-			maxp.setValue(mdl[i]["PositionDomain"]["Max"]);
-			LLVector4a min_pos, max_pos;
-			min_pos.load3(minp.mV);
-			max_pos.load3(maxp.mV);
-
-			min_tc.setValue(mdl[i]["TexCoord0Domain"]["Min"]);
-			max_tc.setValue(mdl[i]["TexCoord0Domain"]["Max"]);
+			const LLVector3& minp = block.mMinPos;
+			const LLVector3& maxp = block.mMaxPos;
+			const LLVector2& min_tc = block.mMinTC;
+			const LLVector2& max_tc = block.mMaxTC;
 
-			LLVector4a pos_range;
-			pos_range.setSub(max_pos, min_pos);
-			LLVector2 tc_range2 = max_tc - min_tc;
-			LLVector4a tc_range;
-			tc_range.set(tc_range2[0], tc_range2[1], tc_range2[0], tc_range2[1]);
-			LLVector4a min_tc4(min_tc[0], min_tc[1], min_tc[0], min_tc[1]);
-
-			LLVector4a* pos_out = face.mPositions;
-			LLVector4a* norm_out = face.mNormals;
-			LLVector4a* tc_out = (LLVector4a*) face.mTexCoords;
+			// q / 65535 * range + min, folded into one multiply-add per vertex
+			const F32 QUANT = 1.f / 65535.f;
+			LLVector4a pos_scale((maxp[0]-minp[0])*QUANT, (maxp[1]-minp[1])*QUANT, (maxp[2]-minp[2])*QUANT, 0.f);
+			LLVector4a min_pos(minp[0], minp[1], minp[2], 0.f);
 
+			if (num_verts)
 			{
-				U16* v = (U16*) &(pos[0]);
-				for (U32 j = 0; j < num_verts; ++j)
-				{
-					pos_out->set((F32) v[0], (F32) v[1], (F32) v[2]);
-					pos_out->div(65535.f);
-					pos_out->mul(pos_range);
-					pos_out->add(min_pos);
-					pos_out++;
-					v += 3;
-				}
-
+				dequantize_u16x3(face.mPositions, pos, num_verts, pos_scale, min_pos);
 			}
 
+			if (norm && block.mSize[LLMeshFaceBlock::NORMAL] >= num_verts*6)
 			{
-				if (!norm.empty())
-				{
-					U16* n = (U16*) &(norm[0]);
-					for (U32 j = 0; j < num_verts; ++j)
-					{
-						norm_out->set((F32) n[0], (F32) n[1], (F32) n[2]);
-						norm_out->div(65535.f);
-						norm_out->mul(2.f);
-						norm_out->sub(1.f);
-						norm_out++;
-						n += 3;
-					}
-				}
-				else
-				{
-					memset(norm_out, 0, sizeof(LLVector4a)*num_verts);
-				}
+				LLVector4a norm_scale(2.f*QUANT, 2.f*QUANT, 2.f*QUANT, 0.f);
+				LLVector4a norm_offset(-1.f, -1.f, -1.f, 0.f);
+				dequantize_u16x3(face.mNormals, norm, num_verts, norm_scale, norm_offset);
 			}
-
+			else
 			{
-				if (!tc.empty())
-				{
-					U16* t = (U16*) &(tc[0]);
-					for (U32 j = 0; j < num_verts; j+=2)
-					{
-						if (j < num_verts-1)
-						{
-							tc_out->set((F32) t[0], (F32) t[1], (F32) t[2], (F32) t[3]);
-						}
-						else
-						{
-							tc_out->set((F32) t[0], (F32) t[1], 0.f, 0.f);
-						}
-
-						t += 4;
-
-						tc_out->div(65535.f);
-						tc_out->mul(tc_range);
-						tc_out->add(min_tc4);
+				memset(face.mNormals, 0, sizeof(LLVector4a)*num_verts);
+			}
 
-						tc_out++;
-					}
-				}
-				else
-				{
-					memset(tc_out, 0, sizeof(LLVector2)*num_verts);
-				}
+			if (tc && block.mSize[LLMeshFaceBlock::TEXCOORD0] >= num_verts*4)
+			{
+				LLVector2 tc_range2 = max_tc - min_tc;
+				LLVector4a tc_scale(tc_range2[0]*QUANT, tc_range2[1]*QUANT, tc_range2[0]*QUANT, tc_range2[1]*QUANT);
+				LLVector4a min_tc4(min_tc[0], min_tc[1], min_tc[0], min_tc[1]);
+				dequantize_u16x2(face.mTexCoords, tc, num_verts, tc_scale, min_tc4);
+			}
+			else
+			{
+				memset(face.mTexCoords, 0, sizeof(LLVector2)*num_verts);
 			}
 
-			if (mdl[i].has("Weights"))
+			if (block.mHasWeights)
 			{
 				face.allocateWeights(num_verts);
 
-				LLSD::Binary weights = mdl[i]["Weights"];
+				const U8* weights = block.mData[LLMeshFaceBlock::WEIGHTS];
+				U32 weights_size = block.mSize[LLMeshFaceBlock::WEIGHTS];
 
 				U32 idx = 0;
 
 				U32 cur_vertex = 0;
-				while (idx < weights.size() && cur_vertex < num_verts)
+				while (idx < weights_size && cur_vertex < num_verts)
 				{
 					const U8 END_INFLUENCES = 0xFF;
 					U8 joint = weights[idx++];
@@ -2573,7 +3000,7 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 					U32 cur_influence = 0;
 					LLVector4 wght(0,0,0,0);
 
-					while (joint != END_INFLUENCES && idx < weights.size())
+					while (joint != END_INFLUENCES && idx < weights_size)
 					{
 						U16 influence = weights[idx++];
 						influence |= ((U16) weights[idx++] << 8);
@@ -2596,7 +3023,7 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 					cur_vertex++;
 				}
 
-				if (cur_vertex != num_verts || idx != weights.size())
+				if (cur_vertex != num_verts || idx != weights_size)
 				{
 					llwarns << "Vertex weight count does not match vertex count!" << llendl;
 				}
@@ -2725,6 +3152,18 @@ void LLVolume::copyVolumeFaces(const LLVolume* volume)
 	mSculptLevel = 0;
 }
 
+void LLVolume::swapSculpt(LLVolume* volume)
+{
+	llassert(volume->getParams() == mParams);
+	std::swap(mPathp, volume->mPathp);
+	std::swap(mProfilep, volume->mProfilep);
+	mMesh.swap(volume->mMesh);
+	mVolumeFaces.swap(volume->mVolumeFaces);
+	std::swap(mFaceMask, volume->mFaceMask);
+	std::swap(mSurfaceArea, volume->mSurfaceArea);
+	std::swap(mSculptLevel, volume->mSculptLevel);
+}
+
 void LLVolume::cacheOptimize()
 {
 	for (S32 i = 0; i < (S32)mVolumeFaces.size(); ++i)
@@ -4692,16 +5131,48 @@ S32 LLVolume::lineSegmentIntersect(const LLVector4a& start, const LLVector4a& en
 			}
 			else
 			{
-				if (!face.mOctree)
+				if (!face.mBVH)
 				{
-					face.createOctree();
+					face.createBVH();
 				}
-			
-				LLOctreeTriangleRayIntersect intersect(start, dir, &face, &closest_t, intersection, tex_coord, normal, bi_normal);
-				intersect.traverse(face.mOctree);
-				if (intersect.mHitFace)
+
+				F32 a, b;
+				U16 idx[3];
+				if (face.mBVH->intersect(start, dir, closest_t, a, b, idx))
 				{
 					hit_face = i;
+
+					if (intersection != NULL)
+					{
+						LLVector4a intersect = dir;
+						intersect.mul(closest_t);
+						intersect.add(start);
+						intersection->set(intersect.getF32ptr());
+					}
+
+					if (tex_coord != NULL)
+					{
+						LLVector2* tc = (LLVector2*) face.mTexCoords;
+						*tex_coord = ((1.f - a - b)  * tc[idx[0]] +
+							a              * tc[idx[1]] +
+							b              * tc[idx[2]]);
+					}
+
+					if (normal != NULL)
+					{
+						LLVector4* norm = (LLVector4*) face.mNormals;
+						*normal		= ((1.f - a - b)  * LLVector3(norm[idx[0]]) + 
+							a              * LLVector3(norm[idx[1]]) +
+							b              * LLVector3(norm[idx[2]]));
+					}
+
+					if (bi_normal != NULL)
+					{
+						LLVector4* binormal = (LLVector4*) face.mBinormals;
+						*bi_normal = ((1.f - a - b)  * LLVector3(binormal[idx[0]]) + 
+								a              * LLVector3(binormal[idx[1]]) +
+								b              * LLVector3(binormal[idx[2]]));
+					}
 				}
 			}
 		}		
@@ -4711,6 +5182,14 @@ S32 LLVolume::lineSegmentIntersect(const LLVector4a& start, const LLVector4a& en
 	return hit_face;
 }
 
+void LLVolume::createBVHs()
+{
+	for (face_list_t::iterator iter = mVolumeFaces.begin(); iter != mVolumeFaces.end(); ++iter)
+	{
+		iter->createBVH();
+	}
+}
+
 class LLVertexIndexPair
 {
 public:
@@ -5484,7 +5963,8 @@ LLVolumeFace::LLVolumeFace() :
 	mTexCoords(NULL),
 	mIndices(NULL),
 	mWeights(NULL),
-	mOctree(NULL)
+	mOctree(NULL),
+	mBVH(NULL)
 {
 	mExtents = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*3);
 	mExtents[0].splat(-0.5f);
@@ -5507,7 +5987,8 @@ LLVolumeFace::LLVolumeFace(const LLVolumeFace& src)
 	mTexCoords(NULL),
 	mIndices(NULL),
 	mWeights(NULL),
-	mOctree(NULL)
+	mOctree(NULL),
+	mBVH(NULL)
 { 
 	mExtents = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*3);
 	mCenter = mExtents+2;
@@ -5590,6 +6071,11 @@ LLVolumeFace& LLVolumeFace::operator=(const LLVolumeFace& src)
 		
 		LLVector4a::memcpyNonAliased16((F32*) mIndices, (F32*) src.mIndices, idx_size);
 	}
+
+	if (src.mBVH)
+	{ //cheap to copy, and may have been built off the main thread
+		mBVH = new LLVolumeBVH(*src.mBVH);
+	}
 	
 	//delete 
 	return *this;
@@ -5620,6 +6106,7 @@ void LLVolumeFace::freeData()
 
 	delete mOctree;
 	mOctree = NULL;
+	destroyBVH();
 }
 
 BOOL LLVolumeFace::create(LLVolume* volume, BOOL partial_build)
@@ -5627,6 +6114,7 @@ BOOL LLVolumeFace::create(LLVolume* volume, BOOL partial_build)
 	//tree for this face is no longer valid
 	delete mOctree;
 	mOctree = NULL;
+	destroyBVH();
 
 	BOOL ret = FALSE ;
 	if (mTypeMask & CAP_MASK)
@@ -5723,6 +6211,8 @@ bool LLVolumeFace::VertexMapData::ComparePosition::operator()(const LLVector3& a
 
 void LLVolumeFace::optimize(F32 angle_cutoff)
 {
+	destroyBVH();
+
 	LLVolumeFace new_face;
 
 	//map of points to vector of vertices at that point
@@ -5807,447 +6297,271 @@ void LLVolumeFace::optimize(F32 angle_cutoff)
 	swapData(new_face);
 }
 
-class LLVCacheTriangleData;
-
-class LLVCacheVertexData
+namespace
 {
-public:
-	S32 mIdx;
-	S32 mCacheTag;
-	F32 mScore;
-	U32 mActiveTriangles;
-	std::vector<LLVCacheTriangleData*> mTriangles;
+	// Forsyth vertex cache scoring:
+	// http://home.comcast.net/~tom_forsyth/papers/fast_vert_cache_opt.html
+	const F32 FindVertexScore_CacheDecayPower = 1.5f;
+	const F32 FindVertexScore_LastTriScore = 0.75f;
+	const F32 FindVertexScore_ValenceBoostScale = 2.0f;
+	const F32 FindVertexScore_ValenceBoostPower = 0.5f;
+	const U32 MaxSizeVertexCache = 32;
+	const U32 MaxValenceScore = 32;
 
-	LLVCacheVertexData()
+	// Scores by cache position and by number of triangles left, computed once
+	// at startup so that cacheOptimize stays safe to call from any thread.
+	struct LLVCacheScores
 	{
-		mCacheTag = -1;
-		mScore = 0.f;
-		mActiveTriangles = 0;
-		mIdx = -1;
-	}
-};
+		F32 mCache[MaxSizeVertexCache];
+		F32 mValence[MaxValenceScore];
 
-class LLVCacheTriangleData
-{
-public:
-	bool mActive;
-	F32 mScore;
-	LLVCacheVertexData* mVertex[3];
-
-	LLVCacheTriangleData()
-	{
-		mActive = true;
-		mScore = 0.f;
-		mVertex[0] = mVertex[1] = mVertex[2] = NULL;
-	}
-
-	void complete()
-	{
-		mActive = false;
-		for (S32 i = 0; i < 3; ++i)
+		LLVCacheScores()
 		{
-			if (mVertex[i])
+			for (U32 i = 0; i < MaxSizeVertexCache; ++i)
 			{
-				llassert_always(mVertex[i]->mActiveTriangles > 0);
-				mVertex[i]->mActiveTriangles--;
+				if (i < 3)
+				{ //vertex was in the last triangle
+					mCache[i] = FindVertexScore_LastTriScore;
+				}
+				else
+				{ //more points for being higher in the cache
+					F32 scaler = 1.f/(MaxSizeVertexCache-3);
+					mCache[i] = powf(1.f-((i-3)*scaler), FindVertexScore_CacheDecayPower);
+				}
 			}
-		}
-	}
-
-	bool operator<(const LLVCacheTriangleData& rhs) const
-	{ //highest score first
-		return rhs.mScore < mScore;
-	}
-};
-
-const F32 FindVertexScore_CacheDecayPower = 1.5f;
-const F32 FindVertexScore_LastTriScore = 0.75f;
-const F32 FindVertexScore_ValenceBoostScale = 2.0f;
-const F32 FindVertexScore_ValenceBoostPower = 0.5f;
-const U32 MaxSizeVertexCache = 32;
-
-F32 find_vertex_score(LLVCacheVertexData& data)
-{
-	if (data.mActiveTriangles == 0)
-	{ //no triangle references this vertex
-		return -1.f;
-	}
-
-	F32 score = 0.f;
-
-	S32 cache_idx = data.mCacheTag;
 
-	if (cache_idx < 0)
-	{
-		//not in cache
-	}
-	else
-	{
-		if (cache_idx < 3)
-		{ //vertex was in the last triangle
-			score = FindVertexScore_LastTriScore;
-		}
-		else
-		{ //more points for being higher in the cache
-			F32 scaler = 1.f/(MaxSizeVertexCache-3);
-			score = 1.f-((cache_idx-3)*scaler);
-			score = powf(score, FindVertexScore_CacheDecayPower);
+			mValence[0] = 0.f;
+			for (U32 i = 1; i < MaxValenceScore; ++i)
+			{ //bonus points for having low valence
+				mValence[i] = FindVertexScore_ValenceBoostScale * powf((F32) i, -FindVertexScore_ValenceBoostPower);
+			}
 		}
-	}
 
-	//bonus points for having low valence
-	F32 valence_boost = powf(data.mActiveTriangles, -FindVertexScore_ValenceBoostPower);
-	score += FindVertexScore_ValenceBoostScale * valence_boost;
+		F32 getScore(S32 cache_idx, U32 active_triangles) const
+		{
+			if (active_triangles == 0)
+			{ //no triangle references this vertex
+				return -1.f;
+			}
 
-	return score;
-}
+			F32 score = cache_idx >= 0 && cache_idx < (S32) MaxSizeVertexCache ? mCache[cache_idx] : 0.f;
+			return score + mValence[llmin(active_triangles, MaxValenceScore-1)];
+		}
+	};
 
-class LLVCacheFIFO
-{
-public:
-	LLVCacheVertexData* mCache[MaxSizeVertexCache];
-	U32 mMisses;
+	const LLVCacheScores sVCacheScores;
 
-	LLVCacheFIFO()
+	// Moves element i of data to remap[i], following each cycle of the
+	// permutation so no second copy of the stream is needed.
+	template <class T>
+	void permute_in_place(T* data, const std::vector<U16>& remap, std::vector<bool>& done)
 	{
-		mMisses = 0;
-		for (U32 i = 0; i < MaxSizeVertexCache; ++i)
+		if (!data)
 		{
-			mCache[i] = NULL;
+			return;
 		}
-	}
 
-	void addVertex(LLVCacheVertexData* data)
-	{
-		if (data->mCacheTag == -1)
+		done.assign(remap.size(), false);
+		for (U32 start = 0; start < remap.size(); ++start)
 		{
-			mMisses++;
-
-			S32 end = MaxSizeVertexCache-1;
-
-			if (mCache[end])
+			if (done[start])
 			{
-				mCache[end]->mCacheTag = -1;
+				continue;
 			}
 
-			for (S32 i = end; i > 0; --i)
+			done[start] = true;
+			T carry = data[start];
+			for (U32 i = remap[start]; i != start; i = remap[i])
 			{
-				mCache[i] = mCache[i-1];
-				if (mCache[i])
-				{
-					mCache[i]->mCacheTag = i;
-				}
+				std::swap(carry, data[i]);
+				done[i] = true;
 			}
-
-			mCache[0] = data;
-			data->mCacheTag = 0;
+			data[start] = carry;
 		}
 	}
-};
+}
 
-class LLVCacheLRU
-{
-public:
-	LLVCacheVertexData* mCache[MaxSizeVertexCache+3];
+void LLVolumeFace::cacheOptimize()
+{ //optimize for vertex cache according to Forsyth method, in linear time
+	if (mNumVertices < 3 || mNumIndices < 3)
+	{ //nothing to do
+		return;
+	}
 
-	LLVCacheTriangleData* mBestTriangle;
-	
-	U32 mMisses;
+	destroyBVH();
 
-	LLVCacheLRU()
-	{
-		for (U32 i = 0; i < MaxSizeVertexCache+3; ++i)
-		{
-			mCache[i] = NULL;
-		}
+	const U32 num_verts = mNumVertices;
+	const U32 num_tris = mNumIndices/3;
 
-		mBestTriangle = NULL;
-		mMisses = 0;
+	//triangles using each vertex, the first mActiveTriangles[v] of them not emitted yet
+	std::vector<U32> tri_offset(num_verts+1, 0);
+	std::vector<U32> active_tris(num_verts, 0);
+	for (U32 i = 0; i < num_tris*3; ++i)
+	{
+		++active_tris[mIndices[i]];
+	}
+	for (U32 i = 0; i < num_verts; ++i)
+	{
+		tri_offset[i+1] = tri_offset[i] + active_tris[i];
 	}
 
-	void addVertex(LLVCacheVertexData* data)
+	std::vector<U32> vertex_tris(num_tris*3);
 	{
-		S32 end = MaxSizeVertexCache+2;
-		if (data->mCacheTag != -1)
-		{ //just moving a vertex to the front of the cache
-			end = data->mCacheTag;
-		}
-		else
+		std::vector<U32> fill(tri_offset.begin(), tri_offset.end()-1);
+		for (U32 i = 0; i < num_tris*3; ++i)
 		{
-			mMisses++;
-			if (mCache[end])
-			{ //adding a new vertex, vertex at end of cache falls off
-				mCache[end]->mCacheTag = -1;
-			}
+			vertex_tris[fill[mIndices[i]]++] = i/3;
 		}
+	}
 
-		for (S32 i = end; i > 0; --i)
-		{ //adjust cache pointers and tags
-			mCache[i] = mCache[i-1];
+	std::vector<S32> cache_tag(num_verts, -1);
+	std::vector<F32> vertex_score(num_verts);
+	std::vector<F32> tri_score(num_tris, 0.f);
+	std::vector<bool> emitted(num_tris, false);
 
-			if (mCache[i])
-			{
-				mCache[i]->mCacheTag = i;			
-			}
-		}
-
-		mCache[0] = data;
-		mCache[0]->mCacheTag = 0;
+	for (U32 i = 0; i < num_verts; ++i)
+	{ //initialize score values
+		vertex_score[i] = sVCacheScores.getScore(-1, active_tris[i]);
 	}
-
-	void addTriangle(LLVCacheTriangleData* data)
+	for (U32 i = 0; i < num_tris*3; ++i)
 	{
-		addVertex(data->mVertex[0]);
-		addVertex(data->mVertex[1]);
-		addVertex(data->mVertex[2]);
+		tri_score[i/3] += vertex_score[mIndices[i]];
 	}
 
-	void updateScores()
+	S32 best_tri = 0;
+	for (U32 i = 1; i < num_tris; ++i)
 	{
-		for (U32 i = MaxSizeVertexCache; i < MaxSizeVertexCache+3; ++i)
-		{ //trailing 3 vertices aren't actually in the cache for scoring purposes
-			if (mCache[i])
-			{
-				mCache[i]->mCacheTag = -1;
-			}
-		}
-
-		for (U32 i = 0; i < MaxSizeVertexCache; ++i)
-		{ //update scores of vertices in cache
-			if (mCache[i])
-			{
-				mCache[i]->mScore = find_vertex_score(*(mCache[i]));
-				llassert_always(mCache[i]->mCacheTag == i);
-			}
-		}
-
-		mBestTriangle = NULL;
-		//update triangle scores
-		for (U32 i = 0; i < MaxSizeVertexCache+3; ++i)
+		if (tri_score[i] > tri_score[best_tri])
 		{
-			if (mCache[i])
-			{
-				for (U32 j = 0; j < mCache[i]->mTriangles.size(); ++j)
-				{
-					LLVCacheTriangleData* tri = mCache[i]->mTriangles[j];
-					if (tri->mActive)
-					{
-						tri->mScore = tri->mVertex[0]->mScore;
-						tri->mScore += tri->mVertex[1]->mScore;
-						tri->mScore += tri->mVertex[2]->mScore;
-
-						if (!mBestTriangle || mBestTriangle->mScore < tri->mScore)
-						{
-							mBestTriangle = tri;
-						}
-					}
-				}
-			}
+			best_tri = i;
 		}
-
-		//knock trailing 3 vertices off the cache
-		for (U32 i = MaxSizeVertexCache; i < MaxSizeVertexCache+3; ++i)
-		{
-			if (mCache[i])
-			{
-				llassert_always(mCache[i]->mCacheTag == -1);
-				mCache[i] = NULL;
-			}
-		}
-	}
-};
-
-
-void LLVolumeFace::cacheOptimize()
-{ //optimize for vertex cache according to Forsyth method: 
-  // http://home.comcast.net/~tom_forsyth/papers/fast_vert_cache_opt.html
-	
-	LLVCacheLRU cache;
-	
-	if (mNumVertices < 3)
-	{ //nothing to do
-		return;
 	}
 
-	//mapping of vertices to triangles and indices
-	std::vector<LLVCacheVertexData> vertex_data;
-
-	//mapping of triangles do vertices
-	std::vector<LLVCacheTriangleData> triangle_data;
-
-	triangle_data.resize(mNumIndices/3);
-	vertex_data.resize(mNumVertices);
+	std::vector<U16> new_indices;
+	new_indices.reserve(num_tris*3);
 
-	for (U32 i = 0; i < (U32)mNumIndices; i++)
-	{ //populate vertex data and triangle data arrays
-		U16 idx = mIndices[i];
-		U32 tri_idx = i/3;
+	//vertices in the cache, the 3 extra slots hold vertices falling off it
+	U32 cache[MaxSizeVertexCache+3];
+	U32 new_cache[MaxSizeVertexCache+3];
+	U32 cache_size = 0;
 
-		vertex_data[idx].mTriangles.push_back(&(triangle_data[tri_idx]));
-		vertex_data[idx].mIdx = idx;
-		triangle_data[tri_idx].mVertex[i%3] = &(vertex_data[idx]);
-	}
+	U32 next_unemitted = 0;
 
-	/*F32 pre_acmr = 1.f;
-	//measure cache misses from before rebuild
+	while (best_tri >= 0)
 	{
-		LLVCacheFIFO test_cache;
-		for (U32 i = 0; i < mNumIndices; ++i)
+		const U16* tri = mIndices + best_tri*3;
+		emitted[best_tri] = true;
+
+		//push the triangle's vertices to the front of the cache
+		U32 new_size = 0;
+		for (U32 k = 0; k < 3; ++k)
 		{
-			test_cache.addVertex(&vertex_data[mIndices[i]]);
+			U16 idx = tri[k];
+			new_indices.push_back(idx);
+			new_cache[new_size++] = idx;
+
+			//drop the triangle from the vertex's active list
+			U32* begin = &vertex_tris[tri_offset[idx]];
+			U32* end = begin + active_tris[idx];
+			U32* found = std::find(begin, end, (U32) best_tri);
+			llassert(found != end);
+			std::swap(*found, *(end-1));
+			--active_tris[idx];
 		}
 
-		for (U32 i = 0; i < mNumVertices; i++)
+		for (U32 i = 0; i < cache_size; ++i)
 		{
-			vertex_data[i].mCacheTag = -1;
+			U32 idx = cache[i];
+			if (idx != tri[0] && idx != tri[1] && idx != tri[2])
+			{
+				new_cache[new_size++] = idx;
+			}
 		}
 
-		pre_acmr = (F32) test_cache.mMisses/(mNumIndices/3);
-	}*/
-
-	for (U32 i = 0; i < (U32)mNumVertices; i++)
-	{ //initialize score values (no cache -- might try a fifo cache here)
-		vertex_data[i].mScore = find_vertex_score(vertex_data[i]);
-		vertex_data[i].mActiveTriangles = vertex_data[i].mTriangles.size();
-
-		for (U32 j = 0; j < vertex_data[i].mTriangles.size(); ++j)
+		for (U32 i = 0; i < new_size; ++i)
 		{
-			vertex_data[i].mTriangles[j]->mScore += vertex_data[i].mScore;
+			cache_tag[new_cache[i]] = i < MaxSizeVertexCache ? (S32) i : -1;
 		}
-	}
-
-	//sort triangle data by score
-	std::sort(triangle_data.begin(), triangle_data.end());
-
-	std::vector<U16> new_indices;
+		cache_size = llmin(new_size, MaxSizeVertexCache);
+		memcpy(cache, new_cache, cache_size*sizeof(U32));
 
-	LLVCacheTriangleData* tri;
+		//rescore the vertices that moved in (or fell out of) the cache and
+		//their remaining triangles
+		for (U32 i = 0; i < new_size; ++i)
+		{
+			U32 idx = new_cache[i];
+			F32 score = sVCacheScores.getScore(cache_tag[idx], active_tris[idx]);
+			F32 delta = score - vertex_score[idx];
+			vertex_score[idx] = score;
 
-	//prime pump by adding first triangle to cache;
-	tri = &(triangle_data[0]);
-	cache.addTriangle(tri);
-	new_indices.push_back(tri->mVertex[0]->mIdx);
-	new_indices.push_back(tri->mVertex[1]->mIdx);
-	new_indices.push_back(tri->mVertex[2]->mIdx);
-	tri->complete();
+			for (U32 j = 0; j < active_tris[idx]; ++j)
+			{
+				tri_score[vertex_tris[tri_offset[idx]+j]] += delta;
+			}
+		}
 
-	U32 breaks = 0;
-	for (U32 i = 1; i < (U32)mNumIndices/3; ++i)
-	{
-		cache.updateScores();
-		tri = cache.mBestTriangle;
-		if (!tri)
+		best_tri = -1;
+		F32 best_score = 0.f;
+		for (U32 i = 0; i < cache_size; ++i)
 		{
-			breaks++;
-			for (U32 j = 0; j < triangle_data.size(); ++j)
+			U32 idx = cache[i];
+			for (U32 j = 0; j < active_tris[idx]; ++j)
 			{
-				if (triangle_data[j].mActive)
+				U32 t = vertex_tris[tri_offset[idx]+j];
+				if (best_tri < 0 || tri_score[t] > best_score)
 				{
-					tri = &(triangle_data[j]);
-					break;
+					best_tri = t;
+					best_score = tri_score[t];
 				}
 			}
-		}	
-		
-		cache.addTriangle(tri);
-		new_indices.push_back(tri->mVertex[0]->mIdx);
-		new_indices.push_back(tri->mVertex[1]->mIdx);
-		new_indices.push_back(tri->mVertex[2]->mIdx);
-		tri->complete();
-	}
-
-	for (U32 i = 0; i < (U32)mNumIndices; ++i)
-	{
-		mIndices[i] = new_indices[i];
-	}
-
-	/*F32 post_acmr = 1.f;
-	//measure cache misses from after rebuild
-	{
-		LLVCacheFIFO test_cache;
-		for (U32 i = 0; i < mNumVertices; i++)
-		{
-			vertex_data[i].mCacheTag = -1;
 		}
 
-		for (U32 i = 0; i < mNumIndices; ++i)
-		{
-			test_cache.addVertex(&vertex_data[mIndices[i]]);
-		}
-		
-		post_acmr = (F32) test_cache.mMisses/(mNumIndices/3);
-	}*/
-
-	//optimize for pre-TnL cache
-	
-	//allocate space for new buffer
-	S32 num_verts = mNumVertices;
-	LLVector4a* pos = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
-	LLVector4a* norm = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
-	S32 size = ((num_verts*sizeof(LLVector2)) + 0xF) & ~0xF;
-	LLVector2* tc = (LLVector2*) ll_aligned_malloc_16(size);
-
-	LLVector4a* wght = NULL;
-	if (mWeights)
-	{
-		wght = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
-	}
-
-	LLVector4a* binorm = NULL;
-	if (mBinormals)
-	{
-		binorm = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
-	}
-
-	//allocate mapping of old indices to new indices
-	std::vector<S32> new_idx;
-	new_idx.resize(mNumVertices, -1);
-
-	S32 cur_idx = 0;
-	for (U32 i = 0; i < (U32)mNumIndices; ++i)
-	{
-		U16 idx = mIndices[i];
-		if (new_idx[idx] == -1)
-		{ //this vertex hasn't been added yet
-			new_idx[idx] = cur_idx;
-
-			//copy vertex data
-			pos[cur_idx] = mPositions[idx];
-			norm[cur_idx] = mNormals[idx];
-			tc[cur_idx] = mTexCoords[idx];
-			if (mWeights)
+		if (best_tri < 0)
+		{ //dead end, nothing left around the cache
+			while (next_unemitted < num_tris && emitted[next_unemitted])
 			{
-				wght[cur_idx] = mWeights[idx];
+				++next_unemitted;
 			}
-			if (mBinormals)
+
+			if (next_unemitted < num_tris)
 			{
-				binorm[cur_idx] = mBinormals[idx];
+				best_tri = next_unemitted;
 			}
-
-			cur_idx++;
 		}
 	}
 
-	for (U32 i = 0; i < (U32)mNumIndices; ++i)
+	llassert(new_indices.size() == num_tris*3);
+
+	//optimize for pre-TnL cache: renumber vertices in order of first use,
+	//unused vertices go to the end
+	std::vector<U16> remap(num_verts);
+	std::vector<bool> used(num_verts, false);
+	U32 cur_idx = 0;
+	for (U32 i = 0; i < num_tris*3; ++i)
 	{
-		mIndices[i] = new_idx[mIndices[i]];
+		U16 idx = new_indices[i];
+		if (!used[idx])
+		{
+			used[idx] = true;
+			remap[idx] = cur_idx++;
+		}
+		mIndices[i] = remap[idx];
+	}
+	for (U32 i = 0; i < num_verts; ++i)
+	{
+		if (!used[i])
+		{
+			remap[i] = cur_idx++;
+		}
 	}
-	
-	ll_aligned_free_16(mPositions);
-	ll_aligned_free_16(mNormals);
-	ll_aligned_free_16(mTexCoords);
-	ll_aligned_free_16(mWeights);
-	ll_aligned_free_16(mBinormals);
-
-	mPositions = pos;
-	mNormals = norm;
-	mTexCoords = tc;
-	mWeights = wght;
-	mBinormals = binorm;
-
-	//std::string result = llformat("ACMR pre/post: %.3f/%.3f  --  %d triangles %d breaks", pre_acmr, post_acmr, mNumIndices/3, breaks);
-	//llinfos << result << llendl;
 
+	//reorder vertex streams in place
+	std::vector<bool> done;
+	permute_in_place(mPositions, remap, done);
+	permute_in_place(mNormals, remap, done);
+	permute_in_place(mTexCoords, remap, done);
+	permute_in_place(mWeights, remap, done);
+	permute_in_place(mBinormals, remap, done);
 }
 
 void LLVolumeFace::createOctree(F32 scaler, const LLVector4a& center, const LLVector4a& size)
@@ -6319,6 +6633,21 @@ void LLVolumeFace::createOctree(F32 scaler, const LLVector4a& center, const LLVe
 	}
 }
 
+void LLVolumeFace::createBVH()
+{
+	if (!mBVH)
+	{
+		LLVolumeBVH* bvh = new LLVolumeBVH();
+		bvh->build(*this);
+		mBVH = bvh;
+	}
+}
+
+void LLVolumeFace::destroyBVH()
+{
+	delete mBVH;
+	mBVH = NULL;
+}
 
 void LLVolumeFace::swapData(LLVolumeFace& rhs)
 {
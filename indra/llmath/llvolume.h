@@ -47,6 +47,7 @@ class LLVector4a;
 class LLVolumeFace;
 class LLVolume;
 class LLVolumeTriangle;
+class LLVolumeBVH;
 
 #include "lldarray.h"
 #include "lluuid.h"
@@ -59,6 +60,7 @@ class LLVolumeTriangle;
 #include "llquaternion.h"
 #include "llstrider.h"
 #include "v4coloru.h"
+#include "llapr.h"
 #include "llrefcount.h"
 #include "llfile.h"
 
@@ -888,6 +890,11 @@ public:
 
 	void createOctree(F32 scaler = 0.25f, const LLVector4a& center = LLVector4a(0,0,0), const LLVector4a& size = LLVector4a(0.5f,0.5f,0.5f));
 
+	// Builds the pick BVH if there isn't one. Thread safe as long as nothing
+	// else touches the face, so it can run where the face is created.
+	void createBVH();
+	void destroyBVH();
+
 	enum
 	{
 		SINGLE_MASK =	0x0001,
@@ -933,7 +940,8 @@ public:
 	// mWeights.size() should be empty or match mVertices.size()  
 	LLVector4a* mWeights;
  
-	LLOctreeNode<LLVolumeTriangle>* mOctree;
+	LLOctreeNode<LLVolumeTriangle>* mOctree; // debug rendering only, picking uses mBVH
+	LLVolumeBVH* mBVH;
 
 private:
 	BOOL createUnCutCubeCap(LLVolume* volume, BOOL partial_build = FALSE);
@@ -1025,6 +1033,9 @@ public:
 								   LLVector2* tex_coord = NULL,
 								   LLVector3* normal = NULL,
 								   LLVector3* bi_normal = NULL);
+
+	// Builds the pick BVH of every face ahead of the first lineSegmentIntersect().
+	void createBVHs();
 	
 	// The following cleans up vertices and triangles,
 	// getting rid of degenerate triangles and duplicate vertices,
@@ -1040,7 +1051,7 @@ public:
 	LLFaceID generateFaceMask();
 
 	BOOL isFaceMaskValid(LLFaceID face_mask);
-	static S32 sNumMeshPoints;
+	static LLAtomicS32 sNumMeshPoints; // updated by the volume build threads too
 
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);		// HACK to bypass Windoze confusion over 
@@ -1052,6 +1063,8 @@ public:
 	
 	void sculpt(U16 sculpt_width, U16 sculpt_height, S8 sculpt_components, const U8* sculpt_data, S32 sculpt_level);
 	void copyVolumeFaces(const LLVolume* volume);
+	// Swaps in the sculpted geometry of a volume with the same params (built off thread).
+	void swapSculpt(LLVolume* volume);
 	void cacheOptimize();
 
 private:
@@ -0,0 +1,551 @@
+/** 
+ * @file llvolumebvh.cpp
+ * @brief Bounding volume hierarchy for line segment picks against a volume face.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvolumebvh.h"
+
+#include "llmemory.h"
+#include "llvolume.h"
+
+#include <algorithm>
+
+// Splits deeper than this fall back to median splits, which keeps the tree
+// shallow enough for the fixed traversal stack in practice. Deeper trees
+// traverse with a heap allocated stack.
+static const U32 MAX_SAH_DEPTH = 40;
+static const U32 TRAVERSAL_STACK_SIZE = 64;
+static const U32 SAH_BINS = 16;
+static const U32 LEAF_TRIANGLES = 4;
+
+struct LLVolumeBVH::BuildTri
+{
+	F32 mMin[3];
+	F32 mMax[3];
+	F32 mCenter[3];
+	U32 mIndex; // of the triangle's first entry in the face's index list
+};
+
+namespace
+{
+	struct CompareCenter
+	{
+		CompareCenter(U32 axis) : mAxis(axis) {}
+		bool operator()(const LLVolumeBVH::BuildTri& lhs, const LLVolumeBVH::BuildTri& rhs) const
+		{
+			return lhs.mCenter[mAxis] < rhs.mCenter[mAxis];
+		}
+		U32 mAxis;
+	};
+
+	struct InLeftBins
+	{
+		InLeftBins(U32 axis, F32 min, F32 scale, U32 split)
+			: mAxis(axis), mMin(min), mScale(scale), mSplit(split) {}
+		bool operator()(const LLVolumeBVH::BuildTri& tri) const
+		{
+			U32 bin = llmin((U32) ((tri.mCenter[mAxis] - mMin) * mScale), SAH_BINS - 1);
+			return bin <= mSplit;
+		}
+		U32 mAxis;
+		F32 mMin;
+		F32 mScale;
+		U32 mSplit;
+	};
+
+	struct Bounds
+	{
+		Bounds()
+		{
+			mMin[0] = mMin[1] = mMin[2] = F32_MAX;
+			mMax[0] = mMax[1] = mMax[2] = -F32_MAX;
+		}
+
+		void add(const F32* min, const F32* max)
+		{
+			for (U32 i = 0; i < 3; ++i)
+			{
+				mMin[i] = llmin(mMin[i], min[i]);
+				mMax[i] = llmax(mMax[i], max[i]);
+			}
+		}
+
+		// half the surface area, all the SAH needs. Boxes flat along x still
+		// have an area, only the empty box (min > max) has none.
+		F32 getArea() const
+		{
+			F32 dx = mMax[0] - mMin[0];
+			F32 dy = mMax[1] - mMin[1];
+			F32 dz = mMax[2] - mMin[2];
+			return dx >= 0.f ? dx*dy + dy*dz + dz*dx : 0.f;
+		}
+
+		F32 mMin[3];
+		F32 mMax[3];
+	};
+}
+
+LLVolumeBVH::LLVolumeBVH()
+	: mPackets(NULL),
+	  mNumPackets(0),
+	  mDepth(0)
+{
+}
+
+LLVolumeBVH::LLVolumeBVH(const LLVolumeBVH& rhs)
+	: mNodes(rhs.mNodes),
+	  mPackets(NULL),
+	  mNumPackets(0),
+	  mDepth(rhs.mDepth)
+{
+	copyPackets(rhs);
+}
+
+LLVolumeBVH::~LLVolumeBVH()
+{
+	ll_aligned_free_16(mPackets);
+}
+
+LLVolumeBVH& LLVolumeBVH::operator=(const LLVolumeBVH& rhs)
+{
+	if (&rhs != this)
+	{
+		mNodes = rhs.mNodes;
+		mDepth = rhs.mDepth;
+		copyPackets(rhs);
+	}
+	return *this;
+}
+
+void LLVolumeBVH::copyPackets(const LLVolumeBVH& rhs)
+{
+	ll_aligned_free_16(mPackets);
+	mPackets = NULL;
+	mNumPackets = rhs.mNumPackets;
+	if (mNumPackets)
+	{
+		mPackets = (Packet*) ll_aligned_malloc_16(sizeof(Packet)*mNumPackets);
+		memcpy(mPackets, rhs.mPackets, sizeof(Packet)*mNumPackets);
+	}
+}
+
+void LLVolumeBVH::build(const LLVolumeFace& face)
+{
+	mNodes.clear();
+	ll_aligned_free_16(mPackets);
+	mPackets = NULL;
+	mNumPackets = 0;
+	mDepth = 0;
+
+	U32 tri_count = face.mNumIndices/3;
+	if (!tri_count)
+	{
+		return;
+	}
+
+	std::vector<BuildTri> tris(tri_count);
+	for (U32 i = 0; i < tri_count; ++i)
+	{
+		BuildTri& tri = tris[i];
+		tri.mIndex = i*3;
+
+		const F32* v0 = face.mPositions[face.mIndices[i*3+0]].getF32ptr();
+		const F32* v1 = face.mPositions[face.mIndices[i*3+1]].getF32ptr();
+		const F32* v2 = face.mPositions[face.mIndices[i*3+2]].getF32ptr();
+		for (U32 k = 0; k < 3; ++k)
+		{
+			tri.mMin[k] = llmin(v0[k], llmin(v1[k], v2[k]));
+			tri.mMax[k] = llmax(v0[k], llmax(v1[k], v2[k]));
+			tri.mCenter[k] = (tri.mMin[k] + tri.mMax[k]) * 0.5f;
+		}
+	}
+
+	mNodes.reserve(tri_count/2 + 1);
+	mNodes.resize(1);
+	buildNode(0, tris, 0, tri_count, 0);
+
+	//pack the triangles of each leaf, in leaf order
+	for (std::vector<Node>::iterator iter = mNodes.begin(); iter != mNodes.end(); ++iter)
+	{
+		if (iter->mLeaf)
+		{
+			++mNumPackets;
+		}
+	}
+
+	mPackets = (Packet*) ll_aligned_malloc_16(sizeof(Packet)*mNumPackets);
+	memset(mPackets, 0, sizeof(Packet)*mNumPackets);
+
+	//while building, a leaf's mIndex is its first triangle and mLeaf its triangle count
+	U32 packet = 0;
+	for (std::vector<Node>::iterator iter = mNodes.begin(); iter != mNodes.end(); ++iter)
+	{
+		if (!iter->mLeaf)
+		{
+			continue;
+		}
+
+		Packet& p = mPackets[packet];
+		F32* v0[3] = { p.mV0[0].getF32ptr(), p.mV0[1].getF32ptr(), p.mV0[2].getF32ptr() };
+		F32* e1[3] = { p.mEdge1[0].getF32ptr(), p.mEdge1[1].getF32ptr(), p.mEdge1[2].getF32ptr() };
+		F32* e2[3] = { p.mEdge2[0].getF32ptr(), p.mEdge2[1].getF32ptr(), p.mEdge2[2].getF32ptr() };
+
+		for (S32 lane = 0; lane < iter->mLeaf; ++lane)
+		{
+			const BuildTri& tri = tris[iter->mIndex + lane];
+			const U16* idx = face.mIndices + tri.mIndex;
+			const F32* a = face.mPositions[idx[0]].getF32ptr();
+			const F32* b = face.mPositions[idx[1]].getF32ptr();
+			const F32* c = face.mPositions[idx[2]].getF32ptr();
+
+			for (U32 k = 0; k < 3; ++k)
+			{
+				v0[k][lane] = a[k];
+				e1[k][lane] = b[k] - a[k];
+				e2[k][lane] = c[k] - a[k];
+				p.mIndices[lane][k] = idx[k];
+			}
+		}
+
+		iter->mIndex = packet++;
+		iter->mLeaf = 1;
+	}
+}
+
+void LLVolumeBVH::buildNode(S32 node_index, std::vector<BuildTri>& tris, U32 begin, U32 end, U32 depth)
+{
+	Bounds bounds;
+	Bounds centers;
+	for (U32 i = begin; i < end; ++i)
+	{
+		bounds.add(tris[i].mMin, tris[i].mMax);
+		centers.add(tris[i].mCenter, tris[i].mCenter);
+	}
+
+	mDepth = llmax(mDepth, depth);
+
+	{
+		Node& node = mNodes[node_index];
+		for (U32 k = 0; k < 3; ++k)
+		{
+			node.mMin[k] = bounds.mMin[k];
+			node.mMax[k] = bounds.mMax[k];
+		}
+		node.mMin[3] = node.mMax[3] = 0.f;
+
+		U32 count = end - begin;
+		if (count <= LEAF_TRIANGLES)
+		{
+			node.mIndex = begin;
+			node.mLeaf = count;
+			return;
+		}
+		node.mLeaf = 0;
+	}
+
+	//find the cheapest binned split along any axis
+	U32 mid = begin;
+	F32 best_cost = F32_MAX;
+	U32 best_axis = 0;
+	U32 best_split = 0;
+
+	if (depth < MAX_SAH_DEPTH)
+	{
+		for (U32 axis = 0; axis < 3; ++axis)
+		{
+			F32 extent = centers.mMax[axis] - centers.mMin[axis];
+			if (extent <= 0.f)
+			{
+				continue;
+			}
+
+			F32 scale = SAH_BINS / extent;
+			Bounds bin_bounds[SAH_BINS];
+			U32 bin_count[SAH_BINS] = { 0 };
+
+			for (U32 i = begin; i < end; ++i)
+			{
+				U32 bin = llmin((U32) ((tris[i].mCenter[axis] - centers.mMin[axis]) * scale), SAH_BINS - 1);
+				bin_bounds[bin].add(tris[i].mMin, tris[i].mMax);
+				++bin_count[bin];
+			}
+
+			//sweep from the right to get the cost of everything past each split
+			F32 right_area[SAH_BINS];
+			U32 right_count[SAH_BINS];
+			Bounds right;
+			U32 count = 0;
+			for (U32 i = SAH_BINS - 1; i > 0; --i)
+			{
+				right.add(bin_bounds[i].mMin, bin_bounds[i].mMax);
+				count += bin_count[i];
+				right_area[i] = right.getArea();
+				right_count[i] = count;
+			}
+
+			Bounds left;
+			count = 0;
+			for (U32 i = 0; i < SAH_BINS - 1; ++i)
+			{
+				left.add(bin_bounds[i].mMin, bin_bounds[i].mMax);
+				count += bin_count[i];
+				if (!count || !right_count[i+1])
+				{
+					continue;
+				}
+
+				F32 cost = left.getArea()*count + right_area[i+1]*right_count[i+1];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_split = i;
+				}
+			}
+		}
+
+		if (best_cost < F32_MAX)
+		{
+			F32 scale = SAH_BINS / (centers.mMax[best_axis] - centers.mMin[best_axis]);
+			mid = std::partition(tris.begin() + begin, tris.begin() + end,
+								 InLeftBins(best_axis, centers.mMin[best_axis], scale, best_split)) - tris.begin();
+		}
+	}
+
+	if (mid == begin || mid == end)
+	{ //no usable split (too deep, or all centers in one spot), split by count along the longest axis
+		U32 axis = 0;
+		for (U32 k = 1; k < 3; ++k)
+		{
+			if (centers.mMax[k] - centers.mMin[k] > centers.mMax[axis] - centers.mMin[axis])
+			{
+				axis = k;
+			}
+		}
+		mid = begin + (end - begin)/2;
+		std::nth_element(tris.begin() + begin, tris.begin() + mid, tris.begin() + end, CompareCenter(axis));
+	}
+
+	S32 child = mNodes.size();
+	mNodes.resize(child + 2);
+	mNodes[node_index].mIndex = child;
+
+	buildNode(child, tris, begin, mid, depth + 1);
+	buildNode(child + 1, tris, mid, end, depth + 1);
+}
+
+// Entry distance of the segment into a node's box, false if it misses or
+// enters past max_t.
+static inline bool segment_box_intersect(const F32* box_min, const F32* box_max,
+										 const LLVector4a& start, const LLVector4a& inv_dir,
+										 F32 max_t, F32& t_near)
+{
+	LLVector4a lo;
+	LLVector4a hi;
+	lo.loadua(box_min);
+	hi.loadua(box_max);
+	lo.sub(start);
+	lo.mul(inv_dir);
+	hi.sub(start);
+	hi.mul(inv_dir);
+
+	LLVector4a t0;
+	LLVector4a t1;
+	t0.setMin(lo, hi);
+	t1.setMax(lo, hi);
+
+	t_near = llmax(llmax(t0[0], t0[1]), llmax(t0[2], 0.f));
+	F32 t_far = llmin(llmin(t1[0], t1[1]), llmin(t1[2], max_t));
+	return t_near <= t_far;
+}
+
+bool LLVolumeBVH::intersect(const LLVector4a& start, const LLVector4a& dir, F32& closest_t,
+							F32& a, F32& b, U16 indices[3]) const
+{
+	if (mNodes.empty())
+	{
+		return false;
+	}
+
+	//keep the slab test finite for axis aligned segments
+	F32 inv[3];
+	for (U32 k = 0; k < 3; ++k)
+	{
+		F32 d = dir[k];
+		if (fabsf(d) < 1e-20f)
+		{
+			d = d < 0.f ? -1e-20f : 1e-20f;
+		}
+		inv[k] = 1.f / d;
+	}
+	LLVector4a inv_dir;
+	inv_dir.set(inv[0], inv[1], inv[2], 0.f);
+
+	F32 t_near;
+	if (!segment_box_intersect(mNodes[0].mMin, mNodes[0].mMax, start, inv_dir, llmin(closest_t, 1.f), t_near))
+	{
+		return false;
+	}
+
+	const LLQuad dx = _mm_set1_ps(dir[0]);
+	const LLQuad dy = _mm_set1_ps(dir[1]);
+	const LLQuad dz = _mm_set1_ps(dir[2]);
+	const LLQuad ox = _mm_set1_ps(start[0]);
+	const LLQuad oy = _mm_set1_ps(start[1]);
+	const LLQuad oz = _mm_set1_ps(start[2]);
+	const LLQuad zero = _mm_setzero_ps();
+	const LLQuad one = _mm_set1_ps(1.f);
+	const LLQuad epsilon = _mm_set1_ps(LLVector4a::getEpsilon()[0]);
+
+	//each level pops one node and pushes at most two
+	S32 local_stack[TRAVERSAL_STACK_SIZE];
+	std::vector<S32> heap_stack;
+	S32* stack = local_stack;
+	if (mDepth + 2 > TRAVERSAL_STACK_SIZE)
+	{
+		heap_stack.resize(mDepth + 2);
+		stack = &heap_stack[0];
+	}
+
+	bool hit = false;
+	U32 depth = 0;
+	stack[depth++] = 0;
+
+	while (depth)
+	{
+		const Node& node = mNodes[stack[--depth]];
+
+		if (!node.mLeaf)
+		{ //visit the nearer child first so the farther one is more likely to be culled
+			const Node& left = mNodes[node.mIndex];
+			const Node& right = mNodes[node.mIndex+1];
+			F32 max_t = llmin(closest_t, 1.f);
+			F32 t_left, t_right;
+			bool hit_left = segment_box_intersect(left.mMin, left.mMax, start, inv_dir, max_t, t_left);
+			bool hit_right = segment_box_intersect(right.mMin, right.mMax, start, inv_dir, max_t, t_right);
+
+			if (hit_left && hit_right)
+			{
+				if (t_left <= t_right)
+				{
+					stack[depth++] = node.mIndex+1;
+					stack[depth++] = node.mIndex;
+				}
+				else
+				{
+					stack[depth++] = node.mIndex;
+					stack[depth++] = node.mIndex+1;
+				}
+			}
+			else if (hit_left)
+			{
+				stack[depth++] = node.mIndex;
+			}
+			else if (hit_right)
+			{
+				stack[depth++] = node.mIndex+1;
+			}
+			continue;
+		}
+
+		//Moller-Trumbore against the four triangles of the packet, one sided
+		//like LLTriangleRayIntersect
+		const Packet& p = mPackets[node.mIndex];
+		const LLQuad e1x = p.mEdge1[0], e1y = p.mEdge1[1], e1z = p.mEdge1[2];
+		const LLQuad e2x = p.mEdge2[0], e2y = p.mEdge2[1], e2z = p.mEdge2[2];
+
+		//pvec = dir x edge2
+		LLQuad px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		LLQuad py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		LLQuad pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+		LLQuad det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+		LLQuad mask = _mm_cmpge_ps(det, epsilon);
+		if (!_mm_movemask_ps(mask))
+		{
+			continue;
+		}
+
+		//tvec = start - v0
+		LLQuad tx = _mm_sub_ps(ox, p.mV0[0]);
+		LLQuad ty = _mm_sub_ps(oy, p.mV0[1]);
+		LLQuad tz = _mm_sub_ps(oz, p.mV0[2]);
+
+		LLQuad u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz));
+		mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, det)));
+
+		//qvec = tvec x edge1
+		LLQuad qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+		LLQuad qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+		LLQuad qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+		LLQuad v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz));
+		mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), det)));
+		if (!_mm_movemask_ps(mask))
+		{
+			continue;
+		}
+
+		//divide only by the determinants of lanes still in play
+		LLQuad safe_det = _mm_or_ps(_mm_and_ps(mask, det), _mm_andnot_ps(mask, one));
+		LLQuad t = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), safe_det);
+		mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, one)));
+		mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(closest_t)));
+
+		S32 lanes = _mm_movemask_ps(mask);
+		if (!lanes)
+		{
+			continue;
+		}
+
+		const LLVector4a t_lane(t);
+		const LLVector4a u_lane(u);
+		const LLVector4a v_lane(v);
+		const LLVector4a det_lane(safe_det);
+
+		for (U32 lane = 0; lane < 4; ++lane)
+		{
+			if ((lanes & (1 << lane)) && t_lane[lane] < closest_t)
+			{
+				closest_t = t_lane[lane];
+				a = u_lane[lane] / det_lane[lane];
+				b = v_lane[lane] / det_lane[lane];
+				indices[0] = p.mIndices[lane][0];
+				indices[1] = p.mIndices[lane][1];
+				indices[2] = p.mIndices[lane][2];
+				hit = true;
+			}
+		}
+	}
+
+	return hit;
+}
@@ -0,0 +1,95 @@
+/** 
+ * @file llvolumebvh.h
+ * @brief Bounding volume hierarchy for line segment picks against a volume face.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOLUMEBVH_H
+#define LL_LLVOLUMEBVH_H
+
+#include "llmath.h"
+
+#include <vector>
+
+class LLVolumeFace;
+
+// Flat, binned-SAH bounding volume hierarchy over the triangles of a volume
+// face. Each leaf holds up to four triangles stored as one SoA packet that
+// is tested against the segment in a single pass.
+// Keeps its own copy of the triangle data and no pointers into the face, so
+// it can be built on any thread and copied along with the face.
+class LLVolumeBVH
+{
+public:
+	LLVolumeBVH();
+	LLVolumeBVH(const LLVolumeBVH& rhs);
+	~LLVolumeBVH();
+	LLVolumeBVH& operator=(const LLVolumeBVH& rhs);
+
+	void build(const LLVolumeFace& face);
+
+	// Finds the closest triangle hit by start + t*dir with 0 <= t <= 1 and
+	// t < closest_t. On a hit, updates closest_t and returns the barycentric
+	// coordinates of the hit in a and b and the triangle's vertex indices.
+	bool intersect(const LLVector4a& start, const LLVector4a& dir, F32& closest_t,
+				   F32& a, F32& b, U16 indices[3]) const;
+
+	U32 getNumNodes() const { return mNodes.size(); }
+	U32 getNumPackets() const { return mNumPackets; }
+
+	struct BuildTri; // build time only
+
+private:
+	struct Node
+	{
+		F32 mMin[4];
+		F32 mMax[4];
+		S32 mIndex;	// inner node: first child, the second one follows it; leaf: packet
+		S32 mLeaf;
+	};
+
+	// Four triangles, one per lane. Unused lanes are degenerate.
+	struct Packet
+	{
+		LLVector4a mV0[3];
+		LLVector4a mEdge1[3];
+		LLVector4a mEdge2[3];
+		U16 mIndices[4][3];
+	};
+
+	void buildNode(S32 node_index, std::vector<BuildTri>& tris, U32 begin, U32 end, U32 depth);
+	void copyPackets(const LLVolumeBVH& rhs);
+
+	std::vector<Node> mNodes;
+	Packet* mPackets; // 16 byte aligned
+	U32 mNumPackets;
+	U32 mDepth; // of the deepest leaf, sizes the traversal stack
+};
+
+#endif // LL_LLVOLUMEBVH_H
@@ -35,6 +35,8 @@
 #include "llmemtype.h"
 #include "llvolume.h"
 
+#include <sstream>
+
 
 const F32 BASE_THRESHOLD = 0.03f;
 
@@ -51,47 +53,76 @@ F32 LLVolumeLODGroup::mDetailScales[NUM_LODS] = {1.f, 1.5f, 2.5f, 4.f};
 //============================================================================
 
 LLVolumeMgr::LLVolumeMgr()
-:	mDataMutex(NULL)
 {
 	// the LLMutex magic interferes with easy unit testing,
 	// so you now must manually call useMutex() to use it
-	//mDataMutex = new LLMutex;
+	for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
+	{
+		mLODHits[i] = 0;
+		mLODBuilds[i] = 0;
+	}
 }
 
 LLVolumeMgr::~LLVolumeMgr()
 {
 	cleanup();
 
-	delete mDataMutex;
-	mDataMutex = NULL;
+	for (S32 i = 0; i < NUM_STRIPES; i++)
+	{
+		delete mStripes[i].mMutex;
+		mStripes[i].mMutex = NULL;
+		delete mStripes[i].mLODMutex;
+		mStripes[i].mLODMutex = NULL;
+	}
 }
 
 BOOL LLVolumeMgr::cleanup()
 {
 	BOOL no_refs = TRUE;
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin(),
-			 end = mVolumeLODGroups.end();
-		 iter != end; iter++)
+	for (S32 i = 0; i < NUM_STRIPES; i++)
 	{
-		LLVolumeLODGroup *volgroupp = iter->second;
-		if (volgroupp->cleanupRefs() == false)
+		Stripe& stripe = mStripes[i];
+		LLMutexLock lock(stripe.mMutex);
+		for (volume_lod_group_map_t::iterator iter = stripe.mVolumeLODGroups.begin(),
+				 end = stripe.mVolumeLODGroups.end();
+			 iter != end; iter++)
 		{
-			no_refs = FALSE;
+			LLVolumeLODGroup *volgroupp = iter->second;
+			if (volgroupp->cleanupRefs() == false)
+			{
+				no_refs = FALSE;
+			}
+			delete volgroupp;
 		}
- 		delete volgroupp;
-	}
-	mVolumeLODGroups.clear();
-	if (mDataMutex)
-	{
-		mDataMutex->unlock();
+		stripe.mVolumeLODGroups.clear();
 	}
 	return no_refs;
 }
 
+//static
+U32 LLVolumeMgr::hashParams(const LLVolumeParams& volume_params)
+{
+	// Only needs to agree with LLVolumeParams::operator==, quantizing keeps
+	// -0.f and 0.f together.
+	const LLProfileParams& profile = volume_params.getProfileParams();
+	const LLPathParams& path = volume_params.getPathParams();
+	const F32 values[] = { profile.getBegin(), profile.getEnd(), profile.getHollow(),
+						   path.getBegin(), path.getEnd(), path.getScaleX(), path.getScaleY(),
+						   path.getShearX(), path.getShearY(), path.getTwistBegin(), path.getTwist(),
+						   path.getRadiusOffset(), path.getTaperX(), path.getTaperY(),
+						   path.getRevolutions(), path.getSkew() };
+
+	U32 hash = volume_params.getSculptID().getCRC32();
+	hash = hash * 31 + (U32)profile.getCurveType();
+	hash = hash * 31 + (U32)path.getCurveType();
+	hash = hash * 31 + (U32)volume_params.getSculptType();
+	for (U32 i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+	{
+		hash = hash * 31 + (U32)(S32)(values[i] * 50000.f);
+	}
+	return hash ^ (hash >> 16);
+}
+
 // Always only ever store the results of refVolume in a LLPointer
 // Note however that LLVolumeLODGroup that contains the volume
 //  also holds a LLPointer so the volume will only go away after
@@ -99,43 +130,47 @@ BOOL LLVolumeMgr::cleanup()
 LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32 detail)
 {
 	LLVolumeLODGroup* volgroupp;
-	if (mDataMutex)
 	{
-		mDataMutex->lock();
+		Stripe& stripe = getStripe(volume_params);
+		LLMutexLock lock(stripe.mMutex);
+		volume_lod_group_map_t::iterator iter = stripe.mVolumeLODGroups.find(&volume_params);
+		if( iter == stripe.mVolumeLODGroups.end() )
+		{
+			volgroupp = createNewGroup(volume_params);
+		}
+		else
+		{
+			volgroupp = iter->second;
+		}
+		volgroupp->pin();
 	}
-	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&volume_params);
-	if( iter == mVolumeLODGroups.end() )
+
+	// Nobody waits while a missing LOD is generated
+	bool built = false;
+	LLVolume* volumep = volgroupp->refLOD(detail, &built);
+	volgroupp->unpin(); // refLOD() holds its own ref
+	if (built)
 	{
-		volgroupp = createNewGroup(volume_params);
+		mLODBuilds[detail]++;
 	}
 	else
 	{
-		volgroupp = iter->second;
-	}
-	if (mDataMutex)
-	{
-		mDataMutex->unlock();
+		mLODHits[detail]++;
 	}
-	return volgroupp->refLOD(detail);
+	return volumep;
 }
 
 // virtual
 LLVolumeLODGroup* LLVolumeMgr::getGroup( const LLVolumeParams& volume_params ) const
 {
 	LLVolumeLODGroup* volgroupp = NULL;
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	volume_lod_group_map_t::const_iterator iter = mVolumeLODGroups.find(&volume_params);
-	if( iter != mVolumeLODGroups.end() )
+	const Stripe& stripe = getStripe(volume_params);
+	LLMutexLock lock(stripe.mMutex);
+	volume_lod_group_map_t::const_iterator iter = stripe.mVolumeLODGroups.find(&volume_params);
+	if( iter != stripe.mVolumeLODGroups.end() )
 	{
 		volgroupp = iter->second;
 	}
-	if (mDataMutex)
-	{
-		mDataMutex->unlock();
-	}
 	return volgroupp;
 }
 
@@ -147,18 +182,12 @@ void LLVolumeMgr::unrefVolume(LLVolume *volumep)
 		return;
 	}
 	const LLVolumeParams* params = &(volumep->getParams());
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(params);
-	if( iter == mVolumeLODGroups.end() )
+	Stripe& stripe = getStripe(*params);
+	LLMutexLock lock(stripe.mMutex);
+	volume_lod_group_map_t::iterator iter = stripe.mVolumeLODGroups.find(params);
+	if( iter == stripe.mVolumeLODGroups.end() )
 	{
 		llerrs << "Warning! Tried to cleanup unknown volume type! " << *params << llendl;
-		if (mDataMutex)
-		{
-			mDataMutex->unlock();
-		}
 		return;
 	}
 	else
@@ -166,31 +195,94 @@ void LLVolumeMgr::unrefVolume(LLVolume *volumep)
 		LLVolumeLODGroup* volgroupp = iter->second;
 
 		volgroupp->derefLOD(volumep);
+		// refVolume() takes its group ref under the stripe lock too,
+		// so nobody can pick the group up again while it is deleted
 		if (volgroupp->getNumRefs() == 0)
 		{
-			mVolumeLODGroups.erase(params);
+			stripe.mVolumeLODGroups.erase(params);
 			delete volgroupp;
 		}
 	}
-	if (mDataMutex)
+}
+
+bool LLVolumeMgr::hasVolume(const LLVolumeParams &volume_params, const S32 detail) const
+{
+	const Stripe& stripe = getStripe(volume_params);
+	LLMutexLock lock(stripe.mMutex);
+	volume_lod_group_map_t::const_iterator iter = stripe.mVolumeLODGroups.find(&volume_params);
+	return iter != stripe.mVolumeLODGroups.end() && iter->second->hasLOD(detail);
+}
+
+bool LLVolumeMgr::publishVolume(LLVolume *volumep, const S32 detail)
+{
+	Stripe& stripe = getStripe(volumep->getParams());
+	LLMutexLock lock(stripe.mMutex);
+	volume_lod_group_map_t::iterator iter = stripe.mVolumeLODGroups.find(&volumep->getParams());
+	if (iter != stripe.mVolumeLODGroups.end() && iter->second->setLOD(detail, volumep))
 	{
-		mDataMutex->unlock();
+		mLODBuilds[detail]++;
+		return true;
 	}
+	return false;
+}
 
+static U32 get_volume_bytes(const LLVolume* volumep)
+{
+	U32 bytes = 0;
+	for (S32 i = 0; i < volumep->getNumVolumeFaces(); i++)
+	{
+		const LLVolumeFace& face = volumep->getVolumeFace(i);
+		bytes += face.mNumVertices * (sizeof(LLVector4a) * 2 + sizeof(LLVector2));
+		bytes += face.mNumIndices * sizeof(U16);
+	}
+	return bytes;
 }
 
+void LLVolumeMgr::getLODStats(LODStats* stats) const
+{
+	for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
+	{
+		stats[i].mHits = mLODHits[i];
+		stats[i].mBuilds = mLODBuilds[i];
+		stats[i].mVolumes = 0;
+		stats[i].mBytes = 0;
+	}
+
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		const Stripe& stripe = mStripes[s];
+		LLMutexLock lock(stripe.mMutex);
+		for (volume_lod_group_map_t::const_iterator iter = stripe.mVolumeLODGroups.begin();
+			 iter != stripe.mVolumeLODGroups.end(); ++iter)
+		{
+			LLVolumeLODGroup* volgroupp = iter->second;
+			LLMutexLock lod_lock(volgroupp->mLODMutex);
+			for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
+			{
+				if (volgroupp->mVolumeLODs[i].notNull())
+				{
+					stats[i].mVolumes++;
+					stats[i].mBytes += get_volume_bytes(volgroupp->mVolumeLODs[i]);
+				}
+			}
+		}
+	}
+}
+
+// stripe.mMutex must be locked
 // protected
-void LLVolumeMgr::insertGroup(LLVolumeLODGroup* volgroup)
+void LLVolumeMgr::insertGroup(Stripe& stripe, LLVolumeLODGroup* volgroup)
 {
-	mVolumeLODGroups[volgroup->getVolumeParams()] = volgroup;
+	stripe.mVolumeLODGroups[volgroup->getVolumeParams()] = volgroup;
 }
 
 // protected
 LLVolumeLODGroup* LLVolumeMgr::createNewGroup(const LLVolumeParams& volume_params)
 {
 	LLMemType m1(LLMemType::MTYPE_VOLUME);
-	LLVolumeLODGroup* volgroup = new LLVolumeLODGroup(volume_params);
-	insertGroup(volgroup);
+	Stripe& stripe = getStripe(volume_params);
+	LLVolumeLODGroup* volgroup = new LLVolumeLODGroup(volume_params, stripe.mLODMutex);
+	insertGroup(stripe, volgroup);
 	return volgroup;
 }
 
@@ -198,63 +290,72 @@ LLVolumeLODGroup* LLVolumeMgr::createNewGroup(const LLVolumeParams& volume_param
 void LLVolumeMgr::dump()
 {
 	F32 avg = 0.f;
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin(),
-			 end = mVolumeLODGroups.end();
-		 iter != end; iter++)
-	{
-		LLVolumeLODGroup *volgroupp = iter->second;
-		avg += volgroupp->dump();
+	int count = 0;
+	for (S32 s = 0; s < NUM_STRIPES; s++)
+	{
+		Stripe& stripe = mStripes[s];
+		LLMutexLock lock(stripe.mMutex);
+		for (volume_lod_group_map_t::iterator iter = stripe.mVolumeLODGroups.begin(),
+				 end = stripe.mVolumeLODGroups.end();
+			 iter != end; iter++)
+		{
+			LLVolumeLODGroup *volgroupp = iter->second;
+			avg += volgroupp->dump();
+		}
+		count += (int)stripe.mVolumeLODGroups.size();
 	}
-	int count = (int)mVolumeLODGroups.size();
 	avg = count ? avg / (F32)count : 0.0f;
-	if (mDataMutex)
+	llinfos << "Average usage of LODs " << avg << llendl;
+
+	LODStats stats[LLVolumeLODGroup::NUM_LODS];
+	getLODStats(stats);
+	for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; i++)
 	{
-		mDataMutex->unlock();
+		llinfos << "LOD " << i << ": " << stats[i].mHits << " hits, " << stats[i].mBuilds << " builds, "
+				<< stats[i].mVolumes << " volumes, " << stats[i].mBytes / 1024 << " KB" << llendl;
 	}
-	llinfos << "Average usage of LODs " << avg << llendl;
 }
 
 void LLVolumeMgr::useMutex()
 { 
-	if (!mDataMutex)
+	for (S32 i = 0; i < NUM_STRIPES; i++)
 	{
-		mDataMutex = new LLMutex;
+		if (!mStripes[i].mMutex)
+		{
+			mStripes[i].mMutex = new LLMutex;
+			mStripes[i].mLODMutex = new LLMutex;
+		}
 	}
 }
 
 std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr)
 {
-	s << "{ numLODgroups=" << volume_mgr.mVolumeLODGroups.size() << ", ";
-
 	S32 total_refs = 0;
-	if (volume_mgr.mDataMutex)
-	{
-		volume_mgr.mDataMutex->lock();
-	}
-
-	for (LLVolumeMgr::volume_lod_group_map_t::const_iterator iter = volume_mgr.mVolumeLODGroups.begin();
-		 iter != volume_mgr.mVolumeLODGroups.end(); ++iter)
-	{
-		LLVolumeLODGroup *volgroupp = iter->second;
-		total_refs += volgroupp->getNumRefs();
-		s << ", " << (*volgroupp);
-	}
+	S32 num_groups = 0;
+	std::ostringstream groups;
 
-	if (volume_mgr.mDataMutex)
+	for (S32 i = 0; i < LLVolumeMgr::NUM_STRIPES; i++)
 	{
-		volume_mgr.mDataMutex->unlock();
+		const LLVolumeMgr::Stripe& stripe = volume_mgr.mStripes[i];
+		LLMutexLock lock(stripe.mMutex);
+		for (LLVolumeMgr::volume_lod_group_map_t::const_iterator iter = stripe.mVolumeLODGroups.begin();
+			 iter != stripe.mVolumeLODGroups.end(); ++iter)
+		{
+			LLVolumeLODGroup *volgroupp = iter->second;
+			total_refs += volgroupp->getNumRefs();
+			groups << ", " << (*volgroupp);
+		}
+		num_groups += (S32)stripe.mVolumeLODGroups.size();
 	}
 
+	s << "{ numLODgroups=" << num_groups << ", " << groups.str();
 	s << ", total_refs=" << total_refs << " }";
 	return s;
 }
 
-LLVolumeLODGroup::LLVolumeLODGroup(const LLVolumeParams &params)
+LLVolumeLODGroup::LLVolumeLODGroup(const LLVolumeParams &params, LLMutex* lod_mutex)
 	: mVolumeParams(params),
+	  mLODMutex(lod_mutex),
 	  mRefs(0)
 {
 	for (S32 i = 0; i < NUM_LODS; i++)
@@ -295,25 +396,65 @@ bool LLVolumeLODGroup::cleanupRefs()
 	return res;
 }
 
-LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
+LLVolume* LLVolumeLODGroup::refLOD(const S32 detail, bool* built)
 {
 	llassert(detail >=0 && detail < NUM_LODS);
 	mAccessCount[detail]++;
 	
 	mRefs++;
-	if (mVolumeLODs[detail].isNull())
+	{
+		LLMutexLock lock(mLODMutex);
+		if (mVolumeLODs[detail].notNull())
+		{
+			mLODRefs[detail]++;
+			return mVolumeLODs[detail];
+		}
+	}
+
+	// Build without the lock, the other groups of the stripe share it.
+	LLPointer<LLVolume> volumep;
 	{
 		LLMemType m1(LLMemType::MTYPE_VOLUME);
-		mVolumeLODs[detail] = new LLVolume(mVolumeParams, mDetailScales[detail]);
+		volumep = new LLVolume(mVolumeParams, mDetailScales[detail]);
 	}
+
+	LLMutexLock lock(mLODMutex);
+	if (mVolumeLODs[detail].isNull())
+	{
+		mVolumeLODs[detail] = volumep;
+		if (built)
+		{
+			*built = true;
+		}
+	}
+	// else another thread built it meanwhile, ours is dropped
 	mLODRefs[detail]++;
 	return mVolumeLODs[detail];
 }
 
+bool LLVolumeLODGroup::hasLOD(const S32 detail) const
+{
+	LLMutexLock lock(mLODMutex);
+	return mVolumeLODs[detail].notNull();
+}
+
+bool LLVolumeLODGroup::setLOD(const S32 detail, LLVolume* volumep)
+{
+	llassert(detail >=0 && detail < NUM_LODS);
+	LLMutexLock lock(mLODMutex);
+	if (mVolumeLODs[detail].notNull())
+	{
+		return false;
+	}
+	mVolumeLODs[detail] = volumep;
+	return true;
+}
+
 BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 {
 	llassert_always(mRefs > 0);
 	mRefs--;
+	LLMutexLock lock(mLODMutex);
 	for (S32 i = 0; i < NUM_LODS; i++)
 	{
 		if (mVolumeLODs[i] == volumep)
@@ -400,7 +541,7 @@ F32 LLVolumeLODGroup::dump()
 	}
 	usage = usage / (F32)NUM_LODS;
 
-	std::string dump_str = llformat("%.3f %d %d %d %d", usage, mAccessCount[0], mAccessCount[1], mAccessCount[2], mAccessCount[3]);
+	std::string dump_str = llformat("%.3f %d %d %d %d", usage, (S32)mAccessCount[0], (S32)mAccessCount[1], (S32)mAccessCount[2], (S32)mAccessCount[3]);
 
 	llinfos << dump_str << llendl;
 	return usage;
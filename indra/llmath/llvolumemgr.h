@@ -35,6 +35,7 @@
 
 #include <map>
 
+#include "llapr.h"
 #include "llvolume.h"
 #include "llpointer.h"
 #include "llthread.h"
@@ -52,7 +53,7 @@ public:
 		NUM_LODS = 4
 	};
 
-	LLVolumeLODGroup(const LLVolumeParams &params);
+	LLVolumeLODGroup(const LLVolumeParams &params, LLMutex* lod_mutex = NULL);
 	~LLVolumeLODGroup();
 	bool cleanupRefs();
 
@@ -61,9 +62,18 @@ public:
 	static F32 getVolumeScaleFromDetail(const S32 detail);
 	static S32 getVolumeDetailFromScale(F32 scale);
 
-	LLVolume* refLOD(const S32 detail);
+	// Keeps the group alive between a lookup under the lock of the map that
+	// owns it and the refLOD() that follows outside of that lock.
+	void pin() { mRefs++; }
+	void unpin() { mRefs--; }
+	// Sets built to true if the LOD had to be created.
+	LLVolume* refLOD(const S32 detail, bool* built = NULL);
 	BOOL derefLOD(LLVolume *volumep);
 	S32 getNumRefs() const { return mRefs; }
+
+	bool hasLOD(const S32 detail) const;
+	// Stores a volume built elsewhere, unless that LOD already exists.
+	bool setLOD(const S32 detail, LLVolume* volumep);
 	
 	const LLVolumeParams* getVolumeParams() const { return &mVolumeParams; };
 
@@ -73,17 +83,39 @@ public:
 protected:
 	LLVolumeParams mVolumeParams;
 
-	S32 mRefs;
-	S32 mLODRefs[NUM_LODS];
+	// Guards mVolumeLODs, shared with the other groups of the same stripe.
+	LLMutex* mLODMutex;
+
+	mutable LLAtomicS32 mRefs;
+	LLAtomicS32 mLODRefs[NUM_LODS];
 	LLPointer<LLVolume> mVolumeLODs[NUM_LODS];
 	static F32 mDetailThresholds[NUM_LODS];
 	static F32 mDetailScales[NUM_LODS];
-	S32		mAccessCount[NUM_LODS];
+	LLAtomicS32 mAccessCount[NUM_LODS];
+
+	friend class LLVolumeMgr;
 };
 
+// Volumes are shared between all prims with identical parameters.
+// The groups are hashed into stripes, each with its own lock, so that
+// lookups from different threads rarely wait on each other; missing LODs
+// are built outside of any lock and inserted afterwards.
 class LLVolumeMgr
 {
 public:
+	enum
+	{
+		NUM_STRIPES = 16 // power of two
+	};
+
+	struct LODStats
+	{
+		U32 mHits;		// refs to an existing volume
+		U32 mBuilds;	// volumes created by refVolume()
+		U32 mVolumes;	// volumes currently cached
+		U32 mBytes;		// approximate vertex and index memory of those volumes
+	};
+
 	LLVolumeMgr();
 	virtual ~LLVolumeMgr();
 	BOOL cleanup();			// Cleanup all volumes being managed, returns TRUE if no dangling references
@@ -96,6 +128,15 @@ public:
 	virtual LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail);
 	virtual void unrefVolume(LLVolume *volumep);
 
+	// TRUE if refVolume() can hand out that LOD without building it
+	bool hasVolume(const LLVolumeParams &volume_params, const S32 detail) const;
+	// Hands over a volume built off the main thread to its LOD group.
+	// Returns false (and keeps nothing) if the group is gone or the LOD already exists.
+	bool publishVolume(LLVolume *volumep, const S32 detail);
+
+	// Fills in NUM_LODS entries. Walks all groups, meant for debug displays.
+	void getLODStats(LODStats* stats) const;
+
 	void dump();
 
 	// manually call this for mutex magic
@@ -104,15 +145,31 @@ public:
 	friend std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr);
 
 protected:
-	void insertGroup(LLVolumeLODGroup* volgroup);
+	typedef std::map<const LLVolumeParams*, LLVolumeLODGroup*, LLVolumeParams::compare> volume_lod_group_map_t;
+
+	struct Stripe
+	{
+		Stripe() : mMutex(NULL), mLODMutex(NULL) {}
+
+		volume_lod_group_map_t mVolumeLODGroups;
+		LLMutex* mMutex;	// guards mVolumeLODGroups
+		LLMutex* mLODMutex;	// handed to the groups of this stripe
+	};
+
+	static U32 hashParams(const LLVolumeParams& volume_params);
+	Stripe& getStripe(const LLVolumeParams& volume_params) { return mStripes[hashParams(volume_params) & (NUM_STRIPES - 1)]; }
+	const Stripe& getStripe(const LLVolumeParams& volume_params) const { return mStripes[hashParams(volume_params) & (NUM_STRIPES - 1)]; }
+
+	// stripe.mMutex must be locked
+	void insertGroup(Stripe& stripe, LLVolumeLODGroup* volgroup);
 	// Overridden in llphysics/abstract/utils/llphysicsvolumemanager.h
 	virtual LLVolumeLODGroup* createNewGroup(const LLVolumeParams& volume_params);
 
 protected:
-	typedef std::map<const LLVolumeParams*, LLVolumeLODGroup*, LLVolumeParams::compare> volume_lod_group_map_t;
-	volume_lod_group_map_t mVolumeLODGroups;
+	Stripe mStripes[NUM_STRIPES];
 
-	LLMutex* mDataMutex;
+	mutable LLAtomicU32 mLODHits[LLVolumeLODGroup::NUM_LODS];
+	mutable LLAtomicU32 mLODBuilds[LLVolumeLODGroup::NUM_LODS];
 };
 
 #endif // LL_LLVOLUMEMGR_H
@@ -0,0 +1,281 @@
+/**
+ * @file llvolume_test.cpp
+ * @brief LLVolumeFace::cacheOptimize test cases.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvolume.h"
+
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+#include <algorithm>
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: globals llvolume.cpp expects from llrender and the viewer.
+
+BOOL gDebugGL = FALSE;
+U32 gOctreeMaxCapacity = 128;
+
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	// Flat grid in the xy plane, cells*cells quads. Vertex v sits at
+	// (v % (cells+1), v / (cells+1)) before any shuffling.
+	void make_grid(LLVolumeFace& face, U32 cells)
+	{
+		U32 columns = cells + 1;
+		face.resizeVertices(columns*columns);
+		for (U32 v = 0; v < columns*columns; ++v)
+		{
+			F32 x = (F32) (v % columns);
+			F32 y = (F32) (v / columns);
+			face.mPositions[v].set(x, y, 0.f);
+			face.mNormals[v].set(0.f, 0.f, 1.f);
+			face.mTexCoords[v].set(x / cells, y / cells);
+		}
+
+		face.resizeIndices(cells*cells*6);
+		U16* idx = face.mIndices;
+		for (U32 j = 0; j < cells; ++j)
+		{
+			for (U32 i = 0; i < cells; ++i)
+			{
+				U16 a = j*columns + i;
+				U16 b = a + 1;
+				U16 c = a + columns;
+				U16 d = c + 1;
+				*idx++ = a; *idx++ = b; *idx++ = c;
+				*idx++ = b; *idx++ = d; *idx++ = c;
+			}
+		}
+	}
+
+	U32 next_random(U32& seed)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return seed >> 8;
+	}
+
+	// Renumbers the vertices and reorders the triangles at random, the worst
+	// case for a vertex cache.
+	void shuffle_face(LLVolumeFace& face)
+	{
+		U32 seed = 1;
+
+		std::vector<U16> remap(face.mNumVertices);
+		for (U32 i = 0; i < remap.size(); ++i)
+		{
+			remap[i] = i;
+		}
+		for (U32 i = remap.size() - 1; i > 0; --i)
+		{
+			std::swap(remap[i], remap[next_random(seed) % (i + 1)]);
+		}
+
+		std::vector<LLVector4a> positions(face.mPositions, face.mPositions + face.mNumVertices);
+		std::vector<LLVector2> tcs(face.mTexCoords, face.mTexCoords + face.mNumVertices);
+		for (U32 i = 0; i < remap.size(); ++i)
+		{
+			face.mPositions[remap[i]] = positions[i];
+			face.mTexCoords[remap[i]] = tcs[i];
+		}
+
+		U32 num_tris = face.mNumIndices/3;
+		for (U32 i = 0; i < (U32) face.mNumIndices; ++i)
+		{
+			face.mIndices[i] = remap[face.mIndices[i]];
+		}
+		for (U32 i = num_tris - 1; i > 0; --i)
+		{
+			U32 j = next_random(seed) % (i + 1);
+			std::swap_ranges(face.mIndices + i*3, face.mIndices + i*3 + 3, face.mIndices + j*3);
+		}
+	}
+
+	// Cache misses of a FIFO vertex cache of the given size
+	U32 count_misses(const LLVolumeFace& face, U32 cache_size)
+	{
+		std::vector<S32> fifo(cache_size, -1);
+		U32 head = 0;
+		U32 misses = 0;
+		for (S32 i = 0; i < face.mNumIndices; ++i)
+		{
+			S32 idx = face.mIndices[i];
+			if (std::find(fifo.begin(), fifo.end(), idx) == fifo.end())
+			{
+				fifo[head] = idx;
+				head = (head + 1) % cache_size;
+				++misses;
+			}
+		}
+		return misses;
+	}
+
+	const U32 FIFO_SIZE = 16;
+
+	// Average cache miss ratio, misses per triangle
+	F32 get_acmr(const LLVolumeFace& face)
+	{
+		return (F32) count_misses(face, FIFO_SIZE) / (face.mNumIndices/3);
+	}
+
+	// Average transform to vertex ratio, misses per vertex
+	F32 get_atvr(const LLVolumeFace& face)
+	{
+		return (F32) count_misses(face, FIFO_SIZE) / face.mNumVertices;
+	}
+
+	// The triangles of a grid face as sorted grid position triples, winding kept
+	std::vector<U64> grid_triangles(const LLVolumeFace& face, U32 cells)
+	{
+		std::vector<U64> tris;
+		for (S32 i = 0; i < face.mNumIndices; i += 3)
+		{
+			U64 v[3];
+			for (U32 k = 0; k < 3; ++k)
+			{
+				const F32* p = face.mPositions[face.mIndices[i+k]].getF32ptr();
+				v[k] = (U64) (llround(p[1]) * (cells + 1) + llround(p[0]));
+			}
+			//rotate the smallest first so the same triangle always gives the same key
+			U32 first = v[0] < v[1] ? (v[0] < v[2] ? 0 : 2) : (v[1] < v[2] ? 1 : 2);
+			tris.push_back((v[first] << 40) | (v[(first+1)%3] << 20) | v[(first+2)%3]);
+		}
+		std::sort(tris.begin(), tris.end());
+		return tris;
+	}
+}
+
+namespace tut
+{
+	struct volume_test
+	{
+	};
+	typedef test_group<volume_test> volume_test_t;
+	typedef volume_test_t::object volume_test_object_t;
+	tut::volume_test_t tut_volume_test("LLVolume");
+
+	// cacheOptimize keeps every triangle and every vertex with its attributes
+	template<> template<>
+	void volume_test_object_t::test<1>()
+	{
+		const U32 cells = 32;
+		LLVolumeFace face;
+		make_grid(face, cells);
+		shuffle_face(face);
+		std::vector<U64> before = grid_triangles(face, cells);
+		S32 num_verts = face.mNumVertices;
+
+		face.cacheOptimize();
+
+		ensure_equals("vertex count", face.mNumVertices, num_verts);
+		ensure("same triangles", grid_triangles(face, cells) == before);
+
+		for (S32 i = 0; i < face.mNumVertices; ++i)
+		{
+			const F32* p = face.mPositions[i].getF32ptr();
+			ensure_approximately_equals("u follows position", face.mTexCoords[i].mV[0], p[0] / cells, 20);
+			ensure_approximately_equals("v follows position", face.mTexCoords[i].mV[1], p[1] / cells, 20);
+		}
+
+		//vertices come in order of first use
+		S32 next = 0;
+		for (S32 i = 0; i < face.mNumIndices; ++i)
+		{
+			ensure("first use order", face.mIndices[i] <= next);
+			if (face.mIndices[i] == next)
+			{
+				++next;
+			}
+		}
+	}
+
+	// ACMR and ATVR against a 16 entry FIFO, from ordered and from shuffled input
+	template<> template<>
+	void volume_test_object_t::test<2>()
+	{
+		const U32 cells = 64;
+
+		LLVolumeFace ordered;
+		make_grid(ordered, cells);
+		F32 ordered_acmr = get_acmr(ordered);
+		ordered.cacheOptimize();
+
+		LLVolumeFace shuffled;
+		make_grid(shuffled, cells);
+		shuffle_face(shuffled);
+		F32 shuffled_acmr = get_acmr(shuffled);
+		shuffled.cacheOptimize();
+
+		llinfos << "ordered input ACMR " << ordered_acmr << " -> " << get_acmr(ordered)
+				<< ", ATVR " << get_atvr(ordered) << llendl;
+		llinfos << "shuffled input ACMR " << shuffled_acmr << " -> " << get_acmr(shuffled)
+				<< ", ATVR " << get_atvr(shuffled) << llendl;
+
+		//a regular grid gets close to 0.5 misses per triangle at best
+		ensure("ordered ACMR improved", get_acmr(ordered) < ordered_acmr);
+		ensure("ordered ACMR", get_acmr(ordered) < 0.75f);
+		ensure("ordered ATVR", get_atvr(ordered) < 1.5f);
+		ensure("shuffled ACMR", get_acmr(shuffled) < 0.75f);
+		ensure("shuffled ATVR", get_atvr(shuffled) < 1.5f);
+	}
+
+	// Timing on a 64800 triangle grid, run with --debug to see the results
+	template<> template<>
+	void volume_test_object_t::test<3>()
+	{
+		const U32 cells = 180;
+
+		for (U32 pass = 0; pass < 2; ++pass)
+		{
+			LLVolumeFace face;
+			make_grid(face, cells);
+			if (pass)
+			{
+				shuffle_face(face);
+			}
+			F32 acmr = get_acmr(face);
+
+			LLTimer timer;
+			face.cacheOptimize();
+			F64 seconds = timer.getElapsedTimeF64();
+
+			llinfos << (pass ? "shuffled" : "ordered") << " grid of " << face.mNumIndices/3 << " triangles: ACMR "
+					<< acmr << " -> " << get_acmr(face) << ", ATVR " << get_atvr(face) << ", "
+					<< seconds * 1000.0 << " ms" << llendl;
+
+			ensure("ACMR", get_acmr(face) < 0.75f);
+		}
+	}
+}
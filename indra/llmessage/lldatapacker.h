@@ -171,6 +171,10 @@ public:
 				const U8*   getBuffer() const   { return mBufferp; }    
 				void		reset()				{ mCurBufferp = mBufferp; mWriteEnabled = (mCurBufferp != NULL); }
 				void		freeBuffer()		{ delete [] mBufferp; mBufferp = mCurBufferp = NULL; mBufferSize = 0; mWriteEnabled = FALSE; }
+				// Forgets a buffer owned by someone else, without freeing it.
+				void		releaseBuffer()		{ mBufferp = mCurBufferp = NULL; mBufferSize = 0; mWriteEnabled = FALSE; }
+				// Moves the read position to offset bytes into the buffer.
+				void		seek(S32 offset)	{ llassert(offset >= 0 && offset <= mBufferSize); mCurBufferp = mBufferp + offset; }
 				void		assignBuffer(U8 *bufferp, S32 size)
 				{
 					if(mBufferp && mBufferp != bufferp)
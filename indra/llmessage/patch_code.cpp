@@ -281,128 +281,97 @@ void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph)
 	gWordBits = (ph->quant_wbits & 0xf) + 2;
 }
 
-void	decode_patch(LLBitPack &bitpack, S32 *patches)
+// Reads the bits of an LLBitPack through a 64 bit accumulator refilled a
+// byte at a time, instead of one bitUnpack() call per bit. Hands the
+// unconsumed bits back to the bitpack when done.
+class LLPatchBitReader
 {
-#ifdef LL_BIG_ENDIAN
-	S32		i, j, patch_size = gPatchSize, wbits = gWordBits;
-	U8		tempu8;
-	U16		tempu16;
-	U32		tempu32;
-	for (i = 0; i < patch_size*patch_size; i++)
+public:
+	LLPatchBitReader(LLBitPack& bitpack)
+	:	mBitPack(bitpack),
+		mBits((U64)bitpack.mLoad << 56),
+		mNumBits(bitpack.mLoadSize),
+		mPos(bitpack.mBufferSize)
 	{
-		bitpack.bitUnpack((U8 *)&tempu8, 1);
-		if (tempu8)
+	}
+
+	~LLPatchBitReader()
+	{
+		U32 num_bytes = mNumBits >> 3;
+		U32 num_bits = mNumBits & 7;
+		mBitPack.mBufferSize = mPos - num_bytes;
+		mBitPack.mLoadSize = num_bits;
+		mBitPack.mLoad = num_bits ? (U8)((mBits >> 56) & (0xFF << (8 - num_bits))) : 0;
+	}
+
+	// Next count bits, first one in the highest position. count <= 32.
+	U32 read(U32 count)
+	{
+		if (mNumBits < count)
 		{
-			// either 0 EOB or Value
-			bitpack.bitUnpack((U8 *)&tempu8, 1);
-			if (tempu8)
-			{
-				// value
-				bitpack.bitUnpack((U8 *)&tempu8, 1);
-				if (tempu8)
-				{
-					// negative
-					patches[i] = -1;
-				}
-				else
-				{
-					// positive
-					patches[i] = 1;
-				}
-				if (wbits <= 8)
-				{
-					bitpack.bitUnpack((U8 *)&tempu8, wbits);
-					patches[i] *= tempu8;
-				}
-				else if (wbits <= 16)
-				{
-					tempu16 = 0;
-					U8 *ret = (U8 *)&tempu16;
-					bitpack.bitUnpack(&(ret[1]), 8);
-					bitpack.bitUnpack(&(ret[0]), wbits - 8);
-					patches[i] *= tempu16;
-				}
-				else if (wbits <= 24)
-				{
-					tempu32 = 0;
-					U8 *ret = (U8 *)&tempu32;
-					bitpack.bitUnpack(&(ret[2]), 8);
-					bitpack.bitUnpack(&(ret[1]), 8);
-					bitpack.bitUnpack(&(ret[0]), wbits - 16);
-					patches[i] *= tempu32;
-				}
-				else if (wbits <= 32)
-				{
-					tempu32 = 0;
-					U8 *ret = (U8 *)&tempu32;
-					bitpack.bitUnpack(&(ret[3]), 8);
-					bitpack.bitUnpack(&(ret[2]), 8);
-					bitpack.bitUnpack(&(ret[1]), 8);
-					bitpack.bitUnpack(&(ret[0]), wbits - 24);
-					patches[i] *= tempu32;
-				}
-			}
-			else
-			{
-				for (j = i; j < patch_size*patch_size; j++)
-				{
-					patches[j] = 0;
-				}
-				return;
-			}
+			refill();
 		}
-		else
+		U32 value = (U32)(mBits >> (64 - count));
+		mBits <<= count;
+		mNumBits -= llmin(count, mNumBits);
+		return value;
+	}
+
+	// Same layout as bitUnpack() into a little endian word: whole bytes
+	// first, the remaining bits in the highest byte.
+	U32 readWord(U32 count)
+	{
+		U32 value = 0;
+		U32 shift = 0;
+		while (count > 8)
 		{
-			patches[i] = 0;
+			value |= read(8) << shift;
+			shift += 8;
+			count -= 8;
 		}
+		return value | (read(count) << shift);
 	}
-#else
-	S32		i, j, patch_size = gPatchSize, wbits = gWordBits;
-	U32		temp;
-	for (i = 0; i < patch_size*patch_size; i++)
+
+private:
+	void refill()
 	{
-		temp = 0;
-		bitpack.bitUnpack((U8 *)&temp, 1);
-		if (temp)
+		while (mNumBits <= 56 && mPos < mBitPack.mMaxSize)
 		{
-			// either 0 EOB or Value
-			temp = 0;
-			bitpack.bitUnpack((U8 *)&temp, 1);
-			if (temp)
-			{
-				// value
-				temp = 0;
-				bitpack.bitUnpack((U8 *)&temp, 1);
-				if (temp)
-				{
-					// negative
-					temp = 0;
-					bitpack.bitUnpack((U8 *)&temp, wbits);
-					patches[i] = temp;
-					patches[i] *= -1;
-				}
-				else
-				{
-					// positive
-					temp = 0;
-					bitpack.bitUnpack((U8 *)&temp, wbits);
-					patches[i] = temp;
-				}
-			}
-			else
-			{
-				for (j = i; j < patch_size*patch_size; j++)
-				{
-					patches[j] = 0;
-				}
-				return;
-			}
+			mBits |= (U64)mBitPack.mBuffer[mPos++] << (56 - mNumBits);
+			mNumBits += 8;
 		}
-		else
+	}
+
+	LLBitPack& mBitPack;
+	U64 mBits;		// unread bits, first one in the highest position
+	U32 mNumBits;
+	U32 mPos;		// next byte of the bitpack buffer to load
+};
+
+void	decode_patch(LLBitPack &bitpack, S32 *patches)
+{
+	S32 i, patch_size = gPatchSize, wbits = gWordBits;
+	S32 count = patch_size*patch_size;
+	LLPatchBitReader reader(bitpack);
+	for (i = 0; i < count; i++)
+	{
+		if (!reader.read(1))
 		{
 			patches[i] = 0;
 		}
+		else if (!reader.read(1))
+		{
+			// zero EOB
+			memset(patches + i, 0, (count - i)*sizeof(S32));
+			return;
+		}
+		else if (reader.read(1))
+		{
+			patches[i] = -(S32)reader.readWord(wbits);
+		}
+		else
+		{
+			patches[i] = (S32)reader.readWord(wbits);
+		}
 	}
-#endif
 }
-
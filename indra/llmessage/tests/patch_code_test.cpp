@@ -0,0 +1,452 @@
+/** 
+ * @file patch_code_test.cpp
+ * @brief Terrain patch decoding test cases and benchmark.
+ *
+ * $LicenseInfo:firstyear=2000&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../patch_code.h"
+#include "../patch_dct.h"
+
+#include "bitpack.h"
+#include "llmath.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+extern U32 gPatchSize, gWordBits;
+
+// -------------------------------------------------------------------------------------------
+// The bit decoder and inverse DCT as they were before they got vectorized, kept here to check
+// the current ones against.
+// -------------------------------------------------------------------------------------------
+
+namespace scalar
+{
+	F32 gDequantizeTable[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	F32 gICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	S32 gDeCopyMatrix[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+
+	void init_patch_decompressor(S32 size)
+	{
+		F32 oosob = F_PI*0.5f/size;
+		for (S32 j = 0; j < size; j++)
+		{
+			for (S32 i = 0; i < size; i++)
+			{
+				gDequantizeTable[j*size + i] = (1.f + 2.f*(i+j));
+				gICosines[j*size + i] = cosf((2.f*i+1.f)*j*oosob);
+			}
+		}
+
+		// zigzag order of the coefficients
+		S32 i = 0, j = 0, count = 0;
+		bool diag = false, right = true;
+		while (i < size && j < size)
+		{
+			gDeCopyMatrix[j*size + i] = count++;
+			if (!diag)
+			{
+				if (right)
+				{
+					if (i < size - 1) i++; else j++;
+				}
+				else
+				{
+					if (j < size - 1) j++; else i++;
+				}
+				right = !right;
+				diag = true;
+			}
+			else if (right)
+			{
+				i++;
+				j--;
+				diag = !(i == size - 1 || j == 0);
+			}
+			else
+			{
+				i--;
+				j++;
+				diag = !(i == 0 || j == size - 1);
+			}
+		}
+	}
+
+	void decode_patch(LLBitPack &bitpack, S32 *patches)
+	{
+		S32 i, j, patch_size = gPatchSize, wbits = gWordBits;
+		U32 temp;
+		for (i = 0; i < patch_size*patch_size; i++)
+		{
+			temp = 0;
+			bitpack.bitUnpack((U8 *)&temp, 1);
+			if (temp)
+			{
+				// either 0 EOB or Value
+				temp = 0;
+				bitpack.bitUnpack((U8 *)&temp, 1);
+				if (temp)
+				{
+					// value
+					temp = 0;
+					bitpack.bitUnpack((U8 *)&temp, 1);
+					bool negative = temp != 0;
+					temp = 0;
+					bitpack.bitUnpack((U8 *)&temp, wbits);
+					patches[i] = negative ? -(S32)temp : (S32)temp;
+				}
+				else
+				{
+					for (j = i; j < patch_size*patch_size; j++)
+					{
+						patches[j] = 0;
+					}
+					return;
+				}
+			}
+			else
+			{
+				patches[i] = 0;
+			}
+		}
+	}
+
+	// Same summation order as the unrolled idct_column() and idct_line()
+	void idct_patch(F32 *block, S32 size)
+	{
+		F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		for (S32 column = 0; column < size; column++)
+		{
+			for (S32 n = 0; n < size; n++)
+			{
+				F32 total = OO_SQRT2*block[column];
+				for (S32 u = 1; u < size; u++)
+				{
+					total += block[u*size + column]*gICosines[u*size + n];
+				}
+				temp[n*size + column] = total;
+			}
+		}
+
+		F32 oosob = 2.f/size;
+		for (S32 line = 0; line < size; line++)
+		{
+			for (S32 n = 0; n < size; n++)
+			{
+				F32 total = OO_SQRT2*temp[line*size];
+				for (S32 u = 1; u < size; u++)
+				{
+					total += temp[line*size + u]*gICosines[u*size + n];
+				}
+				block[line*size + n] = total*oosob;
+			}
+		}
+	}
+
+	void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph, S32 size, S32 stride)
+	{
+		F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		S32 prequant = (ph->quant_wbits >> 4) + 2;
+		F32 mult = (1.f/(F32)(1<<prequant))*ph->range;
+		F32 addval = mult*(F32)(1<<(prequant - 1)) + ph->dc_offset;
+
+		for (S32 i = 0; i < size*size; i++)
+		{
+			block[i] = cpatch[gDeCopyMatrix[i]]*gDequantizeTable[i];
+		}
+
+		idct_patch(block, size);
+
+		for (S32 j = 0; j < size; j++)
+		{
+			for (S32 i = 0; i < size; i++)
+			{
+				patch[j*stride + i] = block[j*size + i]*mult + addval;
+			}
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+// Helpers
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	const U8 LAND_LAYER = 'L';
+	const S32 PACKET_SIZE = 4096;
+
+	struct layer_packet
+	{
+		U8 mData[PACKET_SIZE];
+		U32 mSize;
+	};
+
+	// Rolling hills with some noise on top, the kind of land a sim sends.
+	void make_land(std::vector<F32>& heights, S32 grids)
+	{
+		heights.resize(grids*grids);
+		U32 seed = 12345;
+		for (S32 y = 0; y < grids; y++)
+		{
+			for (S32 x = 0; x < grids; x++)
+			{
+				seed = seed*1664525 + 1013904223;
+				F32 noise = (F32)(seed >> 8) / (F32)(1 << 24) - 0.5f;
+				heights[y*grids + x] = 24.f + 6.f*sinf(x*0.05f)*cosf(y*0.07f) + 2.f*sinf((x + y)*0.31f) + 0.3f*noise;
+			}
+		}
+	}
+
+	// Codes the land of a region the way a sim does, starting a new LayerData
+	// packet once one holds about a kilobyte.
+	void code_land(std::vector<layer_packet>& packets, std::vector<F32>& heights, S32 patch_size, S32 patches_per_edge)
+	{
+		const U32 FULL_PACKET = 1000;
+		S32 grids = patch_size*patches_per_edge + 1;
+		make_land(heights, grids);
+		init_patch_compressor(patch_size, grids, LAND_LAYER);
+		LLGroupHeader gopp;
+		get_patch_group_header(&gopp);
+
+		packets.clear();
+		LLBitPack* bitpack = NULL;
+		S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		for (S32 j = 0; j < patches_per_edge; j++)
+		{
+			for (S32 i = 0; i < patches_per_edge; i++)
+			{
+				if (!bitpack)
+				{
+					packets.push_back(layer_packet());
+					bitpack = new LLBitPack(packets.back().mData, PACKET_SIZE);
+					init_patch_coding(*bitpack);
+					code_patch_group_header(*bitpack, &gopp);
+				}
+
+				F32* patch = &heights[j*patch_size*grids + i*patch_size];
+				LLPatchHeader ph;
+				F32 zmax, zmin;
+				prescan_patch(patch, &ph, zmax, zmin);
+				compress_patch(patch, cpatch, &ph, 10);
+				ph.patchids = (i << 5) | j;
+				code_patch_header(*bitpack, &ph, cpatch);
+				code_patch(*bitpack, cpatch, 0);
+
+				bool last = (i == patches_per_edge - 1 && j == patches_per_edge - 1);
+				if (last || bitpack->mBufferSize >= FULL_PACKET)
+				{
+					code_end_of_data(*bitpack);
+					end_patch_coding(*bitpack);
+					packets.back().mSize = bitpack->mBufferSize;
+					delete bitpack;
+					bitpack = NULL;
+				}
+			}
+		}
+	}
+}
+
+namespace tut
+{
+	struct patch_code_test
+	{
+	};
+	typedef test_group<patch_code_test> patch_code_test_t;
+	typedef patch_code_test_t::object patch_code_test_object_t;
+	tut::patch_code_test_t tut_patch_code_test("patch_code");
+
+	// Decodes every packet of a coded region with both decoders side by side
+	// and checks the coefficients, the bitstream position and the heights.
+	void check_region(S32 patch_size, S32 patches_per_edge)
+	{
+		std::vector<layer_packet> packets;
+		std::vector<F32> heights;
+		code_land(packets, heights, patch_size, patches_per_edge);
+
+		S32 grids = patch_size*patches_per_edge + 1;
+		std::vector<F32> old_heights(grids*grids, 0.f);
+		std::vector<F32> new_heights(grids*grids, 0.f);
+		S32 old_coeffs[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		S32 new_coeffs[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		S32 num_patches = 0;
+		F32 max_error = 0.f;
+		// The large patch coder drops the higher frequencies of the noise
+		F32 coding_error = patch_size == NORMAL_PATCH_SIZE ? 0.5f : 1.f;
+
+		for (U32 p = 0; p < packets.size(); p++)
+		{
+			LLBitPack old_bits(packets[p].mData, packets[p].mSize);
+			LLBitPack new_bits(packets[p].mData, packets[p].mSize);
+			LLGroupHeader gopp;
+			decode_patch_group_header(old_bits, &gopp);
+			decode_patch_group_header(new_bits, &gopp);
+			ensure_equals("patch size", (S32)gopp.patch_size, patch_size);
+
+			init_patch_decompressor(gopp.patch_size);
+			scalar::init_patch_decompressor(gopp.patch_size);
+			gopp.stride = grids;
+			set_group_of_patch_header(&gopp);
+
+			while (1)
+			{
+				LLPatchHeader ph;
+				decode_patch_header(old_bits, &ph);
+				decode_patch_header(new_bits, &ph);
+				if (ph.quant_wbits == END_OF_PATCHES)
+				{
+					break;
+				}
+				scalar::decode_patch(old_bits, old_coeffs);
+				decode_patch(new_bits, new_coeffs);
+				ensure("same coefficients", !memcmp(old_coeffs, new_coeffs, patch_size*patch_size*sizeof(S32)));
+				ensure_equals("same byte position", new_bits.mBufferSize, old_bits.mBufferSize);
+				ensure_equals("same bit position", new_bits.mLoadSize, old_bits.mLoadSize);
+				ensure_equals("same pending bits", new_bits.mLoad, old_bits.mLoad);
+
+				S32 offset = (ph.patchids & 0x1f)*patch_size*grids + (ph.patchids >> 5)*patch_size;
+				scalar::decompress_patch(&old_heights[offset], old_coeffs, &ph, patch_size, grids);
+				decompress_patch(&new_heights[offset], new_coeffs, &ph);
+				for (S32 j = 0; j < patch_size; j++)
+				{
+					for (S32 i = 0; i < patch_size; i++)
+					{
+						S32 index = offset + j*grids + i;
+						max_error = llmax(max_error, fabsf(new_heights[index] - old_heights[index]));
+						ensure("close to the coded land", fabsf(old_heights[index] - heights[index]) < coding_error);
+					}
+				}
+				num_patches++;
+			}
+		}
+
+		ensure_equals("every patch decoded", num_patches, patches_per_edge*patches_per_edge);
+		ensure("heights within 4e-6 of the scalar IDCT", max_error <= 4e-6f);
+	}
+
+	// normal 16x16 patches
+	template<> template<>
+	void patch_code_test_object_t::test<1>()
+	{
+		check_region(NORMAL_PATCH_SIZE, 16);
+	}
+
+	// large 32x32 patches
+	template<> template<>
+	void patch_code_test_object_t::test<2>()
+	{
+		check_region(LARGE_PATCH_SIZE, 8);
+	}
+
+	// bit decoding and the inverse DCT of a whole region, old against new.
+	// Logged at INFO level, run with --debug to see the timings.
+	template<> template<>
+	void patch_code_test_object_t::test<3>()
+	{
+		const S32 patch_size = NORMAL_PATCH_SIZE;
+		const S32 patches_per_edge = 16;
+		const S32 passes = 50;
+		std::vector<layer_packet> packets;
+		std::vector<F32> heights;
+		code_land(packets, heights, patch_size, patches_per_edge);
+
+		S32 grids = patch_size*patches_per_edge + 1;
+		S32 num_patches = patches_per_edge*patches_per_edge;
+		std::vector<S32> coeffs(num_patches*patch_size*patch_size);
+		std::vector<LLPatchHeader> headers(num_patches + 1); // and the end of data
+		LLGroupHeader gopp;
+
+		F64 decode_seconds[2];
+		for (S32 k = 0; k < 2; k++)
+		{
+			LLTimer timer;
+			for (S32 pass = 0; pass < passes; pass++)
+			{
+				S32 n = 0;
+				for (U32 p = 0; p < packets.size(); p++)
+				{
+					LLBitPack bits(packets[p].mData, packets[p].mSize);
+					decode_patch_group_header(bits, &gopp);
+					while (1)
+					{
+						decode_patch_header(bits, &headers[n]);
+						if (headers[n].quant_wbits == END_OF_PATCHES)
+						{
+							break;
+						}
+						S32* patch = &coeffs[n*patch_size*patch_size];
+						if (k)
+						{
+							decode_patch(bits, patch);
+						}
+						else
+						{
+							scalar::decode_patch(bits, patch);
+						}
+						n++;
+					}
+				}
+			}
+			decode_seconds[k] = timer.getElapsedTimeF64();
+		}
+
+		std::vector<F32> land(grids*grids);
+		gopp.stride = grids;
+		set_group_of_patch_header(&gopp);
+		init_patch_decompressor(patch_size);
+		scalar::init_patch_decompressor(patch_size);
+
+		F64 idct_seconds[2];
+		for (S32 k = 0; k < 2; k++)
+		{
+			LLTimer timer;
+			for (S32 pass = 0; pass < passes; pass++)
+			{
+				for (S32 n = 0; n < num_patches; n++)
+				{
+					LLPatchHeader& ph = headers[n];
+					S32 offset = (ph.patchids & 0x1f)*patch_size*grids + (ph.patchids >> 5)*patch_size;
+					S32* patch = &coeffs[n*patch_size*patch_size];
+					if (k)
+					{
+						decompress_patch(&land[offset], patch, &ph);
+					}
+					else
+					{
+						scalar::decompress_patch(&land[offset], patch, &ph, patch_size, grids);
+					}
+				}
+			}
+			idct_seconds[k] = timer.getElapsedTimeF64();
+		}
+
+		F64 us_per_patch = 1000000.0 / (passes*num_patches);
+		llinfos << num_patches << " patches in " << packets.size() << " packets: bit decode "
+				<< decode_seconds[0]*us_per_patch << " -> " << decode_seconds[1]*us_per_patch
+				<< " us per patch, dequantize and IDCT " << idct_seconds[0]*us_per_patch << " -> "
+				<< idct_seconds[1]*us_per_patch << " us per patch" << llendl;
+	}
+}
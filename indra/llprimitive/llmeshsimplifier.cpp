@@ -0,0 +1,609 @@
+/**
+ * @file llmeshsimplifier.cpp
+ * @brief Quadric error metric simplification of volume faces.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmeshsimplifier.h"
+
+#include "llmath.h"
+#include "llmemory.h"
+#include "llvolume.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+// Open borders are kept in place by planes orthogonal to their triangles,
+// weighted so that sliding along the border is much cheaper than leaving it.
+const F64 BORDER_WEIGHT = 10.0;
+
+// Collapses may rotate a neighbouring triangle by at most ~75 degrees.
+const F32 MIN_NORMAL_COS = 0.25f;
+
+// Border vertices where the border turns by more than ~25 degrees are
+// corners of the outline and stay put.
+const F32 MIN_BORDER_COS = 0.9f;
+
+const U32 MAX_PASSES = 64;
+
+enum
+{
+	VERTEX_MANIFOLD,	// may collapse onto any neighbour
+	VERTEX_BORDER,		// may only collapse along its border
+	VERTEX_LOCKED		// seam, corner or non manifold vertex, never moves
+};
+
+struct Quadric
+{
+	F64 mA00, mA11, mA22, mA01, mA02, mA12;
+	F64 mB0, mB1, mB2;
+	F64 mC;
+	F64 mWeight;
+
+	Quadric()
+		: mA00(0.0), mA11(0.0), mA22(0.0), mA01(0.0), mA02(0.0), mA12(0.0),
+		  mB0(0.0), mB1(0.0), mB2(0.0), mC(0.0), mWeight(0.0)
+	{
+	}
+
+	// Adds the squared distance to the plane n.x + d = 0.
+	void addPlane(const LLVector4a& n, F64 d, F64 w)
+	{
+		const F32* v = n.getF32ptr();
+		F64 x = v[0], y = v[1], z = v[2];
+		mA00 += w*x*x; mA11 += w*y*y; mA22 += w*z*z;
+		mA01 += w*x*y; mA02 += w*x*z; mA12 += w*y*z;
+		mB0 += w*x*d; mB1 += w*y*d; mB2 += w*z*d;
+		mC += w*d*d;
+		mWeight += w;
+	}
+
+	void add(const Quadric& q)
+	{
+		mA00 += q.mA00; mA11 += q.mA11; mA22 += q.mA22;
+		mA01 += q.mA01; mA02 += q.mA02; mA12 += q.mA12;
+		mB0 += q.mB0; mB1 += q.mB1; mB2 += q.mB2;
+		mC += q.mC;
+		mWeight += q.mWeight;
+	}
+
+	// Weighted mean of the squared distances of p to the planes.
+	F64 error(const LLVector4a& p) const
+	{
+		const F32* v = p.getF32ptr();
+		F64 x = v[0], y = v[1], z = v[2];
+		F64 e = mA00*x*x + mA11*y*y + mA22*z*z
+			  + 2.0*(mA01*x*y + mA02*x*z + mA12*y*z)
+			  + 2.0*(mB0*x + mB1*y + mB2*z)
+			  + mC;
+		return mWeight > 0.0 ? fabs(e) / mWeight : 0.0;
+	}
+};
+
+struct Collapse
+{
+	U32 mFrom;
+	U32 mTo;
+	F64 mError;
+
+	bool operator<(const Collapse& rhs) const { return mError < rhs.mError; }
+};
+
+struct PositionLess
+{
+	PositionLess(const LLVector4a* positions) : mPositions(positions) {}
+
+	bool operator()(U32 a, U32 b) const
+	{
+		const F32* pa = mPositions[a].getF32ptr();
+		const F32* pb = mPositions[b].getF32ptr();
+		if (pa[0] != pb[0]) return pa[0] < pb[0];
+		if (pa[1] != pb[1]) return pa[1] < pb[1];
+		return pa[2] < pb[2];
+	}
+
+	const LLVector4a* mPositions;
+};
+
+inline U64 edge_key(U32 a, U32 b)
+{
+	return ((U64) a << 32) | b;
+}
+
+inline bool has_edge(const std::vector<U64>& edges, U32 a, U32 b)
+{
+	return std::binary_search(edges.begin(), edges.end(), edge_key(a, b));
+}
+
+inline bool is_degenerate(const U32* tri)
+{
+	return tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0];
+}
+
+class Simplifier
+{
+public:
+	Simplifier(const LLVector4a* positions, U32 num_verts, std::vector<U32>& indices)
+		: mPositions(positions),
+		  mNumVerts(num_verts),
+		  mIndices(indices),
+		  mGroup(num_verts),
+		  mGroupSize(num_verts, 0),
+		  mKind(num_verts, VERTEX_MANIFOLD),
+		  mQuadrics(num_verts)
+	{
+	}
+
+	void simplify(U32 target_triangles, F32 max_error);
+
+private:
+	void buildGroups();
+	void buildEdges();
+	void classifyVertices();
+	void buildQuadrics();
+	void buildAdjacency();
+	bool canCollapse(U32 from, U32 to) const;
+	bool flipsTriangle(U32 from, U32 to) const;
+	U32 collapse(U32 from, U32 to);
+	void removeDegenerates();
+
+	const LLVector4a* mPositions;
+	U32 mNumVerts;
+	std::vector<U32>& mIndices;
+
+	// Vertices at the same position (split for their normals or texture
+	// coordinates) share a group, named after its first vertex.
+	std::vector<U32> mGroup;
+	std::vector<U32> mGroupSize;
+
+	std::vector<U64> mEdges; // sorted directed edges between groups
+	std::vector<U8> mKind;
+	std::vector<Quadric> mQuadrics;
+
+	// Triangles using each vertex, rebuilt at the start of every pass.
+	std::vector<U32> mAdjacencyOffset;
+	std::vector<U32> mAdjacency;
+};
+
+void Simplifier::buildGroups()
+{
+	std::vector<U32> order(mNumVerts);
+	for (U32 i = 0; i < mNumVerts; ++i)
+	{
+		order[i] = i;
+	}
+	PositionLess less(mPositions);
+	std::sort(order.begin(), order.end(), less);
+
+	U32 group = 0;
+	for (U32 i = 0; i < mNumVerts; ++i)
+	{
+		if (i == 0 || less(order[i-1], order[i]))
+		{
+			group = order[i];
+		}
+		mGroup[order[i]] = group;
+		++mGroupSize[group];
+	}
+}
+
+void Simplifier::buildEdges()
+{
+	mEdges.clear();
+	mEdges.reserve(mIndices.size());
+	for (U32 i = 0; i < mIndices.size(); i += 3)
+	{
+		for (U32 k = 0; k < 3; ++k)
+		{
+			mEdges.push_back(edge_key(mGroup[mIndices[i+k]], mGroup[mIndices[i+(k+1)%3]]));
+		}
+	}
+	std::sort(mEdges.begin(), mEdges.end());
+}
+
+void Simplifier::classifyVertices()
+{
+	std::vector<U32> border_edges(mNumVerts, 0);
+	std::vector<U32> border_ends(mNumVerts*2); // the other ends of the first two border edges
+	std::vector<bool> locked(mNumVerts, false);
+
+	for (U32 i = 0; i < mEdges.size(); ++i)
+	{
+		U32 a = (U32) (mEdges[i] >> 32);
+		U32 b = (U32) mEdges[i];
+
+		if ((i > 0 && mEdges[i-1] == mEdges[i]) || a == b)
+		{	// edge shared by more than two triangles
+			locked[a] = locked[b] = true;
+		}
+		if (!has_edge(mEdges, b, a))
+		{
+			if (border_edges[a] < 2)
+			{
+				border_ends[a*2 + border_edges[a]] = b;
+			}
+			if (border_edges[b] < 2)
+			{
+				border_ends[b*2 + border_edges[b]] = a;
+			}
+			++border_edges[a];
+			++border_edges[b];
+		}
+	}
+
+	for (U32 i = 0; i < mNumVerts; ++i)
+	{
+		if (mGroup[i] != i || border_edges[i] != 2)
+		{
+			continue;
+		}
+
+		LLVector4a in, out;
+		in.setSub(mPositions[i], mPositions[border_ends[i*2]]);
+		out.setSub(mPositions[border_ends[i*2 + 1]], mPositions[i]);
+		F32 dot = in.dot3(out).getF32();
+		F32 len_sq = in.dot3(in).getF32() * out.dot3(out).getF32();
+		if (dot <= 0.f || dot * dot < MIN_BORDER_COS * MIN_BORDER_COS * len_sq)
+		{
+			locked[i] = true;
+		}
+	}
+
+	for (U32 i = 0; i < mNumVerts; ++i)
+	{
+		U32 group = mGroup[i];
+		if (mGroupSize[group] > 1 || locked[group])
+		{
+			mKind[i] = VERTEX_LOCKED;
+		}
+		else if (border_edges[group] == 0)
+		{
+			mKind[i] = VERTEX_MANIFOLD;
+		}
+		else
+		{	// a border vertex with more than two border edges is a corner too
+			mKind[i] = border_edges[group] == 2 ? VERTEX_BORDER : VERTEX_LOCKED;
+		}
+	}
+}
+
+void Simplifier::buildQuadrics()
+{
+	for (U32 i = 0; i < mIndices.size(); i += 3)
+	{
+		const U32* tri = &mIndices[i];
+		const LLVector4a& p0 = mPositions[tri[0]];
+
+		LLVector4a e1, e2, n;
+		e1.setSub(mPositions[tri[1]], p0);
+		e2.setSub(mPositions[tri[2]], p0);
+		n.setCross3(e1, e2);
+
+		F32 length = n.getLength3().getF32();
+		if (length <= 0.f)
+		{
+			continue;
+		}
+		n.mul(1.f / length);
+
+		F64 area = length * 0.5f;
+		F64 d = -n.dot3(p0).getF32();
+		for (U32 k = 0; k < 3; ++k)
+		{
+			mQuadrics[tri[k]].addPlane(n, d, area);
+		}
+
+		for (U32 k = 0; k < 3; ++k)
+		{
+			U32 a = tri[k];
+			U32 b = tri[(k+1)%3];
+			if (has_edge(mEdges, mGroup[b], mGroup[a]))
+			{
+				continue;
+			}
+
+			LLVector4a edge, m;
+			edge.setSub(mPositions[b], mPositions[a]);
+			m.setCross3(edge, n);
+			F32 edge_length = m.getLength3().getF32();
+			if (edge_length <= 0.f)
+			{
+				continue;
+			}
+			m.mul(1.f / edge_length);
+
+			F64 md = -m.dot3(mPositions[a]).getF32();
+			F64 w = BORDER_WEIGHT * edge_length * edge_length;
+			mQuadrics[a].addPlane(m, md, w);
+			mQuadrics[b].addPlane(m, md, w);
+		}
+	}
+}
+
+void Simplifier::buildAdjacency()
+{
+	mAdjacencyOffset.assign(mNumVerts + 1, 0);
+	for (U32 i = 0; i < mIndices.size(); ++i)
+	{
+		++mAdjacencyOffset[mIndices[i] + 1];
+	}
+	for (U32 i = 0; i < mNumVerts; ++i)
+	{
+		mAdjacencyOffset[i+1] += mAdjacencyOffset[i];
+	}
+
+	mAdjacency.resize(mIndices.size());
+	std::vector<U32> fill(mAdjacencyOffset.begin(), mAdjacencyOffset.end() - 1);
+	for (U32 i = 0; i < mIndices.size(); ++i)
+	{
+		mAdjacency[fill[mIndices[i]]++] = i / 3;
+	}
+}
+
+bool Simplifier::canCollapse(U32 from, U32 to) const
+{
+	switch (mKind[from])
+	{
+	case VERTEX_MANIFOLD:
+		return true;
+	case VERTEX_BORDER:
+		// stay on the border, and don't cut across to another part of it
+		return mKind[to] != VERTEX_MANIFOLD &&
+			   (!has_edge(mEdges, mGroup[from], mGroup[to]) ||
+				!has_edge(mEdges, mGroup[to], mGroup[from]));
+	default:
+		return false;
+	}
+}
+
+bool Simplifier::flipsTriangle(U32 from, U32 to) const
+{
+	for (U32 i = mAdjacencyOffset[from]; i < mAdjacencyOffset[from+1]; ++i)
+	{
+		const U32* tri = &mIndices[mAdjacency[i]*3];
+		if (is_degenerate(tri) || tri[0] == to || tri[1] == to || tri[2] == to)
+		{	// gone already, or removed by this collapse
+			continue;
+		}
+
+		U32 k = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+		const LLVector4a& a = mPositions[tri[(k+1)%3]];
+		const LLVector4a& b = mPositions[tri[(k+2)%3]];
+
+		LLVector4a e1, e2, n0, n1;
+		e1.setSub(a, mPositions[from]);
+		e2.setSub(b, mPositions[from]);
+		n0.setCross3(e1, e2);
+
+		e1.setSub(a, mPositions[to]);
+		e2.setSub(b, mPositions[to]);
+		n1.setCross3(e1, e2);
+
+		F32 dot = n0.dot3(n1).getF32();
+		F32 len_sq = n0.dot3(n0).getF32() * n1.dot3(n1).getF32();
+		if (dot <= 0.f || dot * dot < MIN_NORMAL_COS * MIN_NORMAL_COS * len_sq)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Returns the number of triangles removed.
+U32 Simplifier::collapse(U32 from, U32 to)
+{
+	U32 removed = 0;
+	for (U32 i = mAdjacencyOffset[from]; i < mAdjacencyOffset[from+1]; ++i)
+	{
+		U32* tri = &mIndices[mAdjacency[i]*3];
+		if (is_degenerate(tri))
+		{
+			continue;
+		}
+		for (U32 k = 0; k < 3; ++k)
+		{
+			if (tri[k] == from)
+			{
+				tri[k] = to;
+			}
+		}
+		if (is_degenerate(tri))
+		{
+			++removed;
+		}
+	}
+	mQuadrics[to].add(mQuadrics[from]);
+	return removed;
+}
+
+void Simplifier::removeDegenerates()
+{
+	U32 count = 0;
+	for (U32 i = 0; i < mIndices.size(); i += 3)
+	{
+		if (!is_degenerate(&mIndices[i]))
+		{
+			mIndices[count++] = mIndices[i];
+			mIndices[count++] = mIndices[i+1];
+			mIndices[count++] = mIndices[i+2];
+		}
+	}
+	mIndices.resize(count);
+}
+
+void Simplifier::simplify(U32 target_triangles, F32 max_error)
+{
+	removeDegenerates();
+
+	buildGroups();
+	buildEdges();
+	buildQuadrics();
+
+	const F64 max_error_sq = max_error >= 0.f ? (F64) max_error * max_error : -1.0;
+
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(mNumVerts);
+
+	for (U32 pass = 0; pass < MAX_PASSES; ++pass)
+	{
+		U32 triangles = mIndices.size() / 3;
+		if (triangles <= target_triangles)
+		{
+			break;
+		}
+
+		if (pass > 0)
+		{
+			buildEdges();
+		}
+		classifyVertices();
+		buildAdjacency();
+
+		collapses.clear();
+		for (U32 i = 0; i < mIndices.size(); i += 3)
+		{
+			for (U32 k = 0; k < 3; ++k)
+			{
+				U32 a = mIndices[i+k];
+				U32 b = mIndices[i+(k+1)%3];
+				if (canCollapse(a, b))
+				{
+					Collapse c = { a, b, mQuadrics[a].error(mPositions[b]) };
+					collapses.push_back(c);
+				}
+				if (canCollapse(b, a))
+				{
+					Collapse c = { b, a, mQuadrics[b].error(mPositions[a]) };
+					collapses.push_back(c);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		// Each vertex takes part in at most one collapse per pass, so the
+		// adjacency and the errors computed above stay valid.
+		touched.assign(mNumVerts, false);
+		U32 removed = 0;
+		for (U32 i = 0; i < collapses.size() && triangles - removed > target_triangles; ++i)
+		{
+			const Collapse& c = collapses[i];
+			if (max_error_sq >= 0.0 && c.mError > max_error_sq)
+			{
+				break;
+			}
+			if (touched[c.mFrom] || touched[c.mTo] || flipsTriangle(c.mFrom, c.mTo))
+			{
+				continue;
+			}
+
+			removed += collapse(c.mFrom, c.mTo);
+			touched[c.mFrom] = touched[c.mTo] = true;
+		}
+
+		removeDegenerates();
+
+		if (removed == 0)
+		{
+			break;
+		}
+	}
+}
+
+} // namespace
+
+//static
+const F32 LLMeshSimplifier::NO_ERROR_LIMIT = -1.f;
+
+//static
+void LLMeshSimplifier::simplifyFace(const LLVolumeFace& src, LLVolumeFace& dst,
+									U32 target_triangles, F32 max_error)
+{
+	std::vector<U32> indices(src.mIndices, src.mIndices + src.mNumIndices);
+	indices.resize(indices.size() - indices.size() % 3);
+
+	if (src.mNumVertices > 0 && indices.size() / 3 > target_triangles && max_error != 0.f)
+	{
+		Simplifier simplifier(src.mPositions, src.mNumVertices, indices);
+		simplifier.simplify(target_triangles, max_error);
+	}
+
+	// Keep only the vertices still in use, in the order they are first
+	// referenced.
+	std::vector<S32> remap(src.mNumVertices, -1);
+	std::vector<U32> vertices;
+	vertices.reserve(src.mNumVertices);
+	for (U32 i = 0; i < indices.size(); ++i)
+	{
+		U32 idx = indices[i];
+		if (remap[idx] < 0)
+		{
+			remap[idx] = vertices.size();
+			vertices.push_back(idx);
+		}
+		indices[i] = remap[idx];
+	}
+
+	dst.resizeVertices(vertices.size());
+	dst.resizeIndices(indices.size());
+
+	for (U32 i = 0; i < vertices.size(); ++i)
+	{
+		U32 idx = vertices[i];
+		dst.mPositions[i] = src.mPositions[idx];
+		if (src.mNormals)
+		{
+			dst.mNormals[i] = src.mNormals[idx];
+		}
+		if (src.mTexCoords)
+		{
+			dst.mTexCoords[i] = src.mTexCoords[idx];
+		}
+	}
+
+	if (!src.mNormals)
+	{
+		ll_aligned_free_16(dst.mNormals);
+		dst.mNormals = NULL;
+	}
+	if (!src.mTexCoords)
+	{
+		ll_aligned_free_16(dst.mTexCoords);
+		dst.mTexCoords = NULL;
+	}
+
+	for (U32 i = 0; i < indices.size(); ++i)
+	{
+		dst.mIndices[i] = (U16) indices[i];
+	}
+}
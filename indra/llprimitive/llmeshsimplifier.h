@@ -0,0 +1,58 @@
+/**
+ * @file llmeshsimplifier.h
+ * @brief Quadric error metric simplification of volume faces.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHSIMPLIFIER_H
+#define LL_LLMESHSIMPLIFIER_H
+
+class LLVolumeFace;
+
+// Generates mesh LODs without GLOD or a GL context: repeatedly collapses the
+// cheapest edge according to the accumulated plane quadrics of its vertices.
+// Collapses only ever move a vertex onto one of its neighbours, so normals and
+// texture coordinates are kept as authored. Vertices on texture/normal seams
+// stay put and open borders only collapse along themselves.
+// Stateless and thread safe; faces can be simplified concurrently.
+class LLMeshSimplifier
+{
+public:
+	static const F32 NO_ERROR_LIMIT; // < 0
+
+	// Writes a simplified copy of src with about target_triangles triangles
+	// into dst, stopping early once the next collapse would move the surface
+	// further than max_error (in the face's space). A max_error of 0 copies
+	// src unchanged; pass NO_ERROR_LIMIT to only honour target_triangles.
+	// dst is left without indices when the whole face collapsed.
+	static void simplifyFace(const LLVolumeFace& src, LLVolumeFace& dst,
+							 U32 target_triangles, F32 max_error);
+};
+
+#endif // LL_LLMESHSIMPLIFIER_H
@@ -28,6 +28,7 @@
 
 #include "llmodel.h"
 #include "llmemory.h"
+#include "llmeshsimplifier.h"
 #if MESH_IMPORT
 #include "llconvexdecomposition.h"
 #endif //MESH_IMPORT
@@ -1044,6 +1045,23 @@ void LLModel::setVolumeFaceData(
 	LLVector4a::memcpyNonAliased16((F32*) face.mIndices, (F32*) ind.get(), size);
 }
 
+void LLModel::simplifyVolumeFace(S32 f, const LLVolumeFace& src, U32 target_triangles, F32 max_error)
+{
+	LLVolumeFace& face = mVolumeFaces[f];
+
+	LLMeshSimplifier::simplifyFace(src, face, target_triangles, max_error);
+
+	if (face.mNumIndices == 0)
+	{	//this face was eliminated, create a dummy triangle (one vertex, 3 indices, all 0)
+		face.resizeVertices(1);
+		face.resizeIndices(3);
+		face.mPositions[0].clear();
+		face.mNormals[0].clear();
+		face.mTexCoords[0].clear();
+		memset(face.mIndices, 0, 3*sizeof(U16));
+	}
+}
+
 void LLModel::appendFaces(LLModel *model, LLMatrix4 &transform, LLMatrix4& norm_mat)
 {
 	if (mVolumeFaces.empty())
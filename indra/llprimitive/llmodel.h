@@ -169,6 +169,11 @@ public:
 		U32 num_verts, 
 		U32 num_indices);
 
+	// Fills face f with a simplified copy of src (see LLMeshSimplifier), or
+	// with a dummy triangle when the whole face collapsed. Different faces may
+	// be simplified concurrently.
+	void simplifyVolumeFace(S32 f, const LLVolumeFace& src, U32 target_triangles, F32 max_error);
+
 	void generateNormals(F32 angle_cutoff);
 
 	void addFace(const LLVolumeFace& face);
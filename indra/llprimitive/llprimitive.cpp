@@ -1031,6 +1031,7 @@ S32 LLPrimitive::packTEField(U8 *cur_ptr, U8 *data_ptr, U8 data_size, U8 last_fa
 	return (S32)(cur_ptr - start_loc);
 }
 
+//static
 S32 LLPrimitive::unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type)
 {
 	U8 *start_loc = cur_ptr;
@@ -1353,83 +1354,86 @@ S32 LLPrimitive::unpackTEMessage(LLMessageSystem* mesgsys, char const* block_nam
 
 S32 LLPrimitive::unpackTEMessage(LLDataPacker &dp)
 {
-	// use a negative block_num to indicate a single-block read (a non-variable block)
-	S32 retval = 0;
-	const U32 MAX_TES = 32;
-
-	// Avoid construction of 32 UUIDs per call
-	static LLUUID image_ids[MAX_TES];
-
-	U8     image_data[MAX_TES*16];
-	U8	   colors[MAX_TES*4];
-	F32    scale_s[MAX_TES];
-	F32    scale_t[MAX_TES];
-	S16    offset_s[MAX_TES];
-	S16    offset_t[MAX_TES];
-	S16    image_rot[MAX_TES];
-	U8	   bump[MAX_TES];
-	U8	   media_flags[MAX_TES];
-    U8     glow[MAX_TES];
+	LLTEContents tec;
+	if (!parseTEMessage(dp, tec))
+	{
+		return TEM_INVALID;
+	}
+	return applyParsedTEMessage(tec);
+}
 
+//static
+BOOL LLPrimitive::parseTEMessage(LLDataPacker &dp, LLTEContents &tec)
+{
 	const U32 MAX_TE_BUFFER = 4096;
 	U8 packed_buffer[MAX_TE_BUFFER];
 	U8 *cur_ptr = packed_buffer;
 
 	S32 size;
-	U32 face_count = 0;
 
 	if (!dp.unpackBinaryData(packed_buffer, size, "TextureEntry"))
 	{
-		retval = TEM_INVALID;
 		llwarns << "Bad texture entry block!  Abort!" << llendl;
-		return retval;
+		return FALSE;
 	}
 
-	if (size == 0)
+	tec.mEmpty = (size == 0);
+	if (tec.mEmpty)
 	{
-		return retval;
+		return TRUE;
 	}
 
-	face_count = llmin((U32) getNumTEs(), MAX_TES);
-	U32 i;
+	// The field layout doesn't depend on the face count, read all of them
+	const U8 face_count = LLTEContents::MAX_TES;
 
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)image_data, 16, face_count, MVT_LLUUID);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, tec.mImageData, 16, face_count, MVT_LLUUID);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)colors, 4, face_count, MVT_U8);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, tec.mColors, 4, face_count, MVT_U8);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)scale_s, 4, face_count, MVT_F32);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)tec.mScaleS, 4, face_count, MVT_F32);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)scale_t, 4, face_count, MVT_F32);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)tec.mScaleT, 4, face_count, MVT_F32);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)offset_s, 2, face_count, MVT_S16Array);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)tec.mOffsetS, 2, face_count, MVT_S16Array);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)offset_t, 2, face_count, MVT_S16Array);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)tec.mOffsetT, 2, face_count, MVT_S16Array);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)image_rot, 2, face_count, MVT_S16Array);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)tec.mImageRot, 2, face_count, MVT_S16Array);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)bump, 1, face_count, MVT_U8);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, tec.mBump, 1, face_count, MVT_U8);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)media_flags, 1, face_count, MVT_U8);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, tec.mMediaFlags, 1, face_count, MVT_U8);
 	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)glow, 1, face_count, MVT_U8);
+	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, tec.mGlow, 1, face_count, MVT_U8);
+
+	return TRUE;
+}
+
+S32 LLPrimitive::applyParsedTEMessage(const LLTEContents &tec)
+{
+	S32 retval = 0;
 
-	for (i = 0; i < face_count; i++)
+	if (tec.mEmpty)
 	{
-		memcpy(image_ids[i].mData,&image_data[i*16],16);	/* Flawfinder: ignore */ 	
+		return retval;
 	}
-	
+
+	U32 face_count = llmin((U32) getNumTEs(), (U32) LLTEContents::MAX_TES);
+
+	LLUUID image_id;
 	LLColor4 color;
 	LLColor4U coloru;
-	for (i = 0; i < face_count; i++)
+	for (U32 i = 0; i < face_count; i++)
 	{
-		retval |= setTETexture(i, image_ids[i]);
-		retval |= setTEScale(i, scale_s[i], scale_t[i]);
-		retval |= setTEOffset(i, (F32)offset_s[i] / (F32)0x7FFF, (F32) offset_t[i] / (F32) 0x7FFF);
-		retval |= setTERotation(i, ((F32)image_rot[i] / TEXTURE_ROTATION_PACK_FACTOR) * F_TWO_PI);
-		retval |= setTEBumpShinyFullbright(i, bump[i]);
-		retval |= setTEMediaTexGen(i, media_flags[i]);
-		retval |= setTEGlow(i, (F32)glow[i] / (F32)0xFF);
-		coloru = LLColor4U(colors + 4*i);
+		memcpy(image_id.mData, &tec.mImageData[i*16], 16);	/* Flawfinder: ignore */
+		retval |= setTETexture(i, image_id);
+		retval |= setTEScale(i, tec.mScaleS[i], tec.mScaleT[i]);
+		retval |= setTEOffset(i, (F32)tec.mOffsetS[i] / (F32)0x7FFF, (F32) tec.mOffsetT[i] / (F32) 0x7FFF);
+		retval |= setTERotation(i, ((F32)tec.mImageRot[i] / TEXTURE_ROTATION_PACK_FACTOR) * F_TWO_PI);
+		retval |= setTEBumpShinyFullbright(i, tec.mBump[i]);
+		retval |= setTEMediaTexGen(i, tec.mMediaFlags[i]);
+		retval |= setTEGlow(i, (F32)tec.mGlow[i] / (F32)0xFF);
+		coloru = LLColor4U(tec.mColors + 4*i);
 
 		// Note:  This is an optimization to send common colors (1.f, 1.f, 1.f, 1.f)
 		// as all zeros.  However, the subtraction and addition must be done in unsigned
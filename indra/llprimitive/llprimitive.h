@@ -295,6 +295,26 @@ public:
 };
 
 
+// Texture entry fields read out of a TextureEntry block but not applied to a
+// primitive yet. Filled for MAX_TES faces, applying only uses the faces the
+// primitive has; plain data, so it can be filled away from the main thread.
+struct LLTEContents
+{
+	enum { MAX_TES = 32 };
+
+	U8	mImageData[MAX_TES*16];
+	U8	mColors[MAX_TES*4];
+	F32	mScaleS[MAX_TES];
+	F32	mScaleT[MAX_TES];
+	S16	mOffsetS[MAX_TES];
+	S16	mOffsetT[MAX_TES];
+	S16	mImageRot[MAX_TES];
+	U8	mBump[MAX_TES];
+	U8	mMediaFlags[MAX_TES];
+	U8	mGlow[MAX_TES];
+	bool mEmpty;	// the block had no data, nothing to apply
+};
+
 class LLPrimitive : public LLXform
 {
 public:
@@ -363,12 +383,15 @@ public:
 
 	void copyTEs(const LLPrimitive *primitive);
 	S32 packTEField(U8 *cur_ptr, U8 *data_ptr, U8 data_size, U8 last_face_index, EMsgVariableType type) const;
-	S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
+	static S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
 	BOOL packTEMessage(LLMessageSystem *mesgsys, int shield = 0, std::string client_str = "") const;
 	BOOL packTEMessage(LLDataPacker &dp) const;
 	S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name);
 	S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num); // Variable num of blocks
 	BOOL unpackTEMessage(LLDataPacker &dp);
+	// unpackTEMessage(dp) in two steps, parsing is thread safe.
+	static BOOL parseTEMessage(LLDataPacker &dp, LLTEContents &tec);
+	S32 applyParsedTEMessage(const LLTEContents &tec);
 	
 #ifdef CHECK_FOR_FINITE
 	inline void setPosition(const LLVector3& pos);
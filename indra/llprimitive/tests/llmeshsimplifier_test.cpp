@@ -0,0 +1,216 @@
+/**
+ * @file llmeshsimplifier_test.cpp
+ * @brief LLMeshSimplifier test cases.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmeshsimplifier.h"
+
+#include "llmemory.h"
+#include "llvolume.h"
+
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: LLVolumeFace storage only, the simplifier doesn't need the rest of llvolume.cpp.
+
+LLVolumeFace::LLVolumeFace()
+	: mNumVertices(0), mNumIndices(0),
+	  mPositions(NULL), mNormals(NULL), mBinormals(NULL), mTexCoords(NULL), mIndices(NULL),
+	  mWeights(NULL), mOctree(NULL), mBVH(NULL)
+{
+}
+
+LLVolumeFace::~LLVolumeFace()
+{
+	ll_aligned_free_16(mPositions);
+	ll_aligned_free_16(mNormals);
+	ll_aligned_free_16(mTexCoords);
+	ll_aligned_free_16(mIndices);
+}
+
+void LLVolumeFace::resizeVertices(S32 num_verts)
+{
+	ll_aligned_free_16(mPositions);
+	ll_aligned_free_16(mNormals);
+	ll_aligned_free_16(mTexCoords);
+	mPositions = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts + 16);
+	mNormals = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts + 16);
+	mTexCoords = (LLVector2*) ll_aligned_malloc_16(sizeof(LLVector2)*num_verts + 16);
+	mNumVertices = num_verts;
+}
+
+void LLVolumeFace::resizeIndices(S32 num_indices)
+{
+	ll_aligned_free_16(mIndices);
+	mIndices = (U16*) ll_aligned_malloc_16(sizeof(U16)*num_indices + 16);
+	mNumIndices = num_indices;
+}
+
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	// Flat unit square in the xy plane, cells*cells quads. With a seam, the
+	// column at x = 0.5 is split into two sets of vertices with different
+	// texture coordinates, like an authored UV seam.
+	void make_grid(LLVolumeFace& face, U32 cells, bool seam)
+	{
+		U32 seam_column = seam ? cells/2 : cells + 1;
+		U32 columns = seam ? cells + 2 : cells + 1;
+		face.resizeVertices(columns*(cells + 1));
+
+		for (U32 j = 0; j <= cells; ++j)
+		{
+			for (U32 i = 0; i < columns; ++i)
+			{
+				U32 c = i > seam_column ? i - 1 : i;
+				F32 x = (F32) c / cells;
+				F32 y = (F32) j / cells;
+				U32 v = j*columns + i;
+				face.mPositions[v].set(x, y, 0.f);
+				face.mNormals[v].set(0.f, 0.f, 1.f);
+				face.mTexCoords[v].set(i > seam_column ? x + 1.f : x, y);
+			}
+		}
+
+		std::vector<U16> indices;
+		for (U32 j = 0; j < cells; ++j)
+		{
+			for (U32 i = 0; i + 1 < columns; ++i)
+			{
+				if (i == seam_column)
+				{
+					continue;
+				}
+				U16 a = j*columns + i;
+				U16 b = a + 1;
+				U16 c = a + columns;
+				U16 d = c + 1;
+				indices.push_back(a); indices.push_back(b); indices.push_back(c);
+				indices.push_back(b); indices.push_back(d); indices.push_back(c);
+			}
+		}
+
+		face.resizeIndices(indices.size());
+		std::copy(indices.begin(), indices.end(), face.mIndices);
+	}
+
+	bool has_vertex(const LLVolumeFace& face, F32 x, F32 y, F32 u)
+	{
+		for (S32 i = 0; i < face.mNumVertices; ++i)
+		{
+			const F32* p = face.mPositions[i].getF32ptr();
+			if (p[0] == x && p[1] == y && face.mTexCoords[i].mV[0] == u)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+namespace tut
+{
+	struct meshsimplifier_test
+	{
+	};
+	typedef test_group<meshsimplifier_test> meshsimplifier_test_t;
+	typedef meshsimplifier_test_t::object meshsimplifier_test_object_t;
+	tut::meshsimplifier_test_t tut_meshsimplifier_test("LLMeshSimplifier");
+
+	// the triangle budget is reached on a surface that allows it
+	template<> template<>
+	void meshsimplifier_test_object_t::test<1>()
+	{
+		LLVolumeFace src;
+		make_grid(src, 16, false);
+		ensure_equals("source triangles", src.mNumIndices/3, 512);
+
+		LLVolumeFace dst;
+		LLMeshSimplifier::simplifyFace(src, dst, 64, LLMeshSimplifier::NO_ERROR_LIMIT);
+		ensure("budget reached", dst.mNumIndices > 0 && dst.mNumIndices/3 <= 64);
+
+		for (S32 i = 0; i < dst.mNumIndices; ++i)
+		{
+			ensure("index in range", dst.mIndices[i] < dst.mNumVertices);
+		}
+	}
+
+	// an error threshold of 0 keeps the face as is
+	template<> template<>
+	void meshsimplifier_test_object_t::test<2>()
+	{
+		LLVolumeFace src;
+		make_grid(src, 16, false);
+
+		LLVolumeFace dst;
+		LLMeshSimplifier::simplifyFace(src, dst, 0, 0.f);
+		ensure_equals("triangles kept", dst.mNumIndices, src.mNumIndices);
+		ensure_equals("vertices kept", dst.mNumVertices, src.mNumVertices);
+	}
+
+	// corners and seam vertices never move, borders stay on the border
+	template<> template<>
+	void meshsimplifier_test_object_t::test<3>()
+	{
+		const U32 cells = 16;
+		LLVolumeFace src;
+		make_grid(src, cells, true);
+
+		LLVolumeFace dst;
+		LLMeshSimplifier::simplifyFace(src, dst, 0, LLMeshSimplifier::NO_ERROR_LIMIT);
+		ensure("simplified", dst.mNumIndices > 0 && dst.mNumIndices < src.mNumIndices);
+
+		ensure("corner 0 0", has_vertex(dst, 0.f, 0.f, 0.f));
+		ensure("corner 1 0", has_vertex(dst, 1.f, 0.f, 2.f));
+		ensure("corner 0 1", has_vertex(dst, 0.f, 1.f, 0.f));
+		ensure("corner 1 1", has_vertex(dst, 1.f, 1.f, 2.f));
+
+		for (U32 j = 0; j <= cells; ++j)
+		{
+			F32 y = (F32) j / cells;
+			ensure("seam left", has_vertex(dst, 0.5f, y, 0.5f));
+			ensure("seam right", has_vertex(dst, 0.5f, y, 1.5f));
+		}
+
+		//a border vertex moving inwards would shrink the square
+		F32 area = 0.f;
+		for (S32 i = 0; i < dst.mNumIndices; i += 3)
+		{
+			const F32* a = dst.mPositions[dst.mIndices[i]].getF32ptr();
+			const F32* b = dst.mPositions[dst.mIndices[i+1]].getF32ptr();
+			const F32* c = dst.mPositions[dst.mIndices[i+2]].getF32ptr();
+			area += ((b[0] - a[0])*(c[1] - a[1]) - (b[1] - a[1])*(c[0] - a[0])) * 0.5f;
+		}
+		ensure_approximately_equals("area kept", area, 1.f, 16);
+	}
+}
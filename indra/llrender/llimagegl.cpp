@@ -39,6 +39,7 @@
 
 #include "llerror.h"
 #include "llimage.h"
+#include "llimagedxt.h"
 
 #include "llmath.h"
 #include "llgl.h"
@@ -1251,6 +1252,51 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S
 	return createGLTexture(discard_level, rawdata, FALSE, usename);
 }
 
+BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageRaw* imageraw, LLImageDXT* compressed, S32 usename, S32 category)
+{
+	if (!compressed || mHasExplicitFormat || !gGLManager.mHasCompressedTextures || gGLManager.mIsDisabled ||
+		(imageraw->getComponents() != 3 && imageraw->getComponents() != 4))
+	{
+		return createGLTexture(discard_level, imageraw, usename, TRUE, category);
+	}
+
+	if (discard_level < 0)
+	{
+		llassert(mCurrentDiscardLevel >= 0);
+		discard_level = mCurrentDiscardLevel;
+	}
+	discard_level = llclamp(discard_level, 0, (S32)mMaxDiscardLevel);
+
+	S32 raw_w = imageraw->getWidth();
+	S32 raw_h = imageraw->getHeight();
+	setSize(raw_w << discard_level, raw_h << discard_level, imageraw->getComponents());
+
+	// The raw image may have been scaled down since it was compressed: use the matching mip,
+	// as long as all the mips the texture needs are still below it.
+	S32 mip = compressed->getMipLevel(raw_w, raw_h);
+	S32 num_mips = LLImageDXT::calcNumMips(compressed->getWidth(), compressed->getHeight());
+	if (mip < 0 || compressed->getComponents() != mComponents ||
+		(mUseMipMaps && mip + mMaxDiscardLevel - discard_level >= num_mips))
+	{
+		return createGLTexture(discard_level, imageraw, usename, TRUE, category);
+	}
+
+	// Alpha analysis and the pick mask work on the uncompressed pixels
+	mFormatInternal = mComponents == 4 ? GL_RGBA8 : GL_RGB8;
+	mFormatPrimary = mComponents == 4 ? GL_RGBA : GL_RGB;
+	mFormatType = GL_UNSIGNED_BYTE;
+	calcAlphaChannelOffsetAndStride();
+	analyzeAlpha(imageraw->getData(), raw_w, raw_h);
+	updatePickMask(raw_w, raw_h, imageraw->getData());
+
+	// Not an explicit format: the next raw image upload goes back to RGB(A)
+	mFormatPrimary = mComponents == 4 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	mFormatInternal = mFormatPrimary;
+
+	setCategory(category);
+	return createGLTexture(discard_level, compressed->getData() + compressed->getMipOffset(mip), TRUE, usename);
+}
+
 BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_hasmips, S32 usename)
 {
 	llassert(data_in);
@@ -1489,7 +1535,12 @@ BOOL LLImageGL::readBackRaw(S32 discard_level, LLImageRaw* imageraw, bool compre
 			return FALSE ;
 		}
 		
-		glGetTexImage(GL_TEXTURE_2D, gl_discard, mFormatPrimary, mFormatType, (GLvoid*)(imageraw->getData()));		
+		LLGLenum format = mFormatPrimary;
+		if (mFormatPrimary >= GL_COMPRESSED_RGBA_S3TC_DXT1_EXT && mFormatPrimary <= GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+		{
+			format = ncomponents == 4 ? GL_RGBA : GL_RGB; // let the driver decompress
+		}
+		glGetTexImage(GL_TEXTURE_2D, gl_discard, format, mFormatType, (GLvoid*)(imageraw->getData()));		
 		//stop_glerror();
 	}
 		
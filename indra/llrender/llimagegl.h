@@ -43,6 +43,8 @@
 
 #include "llrender.h"
 
+class LLImageDXT;
+
 #define BYTES_TO_MEGA_BYTES(x) ((x) >> 20)
 #define MEGA_BYTES_TO_BYTES(x) ((x) << 20)
 
@@ -112,6 +114,8 @@ public:
 	BOOL createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S32 usename = 0, BOOL to_create = TRUE, 
 		S32 category = sMaxCatagories - 1);
 	BOOL createGLTexture(S32 discard_level, const U8* data, BOOL data_hasmips = FALSE, S32 usename = 0);
+	// Uploads the S3TC mips of compressed that match imageraw, or imageraw itself when they can not be used.
+	BOOL createGLTexture(S32 discard_level, const LLImageRaw* imageraw, LLImageDXT* compressed, S32 usename, S32 category);
 	void setImage(const LLImageRaw* imageraw);
 	void setImage(const U8* data_in, BOOL data_hasmips = FALSE);
 	BOOL setSubImage(const LLImageRaw* imageraw, S32 x_pos, S32 y_pos, S32 width, S32 height, BOOL force_fast_update = FALSE);
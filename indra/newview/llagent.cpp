@@ -41,6 +41,7 @@
 #include "llagentwearables.h"
 #include "llagentui.h"
 #include "llanimationstates.h"
+#include "llappviewer.h"
 #include "llcallingcard.h"
 #include "llconsole.h"
 #include "llenvmanager.h"
@@ -56,6 +57,7 @@
 #include "llchatbar.h"
 #include "llnotificationsutil.h"
 #include "llparcel.h"
+#include "llregioncachethread.h"
 #include "llrendersphere.h"
 #include "llsdmessage.h"
 #include "llsdutil.h"
@@ -3493,6 +3495,9 @@ void LLAgent::teleportRequest(
 		// </edit>
 		msg->addVector3("LookAt", look_at);
 		sendReliableMessage();
+
+		// Read what we kept of the destination while the simulator hands us over.
+		LLAppViewer::getRegionCacheThread()->preload(region_handle, true);
 	}
 }
 
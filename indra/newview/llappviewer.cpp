@@ -52,6 +52,7 @@
 #include "llwindow.h"
 #include "llviewerstats.h"
 #include "llmd5.h"
+#include "llmeshcache.h"
 #include "llmeshrepository.h"
 #include "llpumpio.h"
 #include "llimpanel.h"
@@ -112,6 +113,9 @@
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llimageworker.h"
+#include "llvolumebuildthread.h"
+#include "llterraincompositethread.h"
+#include "llregioncachethread.h"
 
 // <edit>
 #include "lldelayeduidelete.h"
@@ -549,6 +553,10 @@ const std::string LLAppViewer::sCrashSettingsName = "CrashSettings";
 
 LLTextureCache* LLAppViewer::sTextureCache = NULL; 
 LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL; 
+LLImageEncodeThread* LLAppViewer::sImageEncodeThread = NULL; 
+LLVolumeBuildThread* LLAppViewer::sVolumeBuildThread = NULL;
+LLTerrainCompositeThread* LLAppViewer::sTerrainCompositeThread = NULL;
+LLRegionCacheThread* LLAppViewer::sRegionCacheThread = NULL;
 LLTextureFetch* LLAppViewer::sTextureFetch = NULL; 
 
 LLAppViewer::LLAppViewer() : 
@@ -1017,6 +1025,10 @@ static LLFastTimer::DeclareTimer FTM_MESSAGES("System Messages");
 static LLFastTimer::DeclareTimer FTM_SLEEP("Sleep");
 static LLFastTimer::DeclareTimer FTM_TEXTURE_CACHE("Texture Cache");
 static LLFastTimer::DeclareTimer FTM_DECODE("Image Decode");
+static LLFastTimer::DeclareTimer FTM_ENCODE("Image Encode");
+static LLFastTimer::DeclareTimer FTM_VOLUME_BUILD("Volume Build");
+static LLFastTimer::DeclareTimer FTM_TERRAIN_COMPOSITE("Terrain Composite");
+static LLFastTimer::DeclareTimer FTM_REGION_CACHE("Region Cache");
 static LLFastTimer::DeclareTimer FTM_VFS("VFS Thread");
 static LLFastTimer::DeclareTimer FTM_LFS("LFS Thread");
 static LLFastTimer::DeclareTimer FTM_PAUSE_THREADS("Pause Threads");
@@ -1253,6 +1265,22 @@ bool LLAppViewer::mainLoop()
 						LLFastTimer ftm(FTM_DECODE);
 	 					work_pending += LLAppViewer::getImageDecodeThread()->update(1); // unpauses the image thread
 					}
+					{
+						LLFastTimer ftm(FTM_ENCODE);
+	 					work_pending += LLAppViewer::getImageEncodeThread()->update(1); // unpauses the image encode thread
+					}
+					{
+						LLFastTimer ftm(FTM_VOLUME_BUILD);
+						work_pending += LLAppViewer::getVolumeBuildThread()->update(1); // unpauses the volume build thread
+					}
+					{
+						LLFastTimer ftm(FTM_TERRAIN_COMPOSITE);
+						work_pending += LLAppViewer::getTerrainCompositeThread()->update(1); // unpauses the terrain composite thread
+					}
+					{
+						LLFastTimer ftm(FTM_REGION_CACHE);
+						work_pending += LLAppViewer::getRegionCacheThread()->update(1); // unpauses the region cache thread
+					}
 					{
 						LLFastTimer ftm(FTM_DECODE);
 	 					work_pending += LLAppViewer::getTextureFetch()->update(1); // unpauses the texture fetch thread
@@ -1672,7 +1700,11 @@ bool LLAppViewer::cleanup()
 		S32 pending = 0;
 		pending += LLAppViewer::getTextureCache()->update(1); // unpauses the worker thread
 		pending += LLAppViewer::getImageDecodeThread()->update(1); // unpauses the image thread
+		pending += LLAppViewer::getImageEncodeThread()->update(1); // unpauses the image encode thread
 		pending += LLAppViewer::getTextureFetch()->update(1); // unpauses the texture fetch thread
+		pending += LLAppViewer::getVolumeBuildThread()->update(1); // unpauses the volume build thread
+		pending += LLAppViewer::getTerrainCompositeThread()->update(1); // unpauses the terrain composite thread
+		pending += LLAppViewer::getRegionCacheThread()->update(1); // writes the regions left at logout
 		pending += LLVFSThread::updateClass(0);
 		pending += LLLFSThread::updateClass(0);
 		if (pending == 0)
@@ -1691,6 +1723,10 @@ bool LLAppViewer::cleanup()
 	sTextureFetch->shutdown();
 	sTextureCache->shutdown();
 	sImageDecodeThread->shutdown();
+	sImageEncodeThread->shutdown();
+	sVolumeBuildThread->shutdown();
+	sTerrainCompositeThread->shutdown();
+	sRegionCacheThread->shutdown();
 	sTextureFetch->shutDownTextureCacheThread();
 	sTextureFetch->shutDownImageDecodeThread();
 	delete sTextureCache;
@@ -1699,6 +1735,14 @@ bool LLAppViewer::cleanup()
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	delete sImageEncodeThread;
+	sImageEncodeThread = NULL;
+	delete sVolumeBuildThread;
+	sVolumeBuildThread = NULL;
+	delete sTerrainCompositeThread;
+	sTerrainCompositeThread = NULL;
+	delete sRegionCacheThread;
+	sRegionCacheThread = NULL;
 
 
 	llinfos << "Cleaning up Media and Textures" << llendflush;
@@ -1825,6 +1869,10 @@ bool LLAppViewer::initThreads()
 
 	// Image decoding
 	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
+	LLAppViewer::sImageEncodeThread = new LLImageEncodeThread(enable_threads && true);
+	LLAppViewer::sVolumeBuildThread = new LLVolumeBuildThread(enable_threads && true);
+	LLAppViewer::sTerrainCompositeThread = new LLTerrainCompositeThread(enable_threads && true);
+	LLAppViewer::sRegionCacheThread = new LLRegionCacheThread(enable_threads && true);
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
 
@@ -3241,7 +3289,7 @@ U32 LLAppViewer::getObjectCacheVersion()
 {
 	// Viewer object cache version, change if object update
 	// format changes. JC
-	const U32 INDRA_OBJECT_CACHE_VERSION = 14;
+	const U32 INDRA_OBJECT_CACHE_VERSION = 15;
 
 	return INDRA_OBJECT_CACHE_VERSION;
 }
@@ -3252,6 +3300,8 @@ bool LLAppViewer::initCache()
 	BOOL read_only = mSecondInstance ? TRUE : FALSE;
 	LLAppViewer::getTextureCache()->setReadOnly(read_only) ;
 	LLVOCache::getInstance()->setReadOnly(read_only);
+	LLMeshCache::getInstance()->setReadOnly(read_only);
+	LLAppViewer::getRegionCacheThread()->setReadOnly(read_only);
 
 	bool texture_cache_mismatch = false;
 	if (gSavedSettings.getS32("LocalCacheVersion") != LLAppViewer::getTextureCacheVersion())
@@ -3332,6 +3382,8 @@ bool LLAppViewer::initCache()
 	texture_cache_size -= extra;
 
 	LLVOCache::getInstance()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("CacheNumberOfRegionsForObjects"), getObjectCacheVersion()) ;
+	LLMeshCache::getInstance()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("MeshCacheMaxDays"), (S64)gSavedSettings.getU32("MeshCacheSize") * MB);
+	LLAppViewer::getRegionCacheThread()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("CacheNumberOfRegionsForObjects"));
 
 	LLSplashScreen::update(LLTrans::getString("StartupInitializingVFS"));
 	
@@ -3476,6 +3528,23 @@ bool LLAppViewer::initCache()
 	{
 		LLVFile::initClass();
 
+		if (!gSavedSettings.getBOOL("MeshVFSPurged"))
+		{
+			// Meshes used to be cached in the VFS; LLMeshCache keeps them now.
+			std::map<LLVFSFileSpecifier, LLVFSFileBlock*> files = gVFS->getFileList();
+			S32 purged = 0;
+			for (std::map<LLVFSFileSpecifier, LLVFSFileBlock*>::iterator iter = files.begin(); iter != files.end(); ++iter)
+			{
+				if (iter->first.mFileType == LLAssetType::AT_MESH)
+				{
+					gVFS->removeFile(iter->first.mFileID, LLAssetType::AT_MESH);
+					++purged;
+				}
+			}
+			llinfos << "Removed " << purged << " meshes from the VFS." << llendl;
+			gSavedSettings.setBOOL("MeshVFSPurged", TRUE);
+		}
+
 #ifndef LL_RELEASE_FOR_DOWNLOAD
 		if (gSavedSettings.getBOOL("DumpVFSCaches"))
 		{
@@ -3497,6 +3566,8 @@ void LLAppViewer::purgeCache()
 	LL_INFOS("AppCache") << "Purging Cache and Texture Cache..." << LL_ENDL;
 	LLAppViewer::getTextureCache()->purgeCache(LL_PATH_CACHE);
 	LLVOCache::getInstance()->removeCache(LL_PATH_CACHE);
+	LLMeshCache::getInstance()->removeCache(LL_PATH_CACHE);
+	LLAppViewer::getRegionCacheThread()->removeCache(LL_PATH_CACHE);
 	std::string mask = "*.*";
 	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, ""), mask);
 }
@@ -3848,11 +3919,6 @@ void LLAppViewer::idle()
 		if (object_debug_timer.getElapsedTimeF32() > 5.f)
 		{
 			object_debug_timer.reset();
-			if (gObjectList.mNumDeadObjectUpdates)
-			{
-				llinfos << "Dead object updates: " << gObjectList.mNumDeadObjectUpdates << llendl;
-				gObjectList.mNumDeadObjectUpdates = 0;
-			}
 			if (gObjectList.mNumUnknownKills)
 			{
 				llinfos << "Kills on unknown objects: " << gObjectList.mNumUnknownKills << llendl;
@@ -3957,6 +4023,10 @@ void LLAppViewer::idle()
 	{
 		gFrameStats.start(LLFrameStats::CLEAN_DEAD);
 		LLFastTimer t(FTM_CLEANUP);
+		{
+			static const LLCachedControl<F32> teardown_budget("RegionTeardownBudget", 2.f);
+			LLWorld::getInstance()->updateRegionTeardown(teardown_budget * 0.001f);
+		}
 		{
 			LLFastTimer t(FTM_CLEANUP_OBJECTS);
 			gObjectList.cleanDeadObjects();
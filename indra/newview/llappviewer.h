@@ -39,6 +39,10 @@
 
 class LLTextureCache;
 class LLImageDecodeThread;
+class LLImageEncodeThread;
+class LLVolumeBuildThread;
+class LLTerrainCompositeThread;
+class LLRegionCacheThread;
 class LLTextureFetch;
 class LLWatchdogTimeout;
 class LLCommandLineParser;
@@ -95,6 +99,10 @@ public:
 	// Thread accessors
 	static LLTextureCache* getTextureCache() { return sTextureCache; }
 	static LLImageDecodeThread* getImageDecodeThread() { return sImageDecodeThread; }
+	static LLImageEncodeThread* getImageEncodeThread() { return sImageEncodeThread; }
+	static LLVolumeBuildThread* getVolumeBuildThread() { return sVolumeBuildThread; }
+	static LLTerrainCompositeThread* getTerrainCompositeThread() { return sTerrainCompositeThread; }
+	static LLRegionCacheThread* getRegionCacheThread() { return sRegionCacheThread; }
 	static LLTextureFetch* getTextureFetch() { return sTextureFetch; }
 
 	static U32 getTextureCacheVersion() ;
@@ -226,6 +234,10 @@ private:
 	// Thread objects.
 	static LLTextureCache* sTextureCache; 
 	static LLImageDecodeThread* sImageDecodeThread; 
+	static LLImageEncodeThread* sImageEncodeThread; 
+	static LLVolumeBuildThread* sVolumeBuildThread;
+	static LLTerrainCompositeThread* sTerrainCompositeThread;
+	static LLRegionCacheThread* sRegionCacheThread;
 	static LLTextureFetch* sTextureFetch;
 
 	S32 mNumSessions;
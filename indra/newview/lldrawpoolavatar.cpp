@@ -43,6 +43,7 @@
 #include "lldrawable.h"
 #include "lldrawpoolbump.h"
 #include "llface.h"
+#include "llgeometryworkers.h"
 #include "llmeshrepository.h"
 #include "llsky.h"
 #include "llviewercamera.h"
@@ -1282,6 +1283,46 @@ void LLDrawPoolAvatar::renderAvatars(LLVOAvatar* single_avatar, S32 pass)
 	}
 }
 
+typedef std::map<std::pair<const LLVOAvatar*, const LLMeshSkinInfo*>, std::vector<LLMatrix4> > matrix_palette_map_t;
+static matrix_palette_map_t sMatrixPalettes;
+static U32 sMatrixPaletteFrame = 0;
+
+//static
+const LLMatrix4* LLDrawPoolAvatar::getMatrixPalette(LLVOAvatar* avatar, const LLMeshSkinInfo* skin, U32& count)
+{
+	if (sMatrixPaletteFrame != gFrameCount)
+	{ //joints have moved, and last frame's avatars or skins may be gone
+		sMatrixPalettes.clear();
+		sMatrixPaletteFrame = gFrameCount;
+	}
+
+	std::vector<LLMatrix4>& palette = sMatrixPalettes[std::make_pair(avatar, skin)];
+	if (palette.empty())
+	{
+		palette.resize(llclamp((S32) skin->mJointNames.size(), 1, 64));
+		U32 joints = llmin((U32) skin->mJointNames.size(), (U32) palette.size());
+		for (U32 i = 0; i < joints; ++i)
+		{
+			LLJoint* joint = avatar->getJoint(skin->mJointNames[i]);
+			if (joint)
+			{
+				palette[i] = skin->mInvBindMatrix[i];
+				palette[i] *= joint->getWorldMatrix();
+			}
+		}
+	}
+
+	count = llmin((U32) skin->mJointNames.size(), (U32) palette.size());
+	return &palette[0];
+}
+
+static void skin_vertices_batch(void* data, U32 index)
+{
+	const LLRiggedSkinJob& job = *(const LLRiggedSkinJob*) data;
+	U32 start = index*LLRiggedSkinJob::BATCH_VERTICES;
+	job.run(start, llmin(start + LLRiggedSkinJob::BATCH_VERTICES, job.mCount));
+}
+
 void LLDrawPoolAvatar::updateRiggedFaceVertexBuffer(LLVOAvatar* avatar, LLFace* face, const LLMeshSkinInfo* skin, LLVolume* volume, const LLVolumeFace& vol_face)
 {
 	LLVector4a* weight = vol_face.mWeights;
@@ -1352,88 +1393,52 @@ void LLDrawPoolAvatar::updateRiggedFaceVertexBuffer(LLVOAvatar* avatar, LLFace*
 		face->getGeometryVolume(*volume, face->getTEOffset(), mat_vert, mat_normal, offset, true);
 
 		buffer->flush();
+
+		//buffer holds unskinned geometry again
+		face->mLastSkinTime = 0.f;
 	}
 
 	if (sShaderLevel <= 0 && face->mLastSkinTime < avatar->getLastSkinTime())
 	{ //perform software vertex skinning for this face
-		LLStrider<LLVector3> position;
-		LLStrider<LLVector3> normal;
-
-		bool has_normal = buffer->hasDataType(LLVertexBuffer::TYPE_NORMAL);
-		buffer->getVertexStrider(position);
-
-		if (has_normal)
+		U32 count = 0;
+		const LLMatrix4* palette = getMatrixPalette(avatar, skin, count);
+		if (count > 0)
 		{
-			buffer->getNormalStrider(normal);
-		}
+			LLStrider<LLVector3> position;
+			LLStrider<LLVector3> normal;
 
-		LLVector4a* pos = (LLVector4a*) position.get();
+			bool has_normal = buffer->hasDataType(LLVertexBuffer::TYPE_NORMAL);
+			buffer->getVertexStrider(position);
 
-		LLVector4a* norm = has_normal ? (LLVector4a*) normal.get() : NULL;
-		
-		//build matrix palette
-		LLMatrix4a mp[64];
-		LLMatrix4* mat = (LLMatrix4*) mp;
-
-		for (U32 j = 0; j < skin->mJointNames.size(); ++j)
-		{
-			LLJoint* joint = avatar->getJoint(skin->mJointNames[j]);
-			if (joint)
+			if (has_normal)
 			{
-				mat[j] = skin->mInvBindMatrix[j];
-				mat[j] *= joint->getWorldMatrix();
+				buffer->getNormalStrider(normal);
 			}
-		}
-
-		LLMatrix4a bind_shape_matrix;
-		bind_shape_matrix.loadu(skin->mBindShapeMatrix);
 
-		for (U32 j = 0; j < (U32)buffer->getNumVerts(); ++j)
-		{
-			LLMatrix4a final_mat;
-			final_mat.clear();
-
-			S32 idx[4];
-
-			LLVector4 wght;
-
-			F32 scale = 0.f;
-			for (U32 k = 0; k < 4; k++)
+			LLMatrix4a mp[64];
+			LLRiggedSkinJob::foldBindShape(palette, count, skin->mBindShapeMatrix, mp);
+
+			LLRiggedSkinJob job;
+			job.mPalette = mp;
+			job.mPaletteSize = count;
+			job.mWeights = weight;
+			job.mPositions = vol_face.mPositions;
+			job.mNormals = vol_face.mNormals;
+			job.mPosOut = (LLVector4a*) position.get();
+			job.mNormOut = has_normal ? (LLVector4a*) normal.get() : NULL;
+			job.mCount = buffer->getNumVerts();
+
+			LLGeometryWorkers* workers = LLGeometryWorkers::getInstance();
+			if (workers && job.mCount >= LLRiggedSkinJob::BATCH_VERTICES*2)
 			{
-				F32 w = weight[j][k];
-
-				idx[k] = llclamp((S32) floorf(w), 0, 63);
-				wght[k] = w - floorf(w);
-				scale += wght[k];
+				workers->run(skin_vertices_batch, &job, (job.mCount + LLRiggedSkinJob::BATCH_VERTICES - 1)/LLRiggedSkinJob::BATCH_VERTICES);
 			}
-
-			wght *= 1.f/scale;
-
-			for (U32 k = 0; k < 4; k++)
+			else
 			{
-				F32 w = wght[k];
-
-				LLMatrix4a src;
-				src.setMul(mp[idx[k]], w);
-
-				final_mat.add(src);
+				job.run(0, job.mCount);
 			}
 
-			
-			LLVector4a& v = vol_face.mPositions[j];
-			LLVector4a t;
-			LLVector4a dst;
-			bind_shape_matrix.affineTransform(v, t);
-			final_mat.affineTransform(t, dst);
-			pos[j] = dst;
-
-			if (norm)
-			{
-				LLVector4a& n = vol_face.mNormals[j];
-				bind_shape_matrix.rotate(n, t);
-				final_mat.rotate(t, dst);
-				norm[j] = dst;
-			}
+			face->mLastSkinTime = avatar->getLastSkinTime();
 		}
 	}
 
@@ -1503,22 +1508,13 @@ void LLDrawPoolAvatar::renderRigged(LLVOAvatar* avatar, U32 type, bool glow)
 		{
 			if (sShaderLevel > 0)
 			{ //upload matrix palette to shader
-				LLMatrix4 mat[64];
-
-				for (U32 i = 0; i < skin->mJointNames.size(); ++i)
-				{
-					LLJoint* joint = avatar->getJoint(skin->mJointNames[i]);
-					if (joint)
-					{
-						mat[i] = skin->mInvBindMatrix[i];
-						mat[i] *= joint->getWorldMatrix();
-					}
-				}
+				U32 count = 0;
+				const LLMatrix4* mat = getMatrixPalette(avatar, skin, count);
 				
 				stop_glerror();
 
 				LLDrawPoolAvatar::sVertexProgram->uniformMatrix4fv("matrixPalette", 
-					skin->mJointNames.size(),
+					count,
 					FALSE,
 					(GLfloat*) mat[0].mMatrix);
 				
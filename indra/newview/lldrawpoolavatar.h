@@ -37,6 +37,7 @@
 
 class LLVOAvatar;
 class LLGLSLShader;
+class LLMatrix4;
 class LLFace;
 class LLMeshSkinInfo;
 class LLVolume;
@@ -142,6 +143,10 @@ public:
 									  const LLVolumeFace& vol_face);
 	void updateRiggedVertexBuffers(LLVOAvatar* avatar);
 
+	// Inverse bind * joint world matrices of avatar for skin, built once per
+	// frame. count is the number of joints, at most 64.
+	static const LLMatrix4* getMatrixPalette(LLVOAvatar* avatar, const LLMeshSkinInfo* skin, U32& count);
+
 	void renderRigged(LLVOAvatar* avatar, U32 type, bool glow = false);
 	void renderRiggedSimple(LLVOAvatar* avatar);
 	void renderRiggedAlpha(LLVOAvatar* avatar);
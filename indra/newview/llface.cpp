@@ -1108,18 +1108,30 @@ static LLFastTimer::DeclareTimer FTM_FACE_GEOM_INDEX("Index");
 static LLFastTimer::DeclareTimer FTM_FACE_GEOM_INDEX_TAIL("Tail");
 static LLFastTimer::DeclareTimer FTM_FACE_POSITION_STORE("Pos");
 static LLFastTimer::DeclareTimer FTM_FACE_TEXTURE_INDEX_STORE("TexIdx");
-static LLFastTimer::DeclareTimer FTM_FACE_POSITION_PAD("Pad");
 static LLFastTimer::DeclareTimer FTM_FACE_TEX_DEFAULT("Default");
 static LLFastTimer::DeclareTimer FTM_FACE_TEX_QUICK("Quick");
 static LLFastTimer::DeclareTimer FTM_FACE_TEX_QUICK_NO_XFORM("No Xform");
 static LLFastTimer::DeclareTimer FTM_FACE_TEX_QUICK_XFORM("Xform");
 
 static LLFastTimer::DeclareTimer FTM_FACE_TEX_QUICK_PLANAR("Quick Planar");
+
+// Flushing unmaps the range the deferred jobs write into, so they have to
+// be joined first.
+static void flush_vertex_buffer(LLVertexBuffer* buffer, face_geometry_job_list_t* jobs)
+{
+	if (jobs)
+	{
+		LLVolumeGeometryManager::runGeometryJobs(*jobs);
+	}
+	buffer->flush();
+}
+
 BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 							   const S32 &f,
 								const LLMatrix4& mat_vert_in, const LLMatrix3& mat_norm_in,
 								const U16 &index_offset,
-								bool force_rebuild)
+								bool force_rebuild,
+								face_geometry_job_list_t* jobs)
 {
 	LLFastTimer t(FTM_FACE_GET_GEOM);
 	llassert(verify());
@@ -1257,7 +1269,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 
 		if (map_range)
 		{
-			mVertexBuffer->flush();
+			flush_vertex_buffer(mVertexBuffer, jobs);
 		}
 	}
 	
@@ -1512,7 +1524,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 
 			if (map_range)
 			{
-				mVertexBuffer->flush();
+				flush_vertex_buffer(mVertexBuffer, jobs);
 			}
 		}
 		else
@@ -1574,7 +1586,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 
 			if (map_range)
 			{
-				mVertexBuffer->flush();
+				flush_vertex_buffer(mVertexBuffer, jobs);
 			}
 
 			if (do_bump)
@@ -1611,7 +1623,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 
 				if (map_range)
 				{
-					mVertexBuffer->flush();
+					flush_vertex_buffer(mVertexBuffer, jobs);
 				}
 			}
 		}
@@ -1623,18 +1635,6 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		llassert(num_vertices > 0);
 		
 		mVertexBuffer->getVertexStrider(vert, mGeomIndex, mGeomCount, map_range);
-			
-
-		LLMatrix4a mat_vert;
-		mat_vert.loadu(mat_vert_in);
-
-		LLVector4a* src = vf.mPositions;
-		volatile F32* dst = (volatile F32*) vert.get();
-
-		volatile F32* end = dst+num_vertices*4;
-		LLVector4a res;
-
-		LLVector4a texIdx;
 
 		U8 index = mTextureIndex < 255 ? mTextureIndex : 0;
 
@@ -1647,42 +1647,28 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 
 		llassert(index <= LLGLSLShader::sIndexedTextureChannels-1);
 
-		LLVector4Logical mask;
-		mask.clear();
-		mask.setElement<3>();
-		
-		texIdx.set(0,0,0,val);
+		LLFaceGeometryJob job;
+		job.mType = LLFaceGeometryJob::POSITION;
+		job.mMatVert = mat_vert_in;
+		job.mSrc = vf.mPositions;
+		job.mDst = (F32*) vert.get();
+		job.mCount = num_vertices;
+		job.mPadCount = mGeomCount - num_vertices;
+		job.mTexIndex = val;
 
+		if (jobs)
 		{
-			LLFastTimer t(FTM_FACE_POSITION_STORE);
-			LLVector4a tmp;
-
-			do
-			{	
-				mat_vert.affineTransform(*src++, res);
-				tmp.setSelectWithMask(mask, texIdx, res);
-				tmp.store4a((F32*) dst);
-				dst += 4;
-			}
-			while(dst < end);
+			jobs->push_back(job);
 		}
-
+		else
 		{
-			LLFastTimer t(FTM_FACE_POSITION_PAD);
-			S32 aligned_pad_vertices = mGeomCount - num_vertices;
-			res.set(res[0], res[1], res[2], 0.f);
-
-			while (aligned_pad_vertices > 0)
-			{
-				--aligned_pad_vertices;
-				res.store4a((F32*) dst);
-				dst += 4;
-			}
+			LLFastTimer t(FTM_FACE_POSITION_STORE);
+			job.run();
 		}
 
 		if (map_range)
 		{
-			mVertexBuffer->flush();
+			flush_vertex_buffer(mVertexBuffer, jobs);
 		}
 	}
 		
@@ -1690,20 +1676,28 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 	{
 		LLFastTimer t(FTM_FACE_GEOM_NORMAL);
 		mVertexBuffer->getNormalStrider(norm, mGeomIndex, mGeomCount, map_range);
-		F32* normals = (F32*) norm.get();
-	
-		for (S32 i = 0; i < num_vertices; i++)
-		{	
-			LLVector4a normal;
-			mat_normal.rotate(vf.mNormals[i], normal);
-			normal.normalize3fast();
-			normal.store4a(normals);
-			normals += 4;
+
+		LLFaceGeometryJob job;
+		job.mType = LLFaceGeometryJob::NORMAL;
+		job.mMatNormal = mat_norm_in;
+		job.mSrc = vf.mNormals;
+		job.mDst = (F32*) norm.get();
+		job.mCount = num_vertices;
+		job.mPadCount = 0;
+		job.mTexIndex = 0.f;
+
+		if (jobs)
+		{
+			jobs->push_back(job);
+		}
+		else
+		{
+			job.run();
 		}
 
 		if (map_range)
 		{
-			mVertexBuffer->flush();
+			flush_vertex_buffer(mVertexBuffer, jobs);
 		}
 	}
 		
@@ -1711,20 +1705,28 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 	{
 		LLFastTimer t(FTM_FACE_GEOM_BINORMAL);
 		mVertexBuffer->getBinormalStrider(binorm, mGeomIndex, mGeomCount, map_range);
-		F32* binormals = (F32*) binorm.get();
-		
-		for (S32 i = 0; i < num_vertices; i++)
-		{	
-			LLVector4a binormal;
-			mat_normal.rotate(vf.mBinormals[i], binormal);
-			binormal.normalize3fast();
-			binormal.store4a(binormals);
-			binormals += 4;
+
+		LLFaceGeometryJob job;
+		job.mType = LLFaceGeometryJob::NORMAL;
+		job.mMatNormal = mat_norm_in;
+		job.mSrc = vf.mBinormals;
+		job.mDst = (F32*) binorm.get();
+		job.mCount = num_vertices;
+		job.mPadCount = 0;
+		job.mTexIndex = 0.f;
+
+		if (jobs)
+		{
+			jobs->push_back(job);
+		}
+		else
+		{
+			job.run();
 		}
 
 		if (map_range)
 		{
-			mVertexBuffer->flush();
+			flush_vertex_buffer(mVertexBuffer, jobs);
 		}
 	}
 	
@@ -1736,13 +1738,13 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		LLVector4a::memcpyNonAliased16(weights, (F32*) vf.mWeights, num_vertices*4*sizeof(F32));
 		if (map_range)
 		{
-			mVertexBuffer->flush();
+			flush_vertex_buffer(mVertexBuffer, jobs);
 		}
 	}
 
-	// <FS:ND> FS-5132 Only use color strider if face has colors.
-	// if (rebuild_color)
-	if (rebuild_color && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_COLOR) )
+	// <FS:ND> FS-5132 Only use color strider if face has colors.
+	// if (rebuild_color)
+	if (rebuild_color && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_COLOR) )
 	// </FS:ND>
 	{
 		LLFastTimer t(FTM_FACE_GEOM_COLOR);
@@ -1770,7 +1772,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 
 		if (map_range)
 		{
-			mVertexBuffer->flush();
+			flush_vertex_buffer(mVertexBuffer, jobs);
 		}
 	}
 
@@ -1810,7 +1812,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 
 		if (map_range)
 		{
-			mVertexBuffer->flush();
+			flush_vertex_buffer(mVertexBuffer, jobs);
 		}
 	}
 	if (rebuild_tcoord)
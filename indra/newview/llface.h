@@ -39,6 +39,7 @@
 #include "v2math.h"
 #include "v3math.h"
 #include "v4math.h"
+#include "m3math.h"
 #include "m4math.h"
 #include "v4coloru.h"
 #include "llquaternion.h"
@@ -48,6 +49,9 @@
 #include "llviewertexture.h"
 #include "llstat.h"
 #include "lldrawable.h"
+#include "llgeometryworkers.h"
+
+#include <vector>
 
 class LLFacePool;
 class LLVolume;
@@ -163,7 +167,8 @@ public:
 						const S32 &f,
 						const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
 						const U16 &index_offset,
-						bool force_rebuild = false);
+						bool force_rebuild = false,
+						face_geometry_job_list_t* jobs = NULL); // defer vertex transforms to jobs if not NULL
 
 	// For avatar
 	U16			 getGeometryAvatar(
@@ -86,6 +86,7 @@
 #include "lldrawpoolavatar.h"
 #include "llface.h"
 #include "llfilepicker.h"
+#include "llmeshsimplifier.h"
 #include "lltoolmgr.h"
 #include "llviewercamera.h"
 #include "llviewercontrol.h"
@@ -3131,6 +3132,7 @@ LLModelPreview::LLModelPreview(S32 width, S32 height, LLFloater* fmp)
 		mRequestedQueueMode[i] = 0;
 		mRequestedBorderMode[i] = 0;
 		mRequestedShareTolerance[i] = 0.f;
+		mLODRequest[i] = 0;
 	}
 
 	mViewOption["show_textures"] = false;
@@ -3186,6 +3188,11 @@ LLModelPreview::~LLModelPreview()
 		mModelLoader->mPreview = NULL;
 		mModelLoader = NULL;
 	}
+	for (std::set<LLLODSimplifier*>::iterator iter = mLODSimplifiers.begin(); iter != mLODSimplifiers.end(); ++iter)
+	{	//they delete themselves once done
+		(*iter)->mPreview = NULL;
+	}
+	mLODSimplifiers.clear();
 	// *HACK : *TODO : turn this back on when we understand why this crashes
 	//glodShutdown();
 }
@@ -3853,6 +3860,10 @@ void LLModelPreview::genLODs(S32 which_lod, U32 decimation, bool enforce_tri_lim
 
 	stop_gloderror();
 	static U32 cur_name = 1;
+	static U32 cur_request = 1;
+
+	const bool use_glod = !gSavedSettings.getBOOL("MeshNativeSimplifier");
+	LLLODSimplifier* simplifier = use_glod ? NULL : new LLLODSimplifier(this, mBaseModel);
 
 	S32 limit = -1;
 
@@ -3909,7 +3920,7 @@ void LLModelPreview::genLODs(S32 which_lod, U32 decimation, bool enforce_tri_lim
 
 	bool object_dirty = false;
 
-	if (mGroup == 0)
+	if (use_glod && mGroup == 0)
 	{
 		object_dirty = true;
 		mGroup = cur_name++;
@@ -3996,6 +4007,20 @@ void LLModelPreview::genLODs(S32 which_lod, U32 decimation, bool enforce_tri_lim
 			}
 		}
 
+		mRequestedTriangleCount[lod] = triangle_count;
+		mRequestedErrorThreshold[lod] = lod_error_threshold;
+
+		if (simplifier)
+		{	//the current LODs stay up until the simplified ones come back
+			mLODRequest[lod] = cur_request++;
+			simplifier->addLOD(lod, mLODRequest[lod], lod_mode == GLOD_TRIANGLE_BUDGET ? triangle_count : 0,
+							   base_triangle_count, lod_mode == GLOD_TRIANGLE_BUDGET ? LLMeshSimplifier::NO_ERROR_LIMIT : lod_error_threshold);
+			continue;
+		}
+
+		//a GLOD result replaces whatever the simplifier still has in flight
+		mLODRequest[lod] = 0;
+
 		mModel[lod].clear();
 		mModel[lod].resize(mBaseModel.size());
 		mVertexBuffer[lod].clear();
@@ -4004,9 +4029,6 @@ void LLModelPreview::genLODs(S32 which_lod, U32 decimation, bool enforce_tri_lim
 		U32 actual_verts = 0;
 		U32 submeshes = 0;
 
-		mRequestedTriangleCount[lod] = triangle_count;
-		mRequestedErrorThreshold[lod] = lod_error_threshold;
-
 		glodGroupParameteri(mGroup, GLOD_ADAPT_MODE, lod_mode);
 		stop_gloderror();
 
@@ -4122,28 +4144,14 @@ void LLModelPreview::genLODs(S32 which_lod, U32 decimation, bool enforce_tri_lim
 			delete [] names;
 		}
 
-		//rebuild scene based on mBaseScene
-		mScene[lod].clear();
-		mScene[lod] = mBaseScene;
+		rebuildLODScene(lod);
+	}
 
-		for (U32 i = 0; i < mBaseModel.size(); ++i)
-		{
-			LLModel* mdl = mBaseModel[i];
-			LLModel* target = mModel[lod][i];
-			if (target)
-			{
-				for (LLModelLoader::scene::iterator iter = mScene[lod].begin(); iter != mScene[lod].end(); ++iter)
-				{
-					for (U32 j = 0; j < iter->second.size(); ++j)
-					{
-						if (iter->second[j].mModel == mdl)
-						{
-							iter->second[j].mModel = target;
-						}
-					}
-				}
-			}
-		}
+	if (simplifier)
+	{
+		mLODSimplifiers.insert(simplifier);
+		simplifier->start();
+		return;
 	}
 
 	mResourceCost = calcResourceCost();
@@ -4160,6 +4168,184 @@ void LLModelPreview::genLODs(S32 which_lod, U32 decimation, bool enforce_tri_lim
 	 }*/
 }
 
+void LLModelPreview::rebuildLODScene(S32 lod)
+{
+	//rebuild scene based on mBaseScene
+	mScene[lod].clear();
+	mScene[lod] = mBaseScene;
+
+	for (U32 i = 0; i < mBaseModel.size(); ++i)
+	{
+		LLModel* mdl = mBaseModel[i];
+		LLModel* target = mModel[lod][i];
+		if (target)
+		{
+			for (LLModelLoader::scene::iterator iter = mScene[lod].begin(); iter != mScene[lod].end(); ++iter)
+			{
+				for (U32 j = 0; j < iter->second.size(); ++j)
+				{
+					if (iter->second[j].mModel == mdl)
+					{
+						iter->second[j].mModel = target;
+					}
+				}
+			}
+		}
+	}
+}
+
+void LLModelPreview::simplifyLODsCallback(LLLODSimplifier* simplifier)
+{
+	assert_main_thread();
+
+	mLODSimplifiers.erase(simplifier);
+
+	if (simplifier->mBaseModel != mBaseModel)
+	{	//a different model got loaded meanwhile
+		return;
+	}
+
+	bool changed = false;
+
+	for (S32 lod = 0; lod < LLModel::NUM_LODS; ++lod)
+	{
+		if (!simplifier->mRequest[lod] || simplifier->mRequest[lod] != mLODRequest[lod])
+		{	//not generated there, or superseded by a later genLODs()
+			continue;
+		}
+
+		mLODRequest[lod] = 0;
+		mModel[lod] = simplifier->mModel[lod];
+		mVertexBuffer[lod].clear();
+
+		for (U32 mdl_idx = 0; mdl_idx < mBaseModel.size(); ++mdl_idx)
+		{
+			LLModel* base = mBaseModel[mdl_idx];
+			LLModel* target_model = mModel[lod][mdl_idx];
+
+			for (S32 i = 0; i < target_model->getNumVolumeFaces(); ++i)
+			{
+				if (!validate_face(target_model->getVolumeFace(i)))
+				{
+					llerrs << "Invalid face generated during LOD generation." << llendl;
+				}
+			}
+
+			//blind copy skin weights, as the GLOD path does
+			target_model->mPosition = base->mPosition;
+			target_model->mSkinWeights = base->mSkinWeights;
+			target_model->mSkinInfo = base->mSkinInfo;
+			//copy material list
+			target_model->mMaterialList = base->mMaterialList;
+
+			if (!validate_model(target_model))
+			{
+				llerrs << "Invalid model generated when creating LODs" << llendl;
+			}
+		}
+
+		rebuildLODScene(lod);
+		changed = true;
+	}
+
+	if (changed)
+	{
+		mResourceCost = calcResourceCost();
+		refresh();
+		updateStatusMessages();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// LLLODSimplifier
+//-----------------------------------------------------------------------------
+
+LLLODSimplifier::LLLODSimplifier(LLModelPreview* preview, const LLModelLoader::model_list& base)
+:	LLThread("LOD Simplifier"),
+	mPreview(preview),
+	mBaseModel(base)
+{
+	for (S32 i = 0; i < LLModel::NUM_LODS; ++i)
+	{
+		mRequest[i] = 0;
+	}
+
+	LLVolumeParams volume_params;
+	volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+
+	for (U32 i = 0; i < mBaseModel.size(); ++i)
+	{	//generateNormals() may change the base faces while this runs
+		LLModel* source = new LLModel(volume_params, 0.f);
+		source->copyVolumeFaces(mBaseModel[i]);
+		mSource.push_back(source);
+	}
+}
+
+void LLLODSimplifier::addLOD(S32 lod, U32 request, U32 triangle_count, U32 base_triangle_count, F32 max_error)
+{
+	mRequest[lod] = request;
+	mModel[lod].resize(mSource.size());
+
+	LLVolumeParams volume_params;
+	volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+
+	for (U32 mdl_idx = 0; mdl_idx < mSource.size(); ++mdl_idx)
+	{
+		LLModel* source = mSource[mdl_idx];
+		LLModel* target_model = new LLModel(volume_params, 0.f);
+		target_model->setNumVolumeFaces(source->getNumVolumeFaces());
+		mModel[lod][mdl_idx] = target_model;
+
+		for (S32 i = 0; i < source->getNumVolumeFaces(); ++i)
+		{
+			Job job;
+			job.mLOD = lod;
+			job.mModel = mdl_idx;
+			job.mFace = i;
+			job.mMaxError = max_error;
+			if (triangle_count && base_triangle_count)
+			{	//split the budget among faces by their share of the base triangles
+				U32 face_triangles = source->getVolumeFace(i).mNumIndices/3;
+				job.mTargetTriangles = llmax((U32) ((U64) face_triangles * triangle_count / base_triangle_count), (U32) 1);
+			}
+			else
+			{
+				job.mTargetTriangles = 0;
+			}
+			mJobs.push_back(job);
+		}
+	}
+}
+
+void LLLODSimplifier::run()
+{
+	for (U32 i = 0; i < mJobs.size(); ++i)
+	{
+		const Job& job = mJobs[i];
+		LLModel* source = mSource[job.mModel];
+		mModel[job.mLOD][job.mModel]->simplifyVolumeFace(job.mFace, source->getVolumeFace(job.mFace),
+														   job.mTargetTriangles, job.mMaxError);
+	}
+	doOnIdleOneTime(boost::bind(&LLLODSimplifier::simplifyCallback, this));
+}
+
+void LLLODSimplifier::simplifyCallback()
+{
+	assert_main_thread();
+
+	while (!isStopped())
+	{	//wait until this thread is stopped before deleting self
+		apr_sleep(100);
+	}
+
+	if (mPreview)
+	{
+		mPreview->simplifyLODsCallback(this);
+	}
+
+	delete this;
+}
+
 void LLModelPreview::updateStatusMessages()
 {
 	assert_main_thread();
@@ -4362,6 +4548,11 @@ void LLModelPreview::updateStatusMessages()
 		}
 	}
 
+	if (!mLODSimplifiers.empty())
+	{	//the LODs on screen are not the ones asked for yet
+		upload_ok = false;
+	}
+
 	if (upload_ok && mModelLoader)
 	{
 		if (!mModelLoader->areTexturesReady() && mFMP->childGetValue("upload_textures").asBoolean())
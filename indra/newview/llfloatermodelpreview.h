@@ -141,6 +141,38 @@ private:
 	static bool isAlive(LLModelLoader* loader) ;
 };
 
+// Generates upload LODs with LLMeshSimplifier instead of GLOD. Works on
+// copies of the base model faces, so the preview stays responsive while it
+// runs; the finished LODs are handed back on the main thread.
+class LLLODSimplifier : public LLThread
+{
+public:
+	struct Job
+	{
+		S32 mLOD;
+		U32 mModel;				// index into mSource
+		S32 mFace;
+		U32 mTargetTriangles;	// 0 in error threshold mode
+		F32 mMaxError;
+	};
+
+	LLLODSimplifier(LLModelPreview* preview, const LLModelLoader::model_list& base);
+
+	// Queues every face of lod. A triangle budget is split among the faces by
+	// their share of base_triangle_count.
+	void addLOD(S32 lod, U32 request, U32 triangle_count, U32 base_triangle_count, F32 max_error);
+
+	virtual void run();
+	void simplifyCallback();
+
+	LLModelPreview* mPreview;						// NULL once the preview is gone
+	LLModelLoader::model_list mBaseModel;			// base models of the preview at start
+	LLModelLoader::model_list mSource;				// copies of their faces
+	LLModelLoader::model_list mModel[LLModel::NUM_LODS];
+	U32 mRequest[LLModel::NUM_LODS];				// 0 for LODs not generated here
+	std::vector<Job> mJobs;
+};
+
 class LLFloaterModelPreview : public LLFloaterModelUploadBase
 {
 public:
@@ -335,6 +367,7 @@ public:
 	void loadModel(std::string filename, S32 lod, bool force_disable_slm = false);
 	void loadModelCallback(S32 lod);
 	void genLODs(S32 which_lod = -1, U32 decimation = 3, bool enforce_tri_limit = false);
+	void simplifyLODsCallback(LLLODSimplifier* simplifier);
 	void generateNormals();
 	U32 calcResourceCost();
 	void rebuildUploadData();
@@ -383,6 +416,8 @@ public:
 private:
 	//Utility function for controller vertex compare
 	bool verifyCount(int expected, int result);
+	//Points the instances of mScene[lod] at mModel[lod], starting from mBaseScene
+	void rebuildLODScene(S32 lod);
 	//Creates the dummy avatar for the preview window
 	void		createPreviewAvatar(void);
 	//Accessor for the dummy avatar
@@ -390,6 +425,7 @@ private:
 
  protected:
 	friend class LLModelLoader;
+	friend class LLLODSimplifier;
 	friend class LLFloaterModelPreview;
 	friend class LLFloaterModelPreview::DecompRequest;
 	friend class LLPhysicsDecomp;
@@ -434,6 +470,11 @@ private:
 
 	LLModelLoader* mModelLoader;
 
+	//LLMeshSimplifier LOD generation in flight, results apply only to the LODs
+	//whose mLODRequest still matches
+	std::set<LLLODSimplifier*> mLODSimplifiers;
+	U32 mLODRequest[LLModel::NUM_LODS];
+
 	LLModelLoader::scene mScene[LLModel::NUM_LODS];
 	LLModelLoader::scene mBaseScene;
 
@@ -78,6 +78,8 @@
 #include "llimagepng.h"
 #include "llimagebmp.h"
 #include "llimagej2c.h"
+#include "llimageworker.h"
+#include "llappviewer.h"
 #include "llnotificationsutil.h"
 #include "llvfile.h"
 #include "llvfs.h"
@@ -106,6 +108,50 @@ S32 BORDER_WIDTH = 6;
 const S32 MAX_POSTCARD_DATASIZE = 1024 * 1024; // one megabyte
 const S32 MAX_TEXTURE_SIZE = 512 ; //max upload texture size 512 * 512
 
+///----------------------------------------------------------------------------
+/// Class LLSnapshotEncodeResponder
+///----------------------------------------------------------------------------
+// Receives a snapshot encoded on the image encode thread, and decodes it back
+// (still on that thread) so the preview shows the compression artifacts.
+// raw is the image that was encoded, shown as is for lossless BMP.
+class LLSnapshotEncodeResponder : public LLImageEncodeThread::Responder
+{
+public:
+	LLSnapshotEncodeResponder(LLImageRaw* raw) : mRawImage(raw), mDone(FALSE), mSuccess(false) {}
+
+	// ENCODE THREAD
+	/*virtual*/ void completed(bool success, LLImageFormatted* image)
+	{
+		if (success && image->getCodec() == IMG_CODEC_BMP)
+		{
+			// special case BMP to copy instead of decode otherwise decode will crash.
+			mPreviewImageEncoded = mRawImage;
+		}
+		else if (success)
+		{
+			mPreviewImageEncoded = new LLImageRaw;
+			success = image->decode(mPreviewImageEncoded, 0);
+		}
+		mRawImage = NULL;
+		mSuccess = success;
+		mFormattedImage = image;
+		mDone = TRUE;
+	}
+
+	// MAIN THREAD; nothing else may be accessed before this returns true.
+	bool isDone() const { return mDone; }
+	bool getSuccess() const { return mSuccess; }
+	LLImageFormatted* getFormattedImage() const { return mFormattedImage; }
+	LLImageRaw* getPreviewImageEncoded() const { return mPreviewImageEncoded; }
+
+private:
+	LLPointer<LLImageRaw> mRawImage;
+	LLAtomic32<BOOL> mDone;
+	bool mSuccess;
+	LLPointer<LLImageFormatted> mFormattedImage;
+	LLPointer<LLImageRaw> mPreviewImageEncoded;
+};
+
 ///----------------------------------------------------------------------------
 /// Class LLSnapshotLivePreview 
 ///----------------------------------------------------------------------------
@@ -135,6 +181,7 @@ public:
 	ESnapshotType getSnapshotType() const { return mSnapshotType; }
 	LLFloaterSnapshot::ESnapshotFormat getSnapshotFormat() const { return mSnapshotFormat; }
 	BOOL getSnapshotUpToDate() const { return mSnapshotUpToDate; }
+	BOOL isEncoding() const { return mEncodeResponder.notNull(); }
 	BOOL isSnapshotActive() { return mSnapshotActive; }
 	LLViewerTexture* getThumbnailImage() const { return mThumbnailImage ; }
 	S32  getThumbnailWidth() const { return mThumbnailWidth ; }
@@ -165,6 +212,11 @@ public:
 	static BOOL onIdle( void* snapshot_preview );
 
 private:
+	// Builds the preview and thumbnail textures from mPreviewImageEncoded.
+	void updatePreviewTextures();
+	// Picks up the result of an asynchronous encode. Returns FALSE while it is still running.
+	BOOL finishEncode();
+
 	LLColor4					mColor;
 	LLPointer<LLViewerTexture>	mViewerImage[2]; //used to represent the scene when the frame is frozen.
 	LLRect						mImageRect[2];
@@ -185,6 +237,7 @@ private:
 	LLPointer<LLImageRaw>		mPreviewImage;
 	LLPointer<LLImageRaw>		mPreviewImageEncoded;
 	LLPointer<LLImageFormatted>	mFormattedImage;
+	LLPointer<LLSnapshotEncodeResponder> mEncodeResponder; // pending JPEG/PNG encode, if any
 	LLFrameTimer				mSnapshotDelayTimer;
 	S32							mShineCountdown;
 	LLFrameTimer				mShineAnimTimer;
@@ -256,6 +309,7 @@ LLSnapshotLivePreview::~LLSnapshotLivePreview()
 	mPreviewImage = NULL;
 	mPreviewImageEncoded = NULL;
 	mFormattedImage = NULL;
+	mEncodeResponder = NULL;
 
 // 	gIdleCallbacks.deleteFunction( &LLSnapshotLivePreview::onIdle, (void*)this );
 	sList.erase(this);
@@ -324,6 +378,7 @@ void LLSnapshotLivePreview::updateSnapshot(BOOL new_snapshot, BOOL new_thumbnail
 		mFallAnimTimer.start();		
 	}
 	mSnapshotUpToDate = FALSE; 		
+	mEncodeResponder = NULL; // a pending encode is for the old snapshot: let it finish unseen
 
 	LLRect& rect = mImageRect[mCurImageIndex];
 	rect.set(0, getRect().getHeight(), getRect().getWidth(), 0);
@@ -753,6 +808,12 @@ BOOL LLSnapshotLivePreview::onIdle( void* snapshot_preview )
 			autosnap ? AUTO_SNAPSHOT_TIME_DELAY : 0.f); // shutter delay if 1st arg is true.
 	}
 
+	// a snapshot taken earlier is being encoded: wait for it.
+	if (previewp->mEncodeResponder.notNull())
+	{
+		return previewp->finishEncode();
+	}
+
 	// see if it's time yet to snap the shot and bomb out otherwise.
 	previewp->mSnapshotActive = 
 		(previewp->mSnapshotDelayTimer.getStarted() && previewp->mSnapshotDelayTimer.hasExpired())
@@ -769,11 +830,6 @@ BOOL LLSnapshotLivePreview::onIdle( void* snapshot_preview )
 		previewp->mPreviewImage = new LLImageRaw;
 	}
 
-	if (!previewp->mPreviewImageEncoded)
-	{
-		previewp->mPreviewImageEncoded = new LLImageRaw;
-	}
-
 	previewp->setVisible(FALSE);
 	previewp->setEnabled(FALSE);
 	
@@ -792,32 +848,28 @@ BOOL LLSnapshotLivePreview::onIdle( void* snapshot_preview )
 							previewp->mSnapshotBufferType,
 							previewp->getMaxImageSize()))
 	{
-		previewp->mPreviewImageEncoded->resize(
-			previewp->mPreviewImage->getWidth(), 
-			previewp->mPreviewImage->getHeight(), 
+		previewp->mPosTakenGlobal = gAgentCamera.getCameraPositionGlobal();
+
+		// delete any existing image
+		previewp->mFormattedImage = NULL;
+		previewp->mDataSize = 0;
+		// encode from a copy since mPreviewImage may be re-captured meanwhile.
+		LLPointer<LLImageRaw> raw = new LLImageRaw(
+			previewp->mPreviewImage->getData(),
+			previewp->mPreviewImage->getWidth(),
+			previewp->mPreviewImage->getHeight(),
 			previewp->mPreviewImage->getComponents());
+		LLPointer<LLImageFormatted> formatted;
 
 		if(previewp->getSnapshotType() == SNAPSHOT_TEXTURE)
 		{
-			LLPointer<LLImageJ2C> formatted = new LLImageJ2C;
-			LLPointer<LLImageRaw> scaled = new LLImageRaw(
-				previewp->mPreviewImage->getData(),
-				previewp->mPreviewImage->getWidth(),
-				previewp->mPreviewImage->getHeight(),
-				previewp->mPreviewImage->getComponents());
-		
-			scaled->biasedScaleToPowerOfTwo(512);
+			// the upload sends this very image.
+			formatted = new LLImageJ2C;
+			raw->biasedScaleToPowerOfTwo(MAX_TEXTURE_SIZE);
 			previewp->mImageScaled[previewp->mCurImageIndex] = TRUE;
-			if (formatted->encode(scaled, 0.f))
-			{
-				previewp->mDataSize = formatted->getDataSize();
-				formatted->decode(previewp->mPreviewImageEncoded, 0);
-			}
 		}
 		else
 		{
-			// delete any existing image
-			previewp->mFormattedImage = NULL;
 			// now create the new one of the appropriate format.
 			// note: postcards hardcoded to use jpeg always.
 			LLFloaterSnapshot::ESnapshotFormat format = previewp->getSnapshotType() == SNAPSHOT_POSTCARD
@@ -825,80 +877,23 @@ BOOL LLSnapshotLivePreview::onIdle( void* snapshot_preview )
 			switch(format)
 			{
 			case LLFloaterSnapshot::SNAPSHOT_FORMAT_PNG:
-				previewp->mFormattedImage = new LLImagePNG(); 
+				formatted = new LLImagePNG(); 
 				break;
 			case LLFloaterSnapshot::SNAPSHOT_FORMAT_JPEG:
-				previewp->mFormattedImage = new LLImageJPEG(previewp->mSnapshotQuality); 
+				formatted = new LLImageJPEG(previewp->mSnapshotQuality); 
 				break;
 			case LLFloaterSnapshot::SNAPSHOT_FORMAT_BMP:
-				previewp->mFormattedImage = new LLImageBMP(); 
+				formatted = new LLImageBMP(); 
 				break;
 			}
-			if (previewp->mFormattedImage->encode(previewp->mPreviewImage, 0))
-			{
-				previewp->mDataSize = previewp->mFormattedImage->getDataSize();
-				// special case BMP to copy instead of decode otherwise decode will crash.
-				if(format == LLFloaterSnapshot::SNAPSHOT_FORMAT_BMP)
-				{
-					previewp->mPreviewImageEncoded->copy(previewp->mPreviewImage);
-				}
-				else
-				{
-					previewp->mFormattedImage->decode(previewp->mPreviewImageEncoded, 0);
-				}
-			}
 		}
 
-		LLPointer<LLImageRaw> scaled = new LLImageRaw(
-			previewp->mPreviewImageEncoded->getData(),
-			previewp->mPreviewImageEncoded->getWidth(),
-			previewp->mPreviewImageEncoded->getHeight(),
-			previewp->mPreviewImageEncoded->getComponents());
-		
-		if(!scaled->isBufferInvalid())
-		{
-			// leave original image dimensions, just scale up texture buffer
-			if (previewp->mPreviewImageEncoded->getWidth() > 1024 || previewp->mPreviewImageEncoded->getHeight() > 1024)
-			{
-				// go ahead and shrink image to appropriate power of 2 for display
-				scaled->biasedScaleToPowerOfTwo(1024);
-				previewp->mImageScaled[previewp->mCurImageIndex] = TRUE;
-			}
-			else
-			{
-				// expand image but keep original image data intact
-				scaled->expandToPowerOfTwo(1024, FALSE);
-			}
-
-			previewp->mViewerImage[previewp->mCurImageIndex] = LLViewerTextureManager::getLocalTexture(scaled.get(), FALSE);
-			LLPointer<LLViewerTexture> curr_preview_image = previewp->mViewerImage[previewp->mCurImageIndex];
-			gGL.getTexUnit(0)->bind(curr_preview_image);
-			if (previewp->getSnapshotType() != SNAPSHOT_TEXTURE)
-			{
-				curr_preview_image->setFilteringOption(LLTexUnit::TFO_POINT);
-			}
-			else
-			{
-				curr_preview_image->setFilteringOption(LLTexUnit::TFO_ANISOTROPIC);
-			}
-			curr_preview_image->setAddressMode(LLTexUnit::TAM_CLAMP);
-
-			previewp->mSnapshotUpToDate = TRUE;
-			//Resize to thumbnail.
-			{
-				previewp->mThumbnailUpToDate = TRUE ;
-				previewp->mThumbnailUpdateLock = TRUE ;
-				S32 w = get_lower_power_two(scaled->getWidth(), 512) * 2 ;
-				S32 h = get_lower_power_two(scaled->getHeight(), 512) * 2 ;
-				scaled->scale(w,h);
-				previewp->mThumbnailImage =  LLViewerTextureManager::getLocalTexture(scaled.get(), FALSE);
-				previewp->mThumbnailUpdateLock = FALSE ;
-				previewp->setThumbnailImageSize();
-			}
-
-			previewp->mPosTakenGlobal = gAgentCamera.getCameraPositionGlobal();
-			previewp->mShineCountdown = 4; // wait a few frames to avoid animation glitch due to readback this frame
-		}
+		// encoding a large snapshot takes seconds: do it on the encode thread.
+		// The save and upload buttons stay disabled until finishEncode().
+		previewp->mEncodeResponder = new LLSnapshotEncodeResponder(raw);
+		LLAppViewer::getImageEncodeThread()->encodeImage(raw, formatted,
+														 LLQueuedThread::PRIORITY_HIGH,
+														 previewp->mEncodeResponder);
 	}
 	previewp->getWindow()->decBusyCount();
 	// only show fullscreen preview when in freeze frame mode
@@ -914,6 +909,85 @@ BOOL LLSnapshotLivePreview::onIdle( void* snapshot_preview )
 	return TRUE;
 }
 
+BOOL LLSnapshotLivePreview::finishEncode()
+{
+	if (!mEncodeResponder->isDone())
+	{
+		return FALSE;
+	}
+	if (mEncodeResponder->getSuccess())
+	{
+		mFormattedImage = mEncodeResponder->getFormattedImage();
+		mDataSize = mFormattedImage->getDataSize();
+		mPreviewImageEncoded = mEncodeResponder->getPreviewImageEncoded();
+		mEncodeResponder = NULL;
+		updatePreviewTextures();
+	}
+	else
+	{
+		// leave the snapshot out of date so nothing can be saved from it.
+		mEncodeResponder = NULL;
+		mPreviewImageEncoded = NULL;
+		mViewerImage[mCurImageIndex] = NULL;
+		LLNotificationsUtil::add("ErrorEncodingSnapshot");
+		llwarns << "Error encoding snapshot" << llendl;
+	}
+	return TRUE;
+}
+
+void LLSnapshotLivePreview::updatePreviewTextures()
+{
+	LLPointer<LLImageRaw> scaled = new LLImageRaw(
+		mPreviewImageEncoded->getData(),
+		mPreviewImageEncoded->getWidth(),
+		mPreviewImageEncoded->getHeight(),
+		mPreviewImageEncoded->getComponents());
+	
+	if(!scaled->isBufferInvalid())
+	{
+		// leave original image dimensions, just scale up texture buffer
+		if (mPreviewImageEncoded->getWidth() > 1024 || mPreviewImageEncoded->getHeight() > 1024)
+		{
+			// go ahead and shrink image to appropriate power of 2 for display
+			scaled->biasedScaleToPowerOfTwo(1024);
+			mImageScaled[mCurImageIndex] = TRUE;
+		}
+		else
+		{
+			// expand image but keep original image data intact
+			scaled->expandToPowerOfTwo(1024, FALSE);
+		}
+
+		mViewerImage[mCurImageIndex] = LLViewerTextureManager::getLocalTexture(scaled.get(), FALSE);
+		LLPointer<LLViewerTexture> curr_preview_image = mViewerImage[mCurImageIndex];
+		gGL.getTexUnit(0)->bind(curr_preview_image);
+		if (getSnapshotType() != SNAPSHOT_TEXTURE)
+		{
+			curr_preview_image->setFilteringOption(LLTexUnit::TFO_POINT);
+		}
+		else
+		{
+			curr_preview_image->setFilteringOption(LLTexUnit::TFO_ANISOTROPIC);
+		}
+		curr_preview_image->setAddressMode(LLTexUnit::TAM_CLAMP);
+
+		mSnapshotUpToDate = TRUE;
+		//Resize to thumbnail.
+		{
+			mThumbnailUpToDate = TRUE ;
+			mThumbnailUpdateLock = TRUE ;
+			S32 w = get_lower_power_two(scaled->getWidth(), 512) * 2 ;
+			S32 h = get_lower_power_two(scaled->getHeight(), 512) * 2 ;
+			scaled->scale(w,h);
+			mThumbnailImage =  LLViewerTextureManager::getLocalTexture(scaled.get(), FALSE);
+			mThumbnailUpdateLock = FALSE ;
+			setThumbnailImageSize();
+		}
+
+		mShineCountdown = 4; // wait a few frames to avoid animation glitch due to readback this frame
+	}
+}
+
 void LLSnapshotLivePreview::setSize(S32 w, S32 h)
 {
 	mWidth[mCurImageIndex] = w;
@@ -965,15 +1039,9 @@ void LLSnapshotLivePreview::saveTexture()
 	tid.generate();
 	LLAssetID new_asset_id = tid.makeAssetID(gAgent.getSecureSessionID());
 		
-	LLPointer<LLImageJ2C> formatted = new LLImageJ2C;
-	LLPointer<LLImageRaw> scaled = new LLImageRaw(mPreviewImage->getData(),
-												  mPreviewImage->getWidth(),
-												  mPreviewImage->getHeight(),
-												  mPreviewImage->getComponents());
-	
-	scaled->biasedScaleToPowerOfTwo(512);
-			
-	if (formatted->encode(scaled, 0.0f))
+	// encoded along with the preview, off the main thread.
+	LLImageJ2C* formatted = dynamic_cast<LLImageJ2C*>(mFormattedImage.get());
+	if (formatted && mSnapshotUpToDate)
 	{
 		LLVFile::writeFile(formatted->getData(), formatted->getDataSize(), gVFS, new_asset_id, LLAssetType::AT_TEXTURE);
 		std::string pos_string;
@@ -1010,6 +1078,12 @@ void LLSnapshotLivePreview::saveTexture()
 
 void LLSnapshotLivePreview::saveLocal()
 {
+	if (mFormattedImage.isNull() || !mSnapshotUpToDate)
+	{
+		//this should never happen, the save button is disabled until encoded.
+		llwarns << "The snapshot image has not been encoded!" << llendl;
+		return;
+	}
 	gViewerWindow->saveImageNumbered(mFormattedImage);
 
 	// Relinquish image memory. Save button will be disabled as a side-effect.
@@ -1307,7 +1381,7 @@ void LLFloaterSnapshot::Impl::updateControls(LLFloaterSnapshot* floater)
 
 	LLSnapshotLivePreview* previewp = getPreviewView(floater);
 	BOOL got_bytes = previewp && previewp->getDataSize() > 0;
-	BOOL got_snap = previewp->getSnapshotUpToDate();
+	BOOL got_snap = previewp->getSnapshotUpToDate() && !previewp->isEncoding();
 
 	floater->childSetEnabled("send_btn",   shot_type == LLSnapshotLivePreview::SNAPSHOT_POSTCARD && got_snap && previewp->getDataSize() <= MAX_POSTCARD_DATASIZE);
 	floater->childSetEnabled("upload_btn", shot_type == LLSnapshotLivePreview::SNAPSHOT_TEXTURE  && got_snap);
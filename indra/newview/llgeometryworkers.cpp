@@ -0,0 +1,304 @@
+/**
+ * @file llgeometryworkers.cpp
+ * @brief Fork-join worker pool for per-frame geometry work.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llgeometryworkers.h"
+
+#include "llmatrix4a.h"
+
+LLGeometryWorkers* LLGeometryWorkers::sInstance = NULL;
+
+//static
+void LLGeometryWorkers::initClass(U32 num_threads)
+{
+	cleanupClass();
+	num_threads = llmin(num_threads, (U32)8);
+	if (num_threads > 0)
+	{
+		sInstance = new LLGeometryWorkers(num_threads);
+		llinfos << "Started " << num_threads << " geometry worker threads" << llendl;
+	}
+}
+
+//static
+void LLGeometryWorkers::cleanupClass()
+{
+	delete sInstance;
+	sInstance = NULL;
+}
+
+LLGeometryWorkers::LLGeometryWorkers(U32 num_threads)
+	: mNextJob(0),
+	  mBatch(0),
+	  mFunc(NULL),
+	  mData(NULL),
+	  mCount(0),
+	  mDone(0),
+	  mActive(0),
+	  mQuitting(false)
+{
+	for (U32 i = 0; i < num_threads; ++i)
+	{
+		Worker* worker = new Worker(this, llformat("Geometry Worker %d", i));
+		mWorkers.push_back(worker);
+		worker->start();
+	}
+}
+
+LLGeometryWorkers::~LLGeometryWorkers()
+{
+	mSignal.lock();
+	mQuitting = true;
+	mSignal.broadcast();
+	mSignal.unlock();
+
+	for (std::vector<Worker*>::iterator iter = mWorkers.begin(); iter != mWorkers.end(); ++iter)
+	{
+		(*iter)->shutdown();
+		delete *iter;
+	}
+	mWorkers.clear();
+}
+
+void LLGeometryWorkers::run(job_func_t func, void* data, U32 count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	mSignal.lock();
+	// A worker that woke up late for the previous batch must be done with
+	// it before the job counter is reset.
+	while (mActive > 0)
+	{
+		mSignal.wait();
+	}
+	mFunc = func;
+	mData = data;
+	mCount = count;
+	mDone = 0;
+	mNextJob = 0;
+	++mBatch;
+	mSignal.broadcast();
+	mSignal.unlock();
+
+	U32 done = runJobs(func, data, count);
+
+	mSignal.lock();
+	mDone += done;
+	while (mDone < mCount || mActive > 0)
+	{
+		mSignal.wait();
+	}
+	mSignal.unlock();
+}
+
+U32 LLGeometryWorkers::runJobs(job_func_t func, void* data, U32 count)
+{
+	U32 done = 0;
+	for (U32 i = mNextJob++; i < count; i = mNextJob++)
+	{
+		func(data, i);
+		++done;
+	}
+	return done;
+}
+
+void LLGeometryWorkers::workerLoop()
+{
+	U32 batch = 0;
+	mSignal.lock();
+	while (true)
+	{
+		while (!mQuitting && mBatch == batch)
+		{
+			mSignal.wait();
+		}
+		if (mQuitting)
+		{
+			break;
+		}
+		batch = mBatch;
+		job_func_t func = mFunc;
+		void* data = mData;
+		U32 count = mCount;
+		++mActive;
+		mSignal.unlock();
+
+		U32 done = runJobs(func, data, count);
+
+		mSignal.lock();
+		--mActive;
+		mDone += done;
+		mSignal.broadcast();
+	}
+	mSignal.unlock();
+}
+
+//----------------------------------------------------------------------------
+
+LLGeometryWorkers::Worker::Worker(LLGeometryWorkers* pool, const std::string& name)
+	: LLThread(name),
+	  mPool(pool)
+{
+}
+
+//virtual
+void LLGeometryWorkers::Worker::run()
+{
+	mPool->workerLoop();
+}
+
+//----------------------------------------------------------------------------
+
+void LLFaceGeometryJob::run() const
+{
+	F32* dst = mDst;
+
+	if (mType == POSITION)
+	{
+		LLMatrix4a mat_vert;
+		mat_vert.loadu(mMatVert);
+
+		LLVector4a tex_idx;
+		tex_idx.set(0, 0, 0, mTexIndex);
+
+		LLVector4Logical mask;
+		mask.clear();
+		mask.setElement<3>();
+
+		LLVector4a res;
+		LLVector4a tmp;
+		const LLVector4a* src = mSrc;
+		const F32* end = dst + mCount*4;
+
+		do
+		{
+			mat_vert.affineTransform(*src++, res);
+			tmp.setSelectWithMask(mask, tex_idx, res);
+			tmp.store4a(dst);
+			dst += 4;
+		}
+		while (dst < end);
+
+		res.set(res[0], res[1], res[2], 0.f);
+		for (S32 i = 0; i < mPadCount; ++i)
+		{
+			res.store4a(dst);
+			dst += 4;
+		}
+	}
+	else
+	{
+		LLMatrix4a mat_normal;
+		mat_normal.loadu(mMatNormal);
+
+		for (S32 i = 0; i < mCount; ++i)
+		{
+			LLVector4a normal;
+			mat_normal.rotate(mSrc[i], normal);
+			normal.normalize3fast();
+			normal.store4a(dst);
+			dst += 4;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+void LLRiggedSkinJob::run(U32 start, U32 end) const
+{
+	S32 max_idx = (S32) mPaletteSize - 1;
+
+	for (U32 j = start; j < end; ++j)
+	{
+		//integer part of each weight is the joint index, fractional part the weight
+		const F32* w = mWeights[j].getF32ptr();
+
+		S32 idx[4];
+		F32 wght[4];
+		F32 scale = 0.f;
+		for (U32 k = 0; k < 4; ++k)
+		{
+			F32 w_floor = floorf(w[k]);
+			idx[k] = llclamp((S32) w_floor, 0, max_idx);
+			wght[k] = w[k] - w_floor;
+			scale += wght[k];
+		}
+
+		if (scale <= 0.f)
+		{
+			continue;
+		}
+		scale = 1.f/scale;
+
+		LLMatrix4a final_mat;
+		final_mat.clear();
+		for (U32 k = 0; k < 4; ++k)
+		{
+			if (wght[k] > 0.f)
+			{
+				LLMatrix4a src;
+				src.setMul(mPalette[idx[k]], wght[k]*scale);
+				final_mat.add(src);
+			}
+		}
+
+		final_mat.affineTransform(mPositions[j], mPosOut[j]);
+
+		if (mNormOut)
+		{
+			final_mat.rotate(mNormals[j], mNormOut[j]);
+		}
+	}
+}
+
+//static
+void LLRiggedSkinJob::foldBindShape(const LLMatrix4* palette, U32 count, const LLMatrix4& bind_shape, LLMatrix4a* out)
+{
+	LLMatrix4a bind_shape_matrix;
+	bind_shape_matrix.loadu(bind_shape);
+
+	for (U32 j = 0; j < count; ++j)
+	{
+		LLMatrix4a joint_mat;
+		joint_mat.loadu(palette[j]);
+		for (U32 k = 0; k < 3; ++k)
+		{
+			joint_mat.rotate(bind_shape_matrix.mMatrix[k], out[j].mMatrix[k]);
+		}
+		joint_mat.affineTransform(bind_shape_matrix.mMatrix[3], out[j].mMatrix[3]);
+	}
+}
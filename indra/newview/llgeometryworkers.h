@@ -0,0 +1,148 @@
+/**
+ * @file llgeometryworkers.h
+ * @brief Fork-join worker pool for per-frame geometry work.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLGEOMETRYWORKERS_H
+#define LL_LLGEOMETRYWORKERS_H
+
+#include "llapr.h"
+#include "llthread.h"
+#include "llvector4a.h"
+#include "m3math.h"
+#include "m4math.h"
+
+#include <vector>
+
+// Small pool of threads that split a batch of independent jobs with the
+// calling thread and return when all of them have run. Meant for work the
+// main thread would otherwise do inline during a frame, like transforming
+// vertices into mapped vertex buffers; job functions must not touch GL,
+// LLFastTimer or anything else that isn't thread safe.
+class LLGeometryWorkers
+{
+public:
+	typedef void (*job_func_t)(void* data, U32 index);
+
+	// num_threads 0 leaves the pool disabled, getInstance() returns NULL.
+	static void initClass(U32 num_threads);
+	static void cleanupClass();
+	static LLGeometryWorkers* getInstance() { return sInstance; }
+
+	// Calls func(data, i) for i in [0, count). Main thread only.
+	void run(job_func_t func, void* data, U32 count);
+
+	U32 getNumThreads() const { return mWorkers.size(); }
+
+private:
+	class Worker : public LLThread
+	{
+	public:
+		Worker(LLGeometryWorkers* pool, const std::string& name);
+		/*virtual*/ void run();
+
+	private:
+		LLGeometryWorkers* mPool;
+	};
+
+	LLGeometryWorkers(U32 num_threads);
+	~LLGeometryWorkers();
+
+	void workerLoop();
+	U32 runJobs(job_func_t func, void* data, U32 count);
+
+	static LLGeometryWorkers* sInstance;
+
+	std::vector<Worker*> mWorkers;
+	LLAtomicU32 mNextJob;
+
+	// protected by mSignal
+	LLCondition mSignal;
+	U32 mBatch;	  // bumped for every run()
+	job_func_t mFunc;
+	void* mData;
+	U32 mCount;
+	U32 mDone;
+	U32 mActive;  // workers inside a batch
+	bool mQuitting;
+};
+
+// Position or normal transform of one face, split out of
+// LLFace::getGeometryVolume() so a group rebuild can run it on the geometry
+// worker threads. Writes straight into the mapped vertex buffer, which the
+// main thread flushes once all jobs for it have run.
+struct LLFaceGeometryJob
+{
+	enum
+	{
+		POSITION = 0,
+		NORMAL		// also used for binormals
+	};
+
+	void run() const;
+
+	U32 mType;
+	LLMatrix4 mMatVert;		// POSITION
+	LLMatrix3 mMatNormal;	// NORMAL
+	const LLVector4a* mSrc;
+	F32* mDst;
+	S32 mCount;
+	S32 mPadCount;			// POSITION: copies of the last vertex up to mGeomCount
+	F32 mTexIndex;			// POSITION: texture index packed in w
+};
+typedef std::vector<LLFaceGeometryJob> face_geometry_job_list_t;
+
+class LLMatrix4a;
+
+// Software skinning of a rigged face, split in batches of vertices so large
+// faces can be spread over the geometry workers.
+struct LLRiggedSkinJob
+{
+	enum { BATCH_VERTICES = 1024 };
+
+	// Skins vertices [start, end).
+	void run(U32 start, U32 end) const;
+
+	// Folds the bind shape matrix into count joint matrices, so each vertex
+	// is transformed once.
+	static void foldBindShape(const LLMatrix4* palette, U32 count, const LLMatrix4& bind_shape, LLMatrix4a* out);
+
+	const LLMatrix4a* mPalette; // bind shape matrix already applied
+	U32 mPaletteSize;
+	const LLVector4a* mWeights;
+	const LLVector4a* mPositions;
+	const LLVector4a* mNormals;
+	LLVector4a* mPosOut;
+	LLVector4a* mNormOut; // NULL if the buffer has no normals
+	U32 mCount;
+};
+
+#endif // LL_LLGEOMETRYWORKERS_H
@@ -0,0 +1,532 @@
+/**
+ * @file llmeshcache.cpp
+ * @brief On-disk cache of mesh asset headers and data blocks.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llmeshcache.h"
+
+#include "llapr.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+#include "llsd.h"
+
+#include <ctime>
+#include <set>
+
+static const char* mesh_cache_dirname = "meshcache";
+static const char* mesh_index_filename = "mesh.index";
+
+static const U32 MESH_INDEX_MAGIC = 0x4d534849; // "MSHI"
+static const U32 MESH_INDEX_VERSION = 1;
+
+struct LLMeshIndexHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+};
+
+//----------------------------------------------------------------------------
+
+const char* LLMeshHeader::sBlockNames[NUM_BLOCKS] =
+{
+	"lowest_lod",
+	"low_lod",
+	"medium_lod",
+	"high_lod",
+	"skin",
+	"physics_convex",
+	"physics_mesh"
+};
+
+void LLMeshHeader::reset()
+{
+	memset(this, 0, sizeof(LLMeshHeader));
+}
+
+void LLMeshHeader::fromLLSD(const LLSD& header, S32 header_size)
+{
+	reset();
+	mVersion = header["version"].asInteger();
+	mHeaderSize = header_size;
+	m404 = header.has("404") ? 1 : 0;
+	for (S32 i = 0; i < NUM_BLOCKS; ++i)
+	{
+		if (header.has(sBlockNames[i]))
+		{
+			const LLSD& block = header[sBlockNames[i]];
+			mOffset[i] = block["offset"].asInteger();
+			mSize[i] = block["size"].asInteger();
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLMeshCache::LLMeshCache()
+	: mInitialized(false),
+	  mReadOnly(true),
+	  mTotalSize(0),
+	  mMaxSize(0),
+	  mIndexRecords(0)
+{
+}
+
+LLMeshCache::~LLMeshCache()
+{
+}
+
+//static
+U32 LLMeshCache::getCurrentBucket()
+{
+	return (U32)(time(NULL) / (24 * 60 * 60));
+}
+
+std::string LLMeshCache::getBucketFilename(U32 bucket) const
+{
+	return mCacheDirName + gDirUtilp->getDirDelimiter() + llformat("%u.bucket", bucket);
+}
+
+void LLMeshCache::initCache(ELLPath location, U32 max_days, S64 max_size)
+{
+	if (mInitialized)
+	{
+		llwarns << "Mesh cache already initialized." << llendl;
+		return;
+	}
+	mInitialized = true;
+
+	mCacheDirName = gDirUtilp->getExpandedFilename(location, mesh_cache_dirname);
+	mIndexFileName = gDirUtilp->getExpandedFilename(location, mesh_cache_dirname, mesh_index_filename);
+	if (!mReadOnly)
+	{
+		LLFile::mkdir(mCacheDirName);
+	}
+
+	LLMutexLock lock(&mMutex);
+
+	bool rewrite = true;
+	S32 file_size = LLAPRFile::size(mIndexFileName);
+	if (file_size >= (S32)sizeof(LLMeshIndexHeader))
+	{
+		std::vector<U8> buffer(file_size);
+		const LLMeshIndexHeader* index_header = (const LLMeshIndexHeader*)&buffer[0];
+		if (LLAPRFile::readEx(mIndexFileName, &buffer[0], 0, file_size) == file_size &&
+			index_header->mMagic == MESH_INDEX_MAGIC && index_header->mVersion == MESH_INDEX_VERSION)
+		{
+			S32 count = (file_size - sizeof(LLMeshIndexHeader)) / sizeof(IndexRecord);
+			const IndexRecord* records = (const IndexRecord*)&buffer[sizeof(LLMeshIndexHeader)];
+			for (S32 i = 0; i < count; ++i)
+			{
+				const IndexRecord& record = records[i];
+				Entry& entry = mEntries[record.mID];
+				if (record.mType == RECORD_HEADER)
+				{
+					entry.mHeader = record.mHeader;
+					entry.mHeaderBucket = record.mBucket;
+					entry.mHasHeader = true;
+				}
+				else if (record.mType == RECORD_BLOCK)
+				{
+					entry.mBlocks.push_back(record.mBlock);
+					mBucketSizes[record.mBlock.mBucket] = 0;
+				}
+			}
+			mIndexRecords = count;
+			// a torn record at the end means we crashed while appending
+			rewrite = (file_size - sizeof(LLMeshIndexHeader)) % sizeof(IndexRecord) != 0;
+		}
+	}
+
+	// Bucket sizes come from the files themselves: blocks are appended to the end.
+	S64 total_size = 0;
+	for (std::map<U32, S64>::iterator iter = mBucketSizes.begin(); iter != mBucketSizes.end(); ++iter)
+	{
+		iter->second = llmax(LLAPRFile::size(getBucketFilename(iter->first)), 0);
+		total_size += iter->second;
+	}
+
+	// Expire whole buckets, oldest first
+	U32 today = getCurrentBucket();
+	std::set<U32> expired;
+	for (std::map<U32, S64>::iterator iter = mBucketSizes.begin(); iter != mBucketSizes.end(); ++iter)
+	{
+		if (iter->first != today && (iter->first + max_days < today || total_size > max_size || iter->second == 0))
+		{
+			expired.insert(iter->first);
+			total_size -= iter->second;
+		}
+	}
+
+	U32 live_records = 0;
+	for (entry_map_t::iterator iter = mEntries.begin(); iter != mEntries.end(); )
+	{
+		Entry& entry = iter->second;
+		if (entry.mHasHeader && entry.mHeaderBucket + max_days < today)
+		{
+			entry.mHasHeader = false;
+		}
+		for (U32 i = 0; i < entry.mBlocks.size(); )
+		{
+			if (expired.count(entry.mBlocks[i].mBucket))
+			{
+				entry.mBlocks[i] = entry.mBlocks.back();
+				entry.mBlocks.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		if (!entry.mHasHeader && entry.mBlocks.empty())
+		{
+			mEntries.erase(iter++);
+		}
+		else
+		{
+			live_records += (entry.mHasHeader ? 1 : 0) + entry.mBlocks.size();
+			++iter;
+		}
+	}
+
+	for (std::set<U32>::iterator iter = expired.begin(); iter != expired.end(); ++iter)
+	{
+		mBucketSizes.erase(*iter);
+	}
+	mTotalSize = total_size;
+	mMaxSize = max_size;
+
+	if (mReadOnly)
+	{
+		return;
+	}
+
+	// Delete expired buckets and the ones the index lost track of
+	LLDirIterator dir_iter(mCacheDirName, "*.bucket");
+	std::string filename;
+	while (dir_iter.next(filename))
+	{
+		U32 bucket = (U32)atol(filename.c_str());
+		if (bucket != today && mBucketSizes.find(bucket) == mBucketSizes.end())
+		{
+			LLAPRFile::remove(getBucketFilename(bucket));
+		}
+	}
+
+	if (rewrite || !expired.empty() || mIndexRecords > live_records * 2 + 1024)
+	{
+		writeIndex();
+	}
+
+	llinfos << "Mesh cache: " << mEntries.size() << " meshes, " << (total_size >> 20) << " MB in "
+			<< mBucketSizes.size() << " buckets, " << expired.size() << " expired." << llendl;
+}
+
+void LLMeshCache::removeCache(ELLPath location)
+{
+	if (mReadOnly)
+	{
+		llwarns << "Not removing mesh cache at " << location << ": Cache is currently in read-only mode." << llendl;
+		return;
+	}
+
+	std::string cache_dir = gDirUtilp->getExpandedFilename(location, mesh_cache_dirname);
+	llinfos << "Removing mesh cache at " << cache_dir << llendl;
+	gDirUtilp->deleteFilesInDir(cache_dir, "*");
+	LLFile::rmdir(cache_dir);
+
+	LLMutexLock lock(&mMutex);
+	clearCacheInMemory();
+	mInitialized = false;
+}
+
+// mMutex must be locked
+void LLMeshCache::clearCacheInMemory()
+{
+	mEntries.clear();
+	mBucketSizes.clear();
+	mTotalSize = 0;
+	mIndexRecords = 0;
+}
+
+// Drops the oldest buckets but keep_bucket until bytes are freed. Returns false
+// if that wasn't enough. mMutex must be locked.
+bool LLMeshCache::evictBuckets(S64 bytes, U32 keep_bucket)
+{
+	std::set<U32> evicted;
+	for (std::map<U32, S64>::iterator iter = mBucketSizes.begin(); iter != mBucketSizes.end() && bytes > 0; ++iter)
+	{
+		if (iter->first != keep_bucket)
+		{
+			evicted.insert(iter->first);
+			bytes -= iter->second;
+		}
+	}
+	if (evicted.empty())
+	{
+		return bytes <= 0;
+	}
+
+	for (entry_map_t::iterator iter = mEntries.begin(); iter != mEntries.end(); )
+	{
+		std::vector<Block>& blocks = iter->second.mBlocks;
+		for (U32 i = 0; i < blocks.size(); )
+		{
+			if (evicted.count(blocks[i].mBucket))
+			{
+				blocks[i] = blocks.back();
+				blocks.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		if (!iter->second.mHasHeader && blocks.empty())
+		{
+			mEntries.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	// A reader that picked a block before this may still have its bucket open: it fails
+	// to read and fetches again. If the file can't be removed yet, initCache will.
+	for (std::set<U32>::iterator iter = evicted.begin(); iter != evicted.end(); ++iter)
+	{
+		mTotalSize -= mBucketSizes[*iter];
+		mBucketSizes.erase(*iter);
+		LLAPRFile::remove(getBucketFilename(*iter));
+	}
+	writeIndex();
+
+	llinfos << "Mesh cache full, evicted " << evicted.size() << " buckets." << llendl;
+	return bytes <= 0;
+}
+
+// mMutex must be locked
+void LLMeshCache::writeIndex()
+{
+	std::vector<U8> buffer(sizeof(LLMeshIndexHeader));
+	LLMeshIndexHeader* index_header = (LLMeshIndexHeader*)&buffer[0];
+	index_header->mMagic = MESH_INDEX_MAGIC;
+	index_header->mVersion = MESH_INDEX_VERSION;
+
+	U32 count = 0;
+	for (entry_map_t::iterator iter = mEntries.begin(); iter != mEntries.end(); ++iter)
+	{
+		const Entry& entry = iter->second;
+		IndexRecord record;
+		record.mID = iter->first;
+		if (entry.mHasHeader)
+		{
+			record.mType = RECORD_HEADER;
+			record.mBucket = entry.mHeaderBucket;
+			record.mHeader = entry.mHeader;
+			buffer.insert(buffer.end(), (U8*)&record, (U8*)(&record + 1));
+			++count;
+		}
+		record.mType = RECORD_BLOCK;
+		record.mHeader.reset();
+		for (U32 i = 0; i < entry.mBlocks.size(); ++i)
+		{
+			record.mBucket = entry.mBlocks[i].mBucket;
+			record.mBlock = entry.mBlocks[i];
+			buffer.insert(buffer.end(), (U8*)&record, (U8*)(&record + 1));
+			++count;
+		}
+	}
+
+	LLAPRFile::remove(mIndexFileName);
+	if (LLAPRFile::writeEx(mIndexFileName, &buffer[0], 0, buffer.size()) != (S32)buffer.size())
+	{
+		llwarns << "Failed to write mesh cache index " << mIndexFileName << llendl;
+	}
+	mIndexRecords = count;
+}
+
+// mMutex must be locked
+void LLMeshCache::appendRecord(const IndexRecord& record)
+{
+	if (LLAPRFile::writeEx(mIndexFileName, (void*)&record, -1, sizeof(IndexRecord)) == sizeof(IndexRecord))
+	{
+		++mIndexRecords;
+	}
+}
+
+bool LLMeshCache::getHeader(const LLUUID& mesh_id, LLMeshHeader& header)
+{
+	LLMutexLock lock(&mMutex);
+	entry_map_t::iterator iter = mEntries.find(mesh_id);
+	if (iter == mEntries.end() || !iter->second.mHasHeader)
+	{
+		return false;
+	}
+
+	Entry& entry = iter->second;
+	header = entry.mHeader;
+
+	U32 today = getCurrentBucket();
+	if (!mReadOnly && entry.mHeaderBucket != today)
+	{	// keep headers that are still in use from expiring
+		entry.mHeaderBucket = today;
+		IndexRecord record;
+		record.mID = mesh_id;
+		record.mType = RECORD_HEADER;
+		record.mBucket = today;
+		record.mHeader = entry.mHeader;
+		appendRecord(record);
+	}
+	return true;
+}
+
+void LLMeshCache::putHeader(const LLUUID& mesh_id, const LLMeshHeader& header)
+{
+	if (!mInitialized || mReadOnly || header.m404)
+	{
+		return;
+	}
+
+	LLMutexLock lock(&mMutex);
+	Entry& entry = mEntries[mesh_id];
+	if (entry.mHasHeader && !memcmp(&entry.mHeader, &header, sizeof(LLMeshHeader)))
+	{
+		return;
+	}
+
+	entry.mHeader = header;
+	entry.mHeaderBucket = getCurrentBucket();
+	entry.mHasHeader = true;
+
+	IndexRecord record;
+	record.mID = mesh_id;
+	record.mType = RECORD_HEADER;
+	record.mBucket = entry.mHeaderBucket;
+	record.mHeader = header;
+	appendRecord(record);
+}
+
+bool LLMeshCache::readBlock(const LLUUID& mesh_id, S32 offset, S32 size, U8* buffer)
+{
+	Block block;
+	{
+		LLMutexLock lock(&mMutex);
+		entry_map_t::iterator iter = mEntries.find(mesh_id);
+		if (iter == mEntries.end())
+		{
+			return false;
+		}
+
+		std::vector<Block>& blocks = iter->second.mBlocks;
+		U32 i = 0;
+		while (i < blocks.size() && (offset < blocks[i].mOffset || offset + size > blocks[i].mOffset + blocks[i].mSize))
+		{
+			++i;
+		}
+		if (i == blocks.size())
+		{
+			return false;
+		}
+		block = blocks[i];
+	}
+
+	// buckets are append only, the block can be read without holding the lock
+	S32 bucket_offset = block.mBucketOffset + (offset - block.mOffset);
+	return LLAPRFile::readEx(getBucketFilename(block.mBucket), buffer, bucket_offset, size) == size;
+}
+
+void LLMeshCache::writeBlock(const LLUUID& mesh_id, S32 offset, S32 size, const U8* data)
+{
+	if (!mInitialized || mReadOnly || size <= 0 || offset < 0)
+	{
+		return;
+	}
+
+	LLMutexLock lock(&mMutex);
+	entry_map_t::iterator iter = mEntries.find(mesh_id);
+	if (iter != mEntries.end())
+	{
+		const std::vector<Block>& blocks = iter->second.mBlocks;
+		for (U32 i = 0; i < blocks.size(); ++i)
+		{
+			if (offset >= blocks[i].mOffset && offset + size <= blocks[i].mOffset + blocks[i].mSize)
+			{
+				return; // already cached
+			}
+		}
+	}
+
+	U32 bucket = getCurrentBucket();
+	if (mTotalSize + size > mMaxSize && !evictBuckets(mTotalSize + size - mMaxSize, bucket))
+	{
+		return; // today's bucket alone fills the cache
+	}
+
+	std::string filename = getBucketFilename(bucket);
+	std::map<U32, S64>::iterator size_iter = mBucketSizes.find(bucket);
+	if (size_iter == mBucketSizes.end())
+	{
+		size_iter = mBucketSizes.insert(std::make_pair(bucket, (S64)llmax(LLAPRFile::size(filename), 0))).first;
+		mTotalSize += size_iter->second;
+	}
+
+	if (size_iter->second + size > (S64)S32_MAX)
+	{
+		return; // the rest of the day goes uncached
+	}
+
+	if (LLAPRFile::writeEx(filename, (void*)data, -1, size) != size)
+	{
+		llwarns << "Failed to write " << size << " bytes to mesh cache bucket " << filename << llendl;
+		S64 bucket_size = llmax(LLAPRFile::size(filename), 0);
+		mTotalSize += bucket_size - size_iter->second;
+		size_iter->second = bucket_size;
+		return;
+	}
+
+	IndexRecord record;
+	record.mID = mesh_id;
+	record.mType = RECORD_BLOCK;
+	record.mBucket = bucket;
+	record.mBlock.mOffset = offset;
+	record.mBlock.mSize = size;
+	record.mBlock.mBucket = bucket;
+	record.mBlock.mBucketOffset = (U32)size_iter->second;
+	size_iter->second += size;
+	mTotalSize += size;
+
+	mEntries[mesh_id].mBlocks.push_back(record.mBlock);
+	appendRecord(record);
+}
@@ -0,0 +1,161 @@
+/**
+ * @file llmeshcache.h
+ * @brief On-disk cache of mesh asset headers and data blocks.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHCACHE_H
+#define LL_LLMESHCACHE_H
+
+#include "lldir.h"
+#include "llsingleton.h"
+#include "llthread.h"
+#include "lluuid.h"
+
+#include <map>
+#include <vector>
+
+class LLSD;
+
+// Decoded mesh asset header. Plain data so the cache index can store it as is.
+struct LLMeshHeader
+{
+	enum
+	{
+		LOWEST_LOD = 0, // LLModel::LOD_*
+		LOW_LOD,
+		MEDIUM_LOD,
+		HIGH_LOD,
+		SKIN,
+		PHYSICS_CONVEX,
+		PHYSICS_MESH,
+		NUM_BLOCKS
+	};
+
+	S32 mVersion;
+	S32 mHeaderSize; // size of the LLSD header, block offsets are relative to its end
+	S32 m404;		 // asset doesn't exist
+	S32 mOffset[NUM_BLOCKS];
+	S32 mSize[NUM_BLOCKS];
+
+	LLMeshHeader() { reset(); }
+
+	void reset();
+	void fromLLSD(const LLSD& header, S32 header_size);
+
+	// Offset of a block in the asset.
+	S32 getBlockOffset(S32 block) const	{ return mHeaderSize + mOffset[block]; }
+
+	static const char* sBlockNames[NUM_BLOCKS];
+};
+
+// Mesh assets are immutable, so the cache never needs to revalidate: headers
+// live in a binary index that is read once at startup, data blocks are
+// appended to one bucket file per day and expire a whole bucket at a time.
+// Thread safe; used from the mesh repo thread and the mesh decode workers.
+class LLMeshCache : public LLSingleton<LLMeshCache>
+{
+	friend class LLSingleton<LLMeshCache>;
+	LLMeshCache();
+	~LLMeshCache();
+
+public:
+	// Loads the index, dropping buckets older than max_days and the oldest
+	// ones beyond max_size bytes. Writes evict the oldest buckets once the
+	// cache is full.
+	void initCache(ELLPath location, U32 max_days, S64 max_size);
+	void removeCache(ELLPath location);
+	void setReadOnly(bool read_only) { mReadOnly = read_only; }
+
+	bool getHeader(const LLUUID& mesh_id, LLMeshHeader& header);
+	void putHeader(const LLUUID& mesh_id, const LLMeshHeader& header);
+
+	// Reads size bytes at offset of the asset, false if that range is not cached.
+	bool readBlock(const LLUUID& mesh_id, S32 offset, S32 size, U8* buffer);
+	void writeBlock(const LLUUID& mesh_id, S32 offset, S32 size, const U8* data);
+
+private:
+	enum
+	{
+		RECORD_HEADER = 1,
+		RECORD_BLOCK = 2
+	};
+
+	struct Block
+	{
+		S32 mOffset; // in the asset
+		S32 mSize;
+		U32 mBucket;
+		U32 mBucketOffset;
+	};
+
+	// Fixed size entry of the index file, appended on every change.
+	struct IndexRecord
+	{
+		IndexRecord() : mType(0), mBucket(0) { memset(&mBlock, 0, sizeof(Block)); }
+
+		LLUUID mID;
+		U32 mType;
+		U32 mBucket; // day the record was written
+		Block mBlock;
+		LLMeshHeader mHeader;
+	};
+
+	struct Entry
+	{
+		Entry() : mHeaderBucket(0), mHasHeader(false) {}
+		LLMeshHeader mHeader;
+		U32 mHeaderBucket;
+		bool mHasHeader;
+		std::vector<Block> mBlocks;
+	};
+	typedef std::map<LLUUID, Entry> entry_map_t;
+
+	static U32 getCurrentBucket();
+	std::string getBucketFilename(U32 bucket) const;
+
+	// mMutex must be locked
+	void appendRecord(const IndexRecord& record);
+	void writeIndex();
+	void clearCacheInMemory();
+	bool evictBuckets(S64 bytes, U32 keep_bucket);
+
+	LLMutex mMutex;
+	bool mInitialized;
+	bool mReadOnly;
+	std::string mCacheDirName;
+	std::string mIndexFileName;
+	entry_map_t mEntries;
+	std::map<U32, S64> mBucketSizes; // bytes per bucket file
+	S64 mTotalSize; // of all the buckets
+	S64 mMaxSize;
+	U32 mIndexRecords;
+};
+
+#endif // LL_LLMESHCACHE_H
@@ -50,7 +50,6 @@
 #include "llsdutil_math.h"
 #include "llsdserialize.h"
 #include "llthread.h"
-#include "llvfile.h"
 #include "llviewercontrol.h"
 #include "llviewerinventory.h"
 #include "llviewermenufile.h"
@@ -72,6 +71,7 @@
 #include "netdb.h"
 #endif
 
+#include <algorithm>
 #include <queue>
 
 LLMeshRepository gMeshRepo;
@@ -95,6 +95,9 @@ U32 LLMeshRepository::sLODPending = 0;
 U32 LLMeshRepository::sCacheBytesRead = 0;
 U32 LLMeshRepository::sCacheBytesWritten = 0;
 U32 LLMeshRepository::sPeakKbps = 0;
+F32 LLMeshRepository::sLODQueueLatency = 0.f;
+F32 LLMeshRepository::sDecodeQueueLatency = 0.f;
+LLMutex* LLMeshRepository::sQueueLatencyMutex = NULL;
 	
 
 const U32 MAX_TEXTURE_UPLOAD_RETRIES = 5;
@@ -108,14 +111,6 @@ std::string make_dump_name(std::string prefix, S32 num)
 void dump_llsd_to_file(const LLSD& content, std::string filename);
 LLSD llsd_from_file(std::string filename);
 
-std::string header_lod[] = 
-{
-	"lowest_lod",
-	"low_lod",
-	"medium_lod",
-	"high_lod"
-};
-
 
 //get the number of bytes resident in memory for given volume
 U32 get_volume_memory_size(const LLVolume* volume)
@@ -228,11 +223,12 @@ class LLMeshLODResponder : public LLCurl::Responder
 public:
 	LLVolumeParams mMeshParams;
 	S32 mLOD;
+	F32 mScore;
 	U32 mRequestedBytes;
 	U32 mOffset;
 
-	LLMeshLODResponder(const LLVolumeParams& mesh_params, S32 lod, U32 offset, U32 requested_bytes)
-		: mMeshParams(mesh_params), mLOD(lod), mOffset(offset), mRequestedBytes(requested_bytes)
+	LLMeshLODResponder(const LLVolumeParams& mesh_params, S32 lod, F32 score, U32 offset, U32 requested_bytes)
+		: mMeshParams(mesh_params), mLOD(lod), mScore(score), mOffset(offset), mRequestedBytes(requested_bytes)
 	{
 		LLMeshRepoThread::sActiveLODRequests++;
 	}
@@ -512,16 +508,25 @@ void LLMeshRepoThread::run()
 
 			// NOTE: throttling intentionally favors LOD requests over header requests
 			
+			// NOTE: both queues are heaps ordered by score, see LLMeshRepository::updateRequests
+			
 			while (!mLODReqQ.empty() && count < MAX_MESH_REQUESTS_PER_SECOND && sActiveLODRequests < (S32)sMaxConcurrentRequests)
 			{
 				if (mMutex)
 				{
 					mMutex->lock();
-					LODRequest req = mLODReqQ.front();
-					mLODReqQ.pop();
+					if (mLODReqQ.empty())
+					{
+						mMutex->unlock();
+						break;
+					}
+					std::pop_heap(mLODReqQ.begin(), mLODReqQ.end(), CompareScoreLess());
+					LODRequest req = mLODReqQ.back();
+					mLODReqQ.pop_back();
 					LLMeshRepository::sLODProcessing--;
 					mMutex->unlock();
-					if (fetchMeshLOD(req.mMeshParams, req.mLOD))
+					LLMeshRepository::updateQueueLatency(LLMeshRepository::sLODQueueLatency, req.mQueueTime);
+					if (fetchMeshLOD(req))
 					{
 						count++;
 					}
@@ -533,8 +538,14 @@ void LLMeshRepoThread::run()
 				if (mMutex)
 				{
 					mMutex->lock();
-					HeaderRequest req = mHeaderReqQ.front();
-					mHeaderReqQ.pop();
+					if (mHeaderReqQ.empty())
+					{
+						mMutex->unlock();
+						break;
+					}
+					std::pop_heap(mHeaderReqQ.begin(), mHeaderReqQ.end(), CompareScoreLess());
+					HeaderRequest req = mHeaderReqQ.back();
+					mHeaderReqQ.pop_back();
 					mMutex->unlock();
 					if (fetchMeshHeader(req.mMeshParams))
 					{
@@ -619,35 +630,45 @@ void LLMeshRepoThread::loadMeshPhysicsShape(const LLUUID& mesh_id)
 }
 
 
-void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+void LLMeshRepoThread::pushHeaderRequest(const HeaderRequest& req)
+{ //mMutex must be locked
+	mHeaderReqQ.push_back(req);
+	std::push_heap(mHeaderReqQ.begin(), mHeaderReqQ.end(), CompareScoreLess());
+}
+
+void LLMeshRepoThread::pushLODRequest(const LODRequest& req)
+{ //mMutex must be locked
+	mLODReqQ.push_back(req);
+	std::push_heap(mLODReqQ.begin(), mLODReqQ.end(), CompareScoreLess());
+}
+
+void LLMeshRepoThread::loadMeshLOD(const LODRequest& req)
 { //protected by mSignal, no locking needed here
+	const LLVolumeParams& mesh_params = req.mMeshParams;
 
 	mesh_header_map::iterator iter = mMeshHeader.find(mesh_params.getSculptID());
 	if (iter != mMeshHeader.end())
 	{ //if we have the header, request LOD byte range
-		LODRequest req(mesh_params, lod);
-		{
-			LLMutexLock lock(mMutex);
-			mLODReqQ.push(req);
-			LLMeshRepository::sLODProcessing++;
-		}
+		LLMutexLock lock(mMutex);
+		pushLODRequest(req);
+		LLMeshRepository::sLODProcessing++;
 	}
 	else
 	{ 
-		HeaderRequest req(mesh_params);
+		HeaderRequest header_req(mesh_params, req.mScore);
 		
 		pending_lod_map::iterator pending = mPendingLOD.find(mesh_params);
 
 		if (pending != mPendingLOD.end())
 		{	//append this lod request to existing header request
-			pending->second.push_back(lod);
+			pending->second.push_back(req.mLOD);
 			llassert(pending->second.size() <= LLModel::NUM_LODS)
 		}
 		else
 		{	//if no header request is pending, fetch header
 			LLMutexLock lock(mMutex);
-			mHeaderReqQ.push(req);
-			mPendingLOD[mesh_params].push_back(lod);
+			pushHeaderRequest(header_req);
+			mPendingLOD[mesh_params].push_back(req.mLOD);
 		}
 	}
 }
@@ -685,53 +706,39 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 
 	mHeaderMutex->lock();
 
-	if (mMeshHeader.find(mesh_id) == mMeshHeader.end())
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+	if (iter == mMeshHeader.end())
 	{	//we have no header info for this mesh, do nothing
 		mHeaderMutex->unlock();
 		return false;
 	}
 
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	const LLMeshHeader& header = iter->second;
 
-	if (header_size > 0)
+	if (header.mHeaderSize > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id]["skin"]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id]["skin"]["size"].asInteger();
+		S32 version = header.mVersion;
+		S32 offset = header.getBlockOffset(LLMeshHeader::SKIN);
+		S32 size = header.mSize[LLMeshHeader::SKIN];
 
 		mHeaderMutex->unlock();
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh skin info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			//check the mesh cache
+			U8* buffer = new U8[size];
+			if (LLMeshCache::getInstance()->readBlock(mesh_id, offset, size, buffer))
 			{
 				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
+				if (skinInfoReceived(mesh_id, buffer, size))
 				{
-					zero = buffer[i] > 0 ? false : true;
-				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (skinInfoReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+					delete[] buffer;
+					return true;
 				}
-
-				delete[] buffer;
 			}
+			delete[] buffer;
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//not cached or corrupt, fetch from sim
 			std::vector<std::string> headers;
 			headers.push_back("Accept: application/octet-stream");
 
@@ -762,53 +769,39 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 
 	mHeaderMutex->lock();
 
-	if (mMeshHeader.find(mesh_id) == mMeshHeader.end())
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+	if (iter == mMeshHeader.end())
 	{	//we have no header info for this mesh, do nothing
 		mHeaderMutex->unlock();
 		return false;
 	}
 
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	const LLMeshHeader& header = iter->second;
 
-	if (header_size > 0)
+	if (header.mHeaderSize > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id]["physics_convex"]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id]["physics_convex"]["size"].asInteger();
+		S32 version = header.mVersion;
+		S32 offset = header.getBlockOffset(LLMeshHeader::PHYSICS_CONVEX);
+		S32 size = header.mSize[LLMeshHeader::PHYSICS_CONVEX];
 
 		mHeaderMutex->unlock();
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh skin info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			//check the mesh cache
+			U8* buffer = new U8[size];
+			if (LLMeshCache::getInstance()->readBlock(mesh_id, offset, size, buffer))
 			{
 				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
+				if (decompositionReceived(mesh_id, buffer, size))
 				{
-					zero = buffer[i] > 0 ? false : true;
-				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (decompositionReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+					delete[] buffer;
+					return true;
 				}
-
-				delete[] buffer;
 			}
+			delete[] buffer;
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//not cached or corrupt, fetch from sim
 			std::vector<std::string> headers;
 			headers.push_back("Accept: application/octet-stream");
 
@@ -839,53 +832,39 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 
 	mHeaderMutex->lock();
 
-	if (mMeshHeader.find(mesh_id) == mMeshHeader.end())
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+	if (iter == mMeshHeader.end())
 	{	//we have no header info for this mesh, do nothing
 		mHeaderMutex->unlock();
 		return false;
 	}
 
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	const LLMeshHeader& header = iter->second;
 
-	if (header_size > 0)
+	if (header.mHeaderSize > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id]["physics_mesh"]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id]["physics_mesh"]["size"].asInteger();
+		S32 version = header.mVersion;
+		S32 offset = header.getBlockOffset(LLMeshHeader::PHYSICS_MESH);
+		S32 size = header.mSize[LLMeshHeader::PHYSICS_MESH];
 
 		mHeaderMutex->unlock();
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh physics shape info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			//check the mesh cache
+			U8* buffer = new U8[size];
+			if (LLMeshCache::getInstance()->readBlock(mesh_id, offset, size, buffer))
 			{
 				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
+				if (physicsShapeReceived(mesh_id, buffer, size))
 				{
-					zero = buffer[i] > 0 ? false : true;
+					delete[] buffer;
+					return true;
 				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (physicsShapeReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
-				}
-
-				delete[] buffer;
 			}
+			delete[] buffer;
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//not cached or corrupt, fetch from sim
 			std::vector<std::string> headers;
 			headers.push_back("Accept: application/octet-stream");
 
@@ -915,26 +894,16 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params)
 {
 	bool retval = false;
 
-	{
-		//look for mesh in asset in vfs
-		LLVFile file(gVFS, mesh_params.getSculptID(), LLAssetType::AT_MESH);
-			
-		S32 size = file.getSize();
-
-		if (size > 0)
-		{ //NOTE -- if the header size is ever more than 4KB, this will break
-			U8 buffer[4096];
-			S32 bytes = llmin(size, 4096);
-			LLMeshRepository::sCacheBytesRead += bytes;	
-			file.read(buffer, bytes);
-			if (headerReceived(mesh_params, buffer, bytes))
-			{	//did not do an HTTP request, return false
-				return false;
-			}
+	{	//headers in the mesh cache are already decoded, no parsing needed
+		LLMeshHeader header;
+		if (LLMeshCache::getInstance()->getHeader(mesh_params.getSculptID(), header))
+		{	//did not do an HTTP request, return false
+			headerLoaded(mesh_params, header);
+			return false;
 		}
 	}
 
-	//either cache entry doesn't exist or is corrupt, request header from simulator
+	//cache entry doesn't exist, request header from simulator
 
 	std::vector<std::string> headers;
 	headers.push_back("Accept: application/octet-stream");
@@ -952,60 +921,47 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params)
 	return retval;
 }
 
-bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+bool LLMeshRepoThread::fetchMeshLOD(const LODRequest& req)
 {	//protected by mMutex
 	if (!mHeaderMutex)
 	{
 		return false;
 	}
 
+	const LLVolumeParams& mesh_params = req.mMeshParams;
+	S32 lod = req.mLOD;
+
 	mHeaderMutex->lock();
 
 	bool retval = false;
 
 	LLUUID mesh_id = mesh_params.getSculptID();
 	
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
 
-	if (header_size > 0)
+	if (iter != mMeshHeader.end() && iter->second.mHeaderSize > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id][header_lod[lod]]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id][header_lod[lod]]["size"].asInteger();
+		S32 version = iter->second.mVersion;
+		S32 offset = iter->second.getBlockOffset(lod);
+		S32 size = iter->second.mSize[lod];
 		mHeaderMutex->unlock();
 				
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-
-			//check VFS for mesh asset
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			//check the mesh cache
+			if (!req.mSkipCache)
 			{
-				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
 				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
-				{
-					zero = buffer[i] > 0 ? false : true;
-				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (lodReceived(mesh_params, lod, buffer, size))
-					{
-						delete[] buffer;
-						return false;
-					}
+				if (LLMeshCache::getInstance()->readBlock(mesh_id, offset, size, buffer))
+				{	//hand off to a decode worker, it falls back to the sim if parsing fails
+					LLMeshRepository::sCacheBytesRead += size;
+					queueDecode(req, buffer, size, offset, 0);
+					return false;
 				}
-
 				delete[] buffer;
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//not cached, fetch from sim
 			std::vector<std::string> headers;
 			headers.push_back("Accept: application/octet-stream");
 
@@ -1015,7 +971,7 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 				retval = true;
 				LLMeshRepository::sHTTPRequestCount++;
 				mCurlRequest->getByteRange(constructUrl(mesh_id), headers, offset, size,
-										   new LLMeshLODResponder(mesh_params, lod, offset, size));
+										   new LLMeshLODResponder(mesh_params, lod, req.mScore, offset, size));
 			}
 			else
 			{
@@ -1070,31 +1026,33 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 		header["404"] = 1;
 	}
 
+	LLMeshHeader mesh_header;
+	mesh_header.fromLLSD(header, header_size);
+	headerLoaded(mesh_params, mesh_header);
+
+	return true;
+}
+
+void LLMeshRepoThread::headerLoaded(const LLVolumeParams& mesh_params, const LLMeshHeader& header)
+{
 	{
-		LLUUID mesh_id = mesh_params.getSculptID();
-		
-		{
-			LLMutexLock lock(mHeaderMutex);
-			mMeshHeaderSize[mesh_id] = header_size;
-			mMeshHeader[mesh_id] = header;
-			}
+		LLMutexLock lock(mHeaderMutex);
+		mMeshHeader[mesh_params.getSculptID()] = header;
+	}
 
-		//check for pending requests
-		pending_lod_map::iterator iter = mPendingLOD.find(mesh_params);
-		if (iter != mPendingLOD.end())
-		{
-			LLMutexLock lock(mMutex);
-			for (U32 i = 0; i < iter->second.size(); ++i)
-			{
-				LODRequest req(mesh_params, iter->second[i]);
-				mLODReqQ.push(req);
-				LLMeshRepository::sLODProcessing++;
-			}
+	//check for pending requests
+	pending_lod_map::iterator iter = mPendingLOD.find(mesh_params);
+	if (iter != mPendingLOD.end())
+	{
+		LLMutexLock lock(mMutex);
+		for (U32 i = 0; i < iter->second.size(); ++i)
+		{	//scored on the next LLMeshRepository::updateRequests
+			LODRequest req(mesh_params, iter->second[i]);
+			pushLODRequest(req);
+			LLMeshRepository::sLODProcessing++;
 		}
 		mPendingLOD.erase(iter);
 	}
-
-	return true;
 }
 
 bool LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
@@ -1107,6 +1065,12 @@ bool LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U
 	{
 		if (volume->getNumFaces() > 0)
 		{
+			if (lod == LLModel::LOD_HIGH)
+			{ //build the pick BVH here rather than on the first hover, only for
+			  //the LOD objects close enough to be picked are likely to use
+				volume->createBVHs();
+			}
+
 			LoadedMesh mesh(volume, mesh_params, lod);
 			{
 				LLMutexLock lock(mMutex);
@@ -1119,6 +1083,97 @@ bool LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U
 	return false;
 }
 
+void LLMeshRepoThread::queueDecode(const LODRequest& req, U8* data, S32 data_size, S32 cache_offset, S32 cache_size)
+{
+	LLMeshDecodeThread* thread = NULL;
+	S32 pending = 0;
+	for (U32 i = 0; i < mDecodeThreads.size(); ++i)
+	{
+		S32 cur_pending = mDecodeThreads[i]->getPending();
+		if (!thread || cur_pending < pending)
+		{
+			thread = mDecodeThreads[i];
+			pending = cur_pending;
+		}
+	}
+
+	if (!thread)
+	{
+		decodeLOD(req, data, data_size, cache_offset, cache_size);
+		delete[] data;
+	}
+	else if (!thread->decodeLOD(req, data, data_size, cache_offset, cache_size))
+	{	//shutting down
+		delete[] data;
+	}
+}
+
+void LLMeshRepoThread::decodeLOD(const LODRequest& req, U8* data, S32 data_size, S32 cache_offset, S32 cache_size)
+{	//called from a decode worker
+	if (lodReceived(req.mMeshParams, req.mLOD, data, data_size))
+	{
+		if (cache_size > 0)
+		{	//good fetch from sim, write to the mesh cache
+			LLMeshCache::getInstance()->writeBlock(req.mMeshParams.getSculptID(), cache_offset, cache_size, data);
+			LLMeshRepository::sCacheBytesWritten += cache_size;
+		}
+	}
+	else if (cache_size == 0)
+	{	//cached copy didn't parse, fetch it from the sim instead
+		LODRequest retry(req.mMeshParams, req.mLOD);
+		retry.mScore = req.mScore;
+		retry.mSkipCache = true;
+
+		LLMutexLock lock(mMutex);
+		pushLODRequest(retry);
+		LLMeshRepository::sLODProcessing++;
+	}
+}
+
+LLMeshDecodeThread::LLMeshDecodeThread()
+: LLQueuedThread("mesh decode")
+{
+}
+
+bool LLMeshDecodeThread::decodeLOD(const LLMeshRepoThread::LODRequest& req, U8* data, S32 data_size, S32 cache_offset, S32 cache_size)
+{
+	DecodeRequest* decode = new DecodeRequest(generateHandle(), req, data, data_size, cache_offset, cache_size);
+	if (!addRequest(decode))
+	{
+		decode->mData = NULL; //caller keeps ownership
+		decode->deleteRequest();
+		return false;
+	}
+	return true;
+}
+
+LLMeshDecodeThread::DecodeRequest::DecodeRequest(handle_t handle, const LLMeshRepoThread::LODRequest& req,
+												 U8* data, S32 data_size, S32 cache_offset, S32 cache_size)
+	: LLQueuedThread::QueuedRequest(handle,
+		//screen area maps into the low priority bits, bigger decodes first
+		LLQueuedThread::PRIORITY_NORMAL | (U32)llclamp(req.mScore * 100000.f, 0.f, (F32)LLQueuedThread::PRIORITY_LOWBITS),
+		FLAG_AUTO_COMPLETE),
+	  mRequest(req),
+	  mData(data),
+	  mDataSize(data_size),
+	  mCacheOffset(cache_offset),
+	  mCacheSize(cache_size),
+	  mQueueTime(LLTimer::getTotalSeconds())
+{
+}
+
+LLMeshDecodeThread::DecodeRequest::~DecodeRequest()
+{
+	delete[] mData;
+}
+
+bool LLMeshDecodeThread::DecodeRequest::processRequest()
+{
+	LLMeshRepository::updateQueueLatency(LLMeshRepository::sDecodeQueueLatency, mQueueTime);
+	gMeshRepo.mThread->decodeLOD(mRequest, mData, mDataSize, mCacheOffset, mCacheSize);
+	return true;
+}
+
 bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size)
 {
 	LLSD skin;
@@ -1693,27 +1748,23 @@ S32 LLMeshRepoThread::getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lo
 
 	if (iter != mMeshHeader.end())
 	{
-		LLSD& header = iter->second;
-
-		return LLMeshRepository::getActualMeshLOD(header, lod);
+		return LLMeshRepository::getActualMeshLOD(iter->second, lod);
 	}
 
 	return lod;
 }
 
 //static
-S32 LLMeshRepository::getActualMeshLOD(LLSD& header, S32 lod)
+S32 LLMeshRepository::getActualMeshLOD(LLMeshHeader& header, S32 lod)
 {
 	lod = llclamp(lod, 0, 3);
 
-	S32 version = header["version"];
-
-	if (header.has("404") || version > MAX_MESH_VERSION)
+	if (header.m404 || header.mVersion > MAX_MESH_VERSION)
 	{
 		return -1;
 	}
 
-	if (header[header_lod[lod]]["size"].asInteger() > 0)
+	if (header.mSize[lod] > 0)
 	{
 		return lod;
 	}
@@ -1721,7 +1772,7 @@ S32 LLMeshRepository::getActualMeshLOD(LLSD& header, S32 lod)
 	//search down to find the next available lower lod
 	for (S32 i = lod-1; i >= 0; --i)
 	{
-		if (header[header_lod[i]]["size"].asInteger() > 0)
+		if (header.mSize[i] > 0)
 		{
 			return i;
 		}
@@ -1730,21 +1781,21 @@ S32 LLMeshRepository::getActualMeshLOD(LLSD& header, S32 lod)
 	//search up to find then ext available higher lod
 	for (S32 i = lod+1; i < 4; ++i)
 	{
-		if (header[header_lod[i]]["size"].asInteger() > 0)
+		if (header.mSize[i] > 0)
 		{
 			return i;
 		}
 	}
 
 	//header exists and no good lod found, treat as 404
-	header["404"] = 1;
+	header.m404 = 1;
 	return -1;
 }
 
 #if MESH_IMPORT
 void LLMeshRepository::cacheOutgoingMesh(LLMeshUploadData& data, LLSD& header)
 {
-	mThread->mMeshHeader[data.mUUID] = header;
+	mThread->mMeshHeader[data.mUUID].fromLLSD(header, 0);
 
 	// we cache the mesh for default parameters
 	LLVolumeParams volume_params;
@@ -1781,7 +1832,9 @@ void LLMeshLODResponder::completedRaw(U32 status, const std::string& reason,
 		if (status == 499 || status == 503)
 		{	//timeout or service unavailable, try again
 			LLMeshRepository::sHTTPRetryCount++;
-			gMeshRepo.mThread->loadMeshLOD(mMeshParams, mLOD);
+			LLMeshRepoThread::LODRequest req(mMeshParams, mLOD);
+			req.mScore = mScore;
+			gMeshRepo.mThread->loadMeshLOD(req);
 		}
 		else
 		{
@@ -1800,23 +1853,12 @@ void LLMeshLODResponder::completedRaw(U32 status, const std::string& reason,
 		buffer->readAfter(channels.in(), NULL, data, data_size);
 	}
 
-	if (gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size))
-	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			file.seek(offset);
-			file.write(data, size);
-			LLMeshRepository::sCacheBytesWritten += size;
-		}
+	if (data)
+	{	//decode worker writes the data to the VFS once it parses
+		LLMeshRepoThread::LODRequest req(mMeshParams, mLOD);
+		req.mScore = mScore;
+		gMeshRepo.mThread->queueDecode(req, data, data_size, mOffset, mRequestedBytes);
 	}
-
-	delete [] data;
 }
 
 void LLMeshSkinInfoResponder::completedRaw(U32 status, const std::string& reason,
@@ -1856,18 +1898,9 @@ void LLMeshSkinInfoResponder::completedRaw(U32 status, const std::string& reason
 
 	if (gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size))
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		//good fetch from sim, write to the mesh cache
+		LLMeshCache::getInstance()->writeBlock(mMeshID, mOffset, mRequestedBytes, data);
+		LLMeshRepository::sCacheBytesWritten += mRequestedBytes;
 	}
 
 	delete [] data;
@@ -1910,18 +1943,9 @@ void LLMeshDecompositionResponder::completedRaw(U32 status, const std::string& r
 
 	if (gMeshRepo.mThread->decompositionReceived(mMeshID, data, data_size))
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		//good fetch from sim, write to the mesh cache
+		LLMeshCache::getInstance()->writeBlock(mMeshID, mOffset, mRequestedBytes, data);
+		LLMeshRepository::sCacheBytesWritten += mRequestedBytes;
 	}
 
 	delete [] data;
@@ -1964,18 +1988,9 @@ void LLMeshPhysicsShapeResponder::completedRaw(U32 status, const std::string& re
 
 	if (gMeshRepo.mThread->physicsShapeReceived(mMeshID, data, data_size))
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		//good fetch from sim, write to the mesh cache
+		LLMeshCache::getInstance()->writeBlock(mMeshID, mOffset, mRequestedBytes, data);
+		LLMeshRepository::sCacheBytesWritten += mRequestedBytes;
 	}
 
 	delete [] data;
@@ -2002,7 +2017,7 @@ void LLMeshHeaderResponder::completedRaw(U32 status, const std::string& reason,
 			LLMeshRepository::sHTTPRetryCount++;
 			LLMeshRepoThread::HeaderRequest req(mMeshParams);
 			LLMutexLock lock(gMeshRepo.mThread->mMutex);
-			gMeshRepo.mThread->mHeaderReqQ.push(req);
+			gMeshRepo.mThread->pushHeaderRequest(req);
 
 			return;
 		}
@@ -2028,58 +2043,23 @@ void LLMeshHeaderResponder::completedRaw(U32 status, const std::string& reason,
 	}
 	else if (data && data_size > 0)
 	{
-		//header was successfully retrieved from sim, cache in vfs
+		//header was successfully retrieved from sim, cache it along with any blocks that came with it
 		LLUUID mesh_id = mMeshParams.getSculptID();
-		LLSD header = gMeshRepo.mThread->mMeshHeader[mesh_id];
-
-		S32 version = header["version"].asInteger();
-
-		if (version <= MAX_MESH_VERSION)
+		LLMeshHeader header;
 		{
-			std::stringstream str;
-
-			S32 lod_bytes = 0;
-
-			for (U32 i = 0; i < LLModel::LOD_PHYSICS; ++i)
-			{ //figure out how many bytes we'll need to reserve in the file
-				std::string lod_name = header_lod[i];
-				lod_bytes = llmax(lod_bytes, header[lod_name]["offset"].asInteger()+header[lod_name]["size"].asInteger());
-			}
-		
-			//just in case skin info or decomposition is at the end of the file (which it shouldn't be)
-			lod_bytes = llmax(lod_bytes, header["skin"]["offset"].asInteger() + header["skin"]["size"].asInteger());
-			lod_bytes = llmax(lod_bytes, header["physics_convex"]["offset"].asInteger() + header["physics_convex"]["size"].asInteger());
-
-			S32 header_bytes = (S32) gMeshRepo.mThread->mMeshHeaderSize[mesh_id];
-			S32 bytes = lod_bytes + header_bytes; 
+			LLMutexLock lock(gMeshRepo.mThread->mHeaderMutex);
+			header = gMeshRepo.mThread->mMeshHeader[mesh_id];
+		}
 
-		
-			//it's possible for the remote asset to have more data than is needed for the local cache
-			//only allocate as much space in the VFS as is needed for the local cache
-			data_size = llmin(data_size, bytes);
+		if (header.mVersion <= MAX_MESH_VERSION)
+		{
+			LLMeshCache::getInstance()->putHeader(mesh_id, header);
 
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH, LLVFile::WRITE);
-			if (file.getMaxSize() >= bytes || file.setMaxSize(bytes))
+			S32 block_bytes = data_size - header.mHeaderSize;
+			if (header.mHeaderSize > 0 && block_bytes > 0)
 			{
-				LLMeshRepository::sCacheBytesWritten += data_size;
-
-				file.write((const U8*) data, data_size);
-			
-				//zero out the rest of the file 
-				U8 block[4096];
-				memset(block, 0, 4096);
-
-				while (bytes-file.tell() > 4096)
-				{
-					file.write(block, 4096);
-				}
-
-				S32 remaining = bytes-file.tell();
-
-				if (remaining > 0)
-				{
-					file.write(block, remaining);
-				}
+				LLMeshCache::getInstance()->writeBlock(mesh_id, header.mHeaderSize, block_bytes, data + header.mHeaderSize);
+				LLMeshRepository::sCacheBytesWritten += block_bytes;
 			}
 		}
 	}
@@ -2099,6 +2079,7 @@ LLMeshRepository::LLMeshRepository()
 void LLMeshRepository::init()
 {
 	mMeshMutex = new LLMutex();
+	sQueueLatencyMutex = new LLMutex();
 	
 #if MESH_IMPORT
 	LLConvexDecomposition::getInstance()->initSystem();
@@ -2115,6 +2096,13 @@ void LLMeshRepository::init()
 	
 	
 	mThread = new LLMeshRepoThread();
+
+	U32 decode_threads = llclamp(gSavedSettings.getU32("MeshDecodeThreads"), (U32)1, (U32)8);
+	for (U32 i = 0; i < decode_threads; ++i)
+	{
+		mThread->mDecodeThreads.push_back(new LLMeshDecodeThread());
+	}
+
 	mThread->start();
 }
 
@@ -2136,6 +2124,15 @@ void LLMeshRepository::shutdown()
 	{
 		apr_sleep(10);
 	}
+
+	//decode workers report back through mThread, stop them before it goes away
+	for (U32 i = 0; i < mThread->mDecodeThreads.size(); ++i)
+	{
+		mThread->mDecodeThreads[i]->shutdown();
+		delete mThread->mDecodeThreads[i];
+	}
+	mThread->mDecodeThreads.clear();
+
 	delete mThread;
 	mThread = NULL;
 
@@ -2156,6 +2153,10 @@ void LLMeshRepository::shutdown()
 	delete mMeshMutex;
 	mMeshMutex = NULL;
 
+	//the mesh and decode threads are gone by now
+	delete sQueueLatencyMutex;
+	sQueueLatencyMutex = NULL;
+
 	llinfos << "Shutting down decomposition system." << llendl;
 
 	if (mDecompThread)
@@ -2212,6 +2213,7 @@ S32 LLMeshRepository::loadMesh(LLVOVolume* vobj, const LLVolumeParams& mesh_para
 			//first request for this mesh
 			mLoadingMeshes[detail][mesh_params].insert(vobj->getID());
 			mPendingRequests.push_back(LLMeshRepoThread::LODRequest(mesh_params, detail));
+			LLMeshRepository::sLODPending++;
 		}
 	}
 
@@ -2382,52 +2384,19 @@ void LLMeshRepository::notifyLoadedMeshes()
 			mUploadErrorQ.pop();
 		}
 
+		updateRequests();
+
 		S32 push_count = LLMeshRepoThread::sMaxConcurrentRequests-(LLMeshRepoThread::sActiveHeaderRequests+LLMeshRepoThread::sActiveLODRequests);
 
 		if (push_count > 0)
 		{
-			//calculate "score" for pending requests
-
-			//create score map
-			std::map<LLUUID, F32> score_map;
-
-			for (U32 i = 0; i < 4; ++i)
-			{
-				for (mesh_load_map::iterator iter = mLoadingMeshes[i].begin();  iter != mLoadingMeshes[i].end(); ++iter)
-				{
-					F32 max_score = 0.f;
-					for (std::set<LLUUID>::iterator obj_iter = iter->second.begin(); obj_iter != iter->second.end(); ++obj_iter)
-					{
-						LLViewerObject* object = gObjectList.findObject(*obj_iter);
-
-						if (object)
-						{
-							LLDrawable* drawable = object->mDrawable;
-							if (drawable)
-							{
-								F32 cur_score = drawable->getRadius()/llmax(drawable->mDistanceWRTCamera, 1.f);
-								max_score = llmax(max_score, cur_score);
-							}
-						}
-					}
-				
-					score_map[iter->first.getSculptID()] = max_score;
-				}
-			}
-
-			//set "score" for pending requests
-			for (std::vector<LLMeshRepoThread::LODRequest>::iterator iter = mPendingRequests.begin(); iter != mPendingRequests.end(); ++iter)
-			{
-				iter->mScore = score_map[iter->mMeshParams.getSculptID()];
-			}
-
 			//sort by "score"
 			std::sort(mPendingRequests.begin(), mPendingRequests.end(), LLMeshRepoThread::CompareScoreGreater());
 
 			while (!mPendingRequests.empty() && push_count > 0)
 			{
 				LLMeshRepoThread::LODRequest& request = mPendingRequests.front();
-				mThread->loadMeshLOD(request.mMeshParams, request.mLOD);
+				mThread->loadMeshLOD(request);
 				mPendingRequests.erase(mPendingRequests.begin());
 				LLMeshRepository::sLODPending--;
 				push_count--;
@@ -2497,6 +2466,124 @@ void LLMeshRepository::notifyDecompositionReceived(LLModel::Decomposition* decom
 	mLoadingDecompositions.erase(decomp->mMeshID);
 }
 
+void LLMeshRepository::updateRequests()
+{	//called from main thread, mMeshMutex and mThread->mMutex locked
+	//score is the projected screen area of the biggest object still waiting on a mesh
+	std::map<LLUUID, F32> score_map;
+
+	for (S32 i = 0; i < 4; ++i)
+	{
+		for (mesh_load_map::iterator iter = mLoadingMeshes[i].begin(); iter != mLoadingMeshes[i].end(); )
+		{
+			const LLVolumeParams& mesh_params = iter->first;
+			S32 actual_lod[4] = { -2, -2, -2, -2 };
+			F32 max_score = 0.f;
+
+			for (std::set<LLUUID>::iterator obj_iter = iter->second.begin(); obj_iter != iter->second.end(); )
+			{
+				LLViewerObject* objectp = gObjectList.findObject(*obj_iter);
+				LLVOVolume* vobj = objectp && objectp->getPCode() == LL_PCODE_VOLUME ? (LLVOVolume*) objectp : NULL;
+				LLVolume* obj_volume = vobj && !vobj->isDead() ? vobj->getVolume() : NULL;
+
+				bool wanted = obj_volume && obj_volume->getParams().getSculptID() == mesh_params.getSculptID();
+				if (wanted && i != LLModel::LOD_HIGH)
+				{	//object may have switched LOD since it asked for this one (LOD_HIGH is also used for costs)
+					S32 obj_lod = llclamp(vobj->getLOD(), 0, 3);
+					if (actual_lod[obj_lod] == -2)
+					{
+						actual_lod[obj_lod] = getActualMeshLOD(mesh_params, obj_lod);
+					}
+					wanted = actual_lod[obj_lod] == i;
+				}
+
+				if (!wanted)
+				{
+					iter->second.erase(obj_iter++);
+					continue;
+				}
+
+				LLDrawable* drawable = vobj->mDrawable;
+				if (drawable)
+				{
+					F32 cur_score = drawable->getRadius()/llmax(drawable->mDistanceWRTCamera, 1.f);
+					max_score = llmax(max_score, cur_score*cur_score);
+				}
+				++obj_iter;
+			}
+
+			if (iter->second.empty())
+			{	//nobody is waiting for this LOD anymore, queued requests for it are dropped below
+				mLoadingMeshes[i].erase(iter++);
+			}
+			else
+			{
+				F32& score = score_map[mesh_params.getSculptID()];
+				score = llmax(score, max_score);
+				++iter;
+			}
+		}
+	}
+
+	//rescore requests not yet handed to the mesh thread, dropping cancelled ones
+	U32 count = 0;
+	for (U32 i = 0; i < mPendingRequests.size(); ++i)
+	{
+		LLMeshRepoThread::LODRequest& req = mPendingRequests[i];
+		if (mLoadingMeshes[req.mLOD].find(req.mMeshParams) == mLoadingMeshes[req.mLOD].end())
+		{
+			LLMeshRepository::sLODPending--;
+			continue;
+		}
+		std::map<LLUUID, F32>::iterator score = score_map.find(req.mMeshParams.getSculptID());
+		req.mScore = score != score_map.end() ? score->second : 0.f;
+		if (count != i)
+		{
+			mPendingRequests[count] = req;
+		}
+		++count;
+	}
+	mPendingRequests.erase(mPendingRequests.begin() + count, mPendingRequests.end());
+
+	//same for the mesh thread's LOD heap
+	std::vector<LLMeshRepoThread::LODRequest>& lod_queue = mThread->mLODReqQ;
+	count = 0;
+	for (U32 i = 0; i < lod_queue.size(); ++i)
+	{
+		LLMeshRepoThread::LODRequest& req = lod_queue[i];
+		if (mLoadingMeshes[req.mLOD].find(req.mMeshParams) == mLoadingMeshes[req.mLOD].end())
+		{
+			LLMeshRepository::sLODProcessing--;
+			continue;
+		}
+		std::map<LLUUID, F32>::iterator score = score_map.find(req.mMeshParams.getSculptID());
+		req.mScore = score != score_map.end() ? score->second : 0.f;
+		if (count != i)
+		{
+			lod_queue[count] = req;
+		}
+		++count;
+	}
+	lod_queue.erase(lod_queue.begin() + count, lod_queue.end());
+	std::make_heap(lod_queue.begin(), lod_queue.end(), LLMeshRepoThread::CompareScoreLess());
+
+	//headers are still wanted for skin info and physics, just reorder them
+	std::vector<LLMeshRepoThread::HeaderRequest>& header_queue = mThread->mHeaderReqQ;
+	for (U32 i = 0; i < header_queue.size(); ++i)
+	{
+		std::map<LLUUID, F32>::iterator score = score_map.find(header_queue[i].mMeshParams.getSculptID());
+		header_queue[i].mScore = score != score_map.end() ? score->second : 0.f;
+	}
+	std::make_heap(header_queue.begin(), header_queue.end(), LLMeshRepoThread::CompareScoreLess());
+}
+
+//static
+void LLMeshRepository::updateQueueLatency(F32& average, F64 queue_time)
+{
+	F32 latency = (F32)((LLTimer::getTotalSeconds() - queue_time) * 1000.0);
+	LLMutexLock lock(sQueueLatencyMutex);
+	average += (latency - average) * 0.05f;
+}
+
 void LLMeshRepository::notifyMeshLoaded(const LLVolumeParams& mesh_params, LLVolume* volume)
 {	//called from main thread
 	S32 detail = LLVolumeLODGroup::getVolumeDetailFromScale(volume->getDetail());
@@ -2674,8 +2761,8 @@ void LLMeshRepository::buildHull(const LLVolumeParams& params, S32 detail)
 
 bool LLMeshRepository::hasPhysicsShape(const LLUUID& mesh_id)
 {
-	LLSD mesh = mThread->getMeshHeader(mesh_id);
-	if (mesh.has("physics_mesh") && mesh["physics_mesh"].has("size") && (mesh["physics_mesh"]["size"].asInteger() > 0))
+	const LLMeshHeader& header = mThread->getMeshHeader(mesh_id);
+	if (header.mSize[LLMeshHeader::PHYSICS_MESH] > 0)
 	{
 		return true;
 	}
@@ -2689,14 +2776,14 @@ bool LLMeshRepository::hasPhysicsShape(const LLUUID& mesh_id)
 	return false;
 }
 
-LLSD& LLMeshRepository::getMeshHeader(const LLUUID& mesh_id)
+LLMeshHeader& LLMeshRepository::getMeshHeader(const LLUUID& mesh_id)
 {
 	return mThread->getMeshHeader(mesh_id);
 }
 
-LLSD& LLMeshRepoThread::getMeshHeader(const LLUUID& mesh_id)
+LLMeshHeader& LLMeshRepoThread::getMeshHeader(const LLUUID& mesh_id)
 {
-	static LLSD dummy_ret;
+	static LLMeshHeader dummy_ret;
 	if (mesh_id.notNull())
 	{
 		LLMutexLock lock(mHeaderMutex);
@@ -2728,15 +2815,14 @@ S32 LLMeshRepository::getMeshSize(const LLUUID& mesh_id, S32 lod)
 		LLMeshRepoThread::mesh_header_map::iterator iter = mThread->mMeshHeader.find(mesh_id);
 		if (iter != mThread->mMeshHeader.end())
 		{
-			LLSD& header = iter->second;
+			const LLMeshHeader& header = iter->second;
 
-			if (header.has("404"))
+			if (header.m404)
 			{
 				return -1;
 			}
 
-			S32 size = header[header_lod[lod]]["size"].asInteger();
-			return size;
+			return header.mSize[lod];
 		}
 
 	}
@@ -2836,6 +2922,14 @@ void LLMeshRepository::uploadError(LLSD& args)
 
 //static
 F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32* bytes_visible, S32 lod, F32 *unscaled_value)
+{
+	LLMeshHeader mesh_header;
+	mesh_header.fromLLSD(header, 0);
+	return getStreamingCost(mesh_header, radius, bytes, bytes_visible, lod, unscaled_value);
+}
+
+//static
+F32 LLMeshRepository::getStreamingCost(LLMeshHeader& header, F32 radius, S32* bytes, S32* bytes_visible, S32 lod, F32 *unscaled_value)
 {
 	F32 max_distance = 512.f;
 
@@ -2853,10 +2947,10 @@ F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32
 
 	F32 bytes_per_triangle = (F32) mesh_bytes_per_triangle.get();
 
-	S32 bytes_lowest = header["lowest_lod"]["size"].asInteger();
-	S32 bytes_low = header["low_lod"]["size"].asInteger();
-	S32 bytes_mid = header["medium_lod"]["size"].asInteger();
-	S32 bytes_high = header["high_lod"]["size"].asInteger();
+	S32 bytes_lowest = header.mSize[LLMeshHeader::LOWEST_LOD];
+	S32 bytes_low = header.mSize[LLMeshHeader::LOW_LOD];
+	S32 bytes_mid = header.mSize[LLMeshHeader::MEDIUM_LOD];
+	S32 bytes_high = header.mSize[LLMeshHeader::HIGH_LOD];
 
 	if (bytes_high == 0)
 	{
@@ -2886,10 +2980,10 @@ F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32
 	if (bytes)
 	{
 		*bytes = 0;
-		*bytes += header["lowest_lod"]["size"].asInteger();
-		*bytes += header["low_lod"]["size"].asInteger();
-		*bytes += header["medium_lod"]["size"].asInteger();
-		*bytes += header["high_lod"]["size"].asInteger();
+		*bytes += header.mSize[LLMeshHeader::LOWEST_LOD];
+		*bytes += header.mSize[LLMeshHeader::LOW_LOD];
+		*bytes += header.mSize[LLMeshHeader::MEDIUM_LOD];
+		*bytes += header.mSize[LLMeshHeader::HIGH_LOD];
 	}
 
 	if (bytes_visible)
@@ -2897,7 +2991,7 @@ F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32
 		lod = LLMeshRepository::getActualMeshLOD(header, lod);
 		if (lod >= 0 && lod <= 3)
 		{
-			*bytes_visible = header[header_lod[lod]]["size"].asInteger();
+			*bytes_visible = header.mSize[lod];
 		}
 	}
 
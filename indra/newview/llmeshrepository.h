@@ -28,7 +28,10 @@
 #define LL_MESH_REPOSITORY_H
 
 #include "llassettype.h"
+#include "llmeshcache.h"
 #include "llmodel.h"
+#include "llqueuedthread.h"
+#include "lltimer.h"
 #include "lluuid.h"
 #include "llviewertexture.h"
 #include "llvolume.h"
@@ -238,6 +241,8 @@ public:
 
 };
 
+class LLMeshDecodeThread;
+
 class LLMeshRepoThread : public LLThread
 {
 public:
@@ -253,19 +258,18 @@ public:
 
 	bool mWaiting;
 
-	//map of known mesh headers
-	typedef std::map<LLUUID, LLSD> mesh_header_map;
+	//map of known mesh headers (protected by mHeaderMutex)
+	typedef std::map<LLUUID, LLMeshHeader> mesh_header_map;
 	mesh_header_map mMeshHeader;
-	
-	std::map<LLUUID, U32> mMeshHeaderSize;
 
 	class HeaderRequest
 	{ 
 	public:
-		const LLVolumeParams mMeshParams;
+		LLVolumeParams mMeshParams;
+		F32 mScore;
 
-		HeaderRequest(const LLVolumeParams&  mesh_params)
-			: mMeshParams(mesh_params)
+		HeaderRequest(const LLVolumeParams&  mesh_params, F32 score = 0.f)
+			: mMeshParams(mesh_params), mScore(score)
 		{
 		}
 
@@ -281,9 +285,12 @@ public:
 		LLVolumeParams  mMeshParams;
 		S32 mLOD;
 		F32 mScore;
+		F64 mQueueTime;
+		bool mSkipCache; //cached copy failed to decode, go straight to the sim
 
 		LODRequest(const LLVolumeParams&  mesh_params, S32 lod)
-			: mMeshParams(mesh_params), mLOD(lod), mScore(0.f)
+			: mMeshParams(mesh_params), mLOD(lod), mScore(0.f),
+			  mQueueTime(LLTimer::getTotalSeconds()), mSkipCache(false)
 		{
 		}
 	};
@@ -295,7 +302,16 @@ public:
 			return lhs.mScore > rhs.mScore; // greatest = first
 		}
 	};
-	
+
+	//heap order for mHeaderReqQ and mLODReqQ
+	struct CompareScoreLess
+	{
+		template<class T>
+		bool operator()(const T& lhs, const T& rhs) const
+		{
+			return lhs.mScore < rhs.mScore; // greatest = top of heap
+		}
+	};
 
 	class LoadedMesh
 	{
@@ -326,11 +342,11 @@ public:
 	//queue of completed Decomposition info requests
 	std::queue<LLModel::Decomposition*> mDecompositionQ;
 
-	//queue of requested headers
-	std::queue<HeaderRequest> mHeaderReqQ;
+	//heap of requested headers, highest score first (protected by mMutex)
+	std::vector<HeaderRequest> mHeaderReqQ;
 
-	//queue of requested LODs
-	std::queue<LODRequest> mLODReqQ;
+	//heap of requested LODs, highest score first (protected by mMutex)
+	std::vector<LODRequest> mLODReqQ;
 
 	//queue of unavailable LODs (either asset doesn't exist or asset doesn't have desired LOD)
 	std::queue<LODRequest> mUnavailableQ;
@@ -342,6 +358,9 @@ public:
 	typedef std::map<LLVolumeParams, std::vector<S32> > pending_lod_map;
 	pending_lod_map mPendingLOD;
 
+	//workers unpacking fetched LODs, owned by LLMeshRepository
+	std::vector<LLMeshDecodeThread*> mDecodeThreads;
+
 	static std::string constructUrl(LLUUID mesh_id);
 
 	LLMeshRepoThread();
@@ -349,15 +368,26 @@ public:
 
 	virtual void run();
 
-	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	//mMutex must be locked
+	void pushHeaderRequest(const HeaderRequest& req);
+	void pushLODRequest(const LODRequest& req);
+
+	void loadMeshLOD(const LODRequest& req);
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params);
-	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	bool fetchMeshLOD(const LODRequest& req);
 	bool headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
+	void headerLoaded(const LLVolumeParams& mesh_params, const LLMeshHeader& header);
 	bool lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
+
+	//hands fetched LOD data (ownership included) to the least busy decode worker.
+	//cache_size is the number of bytes to write back to the VFS at cache_offset,
+	//0 when the data was read from the VFS in the first place.
+	void queueDecode(const LODRequest& req, U8* data, S32 data_size, S32 cache_offset, S32 cache_size);
+	void decodeLOD(const LODRequest& req, U8* data, S32 data_size, S32 cache_offset, S32 cache_size);
 	bool skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
-	LLSD& getMeshHeader(const LLUUID& mesh_id);
+	LLMeshHeader& getMeshHeader(const LLUUID& mesh_id);
 
 	void notifyLoadedMeshes();
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
@@ -381,6 +411,38 @@ public:
 
 };
 
+// Unpacks fetched mesh LODs off the HTTP thread, most visible meshes first.
+class LLMeshDecodeThread : public LLQueuedThread
+{
+public:
+	class DecodeRequest : public LLQueuedThread::QueuedRequest
+	{
+		friend class LLMeshDecodeThread;
+
+	protected:
+		virtual ~DecodeRequest(); // use deleteRequest()
+
+	public:
+		DecodeRequest(handle_t handle, const LLMeshRepoThread::LODRequest& req,
+					  U8* data, S32 data_size, S32 cache_offset, S32 cache_size);
+
+		/*virtual*/ bool processRequest();
+
+	private:
+		LLMeshRepoThread::LODRequest mRequest;
+		U8* mData;
+		S32 mDataSize;
+		S32 mCacheOffset;
+		S32 mCacheSize;
+		F64 mQueueTime;
+	};
+
+	LLMeshDecodeThread();
+
+	//takes ownership of data, returns false if the thread is shutting down
+	bool decodeLOD(const LLMeshRepoThread::LODRequest& req, U8* data, S32 data_size, S32 cache_offset, S32 cache_size);
+};
+
 #if MESH_IMPORT
 class LLMeshUploadThread : public LLThread 
 {
@@ -475,8 +537,14 @@ public:
 	static U32 sCacheBytesRead;
 	static U32 sCacheBytesWritten;
 	static U32 sPeakKbps;
+	static F32 sLODQueueLatency; //ms from loadMesh until the LOD fetch is issued, moving average
+	static F32 sDecodeQueueLatency; //ms fetched LODs wait for a decode worker, moving average
+
+	static LLMutex* sQueueLatencyMutex; //the averages are updated from the mesh and decode threads
+	static void updateQueueLatency(F32& average, F64 queue_time);
 	
 	static F32 getStreamingCost(LLSD& header, F32 radius, S32* bytes = NULL, S32* visible_bytes = NULL, S32 detail = -1, F32 *unscaled_value = NULL);
+	static F32 getStreamingCost(LLMeshHeader& header, F32 radius, S32* bytes = NULL, S32* visible_bytes = NULL, S32 detail = -1, F32 *unscaled_value = NULL);
 
 	LLMeshRepository();
 
@@ -494,7 +562,7 @@ public:
 	void notifyDecompositionReceived(LLModel::Decomposition* info);
 
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
-	static S32 getActualMeshLOD(LLSD& header, S32 lod);
+	static S32 getActualMeshLOD(LLMeshHeader& header, S32 lod);
 	const LLMeshSkinInfo* getSkinInfo(const LLUUID& mesh_id, const LLVOVolume* requesting_obj);
 	LLModel::Decomposition* getDecomposition(const LLUUID& mesh_id);
 	void fetchPhysicsShape(const LLUUID& mesh_id);
@@ -507,7 +575,7 @@ public:
 	bool meshRezEnabled();
 	
 
-	LLSD& getMeshHeader(const LLUUID& mesh_id);
+	LLMeshHeader& getMeshHeader(const LLUUID& mesh_id);
 
 #if MESH_IMPORT
 	void uploadModel(std::vector<LLModelInstance>& data, LLVector3& scale, bool upload_textures,
@@ -529,6 +597,10 @@ public:
 	LLMutex*					mMeshMutex;
 	
 	std::vector<LLMeshRepoThread::LODRequest> mPendingRequests;
+
+	//rescores queued LOD and header requests and drops the LODs no object waits for anymore.
+	//mMeshMutex and mThread->mMutex must be locked
+	void updateRequests();
 	
 	//list of mesh ids awaiting skin info
 	typedef std::map<LLUUID, std::set<LLUUID> > skin_load_map;
@@ -0,0 +1,131 @@
+/**
+ * @file llobjectidmap.cpp
+ * @brief Open addressing map from object ids to viewer objects.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectidmap.h"
+
+// Grows past this many entries per 16 slots.
+const U32 MAX_LOAD_SIXTEENTHS = 11;
+const U32 MIN_CAPACITY_BITS = 10;
+
+LLObjectIDMap::LLObjectIDMap()
+	: mMask(0),
+	  mShift(32),
+	  mCount(0)
+{
+	rehash(1 << MIN_CAPACITY_BITS);
+}
+
+void LLObjectIDMap::insert(const LLUUID& id, LLViewerObject* objectp)
+{
+	llassert_always(objectp);
+	if ((mCount + 1) * 16 > (mMask + 1) * MAX_LOAD_SIXTEENTHS)
+	{
+		rehash((mMask + 1) * 2);
+	}
+
+	for (U32 i = getHome(id); ; i = (i + 1) & mMask)
+	{
+		Entry& entry = mEntries[i];
+		if (!entry.mObject)
+		{
+			entry.mID = id;
+			entry.mObject = objectp;
+			++mCount;
+			return;
+		}
+		if (entry.mID == id)
+		{
+			entry.mObject = objectp;
+			return;
+		}
+	}
+}
+
+bool LLObjectIDMap::erase(const LLUUID& id)
+{
+	U32 hole = getHome(id);
+	while (mEntries[hole].mObject && mEntries[hole].mID != id)
+	{
+		hole = (hole + 1) & mMask;
+	}
+	if (!mEntries[hole].mObject)
+	{
+		return false;
+	}
+
+	// Pull back every following entry of the run whose home isn't between
+	// the hole and itself, so that no lookup runs into the empty slot early.
+	for (U32 i = (hole + 1) & mMask; mEntries[i].mObject; i = (i + 1) & mMask)
+	{
+		U32 home = getHome(mEntries[i].mID);
+		if (((i - home) & mMask) >= ((i - hole) & mMask))
+		{
+			mEntries[hole] = mEntries[i];
+			hole = i;
+		}
+	}
+	mEntries[hole].mObject = NULL;
+	--mCount;
+	return true;
+}
+
+void LLObjectIDMap::clear()
+{
+	mEntries.clear();
+	mCount = 0;
+	rehash(1 << MIN_CAPACITY_BITS);
+}
+
+void LLObjectIDMap::rehash(U32 capacity)
+{
+	std::vector<Entry> entries(capacity);
+	entries.swap(mEntries);
+	mMask = capacity - 1;
+	mShift = 32;
+	while (capacity > 1)
+	{
+		capacity >>= 1;
+		--mShift;
+	}
+	mCount = 0;
+
+	for (std::vector<Entry>::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+	{
+		if (iter->mObject)
+		{
+			insert(iter->mID, iter->mObject);
+		}
+	}
+}
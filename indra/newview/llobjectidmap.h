@@ -0,0 +1,95 @@
+/**
+ * @file llobjectidmap.h
+ * @brief Open addressing map from object ids to viewer objects.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTIDMAP_H
+#define LL_LLOBJECTIDMAP_H
+
+#include "lluuid.h"
+
+#include <vector>
+
+class LLViewerObject;
+
+// Maps object ids to objects in one flat array with linear probing, so a
+// lookup is a hash and usually a single cache line instead of a walk down a
+// red-black tree. Erasing shifts the following entries back rather than
+// leaving tombstones, which keeps probe sequences short under the constant
+// churn of objects coming and going. Holds plain pointers: the object list
+// owns the objects and erases them from here when they die.
+class LLObjectIDMap
+{
+public:
+	LLObjectIDMap();
+
+	inline LLViewerObject* find(const LLUUID& id) const;
+
+	// Adds or replaces the object of id.
+	void insert(const LLUUID& id, LLViewerObject* objectp);
+	// Returns false if id wasn't in the map.
+	bool erase(const LLUUID& id);
+	void clear();
+
+	U32 size() const		{ return mCount; }
+	bool empty() const		{ return mCount == 0; }
+
+private:
+	struct Entry
+	{
+		Entry() : mObject(NULL) {}
+
+		LLUUID mID;
+		LLViewerObject* mObject; // NULL for an empty slot
+	};
+
+	// Object ids are random, so mixing the folded words is all it takes.
+	U32 getHome(const LLUUID& id) const	{ return (id.getCRC32() * 2654435761U) >> mShift; }
+	void rehash(U32 capacity);
+
+	std::vector<Entry> mEntries;
+	U32 mMask;
+	U32 mShift;
+	U32 mCount;
+};
+
+inline LLViewerObject* LLObjectIDMap::find(const LLUUID& id) const
+{
+	for (U32 i = getHome(id); ; i = (i + 1) & mMask)
+	{
+		const Entry& entry = mEntries[i];
+		if (!entry.mObject || entry.mID == id)
+		{
+			return entry.mObject;
+		}
+	}
+}
+
+#endif // LL_LLOBJECTIDMAP_H
@@ -0,0 +1,183 @@
+/**
+ * @file llobjectmotion.cpp
+ * @brief Batched velocity interpolation of active objects.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectmotion.h"
+
+#include "llgeometryworkers.h"
+
+// Objects per worker job; the math per object is tiny, so batches are large.
+const S32 MOTION_BATCH_SIZE = 512;
+
+LLObjectMotionTable::LLObjectMotionTable()
+	: mTime(0.0),
+	  mCount(0),
+	  mCapacity(0),
+	  mVelocity(NULL),
+	  mAcceleration(NULL),
+	  mAngularVelocity(NULL),
+	  mDeltaTime(NULL),
+	  mDisplacement(NULL),
+	  mVelocityDelta(NULL),
+	  mSpin(NULL),
+	  mSpinning(NULL)
+{
+}
+
+LLObjectMotionTable::~LLObjectMotionTable()
+{
+	reserve(0);
+}
+
+void LLObjectMotionTable::reset(F64 time)
+{
+	mTime = time;
+	mCount = 0;
+}
+
+void LLObjectMotionTable::reserve(S32 count)
+{
+	LLVector4a* arrays[] = { mVelocity, mAcceleration, mAngularVelocity, mDisplacement, mVelocityDelta };
+	LLVector4a* grown[5];
+	for (S32 i = 0; i < 5; ++i)
+	{
+		grown[i] = count ? (LLVector4a*)ll_aligned_malloc_16(sizeof(LLVector4a) * count) : NULL;
+		if (mCount)
+		{
+			memcpy(grown[i], arrays[i], sizeof(LLVector4a) * mCount);
+		}
+		ll_aligned_free_16(arrays[i]);
+	}
+	mVelocity = grown[0];
+	mAcceleration = grown[1];
+	mAngularVelocity = grown[2];
+	mDisplacement = grown[3];
+	mVelocityDelta = grown[4];
+
+	F32* delta_time = count ? new F32[count] : NULL;
+	LLQuaternion* spin = count ? new LLQuaternion[count] : NULL;
+	U8* spinning = count ? new U8[count] : NULL;
+	if (mCount)
+	{
+		memcpy(delta_time, mDeltaTime, sizeof(F32) * mCount);
+	}
+	delete[] mDeltaTime;
+	delete[] mSpin;
+	delete[] mSpinning;
+	mDeltaTime = delta_time;
+	mSpin = spin;
+	mSpinning = spinning;
+
+	mCapacity = count;
+}
+
+S32 LLObjectMotionTable::add(const LLVector3& velocity, const LLVector3& acceleration,
+							 const LLVector3& angular_velocity, F32 dt)
+{
+	if (mCount == mCapacity)
+	{
+		reserve(llmax(mCapacity * 2, 256));
+	}
+	S32 slot = mCount++;
+	mVelocity[slot].load3(velocity.mV);
+	mAcceleration[slot].load3(acceleration.mV);
+	mAngularVelocity[slot].load3(angular_velocity.mV);
+	mDeltaTime[slot] = dt;
+	return slot;
+}
+
+void LLObjectMotionTable::integrate()
+{
+	LLGeometryWorkers* workers = LLGeometryWorkers::getInstance();
+	if (workers && mCount >= MOTION_BATCH_SIZE * 2)
+	{
+		workers->run(integrateBatch, this, (mCount + MOTION_BATCH_SIZE - 1) / MOTION_BATCH_SIZE);
+	}
+	else
+	{
+		integrateRange(0, mCount);
+	}
+}
+
+//static
+void LLObjectMotionTable::integrateBatch(void* data, U32 batch)
+{
+	LLObjectMotionTable* table = (LLObjectMotionTable*)data;
+	S32 begin = batch * MOTION_BATCH_SIZE;
+	table->integrateRange(begin, llmin(begin + MOTION_BATCH_SIZE, table->mCount));
+}
+
+void LLObjectMotionTable::integrateRange(S32 begin, S32 end)
+{
+	// The velocity in object updates is the average over the last physics
+	// step rather than the final one, hence the PHYSICS_TIMESTEP correction.
+	LLVector4a dt_v;
+	LLVector4a half_step;
+	for (S32 i = begin; i < end; ++i)
+	{
+		const F32 dt = mDeltaTime[i];
+		dt_v.splat(dt);
+		half_step.splat(0.5f * (dt - PHYSICS_TIMESTEP));
+		mVelocityDelta[i].setMul(mAcceleration[i], dt_v);
+		mDisplacement[i].setMul(mAcceleration[i], half_step);
+		mDisplacement[i].add(mVelocity[i]);
+		mDisplacement[i].mul(dt_v);
+
+		const F32 omega_squared = mAngularVelocity[i].dot3(mAngularVelocity[i]).getF32();
+		mSpinning[i] = omega_squared > 0.00001f;
+		if (mSpinning[i])
+		{
+			const F32 omega = sqrtf(omega_squared);
+			LLVector4a axis(mAngularVelocity[i]);
+			axis.mul(1.f / omega);
+			mSpin[i].setQuat(omega * dt, LLVector3(axis.getF32ptr()));
+		}
+	}
+}
+
+void LLObjectMotionTable::getLinearMotion(S32 slot, LLVector3& displacement, LLVector3& velocity_delta) const
+{
+	displacement.set(mDisplacement[slot].getF32ptr());
+	velocity_delta.set(mVelocityDelta[slot].getF32ptr());
+}
+
+bool LLObjectMotionTable::getSpin(S32 slot, LLQuaternion& rotation) const
+{
+	if (mSpinning[slot])
+	{
+		rotation = mSpin[slot];
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file llobjectmotion.h
+ * @brief Batched velocity interpolation of active objects.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTMOTION_H
+#define LL_LLOBJECTMOTION_H
+
+#include "v3math.h"
+#include "llquaternion.h"
+#include "llvector4a.h"
+
+// Dead reckoning inputs of the frame's moving objects, kept as parallel
+// arrays so their kinematics run as one pass before the objects' idleUpdate()
+// calls pick up the results. Only the pure math lives here; phasing motion
+// out, clamping to land and clipping to regions stay with the object.
+class LLObjectMotionTable
+{
+public:
+	LLObjectMotionTable();
+	~LLObjectMotionTable();
+
+	// Empties the table for the frame at time.
+	void reset(F64 time);
+	F64 getTime() const							{ return mTime; }
+	S32 getCount() const						{ return mCount; }
+
+	// Returns the slot holding the object's results.
+	S32 add(const LLVector3& velocity, const LLVector3& acceleration,
+			const LLVector3& angular_velocity, F32 dt);
+
+	// Fills in the results of every slot, on the geometry workers when there
+	// are enough of them. Main thread only.
+	void integrate();
+
+	// Displacement and velocity change over the slot's dt.
+	void getLinearMotion(S32 slot, LLVector3& displacement, LLVector3& velocity_delta) const;
+	// Rotation over the slot's dt, false when the object isn't spinning.
+	bool getSpin(S32 slot, LLQuaternion& rotation) const;
+
+private:
+	void reserve(S32 count);
+	void integrateRange(S32 begin, S32 end);
+	static void integrateBatch(void* data, U32 batch);
+
+	F64 mTime;
+	S32 mCount;
+	S32 mCapacity;
+
+	// inputs
+	LLVector4a* mVelocity;
+	LLVector4a* mAcceleration;
+	LLVector4a* mAngularVelocity;
+	F32* mDeltaTime;
+
+	// results
+	LLVector4a* mDisplacement;
+	LLVector4a* mVelocityDelta;
+	LLQuaternion* mSpin;
+	U8* mSpinning;
+};
+
+#endif // LL_LLOBJECTMOTION_H
@@ -0,0 +1,457 @@
+/**
+ * @file llregioncachethread.cpp
+ * @brief Saves and preloads the terrain and parcel overlay of visited regions.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llregioncachethread.h"
+
+#include "llapr.h"
+#include "lldatapacker.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+#include "llregionhandle.h"
+#include "llviewercontrol.h"
+#include "llvocache.h"
+
+#include <algorithm>
+#include <set>
+
+static const char region_cache_dirname[] = "regioncache";
+static const char REGION_CACHE_FILENAME[] = "region_%d_%d.slc";
+static const char REGION_CACHE_MASK[] = "region_*.slc";
+
+static const U32 REGION_CACHE_MAGIC = 0x52474e43; // "RGNC"
+static const U32 REGION_CACHE_VERSION = 2;
+
+// Object cache files are read this much at a time, checking for aborts in between.
+static const S32 OBJECT_CACHE_READ_SIZE = 256 * 1024;
+
+// Packed field by field, the file doesn't depend on the struct layout.
+struct LLRegionCacheHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	LLUUID mRegionID;
+	S32 mGridsPerEdge;
+	S32 mPatchesPerEdge;
+	S32 mOwnershipSize;
+
+	static const S32 PACKED_SIZE = 4 + 4 + UUID_BYTES + 4 + 4 + 4;
+
+	bool pack(U8* buffer) const
+	{
+		LLDataPackerBinaryBuffer dp(buffer, PACKED_SIZE);
+		return dp.packU32(mMagic, "Magic")
+			&& dp.packU32(mVersion, "Version")
+			&& dp.packUUID(mRegionID, "RegionID")
+			&& dp.packS32(mGridsPerEdge, "GridsPerEdge")
+			&& dp.packS32(mPatchesPerEdge, "PatchesPerEdge")
+			&& dp.packS32(mOwnershipSize, "OwnershipSize");
+	}
+
+	bool unpack(const U8* buffer)
+	{
+		LLDataPackerBinaryBuffer dp((U8*)buffer, PACKED_SIZE);
+		return dp.unpackU32(mMagic, "Magic")
+			&& dp.unpackU32(mVersion, "Version")
+			&& dp.unpackUUID(mRegionID, "RegionID")
+			&& dp.unpackS32(mGridsPerEdge, "GridsPerEdge")
+			&& dp.unpackS32(mPatchesPerEdge, "PatchesPerEdge")
+			&& dp.unpackS32(mOwnershipSize, "OwnershipSize");
+	}
+};
+
+//----------------------------------------------------------------------------
+
+LLRegionCacheThread::LoadRequest::LoadRequest(handle_t handle, U32 priority, const std::string& filename,
+											  const std::string& object_filename)
+	: LLQueuedThread::QueuedRequest(handle, priority),
+	  mFilename(filename),
+	  mObjectFilename(object_filename)
+{
+}
+
+// Called from the worker thread
+bool LLRegionCacheThread::LoadRequest::processRequest()
+{
+	readState();
+	if (!mObjectFilename.empty() && !(getFlags() & FLAG_ABORT))
+	{
+		readObjectCache();
+	}
+	return true;
+}
+
+void LLRegionCacheThread::LoadRequest::readState()
+{
+	S32 file_size = LLAPRFile::size(mFilename);
+	if (file_size < LLRegionCacheHeader::PACKED_SIZE)
+	{
+		return; // never saved
+	}
+
+	std::vector<U8> buffer(file_size);
+	if (LLAPRFile::readEx(mFilename, &buffer[0], 0, file_size) != file_size)
+	{
+		llwarns << "Failed to read region cache " << mFilename << llendl;
+		return;
+	}
+
+	LLRegionCacheHeader header;
+	if (!header.unpack(&buffer[0]) ||
+		header.mMagic != REGION_CACHE_MAGIC || header.mVersion != REGION_CACHE_VERSION ||
+		header.mGridsPerEdge <= 0 || header.mPatchesPerEdge <= 0 || header.mOwnershipSize < 0)
+	{
+		return;
+	}
+
+	const S64 heights = (S64)header.mGridsPerEdge * header.mGridsPerEdge;
+	const S64 patches = (S64)header.mPatchesPerEdge * header.mPatchesPerEdge;
+	if (LLRegionCacheHeader::PACKED_SIZE + heights * (S64)sizeof(F32) + patches + header.mOwnershipSize != file_size)
+	{
+		llwarns << "Discarding corrupt region cache " << mFilename << llendl;
+		return;
+	}
+
+	const U8* data = &buffer[LLRegionCacheHeader::PACKED_SIZE];
+	mState.mHeights.resize(heights);
+	memcpy(&mState.mHeights[0], data, heights * sizeof(F32));
+	data += heights * sizeof(F32);
+	mState.mPatchReceived.assign(data, data + patches);
+	data += patches;
+	mState.mOwnership.assign(data, data + header.mOwnershipSize);
+
+	mState.mGridsPerEdge = header.mGridsPerEdge;
+	mState.mPatchesPerEdge = header.mPatchesPerEdge;
+	mState.mRegionID = header.mRegionID;
+}
+
+void LLRegionCacheThread::LoadRequest::readObjectCache()
+{
+	// Only the reads matter: LLVOCache maps the file once the region
+	// handshake arrives and then finds it in the OS file cache.
+	LLAPRFile infile(mObjectFilename, LL_APR_RB);
+	if (!infile.getFileHandle())
+	{
+		return;
+	}
+
+	std::vector<U8> buffer(OBJECT_CACHE_READ_SIZE);
+	while (infile.read(&buffer[0], OBJECT_CACHE_READ_SIZE) == OBJECT_CACHE_READ_SIZE)
+	{
+		if (getFlags() & FLAG_ABORT)
+		{
+			break;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLRegionCacheThread::SaveRequest::SaveRequest(handle_t handle, U32 priority, const std::string& filename,
+											  const RegionState& state, const std::string& cache_dir, U32 max_regions)
+	: LLQueuedThread::QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+	  mFilename(filename),
+	  mState(state),
+	  mCacheDirName(cache_dir),
+	  mMaxRegions(max_regions)
+{
+}
+
+// Called from the worker thread
+bool LLRegionCacheThread::SaveRequest::processRequest()
+{
+	LLRegionCacheHeader header;
+	header.mMagic = REGION_CACHE_MAGIC;
+	header.mVersion = REGION_CACHE_VERSION;
+	header.mRegionID = mState.mRegionID;
+	header.mGridsPerEdge = mState.mGridsPerEdge;
+	header.mPatchesPerEdge = mState.mPatchesPerEdge;
+	header.mOwnershipSize = mState.mOwnership.size();
+
+	std::vector<U8> buffer(LLRegionCacheHeader::PACKED_SIZE);
+	header.pack(&buffer[0]);
+	buffer.insert(buffer.end(), (U8*)&mState.mHeights[0], (U8*)(&mState.mHeights[0] + mState.mHeights.size()));
+	buffer.insert(buffer.end(), mState.mPatchReceived.begin(), mState.mPatchReceived.end());
+	buffer.insert(buffer.end(), mState.mOwnership.begin(), mState.mOwnership.end());
+
+	// Write aside and swap, so a crash never leaves half a file. Renaming
+	// doesn't replace an existing file everywhere, and reads of this file
+	// run on this thread too, so nothing sees it missing in between.
+	std::string temp_filename = mFilename + ".tmp";
+	LLAPRFile::remove(temp_filename);
+	if (LLAPRFile::writeEx(temp_filename, &buffer[0], 0, buffer.size()) != (S32)buffer.size() ||
+		(LLAPRFile::isExist(mFilename) && !LLAPRFile::remove(mFilename)) ||
+		!LLAPRFile::rename(temp_filename, mFilename))
+	{
+		llwarns << "Failed to write region cache " << mFilename << llendl;
+		LLAPRFile::remove(temp_filename);
+		return true;
+	}
+
+	evictRegions(mCacheDirName, mMaxRegions, mFilename);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+LLRegionCacheThread::LLRegionCacheThread(bool threaded)
+	: LLQueuedThread("regioncache", threaded),
+	  mInitialized(false),
+	  mReadOnly(false),
+	  mMaxRegions(1)
+{
+}
+
+LLRegionCacheThread::~LLRegionCacheThread()
+{
+}
+
+void LLRegionCacheThread::initCache(ELLPath location, U32 max_regions)
+{
+	mCacheDirName = gDirUtilp->getExpandedFilename(location, region_cache_dirname);
+	mMaxRegions = llmax(max_regions, 1U);
+	if (!mReadOnly)
+	{
+		LLFile::mkdir(mCacheDirName);
+		evictRegions(mCacheDirName, mMaxRegions, LLStringUtil::null);
+	}
+	mInitialized = true;
+}
+
+void LLRegionCacheThread::removeCache(ELLPath location)
+{
+	if (mReadOnly)
+	{
+		llwarns << "Not removing region cache at " << location << ": Cache is currently in read-only mode." << llendl;
+		return;
+	}
+
+	while (!mLoads.empty())
+	{
+		dropLoad(mLoads.begin()->first);
+	}
+
+	std::string cache_dir = gDirUtilp->getExpandedFilename(location, region_cache_dirname);
+	llinfos << "Removing region cache at " << cache_dir << llendl;
+	gDirUtilp->deleteFilesInDir(cache_dir, "*");
+	LLFile::rmdir(cache_dir);
+	mInitialized = false;
+}
+
+std::string LLRegionCacheThread::getStateFilename(U64 region_handle) const
+{
+	U32 region_x, region_y;
+	grid_from_region_handle(region_handle, &region_x, &region_y);
+	return mCacheDirName + gDirUtilp->getDirDelimiter() + llformat(REGION_CACHE_FILENAME, region_x, region_y);
+}
+
+// Deletes the least recently saved region files but keep_filename until
+// max_regions are left. Runs on the worker thread after a save, where all
+// reads run as well, or from initCache() before anything is queued.
+//static
+void LLRegionCacheThread::evictRegions(const std::string& cache_dir, U32 max_regions, const std::string& keep_filename)
+{
+	typedef std::pair<time_t, std::string> saved_file_t;
+	std::vector<saved_file_t> files;
+	LLDirIterator iter(cache_dir, REGION_CACHE_MASK);
+	std::string filename;
+	while (iter.next(filename))
+	{
+		std::string pathname = cache_dir + gDirUtilp->getDirDelimiter() + filename;
+		llstat stat_data;
+		if (pathname != keep_filename && !LLFile::stat(pathname, &stat_data))
+		{
+			files.push_back(saved_file_t(stat_data.st_mtime, pathname));
+		}
+	}
+
+	U32 keep = keep_filename.empty() ? max_regions : max_regions - 1;
+	if (files.size() <= keep)
+	{
+		return;
+	}
+
+	std::sort(files.begin(), files.end());
+	U32 evict = files.size() - keep;
+	for (U32 i = 0; i < evict; i++)
+	{
+		LLAPRFile::remove(files[i].second);
+	}
+	LL_DEBUGS("RegionCache") << "Evicted " << evict << " regions from " << cache_dir << LL_ENDL;
+}
+
+void LLRegionCacheThread::preload(U64 region_handle, bool with_neighbors)
+{
+	static const LLCachedControl<bool> warm_start("RegionWarmStart", true);
+	if (!warm_start || !mInitialized)
+	{
+		return;
+	}
+
+	if (!with_neighbors)
+	{
+		queueLoad(region_handle);
+		return;
+	}
+
+	U32 x, y;
+	from_region_handle(region_handle, &x, &y);
+	std::set<U64> handles;
+	for (S32 i = -1; i <= 1; i++)
+	{
+		for (S32 j = -1; j <= 1; j++)
+		{
+			S64 neighbor_x = (S64)x + i * (S64)REGION_WIDTH_UNITS;
+			S64 neighbor_y = (S64)y + j * (S64)REGION_WIDTH_UNITS;
+			if (neighbor_x >= 0 && neighbor_y >= 0 && neighbor_x <= U32_MAX && neighbor_y <= U32_MAX)
+			{
+				handles.insert(to_region_handle((U32)neighbor_x, (U32)neighbor_y));
+			}
+		}
+	}
+
+	// Reads for the previous destination that no region picked up are stale.
+	for (load_map_t::iterator iter = mLoads.begin(); iter != mLoads.end(); )
+	{
+		U64 handle = (iter++)->first;
+		if (!handles.count(handle))
+		{
+			dropLoad(handle);
+		}
+	}
+
+	// The destination first, requests of the same priority run in the order queued.
+	queueLoad(region_handle);
+	for (std::set<U64>::iterator iter = handles.begin(); iter != handles.end(); ++iter)
+	{
+		queueLoad(*iter);
+	}
+}
+
+bool LLRegionCacheThread::fetchState(U64 region_handle, RegionState& state)
+{
+	static const LLCachedControl<bool> warm_start("RegionWarmStart", true);
+	if (!warm_start || !mInitialized)
+	{
+		dropLoad(region_handle);
+		state = RegionState();
+		return true;
+	}
+
+	load_map_t::iterator iter = mLoads.find(region_handle);
+	if (iter == mLoads.end())
+	{
+		queueLoad(region_handle);
+		return false;
+	}
+
+	status_t status = getRequestStatus(iter->second);
+	if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+	{
+		return false;
+	}
+
+	if (status == STATUS_COMPLETE)
+	{
+		state = ((LoadRequest*)getRequest(iter->second))->getState();
+	}
+	else
+	{
+		state = RegionState();
+	}
+	completeRequest(iter->second);
+	mLoads.erase(iter);
+	return true;
+}
+
+void LLRegionCacheThread::save(U64 region_handle, const RegionState& state)
+{
+	static const LLCachedControl<bool> warm_start("RegionWarmStart", true);
+	if (!warm_start || !mInitialized || mReadOnly || state.isEmpty() || state.mHeights.empty())
+	{
+		return;
+	}
+
+	// A read queued earlier would hand out what this replaces.
+	dropLoad(region_handle);
+
+	handle_t handle = generateHandle();
+	SaveRequest* req = new SaveRequest(handle, LLQueuedThread::PRIORITY_NORMAL, getStateFilename(region_handle), state,
+									   mCacheDirName, mMaxRegions);
+	if (!addRequest(req))
+	{
+		req->deleteRequest();
+	}
+}
+
+void LLRegionCacheThread::queueLoad(U64 region_handle)
+{
+	if (mLoads.count(region_handle))
+	{
+		return;
+	}
+
+	std::string object_filename;
+	if (LLVOCache::hasInstance())
+	{
+		LLVOCache::getInstance()->getObjectCacheFilename(region_handle, object_filename);
+	}
+
+	handle_t handle = generateHandle();
+	LoadRequest* req = new LoadRequest(handle, LLQueuedThread::PRIORITY_NORMAL,
+									   getStateFilename(region_handle), object_filename);
+	if (!addRequest(req))
+	{
+		req->deleteRequest();
+		return;
+	}
+	mLoads[region_handle] = handle;
+}
+
+void LLRegionCacheThread::dropLoad(U64 region_handle)
+{
+	load_map_t::iterator iter = mLoads.find(region_handle);
+	if (iter == mLoads.end())
+	{
+		return;
+	}
+
+	// Drop the read, or release it if it already finished before seeing the abort.
+	abortRequest(iter->second, true);
+	status_t status = getRequestStatus(iter->second);
+	if (status == STATUS_COMPLETE || status == STATUS_ABORTED)
+	{
+		completeRequest(iter->second);
+	}
+	mLoads.erase(iter);
+}
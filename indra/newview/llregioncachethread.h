@@ -0,0 +1,147 @@
+/**
+ * @file llregioncachethread.h
+ * @brief Saves and preloads the terrain and parcel overlay of visited regions.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLREGIONCACHETHREAD_H
+#define LL_LLREGIONCACHETHREAD_H
+
+#include "lldir.h"
+#include "llqueuedthread.h"
+#include "lluuid.h"
+
+#include <map>
+#include <vector>
+
+// Warm start of regions: the terrain heights and parcel overlay of a region
+// are saved per region handle when it goes away, and read back as soon as a
+// login or teleport names the destination, together with its neighbours.
+// The region applies them to whatever the simulator hasn't sent yet once
+// the handshake confirmed its ID. Reading also pulls the object cache files
+// into the OS file cache, so LLVOCache maps them without waiting on the disk.
+// All public methods are for the main thread.
+class LLRegionCacheThread : public LLQueuedThread
+{
+public:
+	struct RegionState
+	{
+		RegionState() : mGridsPerEdge(0), mPatchesPerEdge(0) {}
+
+		bool isEmpty() const { return mRegionID.isNull(); }
+
+		LLUUID mRegionID;					// null when nothing was saved
+		S32 mGridsPerEdge;
+		S32 mPatchesPerEdge;
+		std::vector<F32> mHeights;			// mGridsPerEdge^2, LLSurface layout
+		std::vector<U8> mPatchReceived;		// mPatchesPerEdge^2
+		std::vector<U8> mOwnership;			// empty when the overlay wasn't known
+	};
+
+	class LoadRequest : public LLQueuedThread::QueuedRequest
+	{
+		friend class LLRegionCacheThread;
+
+	protected:
+		virtual ~LoadRequest() {} // use deleteRequest()
+
+	public:
+		LoadRequest(handle_t handle, U32 priority, const std::string& filename,
+					const std::string& object_filename);
+
+		/*virtual*/ bool processRequest();
+
+		const RegionState& getState() const { return mState; }
+
+	private:
+		void readState();
+		void readObjectCache();
+
+		std::string mFilename;
+		std::string mObjectFilename; // empty without an object cache
+		RegionState mState;
+	};
+
+	class SaveRequest : public LLQueuedThread::QueuedRequest
+	{
+		friend class LLRegionCacheThread;
+
+	protected:
+		virtual ~SaveRequest() {} // use deleteRequest()
+
+	public:
+		SaveRequest(handle_t handle, U32 priority, const std::string& filename,
+					const RegionState& state, const std::string& cache_dir, U32 max_regions);
+
+		/*virtual*/ bool processRequest();
+
+	private:
+		std::string mFilename;
+		RegionState mState;
+		std::string mCacheDirName;
+		U32 mMaxRegions;
+	};
+
+public:
+	LLRegionCacheThread(bool threaded = true);
+	virtual ~LLRegionCacheThread();
+
+	// Keeps the max_regions most recently saved regions, dropping the others
+	// now and whenever a save goes past it.
+	void initCache(ELLPath location, U32 max_regions);
+	void removeCache(ELLPath location);
+	void setReadOnly(bool read_only) { mReadOnly = read_only; }
+
+	// Starts reading the region at region_handle and, with_neighbors, the
+	// eight around it, unless they are read already.
+	void preload(U64 region_handle, bool with_neighbors);
+
+	// Hands out the state of a region once read, empty if nothing was saved,
+	// and forgets it. False while still reading; queues the read if nobody
+	// asked for it yet.
+	bool fetchState(U64 region_handle, RegionState& state);
+
+	void save(U64 region_handle, const RegionState& state);
+
+private:
+	std::string getStateFilename(U64 region_handle) const;
+	static void evictRegions(const std::string& cache_dir, U32 max_regions, const std::string& keep_filename);
+	void queueLoad(U64 region_handle);
+	void dropLoad(U64 region_handle);
+
+	bool mInitialized;
+	bool mReadOnly;
+	std::string mCacheDirName;
+	U32 mMaxRegions;
+
+	typedef std::map<U64, handle_t> load_map_t;
+	load_map_t mLoads; // by region handle
+};
+
+#endif // LL_LLREGIONCACHETHREAD_H
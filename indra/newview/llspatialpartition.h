@@ -679,6 +679,10 @@ class LLVolumeGeometryManager: public LLGeometryManager
 	virtual void getGeometry(LLSpatialGroup* group);
 	void genDrawInfo(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces, BOOL distance_sort = FALSE, BOOL batch_textures = FALSE);
 	void registerFace(LLSpatialGroup* group, LLFace* facep, U32 type);
+
+	// Runs the vertex transforms getGeometryVolume() deferred, on the
+	// geometry workers when there is enough of them, then clears jobs.
+	static void runGeometryJobs(face_geometry_job_list_t& jobs);
 };
 
 //spatial partition that uses volume geometry manager (implemented in LLVOVolume.cpp)
@@ -149,6 +149,7 @@
 #include "llpreview.h"
 #include "llpreviewscript.h"
 #include "llproductinforequest.h"
+#include "llregioncachethread.h"
 #include "llsecondlifeurls.h"
 #include "llselectmgr.h"
 #include "llsky.h"
@@ -1681,6 +1682,7 @@ bool idle_startup()
 				U32 region_x = strtoul(region_x_str.c_str(), NULL, 10);
 				U32 region_y = strtoul(region_y_str.c_str(), NULL, 10);
 				gFirstSimHandle = to_region_handle(region_x, region_y);
+				LLAppViewer::getRegionCacheThread()->preload(gFirstSimHandle, true);
 			}
 			
 			const std::string look_at_str = LLUserAuth::getInstance()->getResponse("look_at");
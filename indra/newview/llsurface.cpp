@@ -56,6 +56,7 @@
 #include "llvlcomposition.h"
 #include "noise.h"
 #include "llviewercamera.h"
+#include "llgeometryworkers.h"
 #include "llglheaders.h"
 #include "lldrawpoolterrain.h"
 #include "lldrawable.h"
@@ -636,6 +637,15 @@ void LLSurface::updatePatchVisibilities(LLAgent &agent)
 	}
 }
 
+// Below this many patches the inverse transforms and vertex cache rebuilds
+// run inline, waking the geometry workers costs more than it saves.
+const U32 MIN_PARALLEL_PATCHES = 4;
+
+static void update_vertex_cache_job(void* data, U32 index)
+{
+	((LLSurfacePatch**)data)[index]->updateVertexCache();
+}
+
 BOOL LLSurface::idleUpdate(F32 max_update_time)
 {
 	if (!gPipeline.hasRenderType(LLPipeline::RENDER_TYPE_TERRAIN))
@@ -655,6 +665,9 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 		getRegion()->dirtyHeights();
 	}
 
+	static std::vector<LLSurfacePatch*> rebuild_patches;
+	rebuild_patches.clear();
+
 	// Always call updateNormals() / updateVerticalStats()
 	//  every frame to avoid artifacts
 	for(std::set<LLSurfacePatch *>::iterator iter = mDirtyPatchList.begin();
@@ -673,16 +686,59 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 				mDirtyPatchList.erase(curiter);
 			}
 		}
+		if (mType == 'l' && !patchp->hasVertexCache())
+		{
+			rebuild_patches.push_back(patchp);
+		}
+	}
+
+	// Heights, normals and composition are final for this frame: rebuild the
+	// vertex caches now so LOD changes only have to copy them.
+	if (!rebuild_patches.empty())
+	{
+		// The first one runs here, it sets up the noise tables on first use.
+		rebuild_patches[0]->updateVertexCache();
+		U32 count = rebuild_patches.size() - 1;
+		LLGeometryWorkers* workers = LLGeometryWorkers::getInstance();
+		if (workers && count >= MIN_PARALLEL_PATCHES)
+		{
+			workers->run(update_vertex_cache_job, &rebuild_patches[1], count);
+		}
+		else
+		{
+			for (U32 i = 0; i < count; i++)
+			{
+				update_vertex_cache_job(&rebuild_patches[1], i);
+			}
+		}
 	}
 	return did_update;
 }
 
+// Patch of a LayerData packet with its coefficients read, waiting for the
+// inverse transform.
+struct LLDecodedPatch
+{
+	LLPatchHeader mHeader;
+	LLSurfacePatch* mPatchp;
+	S32 mCoefficients[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+};
+
+static void decompress_patch_job(void* data, U32 index)
+{
+	LLDecodedPatch& decoded = ((LLDecodedPatch*)data)[index];
+	decompress_patch(decoded.mPatchp->getDataZ(), decoded.mCoefficients, &decoded.mHeader);
+}
+
 void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch) 
 {
+	// The bitstream has to be read in order, but the patches it holds are
+	// independent: read them all, then transform them on the geometry workers.
+	static std::vector<LLDecodedPatch> decoded_patches;
+	U32 num_patches = 0;
 
 	LLPatchHeader  ph;
 	S32 j, i;
-	S32 patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 	LLSurfacePatch *patchp;
 
 	init_patch_decompressor(gopp->patch_size);
@@ -717,30 +773,112 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 
 		patchp = &mPatchList[j*mPatchesPerEdge + i];
 
-
-		decode_patch(bitpack, patch);
-		decompress_patch(patchp->getDataZ(), patch, &ph);
-
-		// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
-		patchp->updateNorthEdge();
-		patchp->updateEastEdge();
-		if (patchp->getNeighborPatch(WEST))
+		// A patch sent twice would be transformed concurrently, keep the last one.
+		U32 index = 0;
+		while (index < num_patches && decoded_patches[index].mPatchp != patchp)
 		{
-			patchp->getNeighborPatch(WEST)->updateEastEdge();
+			index++;
 		}
-		if (patchp->getNeighborPatch(SOUTHWEST))
+		if (index == num_patches)
 		{
-			patchp->getNeighborPatch(SOUTHWEST)->updateEastEdge();
-			patchp->getNeighborPatch(SOUTHWEST)->updateNorthEdge();
+			if (decoded_patches.size() == num_patches)
+			{
+				decoded_patches.resize(num_patches + 1);
+			}
+			num_patches++;
 		}
-		if (patchp->getNeighborPatch(SOUTH))
+
+		LLDecodedPatch& decoded = decoded_patches[index];
+		decoded.mHeader = ph;
+		decoded.mPatchp = patchp;
+		decode_patch(bitpack, decoded.mCoefficients);
+	}
+
+	if (!num_patches)
+	{
+		return;
+	}
+
+	LLGeometryWorkers* workers = LLGeometryWorkers::getInstance();
+	if (workers && num_patches >= MIN_PARALLEL_PATCHES)
+	{
+		workers->run(decompress_patch_job, &decoded_patches[0], num_patches);
+	}
+	else
+	{
+		for (U32 index = 0; index < num_patches; index++)
 		{
-			patchp->getNeighborPatch(SOUTH)->updateNorthEdge();
+			decompress_patch_job(&decoded_patches[0], index);
 		}
+	}
 
-		// Dirty patch statistics, and flag that the patch has data.
-		patchp->dirtyZ();
-		patchp->setHasReceivedData();
+	for (U32 index = 0; index < num_patches; index++)
+	{
+		onPatchHeightsChanged(decoded_patches[index].mPatchp);
+		decoded_patches[index].mPatchp->setHasReceivedData();
+	}
+}
+
+void LLSurface::onPatchHeightsChanged(LLSurfacePatch *patchp)
+{
+	// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
+	patchp->updateNorthEdge();
+	patchp->updateEastEdge();
+	if (patchp->getNeighborPatch(WEST))
+	{
+		patchp->getNeighborPatch(WEST)->updateEastEdge();
+	}
+	if (patchp->getNeighborPatch(SOUTHWEST))
+	{
+		patchp->getNeighborPatch(SOUTHWEST)->updateEastEdge();
+		patchp->getNeighborPatch(SOUTHWEST)->updateNorthEdge();
+	}
+	if (patchp->getNeighborPatch(SOUTH))
+	{
+		patchp->getNeighborPatch(SOUTH)->updateNorthEdge();
+	}
+
+	// Dirty patch statistics.
+	patchp->dirtyZ();
+}
+
+void LLSurface::getPatchHeights(std::vector<F32>& heights, std::vector<U8>& received) const
+{
+	heights.assign(mSurfaceZ, mSurfaceZ + mGridsPerEdge * mGridsPerEdge);
+	received.resize(mNumberOfPatches);
+	for (S32 i = 0; i < mNumberOfPatches; i++)
+	{	// heights only filled in from the cache aren't any fresher than the file
+		received[i] = mPatchList[i].getHasReceivedData() ? 1 : 0;
+	}
+}
+
+void LLSurface::setCachedHeights(const std::vector<F32>& heights, const std::vector<U8>& received)
+{
+	if ((S32)heights.size() != mGridsPerEdge * mGridsPerEdge || (S32)received.size() != mNumberOfPatches)
+	{
+		return; // saved with another region size
+	}
+
+	for (S32 j = 0; j < mPatchesPerEdge; j++)
+	{
+		for (S32 i = 0; i < mPatchesPerEdge; i++)
+		{
+			LLSurfacePatch *patchp = getPatch(i, j);
+			if (!received[j * mPatchesPerEdge + i] || patchp->hasHeights())
+			{
+				continue;
+			}
+
+			// The east and north buffers are the neighbours' data, onPatchHeightsChanged() copies them.
+			S32 offset = (i + j * mGridsPerEdge) * mGridsPerPatchEdge;
+			for (U32 y = 0; y < mGridsPerPatchEdge; y++)
+			{
+				memcpy(mSurfaceZ + offset + y * mGridsPerEdge, &heights[offset + y * mGridsPerEdge],
+					   mGridsPerPatchEdge * sizeof(F32));
+			}
+			onPatchHeightsChanged(patchp);
+			patchp->mHasCachedData = TRUE;
+		}
 	}
 }
 
@@ -1018,6 +1156,7 @@ void LLSurface::createPatchData()
 		{
 			patchp = getPatch(i, j);
 			patchp->mHasReceivedData = FALSE;
+			patchp->mHasCachedData = FALSE;
 			patchp->mSTexUpdate = TRUE;
 
 			S32 data_offset = i * mGridsPerPatchEdge + j * mGridsPerPatchEdge * mGridsPerEdge;
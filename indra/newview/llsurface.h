@@ -92,6 +92,12 @@ public:
 	void disconnectAllNeighbors();
 
 	virtual void decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch);
+
+	// Region warm start, see LLRegionCacheThread. received gets one flag per patch.
+	void getPatchHeights(std::vector<F32>& heights, std::vector<U8>& received) const;
+	// Fills the patches the simulator hasn't sent yet with heights saved earlier.
+	// They count as cached, not received, so getPatchHeights() leaves them out.
+	void setCachedHeights(const std::vector<F32>& heights, const std::vector<U8>& received);
 	virtual void updatePatchVisibilities(LLAgent &agent);
 
 	inline F32 getZ(const U32 k) const				{ return mSurfaceZ[k]; }
@@ -195,6 +201,10 @@ protected:
 	
 	LLSurfacePatch *getPatch(const S32 x, const S32 y) const;
 
+	// Brings the edges shared with the neighbours up to date after new heights
+	// were written into patchp.
+	void onPatchHeightsChanged(LLSurfacePatch *patchp);
+
 protected:
 	LLVector3d	mOriginGlobal;		// In absolute frame
 	LLSurfacePatch *mPatchList;		// Array of all patches
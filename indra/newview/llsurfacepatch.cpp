@@ -54,6 +54,7 @@ extern LLPipeline gPipeline;
 
 LLSurfacePatch::LLSurfacePatch() :
 	mHasReceivedData(FALSE),
+	mHasCachedData(FALSE),
 	mSTexUpdate(FALSE),
 	mDirty(FALSE),
 	mDirtyZStats(TRUE),
@@ -61,6 +62,7 @@ LLSurfacePatch::LLSurfacePatch() :
 	mDataOffset(0),
 	mDataZ(NULL),
 	mDataNorm(NULL),
+	mVertexCacheValid(FALSE),
 	mVObjp(NULL),
 	mOriginRegion(0.f, 0.f, 0.f),
 	mCenterRegion(0.f, 0.f, 0.f),
@@ -110,6 +112,7 @@ void LLSurfacePatch::dirty()
 
 	mDirtyZStats = TRUE;
 	mHeightsGenerated = FALSE;
+	mVertexCacheValid = FALSE;
 	
 	if (!mDirty)
 	{
@@ -206,31 +209,28 @@ LLVector2 LLSurfacePatch::getTexCoords(const U32 x, const U32 y) const
 }
 
 
-void LLSurfacePatch::eval(const U32 x, const U32 y, const U32 stride, LLVector3 *vertex, LLVector3 *normal,
-						  LLVector2 *tex0, LLVector2 *tex1)
+void LLSurfacePatch::evalVertex(const U32 x, const U32 y, LLSurfaceVertex &vertex) const
 {
 	if (!mSurfacep || !mSurfacep->getRegion() || !mSurfacep->getGridsPerEdge())
 	{
 		return; // failsafe
 	}
-	llassert_always(vertex && normal && tex0 && tex1);
-	
+
 	U32 surface_stride = mSurfacep->getGridsPerEdge();
 	U32 point_offset = x + y*surface_stride;
 
-	*normal = getNormal(x, y);
+	vertex.mNormal = getNormal(x, y);
 
-	LLVector3 pos_agent = getOriginAgent();
-	pos_agent.mV[VX] += x * mSurfacep->getMetersPerGrid();
-	pos_agent.mV[VY] += y * mSurfacep->getMetersPerGrid();
-	pos_agent.mV[VZ]  = *(mDataZ + point_offset);
-	*vertex     = pos_agent;
+	vertex.mPosition.mV[VX] = x * mSurfacep->getMetersPerGrid();
+	vertex.mPosition.mV[VY] = y * mSurfacep->getMetersPerGrid();
+	vertex.mPosition.mV[VZ] = *(mDataZ + point_offset);
 
-	LLVector3 rel_pos = pos_agent - mSurfacep->getOriginAgent();
+	// Detail texture coordinates are relative to the surface origin.
+	LLVector3 rel_pos = mOriginRegion + vertex.mPosition;
 	LLVector3 tex_pos = rel_pos * (1.f/surface_stride);
-	tex0->mV[0]  = tex_pos.mV[0];
-	tex0->mV[1]  = tex_pos.mV[1];
-	tex1->mV[0] = mSurfacep->getRegion()->getCompositionXY(llfloor(mOriginRegion.mV[0])+x, llfloor(mOriginRegion.mV[1])+y);
+	vertex.mTexCoord0.mV[0] = tex_pos.mV[0];
+	vertex.mTexCoord0.mV[1] = tex_pos.mV[1];
+	vertex.mTexCoord1.mV[0] = mSurfacep->getRegion()->getCompositionXY(llfloor(mOriginRegion.mV[0])+x, llfloor(mOriginRegion.mV[1])+y);
 
 	const F32 xyScale = 4.9215f*7.f; //0.93284f;
 	const F32 xyScaleInv = (1.f / xyScale)*(0.2222222222f);
@@ -241,9 +241,32 @@ void LLSurfacePatch::eval(const U32 x, const U32 y, const U32 stride, LLVector3
 					0.f
 				};
 	F32 rand_val = llclamp(noise2(vec)* 0.75f + 0.5f, 0.f, 1.f);
-	tex1->mV[1] = rand_val;
+	vertex.mTexCoord1.mV[1] = rand_val;
+}
 
+void LLSurfacePatch::updateVertexCache()
+{
+	U32 points_per_edge = mSurfacep->getGridsPerPatchEdge() + 1;
+	mVertexCache.resize(points_per_edge*points_per_edge);
 
+	LLSurfaceVertex* vertexp = &mVertexCache[0];
+	for (U32 y = 0; y < points_per_edge; y++)
+	{
+		for (U32 x = 0; x < points_per_edge; x++)
+		{
+			evalVertex(x, y, *(vertexp++));
+		}
+	}
+	mVertexCacheValid = TRUE;
+}
+
+const LLSurfaceVertex *LLSurfacePatch::getVertexCache()
+{
+	if (!mVertexCacheValid)
+	{
+		updateVertexCache();
+	}
+	return &mVertexCache[0];
 }
 
 
@@ -530,7 +553,7 @@ void LLSurfacePatch::updateNormals()
 				}
 				else
 				{
-					if (getNeighborPatch(EAST)->getHasReceivedData())
+					if (getNeighborPatch(EAST)->hasHeights())
 					{
 						// East, but not north.  Pull from your east neighbor's northwest point.
 						*(mDataZ + grids_per_patch_edge + grids_per_patch_edge*grids_per_edge) =
@@ -555,7 +578,7 @@ void LLSurfacePatch::updateNormals()
 				}
 				else
 				{
-					if (getNeighborPatch(NORTH)->getHasReceivedData())
+					if (getNeighborPatch(NORTH)->hasHeights())
 					{
 						// North, but not east.  Pull from your north neighbor's southeast corner.
 						*(mDataZ + grids_per_patch_edge + grids_per_patch_edge*grids_per_edge) =
@@ -607,6 +630,21 @@ void LLSurfacePatch::updateNormals()
 
 	if (dirty_patch)
 	{
+		// Our west and south edges are the east and north edges of those
+		// neighbours, their cached vertices have the same normals.
+		mVertexCacheValid = FALSE;
+		if (getNeighborPatch(WEST))
+		{
+			getNeighborPatch(WEST)->dirtyVertexCache();
+		}
+		if (getNeighborPatch(SOUTH))
+		{
+			getNeighborPatch(SOUTH)->dirtyVertexCache();
+		}
+		if (getNeighborPatch(SOUTHWEST))
+		{
+			getNeighborPatch(SOUTHWEST)->dirtyVertexCache();
+		}
 		mSurfacep->dirtySurfacePatch(this);
 	}
 
@@ -639,6 +677,8 @@ void LLSurfacePatch::updateEastEdge()
 		return;
 	}
 
+	mVertexCacheValid = FALSE;
+
 	// If patchp is on the east edge of its surface, then we update the east
 	// side buffer
 	for (j=0; j < grids_per_patch_edge; j++)
@@ -672,6 +712,8 @@ void LLSurfacePatch::updateNorthEdge()
 		return;
 	}
 
+	mVertexCacheValid = FALSE;
+
 	// Update patchp's north edge ...
 	for (i=0; i<grids_per_patch_edge; i++)
 	{
@@ -687,10 +729,10 @@ BOOL LLSurfacePatch::updateTexture()
 		F32 meters_per_grid = getSurface()->getMetersPerGrid();
 		F32 grids_per_patch_edge = (F32)getSurface()->getGridsPerPatchEdge();
 
-		if ((!getNeighborPatch(EAST) || getNeighborPatch(EAST)->getHasReceivedData())
-			&& (!getNeighborPatch(WEST) || getNeighborPatch(WEST)->getHasReceivedData())
-			&& (!getNeighborPatch(SOUTH) || getNeighborPatch(SOUTH)->getHasReceivedData())
-			&& (!getNeighborPatch(NORTH) || getNeighborPatch(NORTH)->getHasReceivedData()))
+		if ((!getNeighborPatch(EAST) || getNeighborPatch(EAST)->hasHeights())
+			&& (!getNeighborPatch(WEST) || getNeighborPatch(WEST)->hasHeights())
+			&& (!getNeighborPatch(SOUTH) || getNeighborPatch(SOUTH)->hasHeights())
+			&& (!getNeighborPatch(NORTH) || getNeighborPatch(NORTH)->hasHeights()))
 		{
 			LLViewerRegion *regionp = getSurface()->getRegion();
 			LLVector3d origin_region = getOriginGlobal() - getSurface()->getOriginGlobal();
@@ -713,6 +755,7 @@ BOOL LLSurfacePatch::updateTexture()
 			
 			if (comp->generateComposition())
 			{
+				mVertexCacheValid = FALSE;
 				if (mVObjp)
 				{
 					mVObjp->dirtyGeom();
@@ -33,10 +33,13 @@
 #ifndef LL_LLSURFACEPATCH_H
 #define LL_LLSURFACEPATCH_H
 
+#include "v2math.h"
 #include "v3math.h"
 #include "v3dmath.h"
 #include "llpointer.h"
 
+#include <vector>
+
 class LLSurface;
 class LLVOSurfacePatch;
 class LLVector2;
@@ -64,6 +67,16 @@ public:
 
 
 
+// Renderable attributes of one grid point of a patch. None of them depend on
+// the render stride, so every LOD and edge stitching variant shares them.
+struct LLSurfaceVertex
+{
+	LLVector3 mPosition;	// x and y relative to the patch origin
+	LLVector3 mNormal;
+	LLVector2 mTexCoord0;
+	LLVector2 mTexCoord1;
+};
+
 class LLSurfacePatch 
 {
 public:
@@ -95,6 +108,8 @@ public:
 	void dirtyZ(); // Dirty the z values of this patch
 	void setHasReceivedData();
 	BOOL getHasReceivedData() const;
+	// Heights from the simulator, or saved earlier and shown until it sends them.
+	BOOL hasHeights() const						{ return mHasReceivedData || mHasCachedData; }
 
 	F32 getDistance() const;
 	F32 getMaxZ() const;
@@ -111,10 +126,15 @@ public:
 	void calcNormal(const U32 x, const U32 y, const U32 stride);
 	const LLVector3 &getNormal(const U32 x, const U32 y) const;
 
-	void eval(const U32 x, const U32 y, const U32 stride,
-				LLVector3 *vertex, LLVector3 *normal, LLVector2 *tex0, LLVector2 *tex1);
-	
-	
+	void evalVertex(const U32 x, const U32 y, LLSurfaceVertex &vertex) const;
+
+	// Vertices of all (grids per patch edge + 1)^2 grid points, row by row.
+	// Rebuilt after the heights, normals or composition change; reads only
+	// patch and region data, so patches can be rebuilt on the geometry workers.
+	void updateVertexCache();
+	void dirtyVertexCache()						{ mVertexCacheValid = FALSE; }
+	BOOL hasVertexCache() const					{ return mVertexCacheValid; }
+	const LLSurfaceVertex *getVertexCache();	// updates it first if needed
 
 	LLVector3 getOriginAgent() const;
 	const LLVector3d &getOriginGlobal() const;
@@ -146,6 +166,7 @@ public:
 
 public:
 	BOOL mHasReceivedData;	// has the patch EVER received height data?
+	BOOL mHasCachedData;	// heights from the region cache, see LLSurface::setCachedHeights()
 	BOOL mSTexUpdate;		// Does the surface texture need to be updated?
 
 protected:
@@ -160,6 +181,9 @@ protected:
 	F32 *mDataZ;
 	LLVector3 *mDataNorm;
 
+	std::vector<LLSurfaceVertex> mVertexCache;
+	BOOL mVertexCacheValid;
+
 	// Pointer to the LLVOSurfacePatch object which is used in the new renderer.
 	LLPointer<LLVOSurfacePatch> mVObjp;
 
@@ -0,0 +1,195 @@
+/**
+ * @file llterraincompositethread.cpp
+ * @brief Background blending of the low detail terrain texture.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llterraincompositethread.h"
+
+#include "llmath.h"
+
+//----------------------------------------------------------------------------
+
+LLTerrainCompositeThread::CompositeRequest::CompositeRequest(handle_t handle, U32 priority,
+															 const Params& params, LLImageRaw* target)
+	: LLQueuedThread::QueuedRequest(handle, priority),
+	  mParams(params),
+	  mTarget(target)
+{
+}
+
+LLTerrainCompositeThread::CompositeRequest::~CompositeRequest()
+{
+	mTarget = NULL;
+}
+
+// Called from the worker thread
+bool LLTerrainCompositeThread::CompositeRequest::processRequest()
+{
+	compositeTexels(mParams, mTarget->getData(), mTarget->getWidth(), this);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+LLTerrainCompositeThread::LLTerrainCompositeThread(bool threaded)
+	: LLQueuedThread("terraincomposite", threaded)
+{
+}
+
+LLTerrainCompositeThread::~LLTerrainCompositeThread()
+{
+}
+
+LLQueuedThread::handle_t LLTerrainCompositeThread::composite(const Params& params, LLImageRaw* target)
+{
+	handle_t handle = generateHandle();
+	CompositeRequest* req = new CompositeRequest(handle, LLQueuedThread::PRIORITY_NORMAL, params, target);
+	if (!addRequest(req))
+	{
+		req->deleteRequest();
+		return nullHandle();
+	}
+	return handle;
+}
+
+// Wraps a detail texture coordinate into [0, size).
+static inline S32 wrap_detail(F32 coord, S32 size)
+{
+	coord -= size * llfloor(coord / size);
+	return llclamp(lltrunc(coord), 0, size - 1);
+}
+
+//static
+bool LLTerrainCompositeThread::compositeTexels(const Params& params, U8* target, S32 target_width,
+											   const QueuedRequest* requestp)
+{
+	const S32 comps = 3;
+	const S32 count = params.mXEnd - params.mXBegin;
+	if (count <= 0 || params.mYEnd <= params.mYBegin)
+	{
+		return true;
+	}
+
+	const U8* detail[DETAIL_COUNT];
+	for (S32 i = 0; i < DETAIL_COUNT; i++)
+	{
+		detail[i] = params.mDetail[i]->getData();
+	}
+
+	const F32* composition = &params.mComposition[0];
+	const S32 max_comp_index = params.mCompositionWidth - 1;
+
+	// The composition samples and detail texels of a column are the same on
+	// every row, look them up once. Padded to whole quads.
+	const S32 padded = (count + 3) & ~3;
+	std::vector<S32> x_left(padded, 0);
+	std::vector<S32> x_right(padded, 0);
+	std::vector<F32> x_frac(padded, 0.f);
+	std::vector<S32> detail_x(padded, 0);
+	for (S32 c = 0; c < count; c++)
+	{
+		S32 i = params.mXBegin + c;
+		F32 x = (i * params.mTexelRatioX) * params.mCompositionScaleInv;
+		S32 x1 = llfloor(x);
+		x_frac[c] = x - x1;
+		x_left[c] = llclamp(x1, 0, max_comp_index);
+		x_right[c] = llclamp(x1 + 1, 0, max_comp_index);
+		detail_x[c] = wrap_detail(i * params.mDetailStrideX, params.mDetailSize) * comps;
+	}
+
+	const LLQuad zero = _mm_setzero_ps();
+	const LLQuad one = _mm_set1_ps(1.f);
+	const LLQuad max_detail = _mm_set1_ps((F32)(DETAIL_COUNT - 1));
+	LL_ALIGN_16(S32 lower[4]);
+	LL_ALIGN_16(F32 weight[4]);
+
+	for (S32 j = params.mYBegin; j < params.mYEnd; j++)
+	{
+		if (requestp && (requestp->getFlags() & LLQueuedThread::FLAG_ABORT))
+		{
+			return false;
+		}
+
+		F32 y = (j * params.mTexelRatioY) * params.mCompositionScaleInv;
+		S32 y1 = llfloor(y);
+		LLVector4a y_frac;
+		y_frac.splat(y - y1);
+		const F32* row1 = composition + llclamp(y1, 0, max_comp_index) * params.mCompositionWidth;
+		const F32* row2 = composition + llclamp(y1 + 1, 0, max_comp_index) * params.mCompositionWidth;
+
+		const S32 detail_row = wrap_detail(j * params.mDetailStrideY, params.mDetailSize) * params.mDetailSize * comps;
+		U8* dst = target + (j * target_width + params.mXBegin) * comps;
+
+		for (S32 c = 0; c < count; c += 4)
+		{
+			// Bilinear composition of four texels, same math as getValueScaled()
+			LLVector4a left1, right1, left2, right2, frac, delta, interp1, interp2, value;
+			left1.set(row1[x_left[c]], row1[x_left[c+1]], row1[x_left[c+2]], row1[x_left[c+3]]);
+			right1.set(row1[x_right[c]], row1[x_right[c+1]], row1[x_right[c+2]], row1[x_right[c+3]]);
+			left2.set(row2[x_left[c]], row2[x_left[c+1]], row2[x_left[c+2]], row2[x_left[c+3]]);
+			right2.set(row2[x_right[c]], row2[x_right[c+1]], row2[x_right[c+2]], row2[x_right[c+3]]);
+			frac.loadua(&x_frac[c]);
+
+			delta.setSub(left1, right1);
+			delta.mul(frac);
+			interp1.setSub(left1, delta);
+			delta.setSub(left2, right2);
+			delta.mul(frac);
+			interp2.setSub(left2, delta);
+			delta.setSub(interp1, interp2);
+			delta.mul(y_frac);
+			value.setSub(interp1, delta);
+
+			// Lower detail texture is floor(value) clamped to [0, 3], the
+			// remainder is the weight of the next one.
+			LLQuad floored = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+			floored = _mm_sub_ps(floored, _mm_and_ps(_mm_cmpgt_ps(floored, value), one));
+			floored = _mm_min_ps(_mm_max_ps(floored, zero), max_detail);
+			_mm_store_si128((__m128i*)lower, _mm_cvttps_epi32(floored));
+			_mm_store_ps(weight, _mm_sub_ps(value, floored));
+
+			S32 texels = llmin(4, count - c);
+			for (S32 k = 0; k < texels; k++)
+			{
+				S32 offset = detail_row + detail_x[c + k];
+				const U8* a = detail[lower[k]] + offset;
+				const U8* b = detail[llmin(lower[k] + 1, DETAIL_COUNT - 1)] + offset;
+				F32 w = weight[k];
+				dst[0] = (U8)lltrunc(a[0] + w * (b[0] - a[0]));
+				dst[1] = (U8)lltrunc(a[1] + w * (b[1] - a[1]));
+				dst[2] = (U8)lltrunc(a[2] + w * (b[2] - a[2]));
+				dst += comps;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file llterraincompositethread.h
+ * @brief Background blending of the low detail terrain texture.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTERRAINCOMPOSITETHREAD_H
+#define LL_LLTERRAINCOMPOSITETHREAD_H
+
+#include "llimage.h"
+#include "llpointer.h"
+#include "llqueuedthread.h"
+
+#include <vector>
+
+// Blends the four detail textures of a region into its low detail terrain
+// texture according to the composition layer. Requests carry copies of
+// everything they read, so a region can be dropped while its request runs;
+// LLVLComposition aborts it then.
+class LLTerrainCompositeThread : public LLQueuedThread
+{
+public:
+	enum { DETAIL_COUNT = 4 };
+
+	struct Params
+	{
+		LLPointer<LLImageRaw> mDetail[DETAIL_COUNT]; // all mDetailSize^2, 3 components
+		S32 mDetailSize;
+
+		std::vector<F32> mComposition; // mCompositionWidth^2 values
+		S32 mCompositionWidth;
+		F32 mCompositionScaleInv;
+
+		// Composition layer position of a texel is (x * mTexelRatioX, y * mTexelRatioY),
+		// detail texture position is (x * mDetailStrideX, y * mDetailStrideY) wrapped.
+		F32 mTexelRatioX;
+		F32 mTexelRatioY;
+		F32 mDetailStrideX;
+		F32 mDetailStrideY;
+
+		// Texels to blend, end exclusive. The rest of the target is left as is.
+		S32 mXBegin;
+		S32 mYBegin;
+		S32 mXEnd;
+		S32 mYEnd;
+	};
+
+	class CompositeRequest : public LLQueuedThread::QueuedRequest
+	{
+		friend class LLTerrainCompositeThread;
+
+	protected:
+		virtual ~CompositeRequest(); // use deleteRequest()
+
+	public:
+		CompositeRequest(handle_t handle, U32 priority, const Params& params, LLImageRaw* target);
+
+		/*virtual*/ bool processRequest();
+
+		LLImageRaw* getTarget() const { return mTarget; }
+		const Params& getParams() const { return mParams; }
+
+	private:
+		Params mParams;
+		LLPointer<LLImageRaw> mTarget;
+	};
+
+public:
+	LLTerrainCompositeThread(bool threaded = true);
+	virtual ~LLTerrainCompositeThread();
+
+	// Queues blending into target, which must be the size of the terrain texture.
+	handle_t composite(const Params& params, LLImageRaw* target);
+
+	// Blends the texels of params into target (3 components, target_width
+	// texels wide). Returns false when requestp got aborted half way.
+	static bool compositeTexels(const Params& params, U8* target, S32 target_width,
+								const QueuedRequest* requestp = NULL);
+};
+
+#endif // LL_LLTERRAINCOMPOSITETHREAD_H
@@ -36,11 +36,14 @@
 #include "llagent.h"
 #include "llagentcamera.h"
 #include "llagentwearables.h"
+#include "llappviewer.h"
+#include "llcallbacklist.h"
 #include "llcrc.h"
 #include "lldir.h"
 #include "llglheaders.h"
 #include "llimagebmp.h"
 #include "llimagej2c.h"
+#include "llimageworker.h"
 #include "llimagetga.h"
 #include "llpolymorph.h"
 #include "llquantize.h"
@@ -66,6 +69,37 @@ using namespace LLVOAvatarDefines;
 
 const S32 MAX_BAKE_UPLOAD_ATTEMPTS = 4;
 
+// Keeps a bake while it is encoded on the image encode thread.
+class LLBakeEncodeResponder : public LLImageEncodeThread::Responder
+{
+public:
+	LLBakeEncodeResponder(const LLTransactionID& tid, LLBakedUploadData* baked_upload_data)
+		: mTransactionID(tid), mUploadData(baked_upload_data), mDone(FALSE), mSuccess(false) {}
+	~LLBakeEncodeResponder() { delete mUploadData; }
+
+	// Encode thread
+	/*virtual*/ void completed(bool success, LLImageFormatted* image)
+	{
+		mImage = (LLImageJ2C*)image;
+		mSuccess = success;
+		mDone = TRUE;
+	}
+
+	// Main thread, once isDone()
+	BOOL isDone() const { return mDone; }
+	bool getSuccess() const { return mSuccess; }
+	LLImageJ2C* getImage() const { return mImage; }
+	const LLTransactionID& getTransactionID() const { return mTransactionID; }
+	LLBakedUploadData* takeUploadData() { LLBakedUploadData* data = mUploadData; mUploadData = NULL; return data; }
+
+private:
+	LLTransactionID mTransactionID;
+	LLBakedUploadData* mUploadData;
+	LLPointer<LLImageJ2C> mImage;
+	LLAtomic32<BOOL> mDone;
+	bool mSuccess;
+};
+
 // static
 S32 LLTexLayerSetBuffer::sGLByteCount = 0;
 
@@ -387,80 +421,128 @@ void LLTexLayerSetBuffer::readBackAndUpload()
 		}
 	}
 	
+	delete [] baked_color_data;
+
+	// Compressing a bake takes long enough to cause a visible hitch: encode it on
+	// the image encode thread and upload it from the idle loop once it is done.
+	LLTransactionID tid;
+	tid.generate();
+	const LLAssetID asset_id = tid.makeAssetID(gAgent.getSecureSessionID());
+	mUploadID = asset_id;
+	mNeedsUpload = FALSE;
+
+	// baked_upload_data records the wearables this bake was made from, so create it now
+	LLBakedUploadData* baked_upload_data =
+		new LLBakedUploadData( gAgentAvatarp, this->mTexLayerSet, this, asset_id );
+
 	LLPointer<LLImageJ2C> compressedImage = new LLImageJ2C;
 	compressedImage->setRate(0.f);
-	const char* comment_text = LINDEN_J2C_COMMENT_PREFIX "RGBHM"; // writes into baked_color_data. 5 channels (rgb, heightfield/alpha, mask)
-	if (compressedImage->encode(baked_image, comment_text))
-	{
-		LLTransactionID tid;
-		tid.generate();
-		const LLAssetID asset_id = tid.makeAssetID(gAgent.getSecureSessionID());
-		if (LLVFile::writeFile(compressedImage->getData(), compressedImage->getDataSize(),
-							   gVFS, asset_id, LLAssetType::AT_TEXTURE))
-		{
-			// Read back the file and validate.
-			BOOL valid = FALSE;
-			LLPointer<LLImageJ2C> integrity_test = new LLImageJ2C;
-			S32 file_size = 0;
-			U8* data = LLVFile::readFile(gVFS, LLImageBase::getPrivatePool(), asset_id, LLAssetType::AT_TEXTURE, &file_size);
-			if (data)
-			{
-				valid = integrity_test->validate(data, file_size); // integrity_test will delete 'data'
-			}
-			else
-			{
-				integrity_test->setLastError("Unable to read entire file");
-			}
-			
-			if( valid )
-			{
-				// baked_upload_data is owned by the responder and deleted after the request completes
-				LLBakedUploadData* baked_upload_data =
-					new LLBakedUploadData( gAgentAvatarp, this->mTexLayerSet, this, asset_id );
-				mUploadID = asset_id;
-				
-				// Upload the image
-				const std::string url = gAgent.getRegion()->getCapability("UploadBakedTexture");
-				if(!url.empty()
-					&& !LLPipeline::sForceOldBakedUpload) // toggle debug setting UploadBakedTexOld to change between the new caps method and old method
-				{
-					LLSD body = LLSD::emptyMap();
-					// The responder will call LLTexLayerSetBuffer::onTextureUploadComplete()
-					LLHTTPClient::post(url, body, new LLSendTexLayerResponder(body, mUploadID, LLAssetType::AT_TEXTURE, baked_upload_data));
-					llinfos << "Baked texture upload via capability of " << mUploadID << " to " << url << llendl;
-				} 
-				else
-				{
-					gAssetStorage->storeAssetData(tid,
-												  LLAssetType::AT_TEXTURE,
-												  LLTexLayerSetBuffer::onTextureUploadComplete,
-												  baked_upload_data,
-												  TRUE,		// temp_file
-												  TRUE,		// is_priority
-												  TRUE);	// store_local
-					llinfos << "Baked texture upload via Asset Store." <<  llendl;
-				}
-		
-				mNeedsUpload = FALSE;
-			}
-			else
-			{
-				// The read back and validate operation failed.  Remove the uploaded file.
-				mUploadPending = FALSE;
-				LLVFile file(gVFS, asset_id, LLAssetType::AT_TEXTURE, LLVFile::WRITE);
-				file.remove();
-				llinfos << "Unable to create baked upload file (reason: corrupted)." << llendl;
-			}
+	LLPointer<LLBakeEncodeResponder> responder = new LLBakeEncodeResponder(tid, baked_upload_data);
+	LLAppViewer::getImageEncodeThread()->encodeImage(baked_image, compressedImage, LLQueuedThread::PRIORITY_HIGH, responder,
+													  LINDEN_J2C_COMMENT_PREFIX "RGBHM"); // 5 channels (rgb, heightfield/alpha, mask)
+	doOnIdleRepeating(boost::bind(&LLTexLayerSetBuffer::onBakeEncodeIdle, responder));
+}
+
+// static
+bool LLTexLayerSetBuffer::onBakeEncodeIdle(LLBakeEncodeResponder* responder)
+{
+	if (!responder->isDone())
+	{
+		return false;
+	}
+
+	LLBakedUploadData* baked_upload_data = responder->takeUploadData();
+	// The avatar may be gone, or the bake canceled or redone, while it was being encoded.
+	if (isAgentAvatarValid() &&
+		!gAgentAvatarp->isDead() &&
+		(baked_upload_data->mAvatar == gAgentAvatarp) &&
+		(baked_upload_data->mTexLayerSet->hasComposite()) &&
+		(baked_upload_data->mTexLayerSet->getComposite()->mUploadID == baked_upload_data->mID) &&
+		(baked_upload_data->mTexLayerSet->getComposite()->mUploadPending))
+	{
+		LLTexLayerSetBuffer* layerset_buffer = baked_upload_data->mTexLayerSet->getComposite();
+		if (responder->getSuccess())
+		{
+			layerset_buffer->uploadBakedImage(responder->getTransactionID(), responder->getImage(), baked_upload_data);
+			return true;
 		}
+		// Try again on the next render, as a failed synchronous encode used to.
+		layerset_buffer->mUploadPending = FALSE;
+		layerset_buffer->mNeedsUpload = TRUE;
+		layerset_buffer->mUploadID.setNull();
+		llinfos << "Unable to create baked upload file (reason: failed to encode image)" << llendl;
 	}
-	else
+	delete baked_upload_data;
+	return true;
+}
+
+// Takes ownership of baked_upload_data.
+void LLTexLayerSetBuffer::uploadBakedImage(const LLTransactionID& tid, LLImageJ2C* compressedImage, LLBakedUploadData* baked_upload_data)
+{
+	const LLAssetID& asset_id = baked_upload_data->mID;
+	if (!LLVFile::writeFile(compressedImage->getData(), compressedImage->getDataSize(),
+							gVFS, asset_id, LLAssetType::AT_TEXTURE))
 	{
 		// The VFS write file operation failed.
 		mUploadPending = FALSE;
+		mNeedsUpload = TRUE;
+		mUploadID.setNull();
+		delete baked_upload_data;
 		llinfos << "Unable to create baked upload file (reason: failed to write file)" << llendl;
+		return;
 	}
 
-	delete [] baked_color_data;
+	// Read back the file and validate.
+	BOOL valid = FALSE;
+	LLPointer<LLImageJ2C> integrity_test = new LLImageJ2C;
+	S32 file_size = 0;
+	U8* data = LLVFile::readFile(gVFS, LLImageBase::getPrivatePool(), asset_id, LLAssetType::AT_TEXTURE, &file_size);
+	if (data)
+	{
+		valid = integrity_test->validate(data, file_size); // integrity_test will delete 'data'
+	}
+	else
+	{
+		integrity_test->setLastError("Unable to read entire file");
+	}
+
+	if( valid )
+	{
+		// baked_upload_data is owned by the responder and deleted after the request completes
+
+		// Upload the image
+		const std::string url = gAgent.getRegion()->getCapability("UploadBakedTexture");
+		if(!url.empty()
+			&& !LLPipeline::sForceOldBakedUpload) // toggle debug setting UploadBakedTexOld to change between the new caps method and old method
+		{
+			LLSD body = LLSD::emptyMap();
+			// The responder will call LLTexLayerSetBuffer::onTextureUploadComplete()
+			LLHTTPClient::post(url, body, new LLSendTexLayerResponder(body, mUploadID, LLAssetType::AT_TEXTURE, baked_upload_data));
+			llinfos << "Baked texture upload via capability of " << mUploadID << " to " << url << llendl;
+		} 
+		else
+		{
+			gAssetStorage->storeAssetData(tid,
+										  LLAssetType::AT_TEXTURE,
+										  LLTexLayerSetBuffer::onTextureUploadComplete,
+										  baked_upload_data,
+										  TRUE,		// temp_file
+										  TRUE,		// is_priority
+										  TRUE);	// store_local
+			llinfos << "Baked texture upload via Asset Store." <<  llendl;
+		}
+	}
+	else
+	{
+		// The read back and validate operation failed.  Remove the uploaded file.
+		mUploadPending = FALSE;
+		mNeedsUpload = TRUE;
+		mUploadID.setNull();
+		delete baked_upload_data;
+		LLVFile file(gVFS, asset_id, LLAssetType::AT_TEXTURE, LLVFile::WRITE);
+		file.remove();
+		llinfos << "Unable to create baked upload file (reason: corrupted)." << llendl;
+	}
 }
 
 
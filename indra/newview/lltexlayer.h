@@ -57,6 +57,9 @@ class LLTexGlobalColorInfo;
 class LLTexLayerParamAlphaInfo;
 class LLTexLayerParamAlpha;
 class LLTexParamColorInfo;
+class LLBakeEncodeResponder;
+class LLBakedUploadData;
+class LLImageJ2C;
 class LLTexParamColor;
 class LLPolyMesh;
 class LLXmlTreeNode;
@@ -226,6 +229,8 @@ public:
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
 	void					readBackAndUpload();
 
+	// Polled from the idle loop until the bake encode thread is done with the image.
+	static bool				onBakeEncodeIdle(LLBakeEncodeResponder* responder);
 	static void				onTextureUploadComplete( const LLUUID& uuid,
 													 void* userdata,
 													 S32 result, LLExtStat ext_status);
@@ -239,6 +244,7 @@ private:
 	void					pushProjection() const;
 	void					popProjection() const;
 	BOOL					needsUploadNow() const;
+	void					uploadBakedImage(const LLTransactionID& tid, LLImageJ2C* compressedImage, LLBakedUploadData* baked_upload_data);
 
 private:
 	BOOL					mNeedsUpdate;
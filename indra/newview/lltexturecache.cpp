@@ -104,6 +104,8 @@ public:
 		  mImageSize(imagesize),
 		  mImageFormat(IMG_CODEC_J2C),
 		  mImageLocal(FALSE),
+		  mDiscardLevel(-1),
+		  mCachedBodySize(0),
 		  mResponder(responder),
 		  mFileHandle(LLLFSThread::nullHandle()),
 		  mBytesToRead(0),
@@ -126,6 +128,7 @@ public:
 	handle_t read() { addWork(0, LLWorkerThread::PRIORITY_HIGH | mPriority); return mRequestHandle; }
 	handle_t write() { addWork(1, LLWorkerThread::PRIORITY_HIGH | mPriority); return mRequestHandle; }
 	bool complete() { return checkWork(); }
+	void setDiscardLevel(S32 discardlevel) { mDiscardLevel = discardlevel; }
 	void ioComplete(S32 bytes)
 	{
 		mBytesRead = bytes;
@@ -149,6 +152,8 @@ protected:
 	S32 mImageSize;
 	EImageCodec mImageFormat;
 	BOOL mImageLocal;
+	S32 mDiscardLevel; // discard level covered by the data read or written, -1 if unknown
+	S32 mCachedBodySize; // writes: size of the valid body prefix already on disk
 	LLPointer<LLTextureCache::Responder> mResponder;
 	LLLFSThread::handle_t mFileHandle;
 	S32 mBytesToRead;
@@ -320,6 +325,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 {
 	bool done = false;
 	S32 idx = -1;
+	S32 cached_size = 0;
 
 	S32 local_size = 0;
 	std::string local_filename;
@@ -413,6 +419,9 @@ bool LLTextureCacheRemoteWorker::doRead()
 		else
 		{
 			mImageSize = entry.mImageSize;
+			mDiscardLevel = entry.mDiscardLevel;
+			cached_size = entry.mBodySize > 0 ? TEXTURE_CACHE_ENTRY_SIZE + entry.mBodySize
+											  : llmin(TEXTURE_CACHE_ENTRY_SIZE, entry.mImageSize);
 			// If the read offset is bigger than the header cache, we read directly from the body
 			// Note that currently, we *never* read with offset from the cache, so the result is *always* HEADER
 			mState = mOffset < TEXTURE_CACHE_ENTRY_SIZE ? HEADER : BODY;
@@ -520,6 +529,12 @@ bool LLTextureCacheRemoteWorker::doRead()
 		done = true;
 	}
 
+	// The cached discard level only holds when the whole valid prefix was handed back
+	if (done && (mDataSize <= 0 || mOffset + mDataSize < cached_size))
+	{
+		mDiscardLevel = -1;
+	}
+
 	// Clean up and exit
 	return done;
 }
@@ -555,14 +570,26 @@ bool LLTextureCacheRemoteWorker::doWrite()
 		idx = mCache->getHeaderCacheEntry(mID, entry);
 		if(idx < 0)
 		{
-			idx = mCache->setHeaderCacheEntry(mID, entry, mImageSize, mDataSize); // create the new entry.
+			idx = mCache->setHeaderCacheEntry(mID, entry, mImageSize, mDataSize, mDiscardLevel); // create the new entry.
+		}
+		else if (entry.mBodySize > 0 && entry.mBodySize >= mDataSize - TEXTURE_CACHE_ENTRY_SIZE)
+		{
+			// The cache already holds at least this much of the texture: keep the longer prefix,
+			// but refresh the entry so that the purge still sees it in use.
+			mCache->touchEntry(idx, entry, mImageSize);
+			done = true;
 		}
 		else
 		{
-			alreadyCached = mCache->updateEntry(idx, entry, mImageSize, mDataSize); // update the existing entry.
+			mCachedBodySize = entry.mBodySize; // the valid prefix on disk, the body only needs the suffix
+			alreadyCached = mCache->updateEntry(idx, entry, mImageSize, mDataSize, mDiscardLevel); // update the existing entry.
 		}
 
-		if (idx < 0)
+		if (done)
+		{
+			// nothing to write
+		}
+		else if (idx < 0)
 		{
 			llwarns << "LLTextureCacheWorker: "  << mID
 					<< " Unable to create header entry for writing!" << llendl;
@@ -578,8 +605,9 @@ bool LLTextureCacheRemoteWorker::doWrite()
 			}
 			else
 			{
-				// If the texture has already been cached, we don't resave the header and go directly to the body part
-				mState = alreadyCached ? BODY : HEADER;
+				// If the texture has already been cached (a body implies a complete header record),
+				// we don't resave the header and go directly to the body part
+				mState = (alreadyCached || mCachedBodySize > 0) ? BODY : HEADER;
 			}
 		}
 	}
@@ -637,15 +665,24 @@ bool LLTextureCacheRemoteWorker::doWrite()
 		{
 			// build the cache file name from the UUID
 			std::string filename = mCache->getTextureFileName(mID);			
+
+			// Texture assets are immutable, so when the body file still holds the valid prefix
+			// recorded in the entry, we only need to append the missing suffix.
+			S32 file_offset = 0;
+			if (mCachedBodySize > 0 && mCachedBodySize < file_size &&
+				LLAPRFile::size(filename) == mCachedBodySize)
+			{
+				file_offset = mCachedBodySize;
+			}
 // 			llinfos << "Writing Body: " << filename << " Bytes: " << file_offset+file_size << llendl;
 			S32 bytes_written = LLAPRFile::writeEx(	filename, 
-													mWriteData + TEXTURE_CACHE_ENTRY_SIZE,
-													0, file_size);
+													mWriteData + TEXTURE_CACHE_ENTRY_SIZE + file_offset,
+													file_offset, file_size - file_offset);
 			if (bytes_written <= 0)
 			{
 				llwarns << "LLTextureCacheWorker: "  << mID
 						<< " incorrect number of bytes written to body: " << bytes_written
-						<< " / " << file_size << llendl;
+						<< " / " << file_size - file_offset << llendl;
 				mDataSize = -1; // failed
 				done = true;
 			}
@@ -689,6 +726,8 @@ void LLTextureCacheWorker::finishWork(S32 param, bool completed)
 			// read
 			if (success)
 			{
+				// reads are always issued with a ReadResponder
+				static_cast<LLTextureCache::ReadResponder*>(mResponder.get())->setDiscardLevel(mDiscardLevel);
 				mResponder->setData(mReadData, mDataSize, mImageSize, mImageFormat, mImageLocal);
 				mReadData = NULL; // responder owns data
 				mDataSize = 0;
@@ -873,7 +912,7 @@ BOOL LLTextureCache::isInLocal(const LLUUID& id)
 
 //static
 const S32 MAX_REASONABLE_FILE_SIZE = 512*1024*1024; // 512 MB
-F32 LLTextureCache::sHeaderCacheVersion = 1.5f;
+F32 LLTextureCache::sHeaderCacheVersion = 1.6f; // 1.6: Entry::mDiscardLevel
 U32 LLTextureCache::sCacheMaxEntries = MAX_REASONABLE_FILE_SIZE / TEXTURE_CACHE_ENTRY_SIZE;
 S64 LLTextureCache::sCacheMaxTexturesSize = 0; // no limit
 const char* entries_filename = "texture.entries";
@@ -1086,6 +1125,7 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 				entry.mID = id;
 				entry.mImageSize = -1; //mark it is a brand-new entry.					
 				entry.mBodySize = 0;
+				entry.mDiscardLevel = -1;
 			}
 		}
 	}
@@ -1189,12 +1229,29 @@ void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 	}
 }
 
+//refresh the time stamp and image size of an entry whose data is kept as is, delay writing.
+void LLTextureCache::touchEntry(S32 idx, Entry& entry, S32 new_image_size)
+{
+	if (idx < 0 || mReadOnly)
+	{
+		return;
+	}
+
+	LLMutexLock lock(&mHeaderMutex);
+	entry.mTime = time(NULL);
+	if (new_image_size > 0)
+	{
+		entry.mImageSize = new_image_size;
+	}
+	mUpdatedEntryMap[idx] = entry;
+}
+
 //update an existing entry, write to header file immediately.
-bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size)
+bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size, S32 new_discard_level)
 {
 	S32 new_body_size = llmax(0, new_data_size - TEXTURE_CACHE_ENTRY_SIZE);
 	
-	if(new_image_size == entry.mImageSize && new_body_size == entry.mBodySize)
+	if(new_image_size == entry.mImageSize && new_body_size == entry.mBodySize && new_discard_level == entry.mDiscardLevel)
 			{
 		return true; //nothing changed.
 			}
@@ -1224,6 +1281,7 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 		entry.mTime = time(NULL);
 		entry.mImageSize = new_image_size; 
 		entry.mBodySize = new_body_size;
+		entry.mDiscardLevel = new_discard_level;
 		
 		writeEntryToHeaderImmediately(idx, entry, update_header);
 	
@@ -1697,7 +1755,7 @@ S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 }
 
 // Writes imagesize to the header, updates timestamp
-S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize)
+S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize, S32 discardlevel)
 {
 	mHeaderMutex.lock();
 	S32 idx = openAndReadEntry(id, entry, true);
@@ -1705,7 +1763,7 @@ S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imag
 
 	if (idx >= 0)
 	{
-		updateEntry(idx, entry, imagesize, datasize);				
+		updateEntry(idx, entry, imagesize, datasize, discardlevel);
 	}
 
 	if(idx < 0) // retry
@@ -1716,7 +1774,7 @@ S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imag
 		llassert_always(!mLRU.empty() || mHeaderEntriesInfo.mEntries < sCacheMaxEntries);
 		mHeaderMutex.unlock();
 
-		idx = setHeaderCacheEntry(id, entry, imagesize, datasize); // assert above ensures no inf. recursion
+		idx = setHeaderCacheEntry(id, entry, imagesize, datasize, discardlevel); // assert above ensures no inf. recursion
 	}
 	return idx;
 }
@@ -1785,7 +1843,7 @@ bool LLTextureCache::readComplete(handle_t handle, bool abort)
 
 LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id, U32 priority,
 													  U8* data, S32 datasize, S32 imagesize,
-													  WriteResponder* responder)
+													  S32 discardlevel, WriteResponder* responder)
 {
 	if (mReadOnly)
 	{
@@ -1804,6 +1862,7 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id, U32 prio
 	LLTextureCacheWorker* worker = new LLTextureCacheRemoteWorker(this, priority, id,
 																  data, datasize, 0,
 																  imagesize, responder);
+	worker->setDiscardLevel(discardlevel);
 	handle_t handle = worker->write();
 	mWriters[handle] = worker;
 	return handle;
@@ -1878,6 +1937,7 @@ void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 
 		entry.mImageSize = -1;
 		entry.mBodySize = 0;
+		entry.mDiscardLevel = -1;
 		mHeaderIDMap.erase(entry.mID);
 		mTexturesSizeMap.erase(entry.mID);
 
@@ -1918,6 +1978,7 @@ bool LLTextureCache::removeFromCache(const LLUUID& id)
 
 LLTextureCache::ReadResponder::ReadResponder()
 	: mImageSize(0),
+	  mDiscardLevel(-1),
 	  mImageLocal(FALSE)
 {
 }
@@ -56,17 +56,19 @@ private:
         	Entry() :
 		        mBodySize(0),
 			mImageSize(0),
-			mTime(0)
+			mTime(0),
+			mDiscardLevel(-1)
 		{
 		}
-		Entry(const LLUUID& id, S32 imagesize, S32 bodysize, U32 time) :
-			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time) {}
-		void init(const LLUUID& id, U32 time) { mID = id, mImageSize = 0; mBodySize = 0; mTime = time; }
-		Entry& operator=(const Entry& entry) { mID = entry.mID, mImageSize = entry.mImageSize; mBodySize = entry.mBodySize; mTime = entry.mTime; return *this; }
+		Entry(const LLUUID& id, S32 imagesize, S32 bodysize, U32 time, S32 discardlevel = -1) :
+			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time), mDiscardLevel(discardlevel) {}
+		void init(const LLUUID& id, U32 time) { mID = id, mImageSize = 0; mBodySize = 0; mTime = time; mDiscardLevel = -1; }
+		Entry& operator=(const Entry& entry) { mID = entry.mID, mImageSize = entry.mImageSize; mBodySize = entry.mBodySize; mTime = entry.mTime; mDiscardLevel = entry.mDiscardLevel; return *this; }
 		LLUUID mID; // 16 bytes
 		S32 mImageSize; // total size of image if known
-		S32 mBodySize; // size of body file in body cache
+		S32 mBodySize; // size of body file in body cache (the valid prefix is header + body)
 		U32 mTime; // seconds since 1/1/1970
+		S32 mDiscardLevel; // lowest discard level the valid prefix decodes to, -1 if unknown
 	};
 
 	
@@ -84,9 +86,11 @@ public:
 		ReadResponder();
 		void setData(U8* data, S32 datasize, S32 imagesize, S32 imageformat, BOOL imagelocal);
 		void setImage(LLImageFormatted* image) { mFormattedImage = image; }
+		void setDiscardLevel(S32 discardlevel) { mDiscardLevel = discardlevel; }
 	protected:
 		LLPointer<LLImageFormatted> mFormattedImage;
 		S32 mImageSize;
+		S32 mDiscardLevel;
 		BOOL mImageLocal;
 	};
 
@@ -113,8 +117,10 @@ public:
 	handle_t readFromCache(const LLUUID& id, U32 priority, S32 offset, S32 size,
 						   ReadResponder* responder);
 	bool readComplete(handle_t handle, bool abort);
+	// discardlevel is the lowest discard level data[0..datasize) decodes to (-1 if unknown).
+	// When the cache already holds a prefix of this texture only the missing suffix is written.
 	handle_t writeToCache(const LLUUID& id, U32 priority, U8* data, S32 datasize, S32 imagesize,
-						  WriteResponder* responder);
+						  S32 discardlevel, WriteResponder* responder);
 	bool writeComplete(handle_t handle, bool abort = false);
 	void prioritizeWrite(handle_t handle);
 
@@ -153,8 +159,9 @@ private:
 	void readEntriesHeader();
 	void writeEntriesHeader();
 	S32 openAndReadEntry(const LLUUID& id, Entry& entry, bool create);
-	bool updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_body_size);
+	bool updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_body_size, S32 new_discard_level);
 	void updateEntryTimeStamp(S32 idx, Entry& entry) ;
+	void touchEntry(S32 idx, Entry& entry, S32 new_image_size);
 	U32 openAndReadEntries(std::vector<Entry>& entries);
 	void writeEntriesAndClose(const std::vector<Entry>& entries);
 	void readEntryFromHeaderImmediately(S32& idx, Entry& entry) ;
@@ -162,7 +169,7 @@ private:
 	void removeEntry(S32 idx, Entry& entry, std::string& filename);
 	void removeCachedTexture(const LLUUID& id) ;
 	S32 getHeaderCacheEntry(const LLUUID& id, Entry& entry);
-	S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize);
+	S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize, S32 discardlevel);
 	void writeUpdatedEntries() ;
 	void updatedHeaderEntriesFile() ;
 	void lockHeaders() { mHeaderMutex.lock(); }
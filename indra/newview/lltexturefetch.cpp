@@ -44,6 +44,7 @@
 #include "llhttpclient.h"
 #include "llhttpstatuscodes.h"
 #include "llimage.h"
+#include "llimagedxt.h"
 #include "llimagej2c.h"
 #include "llimageworker.h"
 #include "llworkerthread.h"
@@ -78,7 +79,7 @@ private:
 			LLTextureFetchWorker* worker = mFetcher->getWorker(mID);
 			if (worker)
 			{
- 				worker->callbackCacheRead(success, mFormattedImage, mImageSize, mImageLocal);
+ 				worker->callbackCacheRead(success, mFormattedImage, mImageSize, mDiscardLevel, mImageLocal);
 			}
 		}
 	private:
@@ -156,7 +157,7 @@ public:
 						 const LLIOPipe::buffer_ptr_t& buffer,
 						 bool partial, bool success);
 	void callbackCacheRead(bool success, LLImageFormatted* image,
-						   S32 imagesize, BOOL islocal);
+						   S32 imagesize, S32 discardlevel, BOOL islocal);
 	void callbackCacheWrite(bool success);
 	void callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux);
 	
@@ -233,6 +234,7 @@ private:
 	LLPointer<LLImageFormatted> mFormattedImage;
 	LLPointer<LLImageRaw> mRawImage;
 	LLPointer<LLImageRaw> mAuxImage;
+	LLPointer<LLImageDXT> mCompressedImage; // S3TC copy of mRawImage, if mCompress
 	LLUUID mID;
 	LLHost mHost;
 	std::string mUrl;
@@ -255,12 +257,14 @@ private:
 	S32 mDesiredSize;
 	S32 mFileSize;
 	S32 mCachedSize;	
+	S32 mCachedDiscard; // discard level the cached prefix decodes to, -1 if unknown
 	e_request_state mSentRequest;
 	handle_t mDecodeHandle;
 	BOOL mLoaded;
 	BOOL mDecoded;
 	BOOL mWritten;
 	BOOL mNeedsAux;
+	BOOL mCompress;
 	BOOL mHaveAllData;
 	BOOL mInLocalCache;
 	bool mCanUseHTTP ;
@@ -759,12 +763,14 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mDesiredSize(TEXTURE_CACHE_ENTRY_SIZE),
 	  mFileSize(0),
 	  mCachedSize(0),
+	  mCachedDiscard(-1),
 	  mLoaded(FALSE),
 	  mSentRequest(UNSENT),
 	  mDecodeHandle(0),
 	  mDecoded(FALSE),
 	  mWritten(FALSE),
 	  mNeedsAux(FALSE),
+	  mCompress(FALSE),
 	  mHaveAllData(FALSE),
 	  mInLocalCache(FALSE),
 	  mCanUseHTTP(true),
@@ -983,12 +989,14 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		}
 
 		mRawImage = NULL ;
+		mCompressedImage = NULL;
 		mRequestedDiscard = -1;
 		mLoadedDiscard = -1;
 		mDecodedDiscard = -1;
 		mRequestedSize = 0;
 		mFileSize = 0;
 		mCachedSize = 0;
+		mCachedDiscard = -1;
 		mLoaded = FALSE;
 		mSentRequest = UNSENT;
 		mDecoded  = FALSE;
@@ -1011,6 +1019,22 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	{
 		if (mCacheReadHandle == LLTextureCache::nullHandle())
 		{
+			S32 raw_discard = -1;
+			if (mFormattedImage.isNull() && mUrl.compare(0, 7, "file://") != 0 &&
+				mFetcher->mRawCache.find(mID, mDesiredDiscard, mNeedsAux, raw_discard, mRawImage, mAuxImage))
+			{
+				// Decoded recently: skip the cache read and the decode altogether
+				LL_DEBUGS("Texture") << mID << ": Found in RAM cache. Discard: " << raw_discard << LL_ENDL;
+				mLoadedDiscard = raw_discard;
+				mDecodedDiscard = raw_discard;
+				mCompressedImage = NULL; // not worth compressing under the work mutex
+				mDecoded = TRUE;
+				mWriteToCacheState = NOT_WRITE;
+				mState = DONE;
+				setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
+				return false;
+			}
+
 			U32 cache_priority = mWorkPriority;
 			S32 offset = mFormattedImage.notNull() ? mFormattedImage->getDataSize() : 0;
 			S32 size = mDesiredSize - offset;
@@ -1080,8 +1104,10 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	if (mState == CACHE_POST)
 	{
 		mCachedSize = mFormattedImage.notNull() ? mFormattedImage->getDataSize() : 0;
-		// Successfully loaded
-		if ((mCachedSize >= mDesiredSize) || mHaveAllData)
+		// Successfully loaded. The size estimate for a discard level is conservative, so a
+		// cached prefix that is known to cover the desired discard level is enough as well.
+		if ((mCachedSize >= mDesiredSize) || mHaveAllData ||
+			(mCachedSize > 0 && mCachedDiscard >= 0 && mCachedDiscard <= mDesiredDiscard))
 		{
 			// we have enough data, decode it
 			llassert_always(mFormattedImage->getDataSize() > 0);
@@ -1572,6 +1598,10 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				llassert_always(mRawImage.notNull());
 				LL_DEBUGS("Texture") << mID << ": Decoded. Discard: " << mDecodedDiscard
 						<< " Raw Image: " << llformat("%dx%d",mRawImage->getWidth(),mRawImage->getHeight()) << LL_ENDL;
+				if (!mInLocalCache)
+				{
+					mFetcher->mRawCache.add(mID, mDecodedDiscard, mRawImage, mAuxImage);
+				}
 				setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 				mState = WRITE_TO_CACHE;
 			}
@@ -1605,6 +1635,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			}
 		}
 		llassert_always(datasize);
+		// Record how far the stored prefix goes so that a later fetch can resume from it
+		S32 cached_discard = mHaveAllData ? 0 : mLoadedDiscard;
 		setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
 		U32 cache_priority = mWorkPriority;
 		mWritten = FALSE;
@@ -1612,7 +1644,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		CacheWriteResponder* responder = new CacheWriteResponder(mFetcher, mID);
 		mCacheWriteHandle = mFetcher->mTextureCache->writeToCache(mID, cache_priority,
 																  mFormattedImage->getData(), datasize,
-																  mFileSize, responder);
+																  mFileSize, cached_discard, responder);
 		// fall through
 	}
 	
@@ -1728,6 +1760,7 @@ void LLTextureFetchWorker::removeFromCache()
 	{
 		mFetcher->mTextureCache->removeFromCache(mID);
 	}
+	mFetcher->mRawCache.remove(mID);
 }
 
 
@@ -1863,7 +1896,7 @@ S32 LLTextureFetchWorker::callbackHttpGet(const LLChannelDescriptors& channels,
 //////////////////////////////////////////////////////////////////////////////
 
 void LLTextureFetchWorker::callbackCacheRead(bool success, LLImageFormatted* image,
-											 S32 imagesize, BOOL islocal)
+											 S32 imagesize, S32 discardlevel, BOOL islocal)
 {
 	LLMutexLock lock(&mWorkMutex);
 	if (mState != LOAD_FROM_TEXTURE_CACHE)
@@ -1877,6 +1910,7 @@ void LLTextureFetchWorker::callbackCacheRead(bool success, LLImageFormatted* ima
 		mFileSize = imagesize;
 		mFormattedImage = image;
 		mImageCodec = image->getCodec();
+		mCachedDiscard = discardlevel;
 		mInLocalCache = islocal;
 		if (mFileSize != 0 && mFormattedImage->getDataSize() >= mFileSize)
 		{
@@ -1903,6 +1937,25 @@ void LLTextureFetchWorker::callbackCacheWrite(bool success)
 
 void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux)
 {
+	// Compress on the decode thread, without holding the work mutex that the main thread polls.
+	LLPointer<LLImageDXT> compressed;
+	if (success && raw)
+	{
+		bool compress;
+		{
+			LLMutexLock lock(&mWorkMutex);
+			compress = mCompress && !mNeedsAux && mDecodeHandle != 0;
+		}
+		if (compress)
+		{
+			compressed = new LLImageDXT;
+			if (!compressed->encodeS3TC(raw))
+			{
+				compressed = NULL;
+			}
+		}
+	}
+
 	LLMutexLock lock(&mWorkMutex);
 	if (mDecodeHandle == 0)
 	{
@@ -1922,6 +1975,7 @@ void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImag
 		llassert_always(raw);
 		mRawImage = raw;
 		mAuxImage = aux;
+		mCompressedImage = compressed;
 		mDecodedDiscard = mFormattedImage->getDiscardLevel();
  		LL_DEBUGS("Texture") << mID << ": Decode Finished. Discard: " << mDecodedDiscard
 							 << " Raw Image: " << llformat("%dx%d",mRawImage->getWidth(),mRawImage->getHeight()) << LL_ENDL;
@@ -2012,7 +2066,8 @@ LLTextureFetch::~LLTextureFetch()
 }
 
 bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux, bool can_use_http)
+								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux, bool can_use_http,
+								   bool compress)
 {
 	if (mDebugPause)
 	{
@@ -2072,6 +2127,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 		worker->lockWorkMutex();
 		worker->mActiveCount++;
 		worker->mNeedsAux = needs_aux;
+		worker->mCompress = compress;
 		worker->setImagePriority(priority);
 		worker->setDesiredDiscard(desired_discard, desired_size);
 		worker->setCanUseHTTP(can_use_http) ;
@@ -2096,6 +2152,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 		worker->lockWorkMutex();
 		worker->mActiveCount++;
 		worker->mNeedsAux = needs_aux;
+		worker->mCompress = compress;
 		worker->setCanUseHTTP(can_use_http) ;
 		worker->unlockWorkMutex();
 	}
@@ -2232,7 +2289,8 @@ LLTextureFetchWorker* LLTextureFetch::getWorker(const LLUUID& id)
 
 
 bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
-										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux)
+										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+										LLPointer<LLImageDXT>& compressed)
 {
 	bool res = false;
 	LLTextureFetchWorker* worker = getWorker(id);
@@ -2257,6 +2315,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 			discard_level = worker->mDecodedDiscard;
 			raw = worker->mRawImage;
 			aux = worker->mAuxImage;
+			compressed = worker->mCompressedImage;
 			res = true;
 			LL_DEBUGS("Texture") << id << ": Request Finished. State: " << worker->mState << " Discard: " << discard_level << LL_ENDL;
 			worker->unlockWorkMutex();
@@ -2272,6 +2331,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 				discard_level = worker->mDecodedDiscard;
 				raw = worker->mRawImage;
 				aux = worker->mAuxImage;
+				compressed = worker->mCompressedImage;
 			}
 			worker->unlockWorkMutex();
 		}
@@ -2372,6 +2432,13 @@ void LLTextureFetch::commonUpdate()
 S32 LLTextureFetch::update(F32 max_time_ms)
 {
 	static LLCachedControl<F32> band_width(gSavedSettings,"ThrottleBandwidthKBPS");
+	static LLCachedControl<U32> raw_cache_size(gSavedSettings,"TextureRawCacheSize");
+
+	S64 raw_cache_bytes = (S64)raw_cache_size * 1024 * 1024;
+	if (raw_cache_bytes != mRawCache.getMaxSize())
+	{
+		mRawCache.setMaxSize(raw_cache_bytes);
+	}
 
 	{
 		mNetworkQueueMutex.lock() ;
@@ -39,6 +39,7 @@
 #include "llworkerthread.h"
 #include "llcurl.h"
 #include "lltextureinfo.h"
+#include "lltexturerawcache.h"
 #include "llapr.h"
 
 class LLViewerTexture;
@@ -46,6 +47,7 @@ class LLTextureFetchWorker;
 class HTTPGetResponder;
 class LLTextureCache;
 class LLImageDecodeThread;
+class LLImageDXT;
 class LLHost;
 #if HTTP_METRICS
 class LLViewerAssetStats;
@@ -68,10 +70,12 @@ public:
 	void shutDownImageDecodeThread() ;  //called in the main thread after the ImageDecodeThread shuts down.
 
 	bool createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux, bool can_use_http);
+					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux, bool can_use_http,
+					   bool compress = false);
 	void deleteRequest(const LLUUID& id, bool cancel);
 	bool getRequestFinished(const LLUUID& id, S32& discard_level,
-							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux);
+							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+							LLPointer<LLImageDXT>& compressed);
 	bool updateRequestPriority(const LLUUID& id, F32 priority);
 
 	bool receiveImageHeader(const LLHost& host, const LLUUID& id, U8 codec, U16 packets, U32 totalbytes, U16 data_size, U8* data);
@@ -97,6 +101,7 @@ public:
 	LLTextureFetchWorker* getWorkerAfterLock(const LLUUID& id);
 
 	LLTextureInfo* getTextureInfo() { return &mTextureInfo; }
+	LLTextureRawCache* getRawCache() { return &mRawCache; }
 
 #if HTTP_METRICS
 	// Commands available to other threads to control metrics gathering operations.
@@ -177,6 +182,7 @@ private:
 	LLMutex mNetworkQueueMutex; //to protect mNetworkQueue, mHTTPTextureQueue and mCancelQueue.
 
 	LLTextureCache* mTextureCache;
+	LLTextureRawCache mRawCache; // decoded images, consulted before mTextureCache
 	LLImageDecodeThread* mImageDecodeThread;
 	LLCurlRequest* mCurlGetRequest;
 	
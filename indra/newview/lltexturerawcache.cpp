@@ -0,0 +1,161 @@
+/**
+ * @file lltexturerawcache.cpp
+ * @brief In-memory LRU cache of decoded textures.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturerawcache.h"
+
+LLTextureRawCache::LLTextureRawCache()
+	: mSize(0),
+	  mMaxSize(0),
+	  mHits(0),
+	  mMisses(0)
+{
+}
+
+LLTextureRawCache::~LLTextureRawCache()
+{
+	clear();
+}
+
+//static
+LLImageRaw* LLTextureRawCache::duplicate(LLImageRaw* src)
+{
+	// Decoded images handed to the viewer get scaled and modified in place,
+	// so the cache never shares its copies.
+	return new LLImageRaw(src->getData(), src->getWidth(), src->getHeight(), src->getComponents());
+}
+
+void LLTextureRawCache::add(const LLUUID& id, S32 discard, LLImageRaw* raw, LLImageRaw* aux)
+{
+	if (!raw || !raw->getData() || discard < 0)
+	{
+		return;
+	}
+	S32 size = raw->getDataSize() + (aux ? aux->getDataSize() : 0);
+
+	LLMutexLock lock(&mMutex);
+	if (size > mMaxSize / 4)
+	{
+		return; // disabled, or a single image would flush most of the cache
+	}
+
+	key_t key(id, discard);
+	entry_map_t::iterator iter = mEntries.find(key);
+	if (iter != mEntries.end())
+	{
+		erase(iter);
+	}
+	purge(mMaxSize - size);
+
+	mLRU.push_front(key);
+	Entry& entry = mEntries[key];
+	entry.mRaw = duplicate(raw);
+	entry.mAux = aux ? duplicate(aux) : NULL;
+	entry.mSize = size;
+	entry.mLRUIter = mLRU.begin();
+	mSize += size;
+}
+
+bool LLTextureRawCache::find(const LLUUID& id, S32 discard, bool needs_aux, S32& found_discard,
+							 LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux)
+{
+	LLMutexLock lock(&mMutex);
+	if (mEntries.empty())
+	{
+		return false;
+	}
+
+	// Entries of an id are sorted by discard level: the last one <= discard is
+	// the smallest image that is still good enough.
+	entry_map_t::iterator iter = mEntries.upper_bound(key_t(id, discard));
+	if (iter != mEntries.begin())
+	{
+		--iter;
+		if (iter->first.first == id && (!needs_aux || iter->second.mAux.notNull()))
+		{
+			Entry& entry = iter->second;
+			mLRU.splice(mLRU.begin(), mLRU, entry.mLRUIter);
+			found_discard = iter->first.second;
+			raw = duplicate(entry.mRaw);
+			aux = entry.mAux.notNull() ? duplicate(entry.mAux) : NULL;
+			++mHits;
+			return true;
+		}
+	}
+	++mMisses;
+	return false;
+}
+
+void LLTextureRawCache::remove(const LLUUID& id)
+{
+	LLMutexLock lock(&mMutex);
+	entry_map_t::iterator iter = mEntries.lower_bound(key_t(id, 0));
+	while (iter != mEntries.end() && iter->first.first == id)
+	{
+		erase(iter++);
+	}
+}
+
+void LLTextureRawCache::clear()
+{
+	LLMutexLock lock(&mMutex);
+	mEntries.clear();
+	mLRU.clear();
+	mSize = 0;
+}
+
+void LLTextureRawCache::setMaxSize(S64 max_size)
+{
+	LLMutexLock lock(&mMutex);
+	mMaxSize = llmax(max_size, (S64)0);
+	purge(mMaxSize);
+}
+
+// mMutex must be locked
+void LLTextureRawCache::erase(entry_map_t::iterator iter)
+{
+	mSize -= iter->second.mSize;
+	mLRU.erase(iter->second.mLRUIter);
+	mEntries.erase(iter);
+}
+
+// mMutex must be locked
+void LLTextureRawCache::purge(S64 max_size)
+{
+	while (mSize > max_size && !mLRU.empty())
+	{
+		entry_map_t::iterator iter = mEntries.find(mLRU.back());
+		llassert_always(iter != mEntries.end());
+		erase(iter);
+	}
+}
@@ -0,0 +1,99 @@
+/**
+ * @file lltexturerawcache.h
+ * @brief In-memory LRU cache of decoded textures.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTURERAWCACHE_H
+#define LL_LLTEXTURERAWCACHE_H
+
+#include "llimage.h"
+#include "llthread.h"
+#include "lluuid.h"
+
+#include <list>
+#include <map>
+
+// Sits between LLTextureCache and GL: keeps the most recently decoded
+// images so that a texture that was dropped from GL and is requested again
+// does not go through a disk cache read and a full J2C decode.
+// Thread safe; accessed from the texture fetch worker thread.
+class LLTextureRawCache
+{
+public:
+	LLTextureRawCache();
+	~LLTextureRawCache();
+
+	// Stores a copy of a decoded image (and its aux channel, may be NULL).
+	void add(const LLUUID& id, S32 discard, LLImageRaw* raw, LLImageRaw* aux);
+
+	// Looks for the cheapest cached decode of id with a discard level <= discard.
+	// On success, fills in fresh copies the caller is free to modify.
+	bool find(const LLUUID& id, S32 discard, bool needs_aux, S32& found_discard,
+			  LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux);
+
+	void remove(const LLUUID& id);
+	void clear();
+
+	// Maximum memory in bytes, 0 disables the cache.
+	void setMaxSize(S64 max_size);
+
+	// debug
+	S64 getSize() const { return mSize; }
+	S64 getMaxSize() const { return mMaxSize; }
+	U32 getHits() const { return mHits; }
+	U32 getMisses() const { return mMisses; }
+
+private:
+	typedef std::pair<LLUUID, S32> key_t;
+	typedef std::list<key_t> lru_list_t;
+	struct Entry
+	{
+		LLPointer<LLImageRaw> mRaw;
+		LLPointer<LLImageRaw> mAux;
+		S32 mSize;
+		lru_list_t::iterator mLRUIter;
+	};
+	typedef std::map<key_t, Entry> entry_map_t;
+
+	// mMutex must be locked
+	void erase(entry_map_t::iterator iter);
+	void purge(S64 max_size);
+	static LLImageRaw* duplicate(LLImageRaw* src);
+
+	LLMutex mMutex;
+	entry_map_t mEntries;
+	lru_list_t mLRU; // most recently used at the front
+	S64 mSize;
+	S64 mMaxSize;
+	U32 mHits;
+	U32 mMisses;
+};
+
+#endif // LL_LLTEXTURERAWCACHE_H
@@ -305,6 +305,12 @@ static bool handleVideoMemoryChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleTextureCompressThresholdChanged(const LLSD& newvalue)
+{
+	gTextureList.updateMaxResidentTexMem(0);
+	return true;
+}
+
 static bool handleBandwidthChanged(const LLSD& newvalue)
 {
 	gViewerThrottle.setMaxBandwidth((F32) newvalue.asReal());
@@ -680,6 +686,7 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("RenderDeferredSSAO")->getSignal()->connect(boost::bind(&handleSetShaderChanged, _2));
 	gSavedSettings.getControl("RenderDepthOfField")->getSignal()->connect(boost::bind(&handleSetShaderChanged, _2));
 	gSavedSettings.getControl("TextureMemory")->getSignal()->connect(boost::bind(&handleVideoMemoryChanged, _2));
+	gSavedSettings.getControl("TextureCompressMemoryThreshold")->getSignal()->connect(boost::bind(&handleTextureCompressThresholdChanged, _2));
 	gSavedSettings.getControl("AuditTexture")->getSignal()->connect(boost::bind(&handleAuditTextureChanged, _2));
 	gSavedSettings.getControl("ChatFontSize")->getSignal()->connect(boost::bind(&handleChatFontSizeChanged, _2));
 	gSavedSettings.getControl("ChatPersistTime")->getSignal()->connect(boost::bind(&handleChatPersistTimeChanged, _2));
@@ -57,13 +57,16 @@
 #include "llagentcamera.h"
 #include "llappviewer.h"
 #include "llassetuploadresponders.h"
+#include "llcallbacklist.h"
 #ifdef MESH_UPLOAD
 #include "llfloatermodelpreview.h"
 #endif
 
+#include "llimagej2c.h"
 #include "llimagejpeg.h"
 #include "llimagepng.h"
 #include "llimagebmp.h"
+#include "llimageworker.h"
 
 #include "statemachine/aifilepicker.h"
 #include "llfloateranimpreview.h"
@@ -511,6 +514,42 @@ class LLFileTakeSnapshot : public view_listener_t
 	}
 };
 
+class LLSnapshotSaveResponder : public LLImageEncodeThread::Responder
+{
+public:
+	LLSnapshotSaveResponder() : mDone(FALSE), mSuccess(false) {}
+
+	// Encode thread
+	/*virtual*/ void completed(bool success, LLImageFormatted* image)
+	{
+		mSuccess = success;
+		mDone = TRUE;
+	}
+
+	// Main thread, called from the idle loop until it returns true.
+	static bool saveWhenDone(LLPointer<LLSnapshotSaveResponder> responder, LLPointer<LLImageFormatted> formatted)
+	{
+		if (!responder->mDone)
+		{
+			return false;
+		}
+		formatted->disableOverSize();
+		if (responder->mSuccess)
+		{
+			gViewerWindow->saveImageNumbered(formatted);
+		}
+		else
+		{
+			llwarns << "Failed to encode snapshot" << llendl;
+		}
+		return true;
+	}
+
+private:
+	LLAtomic32<BOOL> mDone;
+	bool mSuccess;
+};
+
 class LLFileTakeSnapshotToDisk : public view_listener_t
 {
 	bool handleEvent(LLPointer<LLEvent> event, const LLSD& userdata)
@@ -563,10 +602,12 @@ class LLFileTakeSnapshotToDisk : public view_listener_t
 				return true;
 			}
 
+			// Compressing a 6144 pixel snapshot takes seconds: do it on the encode thread
+			// and save the file from the idle loop once it is done.
 			formatted->enableOverSize() ;
-			formatted->encode(raw, 0);
-			formatted->disableOverSize();
-			gViewerWindow->saveImageNumbered(formatted);
+			LLPointer<LLSnapshotSaveResponder> responder = new LLSnapshotSaveResponder;
+			LLAppViewer::getImageEncodeThread()->encodeImage(raw, formatted, LLQueuedThread::PRIORITY_HIGH, responder);
+			doOnIdleRepeating(boost::bind(&LLSnapshotSaveResponder::saveWhenDone, responder, formatted));
 		}
 		return true;
 	}
@@ -632,6 +673,86 @@ static void handle_compress_image_continued(AIFilePicker* filepicker)
 	}
 }
 
+// Keeps the arguments of an image upload while it is encoded on the image encode thread.
+class LLUploadEncodeResponder : public LLImageEncodeThread::Responder
+{
+public:
+	LLUploadEncodeResponder(const std::string& src_filename,
+							const std::string& filename,
+							const std::string& name,
+							const std::string& desc,
+							S32 compression_info,
+							LLFolderType::EType destination_folder_type,
+							LLInventoryType::EType inv_type,
+							U32 next_owner_perms,
+							U32 group_perms,
+							U32 everyone_perms,
+							const std::string& display_name,
+							LLAssetStorage::LLStoreAssetCallback callback,
+							S32 expected_upload_cost,
+							void *userdata)
+		: mSrcFilename(src_filename), mFilename(filename), mName(name), mDesc(desc),
+		  mCompressionInfo(compression_info), mDestinationFolderType(destination_folder_type),
+		  mInvType(inv_type), mNextOwnerPerms(next_owner_perms), mGroupPerms(group_perms),
+		  mEveryonePerms(everyone_perms), mDisplayName(display_name), mCallback(callback),
+		  mExpectedUploadCost(expected_upload_cost), mUserData(userdata),
+		  mTemporary(gSavedSettings.getBOOL("TemporaryUpload")),
+		  mDone(FALSE), mSuccess(false) {}
+
+	// Encode thread
+	/*virtual*/ void completed(bool success, LLImageFormatted* image)
+	{
+		mImage = (LLImageJ2C*)image;
+		mSuccess = success;
+		mDone = TRUE;
+	}
+
+	// Main thread, once isDone()
+	BOOL isDone() const { return mDone; }
+	bool getSuccess() const { return mSuccess; }
+	LLImageJ2C* getImage() const { return mImage; }
+
+	const std::string mSrcFilename;
+	const std::string mFilename;
+	const std::string mName;
+	const std::string mDesc;
+	const S32 mCompressionInfo;
+	const LLFolderType::EType mDestinationFolderType;
+	const LLInventoryType::EType mInvType;
+	const U32 mNextOwnerPerms;
+	const U32 mGroupPerms;
+	const U32 mEveryonePerms;
+	const std::string mDisplayName;
+	const LLAssetStorage::LLStoreAssetCallback mCallback;
+	const S32 mExpectedUploadCost;
+	void* const mUserData;
+	const BOOL mTemporary;
+
+private:
+	LLPointer<LLImageJ2C> mImage;
+	LLAtomic32<BOOL> mDone;
+	bool mSuccess;
+};
+
+static void upload_new_resource_file(const std::string& src_filename,
+									 const std::string& filename,
+									 LLAssetType::EType asset_type,
+									 const std::string& name,
+									 const std::string& desc,
+									 S32 compression_info,
+									 LLFolderType::EType destination_folder_type,
+									 LLInventoryType::EType inv_type,
+									 U32 next_owner_perms,
+									 U32 group_perms,
+									 U32 everyone_perms,
+									 const std::string& display_name,
+									 LLAssetStorage::LLStoreAssetCallback callback,
+									 S32 expected_upload_cost,
+									 void *userdata);
+static void upload_resource_error(const std::string& error_message, const std::string& filename);
+static void upload_image_error(const std::string& src_filename, const std::string& filename);
+static bool on_upload_encode_idle(LLUploadEncodeResponder* responder);
+
 void upload_new_resource(const std::string& src_filename, std::string name,
 			 std::string desc, S32 compression_info,
 			 LLFolderType::EType destination_folder_type,
@@ -646,8 +767,6 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 {	
 	// Generate the temporary UUID.
 	std::string filename = gDirUtilp->getTempFilename();
-	LLTransactionID tid;
-	LLAssetID uuid;
 	
 	LLSD args;
 
@@ -655,8 +774,6 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 	U32 codec = LLImageBase::getCodecFromExtension(exten);
 	LLAssetType::EType asset_type = LLAssetType::AT_NONE;
 	std::string error_message;
-
-	BOOL error = FALSE;
 	
 	if (exten.empty())
 	{
@@ -672,17 +789,25 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 	}
 	else if (codec != IMG_CODEC_INVALID)
 	{
-		// It's an image file, the upload procedure is the same for all
-		asset_type = LLAssetType::AT_TEXTURE;
-		if (!LLViewerTextureList::createUploadFile(src_filename, filename, codec))
+		// It's an image file, the upload procedure is the same for all.
+		// Compressing it takes seconds for large images: encode it on the image
+		// encode thread and go on with the upload from the idle loop.
+		LLPointer<LLImageRaw> raw_image = new LLImageRaw;
+		if (!LLViewerTextureList::loadUploadImage(src_filename, codec, raw_image))
 		{
-			error_message = llformat( "Problem with file %s:\n\n%s\n",
-					src_filename.c_str(), LLImage::getLastError().c_str());
-			args["FILE"] = src_filename;
-			args["ERROR"] = LLImage::getLastError();
-			upload_error(error_message, "ProblemWithFile", filename, args);
+			upload_image_error(src_filename, filename);
 			return;
 		}
+		LLPointer<LLImageJ2C> compressed_image = LLViewerTextureList::prepareUploadFile(raw_image);
+		LLPointer<LLUploadEncodeResponder> responder =
+			new LLUploadEncodeResponder(src_filename, filename, name, desc, compression_info,
+										destination_folder_type, inv_type,
+										next_owner_perms, group_perms, everyone_perms,
+										display_name, callback, expected_upload_cost, userdata);
+		LLAppViewer::getImageEncodeThread()->encodeImage(raw_image, compressed_image,
+														 LLQueuedThread::PRIORITY_NORMAL, responder);
+		doOnIdleRepeating(boost::bind(&on_upload_encode_idle, responder));
+		return;
 	}
 	else if(exten == "wav")
 	{
@@ -857,13 +982,41 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 		// Unknown extension
 		// *TODO: Translate?
 		error_message = llformat("Unknown file extension .%s\nExpected .wav, .tga, .bmp, .jpg, .jpeg, or .bvh", exten.c_str());
-		error = TRUE;;
+		upload_resource_error(error_message, filename);
+		return;
 	}
 
+	upload_new_resource_file(src_filename, filename, asset_type, name, desc, compression_info,
+							 destination_folder_type, inv_type, next_owner_perms, group_perms, everyone_perms,
+							 display_name, callback, expected_upload_cost, userdata);
+}
+
+// Copies the file to upload into the VFS and starts the upload.
+static void upload_new_resource_file(const std::string& src_filename,
+									 const std::string& filename,
+									 LLAssetType::EType asset_type,
+									 const std::string& name,
+									 const std::string& desc,
+									 S32 compression_info,
+									 LLFolderType::EType destination_folder_type,
+									 LLInventoryType::EType inv_type,
+									 U32 next_owner_perms,
+									 U32 group_perms,
+									 U32 everyone_perms,
+									 const std::string& display_name,
+									 LLAssetStorage::LLStoreAssetCallback callback,
+									 S32 expected_upload_cost,
+									 void *userdata)
+{
+	std::string exten = gDirUtilp->getExtension(src_filename);
+	std::string error_message;
+	BOOL error = FALSE;
+	LLTransactionID tid;
+	LLAssetID uuid;
+
 	// gen a new transaction ID for this asset
 	tid.generate();
 
-	if (!error)
 	{
 		uuid = tid.makeAssetID(gAgent.getSecureSessionID());
 		// copy this file into the vfs for upload
@@ -923,16 +1076,60 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 	}
 	else
 	{
-		llwarns << error_message << llendl;
-		LLSD args;
-		args["ERROR_MESSAGE"] = error_message;
-		LLNotificationsUtil::add("ErrorMessage", args);
-		if(LLFile::remove(filename) == -1)
-		{
-			lldebugs << "unable to remove temp file" << llendl;
-		}
-		//AIFIXME? LLFilePicker::instance().reset();
+		upload_resource_error(error_message, filename);
+	}
+}
+
+static void upload_resource_error(const std::string& error_message, const std::string& filename)
+{
+	llwarns << error_message << llendl;
+	LLSD args;
+	args["ERROR_MESSAGE"] = error_message;
+	LLNotificationsUtil::add("ErrorMessage", args);
+	if(LLFile::remove(filename) == -1)
+	{
+		lldebugs << "unable to remove temp file" << llendl;
 	}
+	//AIFIXME? LLFilePicker::instance().reset();
+}
+
+static void upload_image_error(const std::string& src_filename, const std::string& filename)
+{
+	std::string error_message = llformat( "Problem with file %s:\n\n%s\n",
+			src_filename.c_str(), LLImage::getLastError().c_str());
+	LLSD args;
+	args["FILE"] = src_filename;
+	args["ERROR"] = LLImage::getLastError();
+	upload_error(error_message, "ProblemWithFile", filename, args);
+}
+
+static bool on_upload_encode_idle(LLUploadEncodeResponder* responder)
+{
+	if (!responder->isDone())
+	{
+		return false;
+	}
+	if (!responder->getSuccess())
+	{
+		LLImage::setLastError("Couldn't convert the image to jpeg2000.");
+		upload_image_error(responder->mSrcFilename, responder->mFilename);
+	}
+	else if (!LLViewerTextureList::saveUploadFile(responder->getImage(), responder->mFilename))
+	{
+		upload_image_error(responder->mSrcFilename, responder->mFilename);
+	}
+	else
+	{
+		// bulk uploads set this for each file, before any of them was encoded.
+		gSavedSettings.setBOOL("TemporaryUpload", responder->mTemporary);
+		upload_new_resource_file(responder->mSrcFilename, responder->mFilename, LLAssetType::AT_TEXTURE,
+								 responder->mName, responder->mDesc, responder->mCompressionInfo,
+								 responder->mDestinationFolderType, responder->mInvType,
+								 responder->mNextOwnerPerms, responder->mGroupPerms, responder->mEveryonePerms,
+								 responder->mDisplayName, responder->mCallback,
+								 responder->mExpectedUploadCost, responder->mUserData);
+	}
+	return true;
 }
 // <edit>
 void temp_upload_callback(const LLUUID& uuid, void* user_data, S32 result, LLExtStat ext_status) // StoreAssetData callback (fixed)
@@ -142,6 +142,7 @@
 #include "llworld.h"
 #include "pipeline.h"
 #include "llappviewer.h"
+#include "llregioncachethread.h"
 #include "llfloaterworldmap.h"
 #include "llviewerdisplay.h"
 #include "llkeythrottle.h"
@@ -3789,6 +3790,7 @@ void process_teleport_finish(LLMessageSystem* msg, void**)
 
 	// Viewer trusts the simulator.
 	gMessageSystem->enableCircuit(sim_host, TRUE);
+	LLAppViewer::getRegionCacheThread()->preload(region_handle, true);
 	LLViewerRegion* regionp =  LLWorld::getInstance()->addRegion(region_handle, sim_host);
 
 /*
@@ -4084,6 +4086,7 @@ void process_crossed_region(LLMessageSystem* msg, void**)
 
 	send_complete_agent_movement(sim_host);
 
+	LLAppViewer::getRegionCacheThread()->preload(region_handle, true);
 	LLViewerRegion* regionp = LLWorld::getInstance()->addRegion(region_handle, sim_host);
 	regionp->setSeedCapability(seedCap);
 }
@@ -101,6 +101,7 @@
 #include "llviewernetwork.h"
 #include "llvowlsky.h"
 #include "llmanip.h"
+#include "llobjectmotion.h"
 
 // [RLVa:KB]
 #include "rlvhandler.h"
@@ -235,8 +236,10 @@ LLViewerObject::LLViewerObject(const LLUUID &id, const LLPCode pcode, LLViewerRe
 	mDead(FALSE),
 	mOrphaned(FALSE),
 	mUserSelected(FALSE),
-	mOnActiveList(FALSE),
-	mOnMap(FALSE),
+	mListIndex(-1),
+	mMotionSlot(-1),
+	mMapIndex(-1),
+	mTerseUpdateIndex(-1),
 	mStatic(FALSE),
 	mNumFaces(0),
 	mTimeDilation(1.f),
@@ -400,15 +403,7 @@ void LLViewerObject::markDead()
 			mPartSourcep = NULL;
 		}
 
-		if (mAudioSourcep)
-		{
-			// Do some cleanup
-			if (gAudiop)
-			{
-				gAudiop->cleanupAudioSource(mAudioSourcep);
-			}
-			mAudioSourcep = NULL;
-		}
+		stopAttachedSound();
 
 		if (flagAnimSource())
 		{
@@ -787,39 +782,13 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	// Coordinates of objects on simulators are region-local.
 	U64 region_handle;
 	mesgsys->getU64Fast(_PREHASH_RegionData, _PREHASH_RegionHandle, region_handle);
-	
-	{
-		LLViewerRegion* regionp = LLWorld::getInstance()->getRegionFromHandle(region_handle);
-		if(regionp != mRegionp && regionp && mRegionp)//region cross
-		{
-			//this is the redundant position and region update, but it is necessary in case the viewer misses the following 
-			//position and region update messages from sim.
-			//this redundant update should not cause any problems.
-			LLVector3 delta_pos =  mRegionp->getOriginAgent() - regionp->getOriginAgent();
-			setPositionParent(getPosition() + delta_pos); //update to the new region position immediately.
-			setRegion(regionp) ; //change the region.
-		}
-		else
-		{
-			mRegionp = regionp ;
-		}
-	}	
-	
-	if (!mRegionp)
+	U16 time_dilation16;
+	mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, time_dilation16);
+	if (!setUpdateRegion(region_handle, time_dilation16))
 	{
-		U32 x, y;
-		from_region_handle(region_handle, &x, &y);
-
-		llerrs << "Object has invalid region " << x << ":" << y << "!" << llendl;
 		return retval;
 	}
 
-	U16 time_dilation16;
-	mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, time_dilation16);
-	F32 time_dilation = ((F32) time_dilation16) / 65535.f;
-	mTimeDilation = time_dilation;
-	mRegionp->setTimeDilation(time_dilation);
-
 	// this will be used to determine if we've really changed position
 	// Use getPosition, not getPositionRegion, since this is what we're comparing directly against.
 	LLVector3 test_pos_parent = getPosition();
@@ -1222,144 +1191,8 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 #endif
 				length = mesgsys->getSizeFast(_PREHASH_ObjectData, block_num, _PREHASH_ObjectData);
 				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_ObjectData, data, length, block_num);
-				count = 0;
-				LLVector4 collision_plane;
-				
-				switch(length)
-				{
-				case(60 + 16):
-					// pull out collision normal for avatar
-					htonmemcpy(collision_plane.mV, &data[count], MVT_LLVector4, sizeof(LLVector4));
-					((LLVOAvatar*)this)->setFootPlane(collision_plane);
-					count += sizeof(LLVector4);
-					// fall through
-				case 60:
-					// this is a terse 32 update
-					// pos
-					this_update_precision = 32;
-					htonmemcpy(new_pos_parent.mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
-					count += sizeof(LLVector3);
-					// vel
-					htonmemcpy((void*)getVelocity().mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
-					count += sizeof(LLVector3);
-					// acc
-					htonmemcpy((void*)getAcceleration().mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
-					count += sizeof(LLVector3);
-					// theta
-					{
-						LLVector3 vec;
-						htonmemcpy(vec.mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
-						new_rot.unpackFromVector3(vec);
-					}
-					count += sizeof(LLVector3);
-					// omega
-					htonmemcpy((void*)new_angv.mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
-					if (new_angv.isExactlyZero())
-					{
-						// reset rotation time
-						resetRot();
-					}
-					setAngularVelocity(new_angv);
-#if LL_DARWIN
-					if (length == 76)
-					{
-						setAngularVelocity(LLVector3::zero);
-					}
-#endif
-					break;
-				case(32 + 16):
-					// pull out collision normal for avatar
-					htonmemcpy(collision_plane.mV, &data[count], MVT_LLVector4, sizeof(LLVector4));
-					((LLVOAvatar*)this)->setFootPlane(collision_plane);
-					count += sizeof(LLVector4);
-					// fall through
-				case 32:
-					// this is a terse 16 update
-					this_update_precision = 16;
-					test_pos_parent.quantize16(-0.5f*size, 1.5f*size, MIN_HEIGHT, MAX_HEIGHT);
-
-#ifdef LL_BIG_ENDIAN
-					htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
-					val = valswizzle;
-#else
-					val = (U16 *) &data[count];
-#endif
-					count += sizeof(U16)*3;
-					new_pos_parent.mV[VX] = U16_to_F32(val[VX], -0.5f*size, 1.5f*size);
-					new_pos_parent.mV[VY] = U16_to_F32(val[VY], -0.5f*size, 1.5f*size);
-					new_pos_parent.mV[VZ] = U16_to_F32(val[VZ], MIN_HEIGHT, MAX_HEIGHT);
-
-#ifdef LL_BIG_ENDIAN
-					htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
-					val = valswizzle;
-#else
-					val = (U16 *) &data[count];
-#endif
-					count += sizeof(U16)*3;
-					setVelocity(U16_to_F32(val[VX], -size, size),
-								U16_to_F32(val[VY], -size, size),
-								U16_to_F32(val[VZ], -size, size));
-
-#ifdef LL_BIG_ENDIAN
-					htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
-					val = valswizzle;
-#else
-					val = (U16 *) &data[count];
-#endif
-					count += sizeof(U16)*3;
-					setAcceleration(U16_to_F32(val[VX], -size, size),
-									U16_to_F32(val[VY], -size, size),
-									U16_to_F32(val[VZ], -size, size));
-
-#ifdef LL_BIG_ENDIAN
-					htonmemcpy(valswizzle, &data[count], MVT_U16Quat, 8); 
-					val = valswizzle;
-#else
-					val = (U16 *) &data[count];
-#endif
-					count += sizeof(U16)*4;
-					new_rot.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
-					new_rot.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
-					new_rot.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
-					new_rot.mQ[VW] = U16_to_F32(val[VW], -1.f, 1.f);
-
-#ifdef LL_BIG_ENDIAN
-					htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
-					val = valswizzle;
-#else
-					val = (U16 *) &data[count];
-#endif
-					setAngularVelocity(	U16_to_F32(val[VX], -size, size),
-										U16_to_F32(val[VY], -size, size),
-										U16_to_F32(val[VZ], -size, size));
-					break;
-
-				case 16:
-					// this is a terse 8 update
-					this_update_precision = 8;
-					test_pos_parent.quantize8(-0.5f*size, 1.5f*size, MIN_HEIGHT, MAX_HEIGHT);
-					new_pos_parent.mV[VX] = U8_to_F32(data[0], -0.5f*size, 1.5f*size);
-					new_pos_parent.mV[VY] = U8_to_F32(data[1], -0.5f*size, 1.5f*size);
-					new_pos_parent.mV[VZ] = U8_to_F32(data[2], MIN_HEIGHT, MAX_HEIGHT);
-
-					setVelocity(U8_to_F32(data[3], -size, size),
-								U8_to_F32(data[4], -size, size),
-								U8_to_F32(data[5], -size, size) );
-
-					setAcceleration(U8_to_F32(data[6], -size, size),
-									U8_to_F32(data[7], -size, size),
-									U8_to_F32(data[8], -size, size) );
-
-					new_rot.mQ[VX] = U8_to_F32(data[9], -1.f, 1.f);
-					new_rot.mQ[VY] = U8_to_F32(data[10], -1.f, 1.f);
-					new_rot.mQ[VZ] = U8_to_F32(data[11], -1.f, 1.f);
-					new_rot.mQ[VW] = U8_to_F32(data[12], -1.f, 1.f);
-
-					setAngularVelocity(	U8_to_F32(data[13], -size, size),
-										U8_to_F32(data[14], -size, size),
-										U8_to_F32(data[15], -size, size) );
-					break;
-				}
+				unpackTerseData(data, length, test_pos_parent, new_pos_parent, new_rot, new_angv,
+								this_update_precision);
 
 				U8 state;
 				mesgsys->getU8Fast(_PREHASH_ObjectData, _PREHASH_State, state, block_num );
@@ -1898,11 +1731,331 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 		}
 	}
 
+	return applyUpdateTransform(update_type, retval, test_pos_parent, new_pos_parent, new_rot,
+								new_angv, old_angv, new_scale, this_update_precision, b_changed_status,
+								old_special_hover_cursor, mesgsys->getSender(), mesgsys->getCurrentRecvPacketID());
+}
+
+//static
+BOOL LLViewerObject::skipCompressedUpdate(LLDataPacker& dp, U32& crc, U32& pass_flags)
+{
+	// Same order as the OUT_FULL_COMPRESSED case of processUpdateMessage()
+	U8 value8;
+	U32 value32;
+	F32 value_f32;
+	LLVector3 vec;
+	LLUUID id;
+	std::string str;
+	U8 block[MAX_OBJECT_PARAMS_SIZE];
+	S32 size;
+
+	dp.unpackU32(crc, "CRC");
+	dp.unpackU8(value8, "Material");
+	dp.unpackU8(value8, "ClickAction");
+	dp.unpackVector3(vec, "Scale");
+	dp.unpackVector3(vec, "Pos");
+	dp.unpackVector3(vec, "Rot");
+	dp.unpackU32(pass_flags, "SpecialCode");
+	dp.unpackUUID(id, "Owner");
+
+	if (pass_flags & 0x80)
+	{
+		dp.unpackVector3(vec, "Omega");
+	}
+
+	if (pass_flags & 0x20)
+	{
+		dp.unpackU32(value32, "ParentID");
+	}
+
+	if (pass_flags & 0x2)
+	{
+		dp.unpackU8(value8, "TreeData");
+	}
+	else if (pass_flags & 0x1)
+	{
+		dp.unpackU32(value32, "ScratchPadSize");
+		if (value32 > sizeof(block))
+		{
+			return FALSE;
+		}
+		dp.unpackBinaryData(block, size, "PartData");
+	}
+
+	if (pass_flags & 0x4)
+	{
+		dp.unpackString(str, "Text");
+		dp.unpackBinaryDataFixed(block, 4, "Color");
+	}
+
+	if (pass_flags & 0x200)
+	{
+		dp.unpackString(str, "MediaURL");
+	}
+
+	if (pass_flags & 0x8)
+	{
+		LLPartSysData part_sys_data;
+		part_sys_data.unpack(dp);
+	}
+
+	U8 num_parameters;
+	dp.unpackU8(num_parameters, "num_params");
+	for (U8 param = 0; param < num_parameters; ++param)
+	{
+		U16 param_type;
+		dp.unpackU16(param_type, "param_type");
+		if (!dp.unpackBinaryData(block, size, "param_data"))
+		{
+			return FALSE;
+		}
+	}
+
+	if (pass_flags & 0x10)
+	{
+		dp.unpackUUID(id, "SoundUUID");
+		dp.unpackF32(value_f32, "SoundGain");
+		dp.unpackU8(value8, "SoundFlags");
+		dp.unpackF32(value_f32, "SoundRadius");
+	}
+
+	if (pass_flags & 0x100)
+	{
+		dp.unpackString(str, "NV");
+	}
+
+	return TRUE;
+}
+
+U32 LLViewerObject::processTerseUpdate(const LLTerseObjectUpdate& update)
+{
+	LLMemType mt(LLMemType::MTYPE_OBJECT);
+	U32 retval = 0x0;
+
+	if (!setUpdateRegion(update.mRegionHandle, update.mTimeDilation))
+	{
+		return retval;
+	}
+
+	LLVector3 test_pos_parent = getPosition();
+	LLVector3 new_pos_parent;
+	LLVector3 new_angv;
+	LLVector3 old_angv = getAngularVelocity();
+	LLQuaternion new_rot;
+	S32 this_update_precision = 32;
+	bool old_special_hover_cursor = specialHoverCursor();
+
+	unpackTerseData(update.mData, update.mLength, test_pos_parent, new_pos_parent, new_rot, new_angv,
+					this_update_precision);
+	mState = update.mState;
+
+	if (sVelocityInterpolate)
+	{
+		// Catch up with the simulator for the time the update was held back.
+		F32 delay = (F32)(LLFrameTimer::getElapsedSeconds() - update.mReceivedTime);
+		new_pos_parent += getVelocity() * (mTimeDilation * delay);
+	}
+
+	return applyUpdateTransform(OUT_TERSE_IMPROVED, retval, test_pos_parent, new_pos_parent, new_rot,
+								new_angv, old_angv, getScale(), this_update_precision, FALSE,
+								old_special_hover_cursor, update.mSender, update.mPacketID);
+}
+
+BOOL LLViewerObject::setUpdateRegion(U64 region_handle, U16 time_dilation16)
+{
+	LLViewerRegion* regionp = LLWorld::getInstance()->getRegionFromHandle(region_handle);
+	if(regionp != mRegionp && regionp && mRegionp)//region cross
+	{
+		//this is the redundant position and region update, but it is necessary in case the viewer misses the following 
+		//position and region update messages from sim.
+		//this redundant update should not cause any problems.
+		LLVector3 delta_pos =  mRegionp->getOriginAgent() - regionp->getOriginAgent();
+		setPositionParent(getPosition() + delta_pos); //update to the new region position immediately.
+		setRegion(regionp) ; //change the region.
+	}
+	else
+	{
+		mRegionp = regionp ;
+	}
+	
+	if (!mRegionp)
+	{
+		U32 x, y;
+		from_region_handle(region_handle, &x, &y);
+
+		llerrs << "Object has invalid region " << x << ":" << y << "!" << llendl;
+		return FALSE;
+	}
+
+	F32 time_dilation = ((F32) time_dilation16) / 65535.f;
+	mTimeDilation = time_dilation;
+	mRegionp->setTimeDilation(time_dilation);
+	return TRUE;
+}
+
+void LLViewerObject::unpackTerseData(const U8* data, S32 length, LLVector3& test_pos_parent,
+									 LLVector3& new_pos_parent, LLQuaternion& new_rot, LLVector3& new_angv,
+									 S32& this_update_precision)
+{
+#ifdef LL_BIG_ENDIAN
+	U16 valswizzle[4];
+#endif
+	const U16* val;
+	const F32 size = LLWorld::getInstance()->getRegionWidthInMeters();
+	const F32 MAX_HEIGHT = LLWorld::getInstance()->getRegionMaxHeight();
+	const F32 MIN_HEIGHT = LLWorld::getInstance()->getRegionMinHeight();
+	S32 count = 0;
+	LLVector4 collision_plane;
+	
+	switch(length)
+	{
+	case(60 + 16):
+		// pull out collision normal for avatar
+		htonmemcpy(collision_plane.mV, &data[count], MVT_LLVector4, sizeof(LLVector4));
+		((LLVOAvatar*)this)->setFootPlane(collision_plane);
+		count += sizeof(LLVector4);
+		// fall through
+	case 60:
+		// this is a terse 32 update
+		// pos
+		this_update_precision = 32;
+		htonmemcpy(new_pos_parent.mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
+		count += sizeof(LLVector3);
+		// vel
+		htonmemcpy((void*)getVelocity().mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
+		count += sizeof(LLVector3);
+		// acc
+		htonmemcpy((void*)getAcceleration().mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
+		count += sizeof(LLVector3);
+		// theta
+		{
+			LLVector3 vec;
+			htonmemcpy(vec.mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
+			new_rot.unpackFromVector3(vec);
+		}
+		count += sizeof(LLVector3);
+		// omega
+		htonmemcpy((void*)new_angv.mV, &data[count], MVT_LLVector3, sizeof(LLVector3));
+		if (new_angv.isExactlyZero())
+		{
+			// reset rotation time
+			resetRot();
+		}
+		setAngularVelocity(new_angv);
+#if LL_DARWIN
+		if (length == 76)
+		{
+			setAngularVelocity(LLVector3::zero);
+		}
+#endif
+		break;
+	case(32 + 16):
+		// pull out collision normal for avatar
+		htonmemcpy(collision_plane.mV, &data[count], MVT_LLVector4, sizeof(LLVector4));
+		((LLVOAvatar*)this)->setFootPlane(collision_plane);
+		count += sizeof(LLVector4);
+		// fall through
+	case 32:
+		// this is a terse 16 update
+		this_update_precision = 16;
+		test_pos_parent.quantize16(-0.5f*size, 1.5f*size, MIN_HEIGHT, MAX_HEIGHT);
+
+#ifdef LL_BIG_ENDIAN
+		htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
+		val = valswizzle;
+#else
+		val = (U16 *) &data[count];
+#endif
+		count += sizeof(U16)*3;
+		new_pos_parent.mV[VX] = U16_to_F32(val[VX], -0.5f*size, 1.5f*size);
+		new_pos_parent.mV[VY] = U16_to_F32(val[VY], -0.5f*size, 1.5f*size);
+		new_pos_parent.mV[VZ] = U16_to_F32(val[VZ], MIN_HEIGHT, MAX_HEIGHT);
+
+#ifdef LL_BIG_ENDIAN
+		htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
+		val = valswizzle;
+#else
+		val = (U16 *) &data[count];
+#endif
+		count += sizeof(U16)*3;
+		setVelocity(U16_to_F32(val[VX], -size, size),
+					U16_to_F32(val[VY], -size, size),
+					U16_to_F32(val[VZ], -size, size));
+
+#ifdef LL_BIG_ENDIAN
+		htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
+		val = valswizzle;
+#else
+		val = (U16 *) &data[count];
+#endif
+		count += sizeof(U16)*3;
+		setAcceleration(U16_to_F32(val[VX], -size, size),
+						U16_to_F32(val[VY], -size, size),
+						U16_to_F32(val[VZ], -size, size));
+
+#ifdef LL_BIG_ENDIAN
+		htonmemcpy(valswizzle, &data[count], MVT_U16Quat, 8); 
+		val = valswizzle;
+#else
+		val = (U16 *) &data[count];
+#endif
+		count += sizeof(U16)*4;
+		new_rot.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
+		new_rot.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
+		new_rot.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
+		new_rot.mQ[VW] = U16_to_F32(val[VW], -1.f, 1.f);
+
+#ifdef LL_BIG_ENDIAN
+		htonmemcpy(valswizzle, &data[count], MVT_U16Vec3, 6); 
+		val = valswizzle;
+#else
+		val = (U16 *) &data[count];
+#endif
+		setAngularVelocity(	U16_to_F32(val[VX], -size, size),
+							U16_to_F32(val[VY], -size, size),
+							U16_to_F32(val[VZ], -size, size));
+		break;
+
+	case 16:
+		// this is a terse 8 update
+		this_update_precision = 8;
+		test_pos_parent.quantize8(-0.5f*size, 1.5f*size, MIN_HEIGHT, MAX_HEIGHT);
+		new_pos_parent.mV[VX] = U8_to_F32(data[0], -0.5f*size, 1.5f*size);
+		new_pos_parent.mV[VY] = U8_to_F32(data[1], -0.5f*size, 1.5f*size);
+		new_pos_parent.mV[VZ] = U8_to_F32(data[2], MIN_HEIGHT, MAX_HEIGHT);
+
+		setVelocity(U8_to_F32(data[3], -size, size),
+					U8_to_F32(data[4], -size, size),
+					U8_to_F32(data[5], -size, size) );
+
+		setAcceleration(U8_to_F32(data[6], -size, size),
+						U8_to_F32(data[7], -size, size),
+						U8_to_F32(data[8], -size, size) );
+
+		new_rot.mQ[VX] = U8_to_F32(data[9], -1.f, 1.f);
+		new_rot.mQ[VY] = U8_to_F32(data[10], -1.f, 1.f);
+		new_rot.mQ[VZ] = U8_to_F32(data[11], -1.f, 1.f);
+		new_rot.mQ[VW] = U8_to_F32(data[12], -1.f, 1.f);
+
+		setAngularVelocity(	U8_to_F32(data[13], -size, size),
+							U8_to_F32(data[14], -size, size),
+							U8_to_F32(data[15], -size, size) );
+		break;
+	}
+}
+
+U32 LLViewerObject::applyUpdateTransform(const EObjectUpdateType update_type, U32 retval,
+										 const LLVector3& test_pos_parent, LLVector3 new_pos_parent,
+										 LLQuaternion new_rot, const LLVector3& new_angv,
+										 const LLVector3& old_angv, const LLVector3& new_scale,
+										 S32 this_update_precision, BOOL b_changed_status,
+										 bool old_special_hover_cursor, const LLHost& sender, U32 packet_id)
+{
 	new_rot.normQuat();
 
 	if (sPingInterpolate)
 	{ 
-		LLCircuitData *cdp = gMessageSystem->mCircuitInfo.findCircuit(mesgsys->getSender());
+		LLCircuitData *cdp = gMessageSystem->mCircuitInfo.findCircuit(sender);
 		if (cdp)
 		{
 			F32 ping_delay = 0.5f * mTimeDilation * ( ((F32)cdp->getPingDelay()) * 0.001f + gFrameDTClamped);
@@ -1921,7 +2074,6 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	//
 	//
 
-	U32 packet_id = mesgsys->getCurrentRecvPacketID(); 
 	if (packet_id < mLatestRecvPacketID && 
 		mLatestRecvPacketID - packet_id < 65536)
 	{
@@ -2091,6 +2243,7 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	return retval;
 }
 
+
 BOOL LLViewerObject::isActive() const
 {
 	return TRUE;
@@ -2116,7 +2269,7 @@ BOOL LLViewerObject::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 
 		if (!mJointInfo)
 		{
-			applyAngularVelocity(dt);
+			applyAngularVelocity(dt, getMotionSlot(time));
 		}
 
 		LLViewerObject *parentp = (LLViewerObject *) getParent();
@@ -2208,6 +2361,54 @@ BOOL LLViewerObject::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	return TRUE;
 }
 
+void LLViewerObject::addToMotionTable(LLObjectMotionTable& table, const F64& time)
+{
+	mMotionSlot = -1;
+
+	// Same conditions as the interpolation in idleUpdate(), joints aside.
+	if (mDead || mStatic || !sVelocityInterpolate || mJointInfo || isSelected() || isAttachment())
+	{
+		return;
+	}
+
+	const LLVector3& vel = getVelocity();
+	const LLVector3& accel = getAcceleration();
+	const LLVector3& ang_vel = getAngularVelocity();
+	if (vel.isExactlyZero() && accel.isExactlyZero() && ang_vel.isExactlyZero())
+	{
+		return;
+	}
+
+	F32 dt = mTimeDilation * (F32)(time - mLastInterpUpdateSecs);
+	mMotionSlot = table.add(vel, accel, ang_vel, dt);
+}
+
+// Slot of this frame's batched motion results, -1 if the batch didn't cover
+// the object.
+S32 LLViewerObject::getMotionSlot(const F64& time) const
+{
+	const LLObjectMotionTable& table = gObjectList.getMotionTable();
+	if (mMotionSlot >= 0 && mMotionSlot < table.getCount() && table.getTime() == time)
+	{
+		return mMotionSlot;
+	}
+	return -1;
+}
+
+void LLViewerObject::getLinearMotion(const F64& time, F32 dt, const LLVector3& vel, const LLVector3& accel,
+									 LLVector3& displacement, LLVector3& velocity_delta) const
+{
+	S32 slot = getMotionSlot(time);
+	if (slot >= 0)
+	{
+		gObjectList.getMotionTable().getLinearMotion(slot, displacement, velocity_delta);
+	}
+	else
+	{
+		displacement = (vel + (0.5f * (dt-PHYSICS_TIMESTEP)) * accel) * dt;
+		velocity_delta = accel * dt;
+	}
+}
 
 // Move an object due to idle-time viewer side updates by iterpolating motion
 void LLViewerObject::interpolateLinearMotion(const F64 & time, const F32 & dt)
@@ -2234,11 +2435,13 @@ void LLViewerObject::interpolateLinearMotion(const F64 & time, const F32 & dt)
 	{	// Old code path ... unbounded, simple interpolation
 		if (!(accel.isExactlyZero() && vel.isExactlyZero()))
 		{
-			LLVector3 pos   = (vel + (0.5f * (dt-PHYSICS_TIMESTEP)) * accel) * dt;  
+			LLVector3 pos;
+			LLVector3 delta_v;
+			getLinearMotion(time, dt, vel, accel, pos, delta_v);
 		
 			// region local  
 			setPositionRegion(pos + getPositionRegion());
-			setVelocity(vel + accel*dt);	
+			setVelocity(vel + delta_v);	
 			
 			// for objects that are spinning but not translating, make sure to flag them as having moved
 			setChanged(MOVED | SILHOUETTE);
@@ -2248,8 +2451,9 @@ void LLViewerObject::interpolateLinearMotion(const F64 & time, const F32 & dt)
 	{	// Object is moving, and hasn't been too long since we got an update from the server
 		
 		// Calculate predicted position and velocity
-		LLVector3 new_pos = (vel + (0.5f * (dt-PHYSICS_TIMESTEP)) * accel) * dt;	
-		LLVector3 new_v = accel * dt;
+		LLVector3 new_pos;
+		LLVector3 new_v;
+		getLinearMotion(time, dt, vel, accel, new_pos, new_v);
 
 		if (time_since_last_update > sPhaseOutUpdateInterpolationTime &&
 			sPhaseOutUpdateInterpolationTime > 0.0)
@@ -3058,21 +3262,15 @@ void LLViewerObject::setScale(const LLVector3 &scale, BOOL damped)
 	{
 		if (permYouOwner() || (scale.magVecSquared() > (7.5f * 7.5f)) )
 		{
-			if (!mOnMap)
+			// Regions being torn down have left the world and stay off the map.
+			if (!isOnMap() && LLWorld::getInstance()->getRegionFromHandle(getRegion()->getHandle()) == getRegion())
 			{
-				llassert_always(LLWorld::getInstance()->getRegionFromHandle(getRegion()->getHandle()));
-
 				gObjectList.addToMap(this);
-				mOnMap = TRUE;
 			}
 		}
 		else
 		{
-			if (mOnMap)
-			{
-				gObjectList.removeFromMap(this);
-				mOnMap = FALSE;
-			}
+			gObjectList.removeFromMap(this);
 		}
 	}
 }
@@ -4536,7 +4734,7 @@ const LLViewerObject* LLViewerObject::getSubParent() const
 
 BOOL LLViewerObject::isOnMap()
 {
-	return mOnMap;
+	return mMapIndex != -1;
 }
 
 
@@ -4736,6 +4934,19 @@ F32 LLViewerObject::getVObjRadius() const
 	return mDrawable.notNull() ? mDrawable->getRadius() : 0.f;
 }
 
+void LLViewerObject::stopAttachedSound()
+{
+	if (mAudioSourcep)
+	{
+		// Do some cleanup
+		if (gAudiop)
+		{
+			gAudiop->cleanupAudioSource(mAudioSourcep);
+		}
+		mAudioSourcep = NULL;
+	}
+}
+
 void LLViewerObject::setAttachedSound(const LLUUID &audio_uuid, const LLUUID& owner_id, const F32 gain, const U8 flags)
 {
 	if (!gAudiop)
@@ -5413,10 +5624,21 @@ U8 LLViewerObject::getPhysicsShapeType() const
 	return mPhysicsShapeType; 
 }
 
-void LLViewerObject::applyAngularVelocity(F32 dt)
+void LLViewerObject::applyAngularVelocity(F32 dt, S32 motion_slot)
 {
 	//do target omega here
 	mRotTime += dt;
+	if (motion_slot >= 0)
+	{
+		LLQuaternion dQ;
+		if (gObjectList.getMotionTable().getSpin(motion_slot, dQ))
+		{
+			setRotation(getRotation()*dQ);
+			setChanged(MOVED | SILHOUETTE);
+		}
+		return;
+	}
+
 	LLVector3 ang_vel = getAngularVelocity();
 	F32 omega = ang_vel.magVecSquared();
 	F32 angle = 0.0f;
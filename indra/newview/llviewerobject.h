@@ -36,6 +36,7 @@
 #include <map>
 
 #include "llassetstorage.h"
+#include "llhost.h"
 #include "llhudtext.h"
 #include "llhudicon.h"
 #include "llinventory.h"
@@ -64,6 +65,7 @@ class LLWorld;
 class LLNameValue;
 class LLNetMap;
 class LLMessageSystem;
+class LLObjectMotionTable;
 class LLPartSysData;
 class LLPrimitive;
 class LLPipeline;
@@ -105,6 +107,20 @@ struct LLVOJointInfo
 	LLVector3 mAxisOrAnchor;	
 };
 
+// ImprovedTerseObjectUpdate block without texture entry, copied out of the
+// message so that applying it can wait for LLViewerObjectList::update().
+struct LLTerseObjectUpdate
+{
+	U64		mRegionHandle;
+	U32		mPacketID;
+	F64		mReceivedTime;
+	LLHost	mSender;
+	S32		mLength;
+	U16		mTimeDilation;
+	U8		mState;
+	U8		mData[60 + 16];
+};
+
 // for exporting textured materials from SL
 struct LLMaterialExportInfo
 {
@@ -174,11 +190,23 @@ public:
 										U32 block_num,
 										const EObjectUpdateType update_type,
 										LLDataPacker *dp);
+	// Steps dp over the fields processUpdateMessage() reads from a compressed
+	// full update, starting right after the PCode, and returns the CRC and
+	// special code found on the way. Thread safe.
+	static BOOL		skipCompressedUpdate(LLDataPacker& dp, U32& crc, U32& pass_flags);
+	// Same as processUpdateMessage() for a held back terse update.
+	U32				processTerseUpdate(const LLTerseObjectUpdate& update);
+	S32				getTerseUpdateIndex() const			{ return mTerseUpdateIndex; }
+	void			setTerseUpdateIndex(S32 index)		{ mTerseUpdateIndex = index; }
 
 
 	virtual BOOL    isActive() const; // Whether this object needs to do an idleUpdate.
-	BOOL			onActiveList() const				{return mOnActiveList;}
-	void			setOnActiveList(BOOL on_active)		{ mOnActiveList = on_active; }
+	BOOL			onActiveList() const				{ return mListIndex != -1; }
+	S32				getListIndex() const				{ return mListIndex; }
+	void			setListIndex(S32 index)				{ mListIndex = index; }
+
+	// Queues the frame's velocity interpolation into the object list's batched pass.
+	void			addToMotionTable(LLObjectMotionTable& table, const F64& time);
 
 	virtual BOOL	isAttachment() const { return FALSE; }
 	virtual LLVOAvatar* getAvatar() const;  //get the avatar this object is attached to, or NULL if object is not an attachment
@@ -211,7 +239,7 @@ public:
 	virtual BOOL		setDrawableParent(LLDrawable* parentp);
 	F32					getRotTime() { return mRotTime; }
 	void				resetRot();
-	void				applyAngularVelocity(F32 dt);
+	void				applyAngularVelocity(F32 dt, S32 motion_slot = -1);
 
 	void setLineWidthForWindowSize(S32 window_width);
 
@@ -367,6 +395,8 @@ public:
 	void setAttachedSound(const LLUUID &audio_uuid, const LLUUID& owner_id, const F32 gain, const U8 flags);
 	void adjustAudioGain(const F32 gain);
 	void clearAttachedSound()								{ mAudioSourcep = NULL; }
+	// Stops and releases the attached sound, if any.
+	void stopAttachedSound();
 
 	 // Create if necessary
 	LLAudioSource *getAudioSource(const LLUUID& owner_id);
@@ -552,6 +582,9 @@ private:
 	
 	// Motion prediction between updates
 	void interpolateLinearMotion(const F64 & time, const F32 & dt);
+	S32 getMotionSlot(const F64& time) const;
+	void getLinearMotion(const F64& time, F32 dt, const LLVector3& vel, const LLVector3& accel,
+						 LLVector3& displacement, LLVector3& velocity_delta) const;
 
 public:
 	//
@@ -640,6 +673,18 @@ protected:
 
 	BOOL setData(const U8 *datap, const U32 data_size);
 
+	// Shared by processUpdateMessage() and processTerseUpdate().
+	BOOL	setUpdateRegion(U64 region_handle, U16 time_dilation16);
+	void	unpackTerseData(const U8* data, S32 length, LLVector3& test_pos_parent,
+							LLVector3& new_pos_parent, LLQuaternion& new_rot, LLVector3& new_angv,
+							S32& this_update_precision);
+	U32		applyUpdateTransform(const EObjectUpdateType update_type, U32 retval,
+								 const LLVector3& test_pos_parent, LLVector3 new_pos_parent,
+								 LLQuaternion new_rot, const LLVector3& new_angv,
+								 const LLVector3& old_angv, const LLVector3& new_scale,
+								 S32 this_update_precision, BOOL b_changed_status,
+								 bool old_special_hover_cursor, const LLHost& sender, U32 packet_id);
+
 	// Hide or show HUD, icon and particles
 	void	hideExtraDisplayItems( BOOL hidden );
 
@@ -653,6 +698,8 @@ protected:
 	void doInventoryCallback();
 	
 	BOOL isOnMap();
+	S32 getMapIndex() const { return mMapIndex; }
+	void setMapIndex(S32 index) { mMapIndex = index; }
 
 	void unpackParticleSource(const S32 block_num, const LLUUID& owner_id);
 	void unpackParticleSource(LLDataPacker &dp, const LLUUID& owner_id);
@@ -704,8 +751,10 @@ protected:
 	BOOL			mDead;
 	BOOL			mOrphaned;					// This is an orphaned child
 	BOOL			mUserSelected;				// Cached user select information
-	BOOL			mOnActiveList;
-	BOOL			mOnMap;						// On the map.
+	S32				mListIndex;					// Index in the active object list, -1 if not on it.
+	S32				mMotionSlot;				// Slot in the object list's motion table.
+	S32				mMapIndex;					// Index in the object list's map objects, -1 if not on the map.
+	S32				mTerseUpdateIndex;			// Index of the object list's held back terse update, -1 if none.
 	BOOL			mStatic;					// Object doesn't move.
 	S32				mNumFaces;
 
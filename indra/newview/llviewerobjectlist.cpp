@@ -81,6 +81,7 @@
 
 #include "llappviewer.h"
 #include "llfloaterblacklist.h"
+#include "llgeometryworkers.h"
 
 #include "llviewerobjectbackup.h"
 
@@ -91,7 +92,6 @@ void dialog_refresh_all();
 
 #define CULL_VIS
 //#define ORPHAN_SPAM
-//#define IGNORE_DEAD
 
 // Global lists of objects - should go away soon.
 LLViewerObjectList gObjectList;
@@ -114,7 +114,6 @@ LLViewerObjectList::LLViewerObjectList()
 	mNumOrphans = 0;
 	mNumNewObjects = 0;
 	mWasPaused = FALSE;
-	mNumDeadObjectUpdates = 0;
 	mNumUnknownKills = 0;
 	mNumUnknownUpdates = 0;
 }
@@ -130,10 +129,8 @@ void LLViewerObjectList::destroy()
 
 	resetObjectBeacons();
 	mActiveObjects.clear();
-	mDeadObjects.clear();
 	mMapObjects.clear();
 	mUUIDObjectMap.clear();
-	mUUIDAvatarMap.clear();
 }
 
 
@@ -242,6 +239,9 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 {
 	LLMessageSystem* msg = gMessageSystem;
 
+	// Whatever arrives now supersedes a terse update held back.
+	discardTerseUpdate(objectp);
+
 	// ignore returned flags
 	objectp->processUpdateMessage(msg, user_data, i, update_type, dpp);
 		
@@ -294,6 +294,167 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 
 static LLFastTimer::DeclareTimer FTM_PROCESS_OBJECTS("Process Objects");
 
+// Below this many blocks in a message decoding them inline is cheaper than
+// waking the geometry workers.
+const S32 MIN_PARALLEL_DECODE_BLOCKS = 8;
+
+// Largest ObjectUpdateCompressed data block, before or after inflating.
+const S32 OBJECT_BLOCK_SIZE = 2048;
+
+// One block of an ObjectUpdateCompressed message, decoded by
+// decode_object_block() so that the main thread only has to apply it.
+struct LLCompressedObjectBlock
+{
+	// Set by decode_compressed_blocks()
+	U8* mData;				// block data, or where to inflate it
+	S32 mSize;				// -1 if the block didn't inflate
+	const U8* mCompressed;	// NULL if the block wasn't zlib compressed
+	S32 mCompressedSize;
+
+	// Set by decode_object_block()
+	S32 mHeaderSize;		// bytes up to the fields LLViewerObject reads
+	LLUUID mFullID;			// full updates only, like mPCode and mCRC
+	U32 mLocalID;
+	LLPCode mPCode;
+	U32 mCRC;
+	bool mCacheDupe;		// the region cache holds this CRC already
+	bool mHasVolume;		// mVolume is set
+	LLVOVolume::CompressedUpdate mVolume;
+};
+
+// The blocks of one ObjectUpdateCompressed message. Main thread only, but for
+// decode_object_block() running on the geometry workers while it waits.
+struct LLCompressedObjectBlocks
+{
+	std::vector<LLCompressedObjectBlock> mBlocks;
+	std::vector<U8> mRaw;		// the data of every block back to back
+	std::vector<U8> mInflated;	// OBJECT_BLOCK_SIZE per zlib compressed block
+	LLViewerRegion* mRegion;
+	EObjectUpdateType mUpdateType;
+};
+
+static void decode_object_block(void* data, U32 index)
+{
+	LLCompressedObjectBlocks& blocks = *(LLCompressedObjectBlocks*)data;
+	LLCompressedObjectBlock& block = blocks.mBlocks[index];
+	block.mHeaderSize = 0;
+	block.mCacheDupe = false;
+	block.mHasVolume = false;
+
+	if (block.mCompressed)
+	{
+		uLongf length = OBJECT_BLOCK_SIZE;
+		if (uncompress(block.mData, &length, block.mCompressed, block.mCompressedSize) != Z_OK)
+		{	// logged by the main thread
+			block.mSize = -1;
+			return;
+		}
+		block.mSize = (S32)length;
+	}
+
+	LLDataPackerBinaryBuffer dp(block.mData, block.mSize);
+	if (blocks.mUpdateType == OUT_TERSE_IMPROVED)
+	{
+		dp.unpackU32(block.mLocalID, "LocalID");
+		block.mHeaderSize = dp.getCurrentSize();
+		return;
+	}
+
+	dp.unpackUUID(block.mFullID, "ID");
+	dp.unpackU32(block.mLocalID, "LocalID");
+	dp.unpackU8(block.mPCode, "PCode");
+	block.mHeaderSize = dp.getCurrentSize();
+
+	U32 pass_flags;
+	if (!LLViewerObject::skipCompressedUpdate(dp, block.mCRC, pass_flags))
+	{	// processUpdateMessage() reads it the slow way and complains
+		return;
+	}
+	block.mCacheDupe = blocks.mRegion->isCacheDupe(block.mLocalID, block.mCRC);
+
+	if (block.mPCode == LL_PCODE_VOLUME)
+	{
+		LLVOVolume::decodeCompressedUpdate(dp, pass_flags, block.mVolume);
+		block.mHasVolume = true;
+	}
+}
+
+// Copies the data of every block of an ObjectUpdateCompressed message out of
+// the message and decodes it, in parallel when there are enough blocks.
+static void decode_compressed_blocks(LLMessageSystem* mesgsys, LLViewerRegion* regionp, const EObjectUpdateType update_type,
+									 S32 num_objects, LLCompressedObjectBlocks& blocks)
+{
+	blocks.mRegion = regionp;
+	blocks.mUpdateType = update_type;
+	if ((S32)blocks.mBlocks.size() < num_objects)
+	{
+		blocks.mBlocks.resize(num_objects);
+	}
+
+	// Size everything first, the blocks point into the buffers
+	S32 raw_size = 0;
+	S32 num_zipped = 0;
+	for (S32 i = 0; i < num_objects; i++)
+	{
+		LLCompressedObjectBlock& block = blocks.mBlocks[i];
+		U32 flags = 0;
+		if (update_type != OUT_TERSE_IMPROVED)
+		{
+			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
+		}
+
+		block.mSize = llclamp(mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data), 0, OBJECT_BLOCK_SIZE);
+		block.mCompressedSize = (flags & FLAGS_ZLIB_COMPRESSED) ? block.mSize : 0;
+		raw_size += block.mSize;
+		if (block.mCompressedSize)
+		{
+			num_zipped++;
+		}
+	}
+
+	if ((S32)blocks.mRaw.size() < raw_size + 1)
+	{
+		blocks.mRaw.resize(raw_size + 1);
+	}
+	if ((S32)blocks.mInflated.size() < num_zipped * OBJECT_BLOCK_SIZE)
+	{
+		blocks.mInflated.resize(num_zipped * OBJECT_BLOCK_SIZE);
+	}
+
+	U8* raw = &blocks.mRaw[0];
+	U8* inflated = num_zipped ? &blocks.mInflated[0] : NULL;
+	for (S32 i = 0; i < num_objects; i++)
+	{
+		LLCompressedObjectBlock& block = blocks.mBlocks[i];
+		mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, raw, 0, i, block.mSize);
+		if (block.mCompressedSize)
+		{
+			block.mCompressed = raw;
+			block.mData = inflated;
+			inflated += OBJECT_BLOCK_SIZE;
+		}
+		else
+		{
+			block.mCompressed = NULL;
+			block.mData = raw;
+		}
+		raw += block.mSize;
+	}
+
+	LLGeometryWorkers* workers = LLGeometryWorkers::getInstance();
+	if (workers && num_objects >= MIN_PARALLEL_DECODE_BLOCKS)
+	{
+		workers->run(decode_object_block, &blocks, num_objects);
+	}
+	else
+	{
+		for (S32 i = 0; i < num_objects; i++)
+		{
+			decode_object_block(&blocks, i);
+		}
+	}
+}
+
 void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 											 void **user_data,
 											 const EObjectUpdateType update_type,
@@ -355,8 +516,14 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		return;
 	}
 
-	U8 compressed_dpbuffer[2048];
-	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
+	// Main thread only, kept around so floods of updates don't reallocate it.
+	static LLCompressedObjectBlocks compressed_blocks;
+	if (compressed)
+	{
+		decode_compressed_blocks(mesgsys, regionp, update_type, num_objects, compressed_blocks);
+	}
+
+	LLDataPackerBinaryBuffer compressed_dp;
 	LLDataPacker *cached_dpp = NULL;
 	
 	for (i = 0; i < num_objects; i++)
@@ -394,43 +561,25 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		}
 		else if (compressed)
 		{
-			U8							compbuffer[2048];
-			S32							uncompressed_length = 2048;
-			S32							compressed_length;
-			compressed_dp.reset();
-
-			U32 flags = 0;
-			if (update_type != OUT_TERSE_IMPROVED)
+			const LLCompressedObjectBlock& block = compressed_blocks.mBlocks[i];
+			if (block.mSize < 0)
 			{
-				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
-			}
-			
-			if (flags & FLAGS_ZLIB_COMPRESSED)
-			{
-				compressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compbuffer, 0, i);
-				uncompressed_length = 2048;
-				uncompress(compressed_dpbuffer, (unsigned long *)&uncompressed_length,
-						   compbuffer, compressed_length);
-				compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
-			}
-			else
-			{
-				uncompressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compressed_dpbuffer, 0, i);
-				compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
+				llwarns << "Failed to inflate compressed object update " << i << " from " << mesgsys->getSender() << llendl;
+				continue;
 			}
+			// The buffer belongs to compressed_blocks, don't let assignBuffer() free it.
+			compressed_dp.releaseBuffer();
+			compressed_dp.assignBuffer(block.mData, block.mSize);
+			compressed_dp.seek(block.mHeaderSize);
 
-
+			local_id = block.mLocalID;
 			if (update_type != OUT_TERSE_IMPROVED)
 			{
-				compressed_dp.unpackUUID(fullid, "ID");
-				compressed_dp.unpackU32(local_id, "LocalID");
-				compressed_dp.unpackU8(pcode, "PCode");
+				fullid = block.mFullID;
+				pcode = block.mPCode;
 			}
 			else
 			{
-				compressed_dp.unpackU32(local_id, "LocalID");
 				getUUIDFromLocal(fullid,
 								 local_id,
 								 gMessageSystem->getSenderIP(),
@@ -520,15 +669,6 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 
 				mesgsys->getU8Fast(_PREHASH_ObjectData, _PREHASH_PCode, pcode, i);
 			}
-#ifdef IGNORE_DEAD
-			if (mDeadObjects.find(fullid) != mDeadObjects.end())
-			{
-				mNumDeadObjectUpdates++;
-				// llinfos << "update for a dead object:" << fullid << llendl;
-				continue;
-			}
-#endif
-
 
 			if(std::find(LLFloaterBlacklist::blacklist_objects.begin(),
 				LLFloaterBlacklist::blacklist_objects.end(),fullid) != LLFloaterBlacklist::blacklist_objects.end())
@@ -556,15 +696,30 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		bool bCached = false;
 		if (compressed)
 		{
+			const LLCompressedObjectBlock& block = compressed_blocks.mBlocks[i];
+			LLVOVolume* volumep = NULL;
 			if (update_type != OUT_TERSE_IMPROVED)
 			{
 				objectp->mLocalID = local_id;
+				if (block.mHasVolume && objectp->getPCode() == LL_PCODE_VOLUME)
+				{
+					volumep = (LLVOVolume*)objectp;
+					volumep->setCompressedUpdate(&block.mVolume);
+				}
 			}
 			processUpdateCore(objectp, user_data, i, update_type, &compressed_dp, justCreated);
+			if (volumep)
+			{
+				volumep->setCompressedUpdate(NULL);
+			}
 			if (update_type != OUT_TERSE_IMPROVED)
 			{
 				bCached = true;
-				objectp->mRegionp->cacheFullUpdate(objectp, compressed_dp);
+				if (!block.mCacheDupe || objectp->mRegionp != regionp
+					|| !regionp->recordCacheDupe(local_id, block.mCRC))
+				{
+					objectp->mRegionp->cacheFullUpdate(objectp, compressed_dp);
+				}
 			}
 		}
 		else if (cached)
@@ -578,6 +733,12 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 			{
 				objectp->mLocalID = local_id;
 			}
+			else if (!justCreated && deferTerseUpdate(objectp, mesgsys, i))
+			{
+				objectp->setLastUpdateType(update_type);
+				objectp->setLastUpdateCached(bCached);
+				continue;
+			}
 			processUpdateCore(objectp, user_data, i, update_type, NULL, justCreated);
 		}
 		
@@ -588,6 +749,168 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 	LLVOAvatar::cullAvatarsByPixelArea();
 }
 
+// Terse updates held back longer than this are applied regardless of the budget.
+const F32 TERSE_UPDATE_MAX_DELAY = 1.f;
+
+bool LLViewerObjectList::deferTerseUpdate(LLViewerObject* objectp, LLMessageSystem* mesgsys, U32 block_num)
+{
+	static const LLCachedControl<F32> budget("ObjectUpdateBudget", 1.f);
+	if (budget <= 0.f
+		|| objectp->getPCode() != LL_PCODE_VOLUME
+		|| objectp->getParent() // attachments move with their avatar
+		|| objectp->isSelected()
+		|| objectp->isSeat() // seated avatars move with it
+		|| (isAgentAvatarValid() && gAgentAvatarp->getRootEdit() == objectp) // the camera follows it
+		|| mesgsys->getSizeFast(_PREHASH_ObjectData, block_num, _PREHASH_TextureEntry))
+	{
+		return false;
+	}
+
+	// 48 and 76 byte blocks carry an avatar foot plane.
+	S32 length = mesgsys->getSizeFast(_PREHASH_ObjectData, block_num, _PREHASH_ObjectData);
+	if (length != 16 && length != 32 && length != 60)
+	{
+		return false;
+	}
+
+	U32 packet_id = mesgsys->getCurrentRecvPacketID();
+	S32 index = objectp->getTerseUpdateIndex();
+	if (index < 0)
+	{
+		index = (S32)mTerseUpdates.size();
+		mTerseUpdates.push_back(PendingTerseUpdate());
+		mTerseUpdates.back().mObject = objectp;
+		objectp->setTerseUpdateIndex(index);
+	}
+	else
+	{
+		U32 held_packet_id = mTerseUpdates[index].mUpdate.mPacketID;
+		if (packet_id < held_packet_id && held_packet_id - packet_id < 65536)
+		{
+			// Out of order, the update held back is newer.
+			return true;
+		}
+	}
+
+	LLTerseObjectUpdate& update = mTerseUpdates[index].mUpdate;
+	mesgsys->getU64Fast(_PREHASH_RegionData, _PREHASH_RegionHandle, update.mRegionHandle);
+	mesgsys->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, update.mTimeDilation);
+	mesgsys->getU8Fast(_PREHASH_ObjectData, _PREHASH_State, update.mState, block_num);
+	mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_ObjectData, update.mData, length, block_num);
+	update.mLength = length;
+	update.mPacketID = packet_id;
+	update.mReceivedTime = LLFrameTimer::getElapsedSeconds();
+	update.mSender = mesgsys->getSender();
+	return true;
+}
+
+void LLViewerObjectList::discardTerseUpdate(LLViewerObject* objectp)
+{
+	S32 index = objectp->getTerseUpdateIndex();
+	if (index >= 0)
+	{
+		llassert(mTerseUpdates[index].mObject == objectp);
+		mTerseUpdates[index].mObject = NULL;
+		objectp->setTerseUpdateIndex(-1);
+	}
+}
+
+static LLFastTimer::DeclareTimer FTM_TERSE_UPDATES("Terse Updates");
+
+void LLViewerObjectList::applyTerseUpdates(F32 max_time)
+{
+	if (mTerseUpdates.empty())
+	{
+		return;
+	}
+
+	LLFastTimer t(FTM_TERSE_UPDATES);
+	static const LLCachedControl<F32> min_area("ObjectUpdateMinArea", 256.f);
+	static const LLCachedControl<F32> interval("ObjectUpdateInterval", 0.25f);
+
+	// Overdue updates go first, then those of objects in view by pixel area,
+	// then everything else that was held back for the interval.
+	typedef std::vector<std::pair<F32, S32> > ready_list_t;
+	ready_list_t overdue, in_view, other;
+	const F64 now = LLFrameTimer::getElapsedSeconds();
+	for (S32 i = 0; i < (S32)mTerseUpdates.size(); ++i)
+	{
+		PendingTerseUpdate& pending = mTerseUpdates[i];
+		LLViewerObject* objectp = pending.mObject;
+		if (!objectp)
+		{
+			continue;
+		}
+		if (!LLWorld::getInstance()->getRegionFromHandle(pending.mUpdate.mRegionHandle))
+		{
+			discardTerseUpdate(objectp);
+			continue;
+		}
+
+		F32 age = (F32)(now - pending.mUpdate.mReceivedTime);
+		F32 area = objectp->getPixelArea();
+		if (age > TERSE_UPDATE_MAX_DELAY || objectp->isSelected())
+		{
+			overdue.push_back(std::make_pair(-age, i));
+		}
+		else if (area >= min_area && objectp->mDrawable.notNull() && objectp->mDrawable->isVisible())
+		{
+			in_view.push_back(std::make_pair(-area, i));
+		}
+		else if (age >= interval)
+		{
+			other.push_back(std::make_pair(-age, i));
+		}
+	}
+	std::sort(overdue.begin(), overdue.end());
+	std::sort(in_view.begin(), in_view.end());
+	std::sort(other.begin(), other.end());
+	U32 num_overdue = overdue.size();
+	ready_list_t& ready = overdue;
+	ready.insert(ready.end(), in_view.begin(), in_view.end());
+	ready.insert(ready.end(), other.begin(), other.end());
+
+	LLTimer timer;
+	for (U32 i = 0; i < ready.size(); ++i)
+	{
+		if (i >= num_overdue && (i & 7) == 0 && timer.getElapsedTimeF32() > max_time)
+		{
+			break;
+		}
+
+		PendingTerseUpdate& pending = mTerseUpdates[ready[i].second];
+		LLPointer<LLViewerObject> objectp = pending.mObject;
+		discardTerseUpdate(objectp);
+		objectp->processTerseUpdate(pending.mUpdate);
+		if (objectp->isDead())
+		{
+			continue;
+		}
+
+		// Same as processUpdateCore() for an existing object.
+		updateActive(objectp);
+		LLObjectBackup::getInstance()->primUpdate(objectp);
+		objectp->setPixelAreaAndAngle(gAgent);
+		findOrphans(objectp, pending.mUpdate.mSender.getAddress(), pending.mUpdate.mSender.getPort());
+	}
+
+	// Compact what was applied or discarded.
+	S32 count = 0;
+	for (S32 i = 0; i < (S32)mTerseUpdates.size(); ++i)
+	{
+		if (mTerseUpdates[i].mObject.notNull())
+		{
+			if (i != count)
+			{
+				mTerseUpdates[count] = mTerseUpdates[i];
+				mTerseUpdates[count].mObject->setTerseUpdateIndex(count);
+			}
+			++count;
+		}
+	}
+	mTerseUpdates.resize(count);
+}
+
 void LLViewerObjectList::processCompressedObjectUpdate(LLMessageSystem *mesgsys,
 											 void **user_data,
 											 const EObjectUpdateType update_type)
@@ -913,6 +1236,9 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	//clear avatar LOD change counter
 	LLVOAvatar::sNumLODChangesThisFrame = 0;
 
+	static const LLCachedControl<F32> terse_update_budget("ObjectUpdateBudget", 1.f);
+	applyTerseUpdates(terse_update_budget * 0.001f);
+
 	const F64 frame_time = LLFrameTimer::getElapsedSeconds();
 	
 	std::vector<LLViewerObject*> kill_list;
@@ -928,7 +1254,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 		LLFastTimer t(idle_copy);
 		idle_list.reserve( mActiveObjects.size() );
 
- 		for (std::set<LLPointer<LLViewerObject> >::iterator active_iter = mActiveObjects.begin();
+ 		for (vobj_list_t::iterator active_iter = mActiveObjects.begin();
 			active_iter != mActiveObjects.end(); active_iter++)
 		{
 			objectp = *active_iter;
@@ -945,6 +1271,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	}
 
 	static const LLCachedControl<bool> freeze_time("FreezeTime",0);
+	mMotionTable.reset(frame_time);
 	if (freeze_time)
 	{
 		for (std::vector<LLViewerObject*>::iterator iter = idle_list.begin();
@@ -960,6 +1287,19 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	}
 	else
 	{
+		static LLFastTimer::DeclareTimer idle_motion("Idle Motion");
+		{
+			// Integrate all the dead reckoning up front, idleUpdate() picks
+			// up the results.
+			LLFastTimer t(idle_motion);
+			for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
+				idle_iter != idle_list.end(); idle_iter++)
+			{
+				(*idle_iter)->addToMotionTable(mMotionTable, frame_time);
+			}
+			mMotionTable.integrate();
+		}
+
 		for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
 			idle_iter != idle_list.end(); idle_iter++)
 		{
@@ -1186,20 +1526,14 @@ void LLViewerObjectList::clearDebugText()
 void LLViewerObjectList::cleanupReferences(LLViewerObject *objectp)
 {
 	LLMemType mt(LLMemType::MTYPE_OBJECT);
-	if (mDeadObjects.find(objectp->mID) != mDeadObjects.end())
-	{
-		llinfos << "Object " << objectp->mID << " already on dead list!" << llendl;	
-	}
-	else
-	{
-		mDeadObjects.insert(objectp->mID);
-	}
 
 	// Cleanup any references we have to this object
 	// Remove from object map so noone can look it up.
 
-	mUUIDObjectMap.erase(objectp->mID);
-	mUUIDAvatarMap.erase(objectp->mID);//No need to be careful here.
+	if (mUUIDObjectMap.find(objectp->mID) == objectp)
+	{
+		mUUIDObjectMap.erase(objectp->mID);
+	}
 	
 	//if (objectp->getRegion())
 	//{
@@ -1213,8 +1547,7 @@ void LLViewerObjectList::cleanupReferences(LLViewerObject *objectp)
 	if (objectp->onActiveList())
 	{
 		//llinfos << "Removing " << objectp->mID << " " << objectp->getPCodeString() << " from active list in cleanupReferences." << llendl;
-		objectp->setOnActiveList(FALSE);
-		mActiveObjects.erase(objectp);
+		removeFromActiveList(objectp);
 	}
 
 	if (objectp->isOnMap())
@@ -1222,6 +1555,8 @@ void LLViewerObjectList::cleanupReferences(LLViewerObject *objectp)
 		removeFromMap(objectp);
 	}
 
+	discardTerseUpdate(objectp);
+
 	// Don't clean up mObject references, these will be cleaned up more efficiently later!
 	// Also, not cleaned up
 	removeDrawable(objectp->mDrawable);
@@ -1306,11 +1641,49 @@ void LLViewerObjectList::killObjects(LLViewerRegion *regionp)
 	llinfos << "Removed " << count << " objects for region " << regionp->getName() << ". (" << kill_timer.getElapsedTimeF64()*1000.0 << "ms)" << llendl;
 }
 
+static bool is_not_avatar(const LLPointer<LLViewerObject>& objectp)
+{
+	return !objectp->isAvatar();
+}
+
+void LLViewerObjectList::detachRegionObjects(LLViewerRegion* regionp, vobj_list_t& objects)
+{
+	for (vobj_list_t::iterator iter = mObjects.begin(); iter != mObjects.end(); ++iter)
+	{
+		LLViewerObject* objectp = *iter;
+		if (objectp->mRegionp == regionp && !objectp->isDead())
+		{
+			removeFromMap(objectp);
+			// Nothing updates a detached object any more, and until it gets
+			// killed it should neither be seen floating in place nor heard.
+			discardTerseUpdate(objectp);
+			if (objectp->onActiveList())
+			{
+				removeFromActiveList(objectp);
+			}
+			objectp->hideExtraDisplayItems(TRUE);
+			objectp->stopAttachedSound();
+			objects.push_back(objectp);
+		}
+	}
+	// Avatars carry name tags and attachments, get them out of sight first.
+	std::stable_partition(objects.begin(), objects.end(), is_not_avatar);
+}
+
 void LLViewerObjectList::killAllObjects()
 {
 	// Used only on global destruction.
 	LLViewerObject *objectp;
 
+	for (std::vector<PendingTerseUpdate>::iterator iter = mTerseUpdates.begin(); iter != mTerseUpdates.end(); ++iter)
+	{
+		if (iter->mObject.notNull())
+		{
+			iter->mObject->setTerseUpdateIndex(-1);
+		}
+	}
+	mTerseUpdates.clear();
+
 	for (vobj_list_t::iterator iter = mObjects.begin(); iter != mObjects.end(); ++iter)
 	{
 		objectp = *iter;
@@ -1331,12 +1704,20 @@ void LLViewerObjectList::killAllObjects()
 	if (!mActiveObjects.empty())
 	{
 		llwarns << "Some objects still on active object list!" << llendl;
+		for (vobj_list_t::iterator iter = mActiveObjects.begin(); iter != mActiveObjects.end(); ++iter)
+		{
+			(*iter)->setListIndex(-1);
+		}
 		mActiveObjects.clear();
 	}
 
 	if (!mMapObjects.empty())
 	{
 		llwarns << "Some objects still on map object list!" << llendl;
+		for (vobj_list_t::iterator iter = mMapObjects.begin(); iter != mMapObjects.end(); ++iter)
+		{
+			(*iter)->setMapIndex(-1);
+		}
 		mMapObjects.clear();
 	}
 }
@@ -1398,9 +1779,6 @@ void LLViewerObjectList::cleanDeadObjects(BOOL use_timer)
 	llassert(end - last == num_removed);
 	mObjects.erase(last, end);
 
-	// We've cleaned the global object list, now let's do some paranoia testing on objects
-	// before blowing away the dead list.
-	mDeadObjects.clear();
 	mNumDeadObjects = 0;
 }
 
@@ -1418,18 +1796,36 @@ void LLViewerObjectList::updateActive(LLViewerObject *objectp)
 		if (active)
 		{
 			//llinfos << "Adding " << objectp->mID << " " << objectp->getPCodeString() << " to active list." << llendl;
-			mActiveObjects.insert(objectp);
-			objectp->setOnActiveList(TRUE);
+			addToActiveList(objectp);
 		}
 		else
 		{
 			//llinfos << "Removing " << objectp->mID << " " << objectp->getPCodeString() << " from active list." << llendl;
-			mActiveObjects.erase(objectp);
-			objectp->setOnActiveList(FALSE);
+			removeFromActiveList(objectp);
 		}
 	}
 }
 
+void LLViewerObjectList::addToActiveList(LLViewerObject* objectp)
+{
+	objectp->setListIndex(mActiveObjects.size());
+	mActiveObjects.push_back(objectp);
+}
+
+// Swaps the last object into the hole, O(1) at the cost of the order.
+void LLViewerObjectList::removeFromActiveList(LLViewerObject* objectp)
+{
+	S32 index = objectp->getListIndex();
+	llassert_always(index >= 0 && index < (S32)mActiveObjects.size() && mActiveObjects[index] == objectp);
+	objectp->setListIndex(-1);
+	if (index != (S32)mActiveObjects.size() - 1)
+	{
+		mActiveObjects[index] = mActiveObjects.back();
+		mActiveObjects[index]->setListIndex(index);
+	}
+	mActiveObjects.pop_back();
+}
+
 void LLViewerObjectList::updateObjectCost(LLViewerObject* object)
 {
 	if (!object->isRoot())
@@ -1863,13 +2259,7 @@ LLViewerObject *LLViewerObjectList::createObjectViewer(const LLPCode pcode, LLVi
 		return NULL;
 	}
 
-	mUUIDObjectMap[fullid] = objectp;
-	if(objectp->isAvatar())
-	{
-		LLVOAvatar *pAvatar = dynamic_cast<LLVOAvatar*>(objectp);
-		if(pAvatar)
-			mUUIDAvatarMap[fullid] = pAvatar;
-	}
+	mUUIDObjectMap.insert(fullid, objectp);
 
 	mObjects.push_back(objectp);
 
@@ -1904,13 +2294,7 @@ LLViewerObject *LLViewerObjectList::createObject(const LLPCode pcode, LLViewerRe
 		return NULL;
 	}
 
-	mUUIDObjectMap[fullid] = objectp;
-	if(objectp->isAvatar())
-	{
-		LLVOAvatar *pAvatar = dynamic_cast<LLVOAvatar*>(objectp);
-		if(pAvatar)
-			mUUIDAvatarMap[fullid] = pAvatar;
-	}
+	mUUIDObjectMap.insert(fullid, objectp);
 	setUUIDAndLocal(fullid,
 					local_id,
 					gMessageSystem->getSenderIP(),
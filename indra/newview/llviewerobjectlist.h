@@ -41,6 +41,8 @@
 #include "llstring.h"
 
 // project includes
+#include "llobjectidmap.h"
+#include "llobjectmotion.h"
 #include "llviewerobject.h"
 #include "llvoavatar.h"
 
@@ -82,6 +84,8 @@ public:
 	
 	BOOL killObject(LLViewerObject *objectp);
 	void killObjects(LLViewerRegion *regionp); // Kill all objects owned by a particular region.
+	// Takes the objects of a region leaving the world off the map and returns them, avatars last.
+	void detachRegionObjects(LLViewerRegion* regionp, std::vector<LLPointer<LLViewerObject> >& objects);
 	void killAllObjects();
 	void removeDrawable(LLDrawable* drawablep);
 
@@ -95,6 +99,15 @@ public:
 	void updateApparentAngles(LLAgent &agent);
 	void update(LLAgent &agent, LLWorld &world);
 
+	// Terse updates of distant and out of view objects are held back and only
+	// the latest one per object is applied, within a per frame budget.
+	// Returns false when the update has to be processed right away.
+	bool deferTerseUpdate(LLViewerObject* objectp, LLMessageSystem* mesgsys, U32 block_num);
+	// Drops the held back update of objectp, superseded by a newer one.
+	void discardTerseUpdate(LLViewerObject* objectp);
+	void applyTerseUpdates(F32 max_time);
+	S32 getNumTerseUpdates() const { return (S32)mTerseUpdates.size(); }
+
 	void fetchObjectCosts();
 	void fetchPhysicsFlags();
 
@@ -131,6 +144,9 @@ public:
 	void updateActive(LLViewerObject *objectp);
 	void updateAvatarVisibility();
 
+	// Batched velocity interpolation results of the current frame.
+	const LLObjectMotionTable& getMotionTable() const { return mMotionTable; }
+
 	// Selection related stuff
 	void generatePickList(LLCamera &camera);
 
@@ -150,6 +166,12 @@ public:
 
 	S32 findReferences(LLDrawable *drawablep) const; // Find references to drawable in all objects, and return value.
 
+private:
+	void addToActiveList(LLViewerObject* objectp);
+	void removeFromActiveList(LLViewerObject* objectp);
+
+public:
+
 	S32 getOrphanParentCount() const { return (S32) mOrphanParents.size(); }
 	S32 getOrphanCount() const { return mNumOrphans; }
 	void orphanize(LLViewerObject *childp, U32 parent_id, U32 ip, U32 port);
@@ -194,7 +216,6 @@ public:
 	static U64 getIndex(const U32 local_id, const U32 ip, const U32 port);
 
 	S32 mNumUnknownUpdates;
-	S32 mNumDeadObjectUpdates;
 	S32 mNumUnknownKills;
 	S32 mNumDeadObjects;
 	S32 mMinNumDeadObjects;
@@ -206,14 +227,20 @@ public:
 	typedef std::vector<LLPointer<LLViewerObject> > vobj_list_t;
 
 	vobj_list_t mObjects;
-	std::set<LLPointer<LLViewerObject> > mActiveObjects;
+	vobj_list_t mActiveObjects; // unordered, objects know their index
+	LLObjectMotionTable mMotionTable;
 
-	vobj_list_t mMapObjects;
+	vobj_list_t mMapObjects; // unordered, objects know their index
 
-	std::set<LLUUID> mDeadObjects;	
+	struct PendingTerseUpdate
+	{
+		LLPointer<LLViewerObject> mObject; // NULL once applied or discarded
+		LLTerseObjectUpdate mUpdate;
+	};
+	std::vector<PendingTerseUpdate> mTerseUpdates; // objects know their index
 
-	std::map<LLUUID, LLPointer<LLViewerObject> > mUUIDObjectMap;
-	std::map<LLUUID, LLPointer<LLVOAvatar> > mUUIDAvatarMap;
+	// Live objects only, dead ones stay in mObjects until cleanDeadObjects().
+	LLObjectIDMap mUUIDObjectMap;
 
 	//set of objects that need to update their cost
 	std::set<LLUUID> mStaleObjectCost;
@@ -265,21 +292,13 @@ extern LLViewerObjectList gObjectList;
 // Inlines
 inline LLViewerObject *LLViewerObjectList::findObject(const LLUUID &id) const
 {
-	std::map<LLUUID, LLPointer<LLViewerObject> >::const_iterator iter = mUUIDObjectMap.find(id);
-	if(iter != mUUIDObjectMap.end())
-	{
-		return iter->second;
-	}
-	else
-	{
-		return NULL;
-	}
+	return mUUIDObjectMap.find(id);
 }
 
 inline LLVOAvatar *LLViewerObjectList::findAvatar(const LLUUID &id) const
 {
-	std::map<LLUUID, LLPointer<LLVOAvatar> >::const_iterator iter = mUUIDAvatarMap.find(id);
-	return (iter != mUUIDAvatarMap.end()) ? iter->second.get() : NULL;
+	LLViewerObject* objectp = mUUIDObjectMap.find(id);
+	return (objectp && objectp->isAvatar()) ? (LLVOAvatar*)objectp : NULL;
 }
 
 inline LLViewerObject *LLViewerObjectList::getObject(const S32 index)
@@ -296,15 +315,25 @@ inline LLViewerObject *LLViewerObjectList::getObject(const S32 index)
 
 inline void LLViewerObjectList::addToMap(LLViewerObject *objectp)
 {
-	mMapObjects.push_back(objectp);
+	if (!objectp->isOnMap())
+	{
+		objectp->setMapIndex(mMapObjects.size());
+		mMapObjects.push_back(objectp);
+	}
 }
 
 inline void LLViewerObjectList::removeFromMap(LLViewerObject *objectp)
 {
-	std::vector<LLPointer<LLViewerObject> >::iterator iter = std::find(mMapObjects.begin(), mMapObjects.end(), objectp);
-	if (iter != mMapObjects.end())
+	S32 index = objectp->getMapIndex();
+	if (index != -1)
 	{
-		mMapObjects.erase(iter);
+		objectp->setMapIndex(-1);
+		if (index != (S32)mMapObjects.size() - 1)
+		{
+			mMapObjects[index] = mMapObjects.back();
+			mMapObjects[index]->setMapIndex(index);
+		}
+		mMapObjects.pop_back();
 	}
 }
 
@@ -59,6 +59,7 @@ const U8  OVERLAY_IMG_COMPONENTS = 4;
 LLViewerParcelOverlay::LLViewerParcelOverlay(LLViewerRegion* region, F32 region_width_meters)
 :	mRegion( region ),
 	mParcelGridsPerEdge( S32( region_width_meters / PARCEL_GRID_STEP_METERS ) ),
+	mReceivedChunks( 0 ),
 	mDirty( FALSE ),
 	mTimeSinceLastUpdate(),
 	mOverlayTextureIdx(-1),
@@ -416,11 +417,39 @@ void LLViewerParcelOverlay::uncompressLandOverlay(S32 chunk, U8 *packed_overlay)
 	S32 chunk_size = size / PARCEL_OVERLAY_CHUNKS;
 
 	memcpy(mOwnership + chunk*chunk_size, packed_overlay, chunk_size);		/*Flawfinder: ignore*/
+	mReceivedChunks |= 1 << chunk;
 
 	// Force property lines and overlay texture to update
 	setDirty();
 }
 
+void LLViewerParcelOverlay::getOwnership(std::vector<U8>& ownership) const
+{
+	ownership.clear();
+	if (mReceivedChunks == (1 << PARCEL_OVERLAY_CHUNKS) - 1)
+	{
+		ownership.assign(mOwnership, mOwnership + mParcelGridsPerEdge * mParcelGridsPerEdge);
+	}
+}
+
+void LLViewerParcelOverlay::setCachedOwnership(const std::vector<U8>& ownership)
+{
+	if ((S32)ownership.size() != mParcelGridsPerEdge * mParcelGridsPerEdge)
+	{
+		return;
+	}
+
+	S32 chunk_size = ownership.size() / PARCEL_OVERLAY_CHUNKS;
+	for (S32 chunk = 0; chunk < PARCEL_OVERLAY_CHUNKS; chunk++)
+	{
+		if (!(mReceivedChunks & (1 << chunk)))
+		{
+			memcpy(mOwnership + chunk*chunk_size, &ownership[chunk*chunk_size], chunk_size);		/*Flawfinder: ignore*/
+		}
+	}
+	setDirty();
+}
+
 
 void LLViewerParcelOverlay::updatePropertyLines()
 {
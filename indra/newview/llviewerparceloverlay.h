@@ -82,6 +82,12 @@ public:
 	// MANIPULATE
 	void	uncompressLandOverlay(S32 chunk, U8 *compressed_overlay);
 
+	// Region warm start, see LLRegionCacheThread. Empty until the simulator
+	// sent every chunk of the ownership.
+	void	getOwnership(std::vector<U8>& ownership) const;
+	// Shows ownership saved earlier for the chunks the simulator hasn't sent.
+	void	setCachedOwnership(const std::vector<U8>& ownership);
+
 	// Indicate property lines and overlay texture need to be rebuilt.
 	void	setDirty();
 
@@ -117,6 +123,7 @@ private:
 	// Each value is 0-3, PARCEL_AVAIL to PARCEL_SELF in the two low bits
 	// and other flags in the upper bits.
 	U8				*mOwnership;
+	U32				mReceivedChunks;	// one bit per overlay chunk the simulator sent
 
 	// Update propery lines and overlay texture
 	BOOL			mDirty;
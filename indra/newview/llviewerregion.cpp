@@ -50,6 +50,7 @@
 
 #include "llagent.h"
 #include "llagentcamera.h"
+#include "llappviewer.h"
 #include "llcallingcard.h"
 #include "llcaphttpsender.h"
 #include "llcapabilitylistener.h"
@@ -60,6 +61,7 @@
 #include "llfloaterreporter.h"
 #include "llfloaterregioninfo.h"
 #include "llhttpnode.h"
+#include "llregioncachethread.h"
 #include "llregioninfomodel.h"
 #include "llsdutil.h"
 #include "llstartup.h"
@@ -104,6 +106,9 @@ public:
 			mSeedCapMaxAttemptsBeforeLogin(MAX_SEED_CAP_ATTEMPTS_BEFORE_LOGIN),
 			mSeedCapAttempts(0),
 			mHttpResponderID(0),
+			mRegionStateRequested(false),
+			mRegionStatePending(false),
+			mRegionStateSaved(false),
 		    // I'd prefer to set the LLCapabilityListener name to match the region
 		    // name -- it's disappointing that's not available at construction time.
 		    // We could instead store an LLCapabilityListener*, making
@@ -158,6 +163,11 @@ public:
 
 	S32 mHttpResponderID;
 
+	// Warm start from the state saved by LLRegionCacheThread.
+	bool mRegionStateRequested;
+	bool mRegionStatePending;
+	bool mRegionStateSaved;
+
 	/// Post an event to this LLCapabilityListener to invoke a capability message on
 	/// this LLViewerRegion's server
 	/// (https://wiki.lindenlab.com/wiki/Viewer:Messaging/Messaging_Notes#Capabilities)
@@ -322,6 +332,9 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 
 	mParcelOverlay = new LLViewerParcelOverlay(this, region_width_meters);
 
+	// Usually read already, along with the neighbours of the login or teleport destination.
+	LLAppViewer::getRegionCacheThread()->preload(handle, false);
+
 	setOriginGlobal(from_region_handle(handle));
 	calculateCenterGlobal();
 
@@ -362,6 +375,7 @@ void LLViewerRegion::initStats()
 
 LLViewerRegion::~LLViewerRegion() 
 {
+	saveRegionState();
 	gVLManager.cleanupData(this);
 	// Can't do this on destruction, because the neighbor pointers might be invalid.
 	// This should be reference counted...
@@ -378,6 +392,8 @@ LLViewerRegion::~LLViewerRegion()
 	LLHTTPSender::clearSender(mImpl->mHost);
 	
 	saveObjectCache();
+	// Left over when updates arrived after an early save.
+	std::for_each(mImpl->mCacheMap.begin(), mImpl->mCacheMap.end(), DeletePairedPointer());
 
 	std::for_each(mImpl->mObjectPartition.begin(), mImpl->mObjectPartition.end(), DeletePointer());
 
@@ -385,6 +401,15 @@ LLViewerRegion::~LLViewerRegion()
 	mImpl = NULL;
 }
 
+void LLViewerRegion::detachFromWorld()
+{
+	gVLManager.cleanupData(this);
+	disconnectAllNeighbors();
+	LLViewerPartSim::getInstance()->cleanupRegion(this);
+	saveObjectCache();
+	saveRegionState();
+}
+
 LLEventPump& LLViewerRegion::getCapAPI() const
 {
 	return mImpl->mCapabilityListener.getCapAPI();
@@ -428,6 +453,48 @@ void LLViewerRegion::loadObjectCache()
 }
 
 
+void LLViewerRegion::loadRegionState()
+{
+	LLRegionCacheThread::RegionState state;
+	if (!LLAppViewer::getRegionCacheThread()->fetchState(mHandle, state))
+	{
+		return; // still reading, idleUpdate() retries
+	}
+	mImpl->mRegionStatePending = false;
+
+	// Handles are reused across grids and region moves.
+	if (state.isEmpty() || state.mRegionID != getRegionID())
+	{
+		return;
+	}
+
+	// Whatever the simulator already sent stays.
+	mImpl->mLandp->setCachedHeights(state.mHeights, state.mPatchReceived);
+	mParcelOverlay->setCachedOwnership(state.mOwnership);
+}
+
+void LLViewerRegion::saveRegionState()
+{
+	if (mImpl->mRegionStateSaved || getRegionID().isNull() || !LLAppViewer::getRegionCacheThread())
+	{
+		return;
+	}
+	mImpl->mRegionStateSaved = true;
+
+	LLRegionCacheThread::RegionState state;
+	state.mRegionID = getRegionID();
+	state.mGridsPerEdge = mImpl->mLandp->getGridsPerEdge();
+	state.mPatchesPerEdge = mImpl->mLandp->getPatchesPerEdge();
+	mImpl->mLandp->getPatchHeights(state.mHeights, state.mPatchReceived);
+	mParcelOverlay->getOwnership(state.mOwnership);
+	if (std::find(state.mPatchReceived.begin(), state.mPatchReceived.end(), 1) == state.mPatchReceived.end()
+		&& state.mOwnership.empty())
+	{
+		return; // nothing arrived
+	}
+	LLAppViewer::getRegionCacheThread()->save(mHandle, state);
+}
+
 void LLViewerRegion::saveObjectCache()
 {
 	if (!mCacheLoaded)
@@ -435,8 +502,16 @@ void LLViewerRegion::saveObjectCache()
 		return;
 	}
 
+	// Saving unloads the cache, a new region with the same handle may map
+	// the file from here on.
+	mCacheLoaded = FALSE;
+
 	if (mImpl->mCacheMap.empty())
 	{
+		if(LLVOCache::hasInstance())
+		{
+			LLVOCache::getInstance()->releaseRegionFile(mHandle) ;
+		}
 		return;
 	}
 
@@ -451,6 +526,12 @@ void LLViewerRegion::saveObjectCache()
 		delete iter->second;
 	}
 	mImpl->mCacheMap.clear();
+
+	// The entries read from the cache pointed into the region's cache file.
+	if(LLVOCache::hasInstance())
+	{
+		LLVOCache::getInstance()->releaseRegionFile(mHandle) ;
+	}
 }
 
 void LLViewerRegion::sendMessage()
@@ -751,8 +832,13 @@ void LLViewerRegion::dirtyHeights()
 BOOL LLViewerRegion::idleUpdate(F32 max_update_time)
 {
 	LLMemType mt_ivr(LLMemType::MTYPE_IDLE_UPDATE_VIEWER_REGION);
+	if (mImpl->mRegionStatePending)
+	{
+		loadRegionState();
+	}
 	// did_update returns TRUE if we did at least one significant update
 	BOOL did_update = mImpl->mLandp->idleUpdate(max_update_time);
+	mImpl->mCompositionp->updateTexture();
 	
 	if (mParcelOverlay)
 	{
@@ -768,6 +854,7 @@ BOOL LLViewerRegion::idleUpdate(F32 max_update_time)
 void LLViewerRegion::forceUpdate()
 {
 	mImpl->mLandp->idleUpdate(0.f);
+	mImpl->mCompositionp->updateTexture();
 
 	if (mParcelOverlay)
 	{
@@ -1266,6 +1353,23 @@ LLViewerRegion::eCacheUpdateResult LLViewerRegion::cacheFullUpdate(LLViewerObjec
 	return result;
 }
 
+bool LLViewerRegion::isCacheDupe(U32 local_id, U32 crc) const
+{
+	LLVOCacheEntry* entry = get_if_there(mImpl->mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	return entry && entry->getCRC() == crc;
+}
+
+bool LLViewerRegion::recordCacheDupe(U32 local_id, U32 crc)
+{
+	LLVOCacheEntry* entry = get_if_there(mImpl->mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	if (!entry || entry->getCRC() != crc)
+	{	// an earlier block of the same message replaced it
+		return false;
+	}
+	entry->recordDupe();
+	return true;
+}
+
 // Get data packer for this object, if we have cached data
 // AND the CRC matches. JC
 LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
@@ -1532,6 +1636,15 @@ void LLViewerRegion::unpackRegionHandshake()
 	}
 
 
+	// Fill in the terrain and parcel overlay from the last visit until the
+	// simulator sends them, if the cache thread read them in time.
+	if (!mImpl->mRegionStateRequested)
+	{
+		mImpl->mRegionStateRequested = true;
+		mImpl->mRegionStatePending = true;
+		loadRegionState();
+	}
+
 	// Now that we have the name, we can load the cache file
 	// off disk.
 	loadObjectCache();
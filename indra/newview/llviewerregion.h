@@ -108,6 +108,14 @@ public:
 	void loadObjectCache();
 	void saveObjectCache();
 
+	// Terrain and parcel overlay saved by an earlier visit, see LLRegionCacheThread.
+	void loadRegionState();
+	void saveRegionState();
+
+	// Cuts the region loose from its neighbours and flushes its caches when
+	// it leaves the world, ahead of its deferred deletion.
+	void detachFromWorld();
+
 	void sendMessage(); // Send the current message to this region's simulator
 	void sendReliableMessage(); // Send the current message to this region's simulator
 
@@ -308,6 +316,11 @@ public:
 
 	// handle a full update message
 	eCacheUpdateResult cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinaryBuffer &dp);
+	// Whether the cache holds local_id with this crc already. Doesn't touch
+	// the cache, so the geometry workers may call it while the main thread waits on them.
+	bool isCacheDupe(U32 local_id, U32 crc) const;
+	// cacheFullUpdate() for an update isCacheDupe() found, false if that no longer holds.
+	bool recordCacheDupe(U32 local_id, U32 crc);
 	LLDataPacker *getDP(U32 local_id, U32 crc, U8 &cache_miss_type);
 	void requestCacheMisses();
 	void addCacheMissFull(const U32 local_id);
@@ -44,6 +44,7 @@
 #include "llhost.h"
 #include "llimage.h"
 #include "llimagebmp.h"
+#include "llimagedxt.h"
 #include "llimagej2c.h"
 #include "llimagetga.h"
 #include "llmemtype.h"
@@ -1590,7 +1591,8 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
 		
 		//if(!(res = insertToAtlas()))
 		//{
-			res = mGLTexturep->createGLTexture(mRawDiscardLevel, mRawImage, usename, TRUE, mBoostLevel);
+			res = mGLTexturep->createGLTexture(mRawDiscardLevel, mRawImage, mCompressedImage.get(), usename, mBoostLevel);
+			mCompressedImage = NULL;
 			//resetFaceAtlas() ;
 		//}
 		setActive() ;
@@ -1968,7 +1970,7 @@ bool LLViewerFetchedTexture::updateFetch()
 		
 		if (mRawImage.notNull()) sRawCount--;
 		if (mAuxRawImage.notNull()) sAuxCount--;
-		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage);
+		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage, mCompressedImage);
 		if (mRawImage.notNull()) sRawCount++;
 		if (mAuxRawImage.notNull()) sAuxCount++;
 		if (finished)
@@ -2134,8 +2136,12 @@ bool LLViewerFetchedTexture::updateFetch()
 		
 		// bypass texturefetch directly by pulling from LLTextureCache
 		bool fetch_request_created = false;
+		// Under texture memory pressure, have ordinary textures compressed as they are decoded
+		bool compress = gTextureList.getCompressTextures() && mBoostLevel == BOOST_NONE && !isForSculptOnly() &&
+						mUrl.compare(0, 7, "file://") != 0;
 		fetch_request_created = LLAppViewer::getTextureFetch()->createRequest(mUrl, getID(),getTargetHost(), decode_priority,
-																			  w, h, c, desired_discard, needsAux(), mCanUseHTTP);
+																			  w, h, c, desired_discard, needsAux(), mCanUseHTTP,
+																			  compress);
 		
 		if (fetch_request_created)
 		{
@@ -2692,6 +2698,7 @@ void LLViewerFetchedTexture::destroyRawImage()
 		}
 		
 		mRawImage = NULL;
+		mCompressedImage = NULL;
 	
 		mIsRawImageValid = FALSE;
 		mRawDiscardLevel = INVALID_DISCARD_LEVEL;
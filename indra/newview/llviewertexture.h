@@ -52,6 +52,7 @@
 
 class LLFace;
 class LLImageGL ;
+class LLImageDXT;
 class LLImageRaw;
 class LLViewerObject;
 class LLViewerTexture;
@@ -557,6 +558,7 @@ protected:
 	// Used ONLY for cloth meshes right now.  Make SURE you know what you're 
 	// doing if you use it for anything else! - djs
 	LLPointer<LLImageRaw> mAuxRawImage;
+	LLPointer<LLImageDXT> mCompressedImage; // S3TC copy of mRawImage made by the fetcher, if any
 
 	//keep a copy of mRawImage for some special purposes
 	//when mForceToSaveRawImage is set.
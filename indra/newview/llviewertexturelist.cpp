@@ -83,6 +83,8 @@ LLViewerTextureList::LLViewerTextureList()
 	mUpdateStats(FALSE),
 	mMaxResidentTexMemInMegaBytes(0),
 	mMaxTotalTextureMemInMegaBytes(0),
+	mCompressTexMemThresholdInMegaBytes(-1),
+	mCompressTextures(FALSE),
 	mInitialized(FALSE)
 {
 }
@@ -635,6 +637,9 @@ void LLViewerTextureList::updateImages(F32 max_time)
 	LLViewerStats::getInstance()->mRawMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(global_raw_memory));
 	LLViewerStats::getInstance()->mFormattedMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(LLImageFormatted::sGlobalFormattedMemory));
 
+	mCompressTextures = mCompressTexMemThresholdInMegaBytes >= 0 &&
+		BYTES_TO_MEGA_BYTES(LLImageGL::sBoundTextureMemoryInBytes) >= mCompressTexMemThresholdInMegaBytes;
+
 
 	{
 		LLFastTimer t(FTM_IMAGE_UPDATE_PRIORITIES);
@@ -1013,11 +1018,31 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 										 const std::string& out_filename,
 										 const U8 codec)
 {	
+	LLPointer<LLImageRaw> raw_image = new LLImageRaw;
+	if (!loadUploadImage(filename, codec, raw_image))
+	{
+		return FALSE;
+	}
+	// Convert to j2c (JPEG2000) and save the file locally
+	LLPointer<LLImageJ2C> compressedImage = convertToUploadFile(raw_image);	
+	if (compressedImage.isNull())
+	{
+		LLImage::setLastError("Couldn't convert the image to jpeg2000.");
+		llinfos << "Couldn't convert to j2c, file : " << filename << llendl;
+		return FALSE;
+	}
+	return saveUploadFile(compressedImage, out_filename);
+}
+
+BOOL LLViewerTextureList::loadUploadImage(const std::string& filename,
+										  const U8 codec,
+										  LLImageRaw* raw_image)
+{
 	// Load the image
 	LLPointer<LLImageFormatted> image = LLImageFormatted::createFromType(codec);
 	if (image.isNull())
 	{
-		image->setLastError("Couldn't open the image to be uploaded.");
+		LLImage::setLastError("Couldn't open the image to be uploaded.");
 		return FALSE;
 	}	
 	if (!image->load(filename))
@@ -1026,7 +1051,6 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 		return FALSE;
 	}
 	// Decompress or expand it in a raw image structure
-	LLPointer<LLImageRaw> raw_image = new LLImageRaw;
 	if (!image->decode(raw_image, 0.0f))
 	{
 		image->setLastError("Couldn't decode the image to be uploaded.");
@@ -1038,17 +1062,14 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 		image->setLastError("Image files with less than 3 or more than 4 components are not supported.");
 		return FALSE;
 	}
-	// Convert to j2c (JPEG2000) and save the file locally
-	LLPointer<LLImageJ2C> compressedImage = convertToUploadFile(raw_image);	
-	if (compressedImage.isNull())
-	{
-		image->setLastError("Couldn't convert the image to jpeg2000.");
-		llinfos << "Couldn't convert to j2c, file : " << filename << llendl;
-		return FALSE;
-	}
+	return TRUE;
+}
+
+BOOL LLViewerTextureList::saveUploadFile(LLImageJ2C* compressedImage, const std::string& out_filename)
+{
 	if (!compressedImage->save(out_filename))
 	{
-		image->setLastError("Couldn't create the jpeg2000 image for upload.");
+		LLImage::setLastError("Couldn't create the jpeg2000 image for upload.");
 		llinfos << "Couldn't create output file : " << out_filename << llendl;
 		return FALSE;
 	}
@@ -1056,7 +1077,7 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 	LLPointer<LLImageJ2C> integrity_test = new LLImageJ2C;
 	if (!integrity_test->loadAndValidate( out_filename ))
 	{
-		image->setLastError("The created jpeg2000 image is corrupt.");
+		LLImage::setLastError("The created jpeg2000 image is corrupt.");
 		llinfos << "Image file : " << out_filename << " is corrupt" << llendl;
 		return FALSE;
 	}
@@ -1065,6 +1086,20 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 
 // note: modifies the argument raw_image!!!!
 LLPointer<LLImageJ2C> LLViewerTextureList::convertToUploadFile(LLPointer<LLImageRaw> raw_image)
+{
+	LLPointer<LLImageJ2C> compressedImage = prepareUploadFile(raw_image);
+	if (!compressedImage->encode(raw_image, 0.0f))
+	{
+		llinfos << "convertToUploadFile : encode returns with error!!" << llendl;
+		// Clear up the pointer so we don't leak that one
+		compressedImage = NULL;
+	}
+	
+	return compressedImage;
+}
+
+// note: modifies the argument raw_image!!!!
+LLPointer<LLImageJ2C> LLViewerTextureList::prepareUploadFile(LLImageRaw* raw_image)
 {
 	raw_image->biasedScaleToPowerOfTwo(LLViewerFetchedTexture::MAX_IMAGE_SIZE_DEFAULT);
 	LLPointer<LLImageJ2C> compressedImage = new LLImageJ2C();
@@ -1087,13 +1122,6 @@ LLPointer<LLImageJ2C> LLViewerTextureList::convertToUploadFile(LLPointer<LLImage
 		compressedImage->initEncode(*raw_image, block_size, precinct_size, 0);
 	}*/
 	
-	if (!compressedImage->encode(raw_image, 0.0f))
-	{
-		llinfos << "convertToUploadFile : encode returns with error!!" << llendl;
-		// Clear up the pointer so we don't leak that one
-		compressedImage = NULL;
-	}
-	
 	return compressedImage;
 }
 
@@ -1178,6 +1206,19 @@ void LLViewerTextureList::updateMaxResidentTexMem(S32 mem)
 	S32 vb_mem = mem;
 	S32 fb_mem = llmax(VIDEO_CARD_FRAMEBUFFER_MEM, vb_mem/4);
 	mMaxResidentTexMemInMegaBytes = (vb_mem - fb_mem) ; //in MB
+
+	// Once the bound textures fill this share of the budget, textures of normal priority
+	// are compressed to DXT1/DXT5 as they are decoded, which takes a quarter to a sixth
+	// of the memory, so that many more of them fit before discard levels get raised.
+	F32 compress_threshold = gSavedSettings.getF32("TextureCompressMemoryThreshold");
+	if (compress_threshold < 0.f || !gGLManager.mHasCompressedTextures)
+	{
+		mCompressTexMemThresholdInMegaBytes = -1;
+	}
+	else
+	{
+		mCompressTexMemThresholdInMegaBytes = (S32)(compress_threshold * mMaxResidentTexMemInMegaBytes);
+	}
 	
 	mMaxTotalTextureMemInMegaBytes = mMaxResidentTexMemInMegaBytes * 2;
 	if (mMaxResidentTexMemInMegaBytes > 640)
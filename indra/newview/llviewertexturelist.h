@@ -76,6 +76,11 @@ class LLViewerTextureList
 public:
 	static BOOL createUploadFile(const std::string& filename, const std::string& out_filename, const U8 codec);
 	static LLPointer<LLImageJ2C> convertToUploadFile(LLPointer<LLImageRaw> raw_image);
+	// The steps of createUploadFile, for encoding the image elsewhere: load and decode,
+	// scale raw_image and set up the encoder, write and validate the encoded image.
+	static BOOL loadUploadImage(const std::string& filename, const U8 codec, LLImageRaw* raw_image);
+	static LLPointer<LLImageJ2C> prepareUploadFile(LLImageRaw* raw_image);
+	static BOOL saveUploadFile(LLImageJ2C* compressedImage, const std::string& out_filename);
 	static void processImageNotInDatabase( LLMessageSystem *msg, void **user_data );
 	static S32 calcMaxTextureRAM();
 	static void receiveImageHeader(LLMessageSystem *msg, void **user_data);
@@ -109,6 +114,8 @@ public:
 
 	S32	getMaxResidentTexMem() const	{ return mMaxResidentTexMemInMegaBytes; }
 	S32 getMaxTotalTextureMem() const   { return mMaxTotalTextureMemInMegaBytes;}
+	// True while normal priority textures should be fetched S3TC compressed to save texture memory
+	BOOL getCompressTextures() const	{ return mCompressTextures; }
 	S32 getNumImages()					{ return mImageList.size(); }
 
 	void updateMaxResidentTexMem(S32 mem);
@@ -201,6 +208,8 @@ private:
 	BOOL mUpdateStats;
 	S32	mMaxResidentTexMemInMegaBytes;
 	S32 mMaxTotalTextureMemInMegaBytes;
+	S32 mCompressTexMemThresholdInMegaBytes; // -1 = never compress
+	BOOL mCompressTextures;
 	LLFrameTimer mForceDecodeTimer;
 	
 public:
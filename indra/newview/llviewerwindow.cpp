@@ -581,11 +581,9 @@ public:
 			S32 total_objects = gObjectList.getNumObjects();
 			S32 ID_objects = gObjectList.mUUIDObjectMap.size();
 			S32 dead_objects = gObjectList.mNumDeadObjects;
-			S32 dead_object_list = gObjectList.mDeadObjects.size();
 			S32 dead_object_check = 0;
 			S32 total_avatars = 0;
-			S32 ID_avatars = gObjectList.mUUIDAvatarMap.size();
-			S32 dead_avatar_list = 0;
+			S32 ID_avatars = 0;
 			S32 dead_avatar_check = 0;
 
 			S32 orphan_parents = gObjectList.getOrphanParentCount();
@@ -600,7 +598,11 @@ public:
 				if(obj)
 				{
 					if(obj->isAvatar())
+					{
 						++total_avatars;
+						if(gObjectList.findObject(obj->getID()) == obj)
+							++ID_avatars;
+					}
 					if(obj->isDead())
 					{
 						++dead_object_check;
@@ -609,23 +611,23 @@ public:
 					}
 				}
 			}
-			for(std::set<LLUUID>::iterator it = gObjectList.mDeadObjects.begin();it!=gObjectList.mDeadObjects.end();++it)
-			{
-				LLViewerObject *obj = gObjectList.findObject(*it);
-				if(obj && obj->isAvatar())
-					++dead_avatar_list;
-			}
 			for(std::vector<LLViewerObjectList::OrphanInfo>::iterator it = gObjectList.mOrphanChildren.begin();it!=gObjectList.mOrphanChildren.end();++it)
 			{
 				LLViewerObject *obj = gObjectList.findObject(it->mChildInfo);
 				if(obj && obj->isAttachment())
 					++orphan_child_attachments;
 			}
-			addText(xpos,ypos, llformat("%d|%d (%d|%d|%d) Objects", total_objects, ID_objects, dead_objects, dead_object_list,dead_object_check));
+			addText(xpos,ypos, llformat("%d|%d (%d|%d) Objects", total_objects, ID_objects, dead_objects, dead_object_check));
 			ypos += y_inc;
-			addText(xpos,ypos, llformat("%d|%d (%d|%d) Avatars", total_avatars, ID_avatars, dead_avatar_list,dead_avatar_check));
+			addText(xpos,ypos, llformat("%d|%d (%d) Avatars", total_avatars, ID_avatars, dead_avatar_check));
 			ypos += y_inc;
 			addText(xpos,ypos, llformat("%d (%d|%d %d %d) Orphans", orphan_total, orphan_parents, orphan_parents_check,orphan_children, orphan_child_attachments));
+			ypos += y_inc;
+			addText(xpos,ypos, llformat("%d (%d) Regions/Objects Tearing Down", LLWorld::getInstance()->getNumTeardownRegions(),
+				LLWorld::getInstance()->getNumTeardownObjects()));
+
+			ypos += y_inc;
+			addText(xpos,ypos, llformat("%d Terse Updates Held Back", gObjectList.getNumTerseUpdates()));
 
 			ypos += y_inc;
 
@@ -642,6 +644,9 @@ public:
 				addText(xpos, ypos, llformat("%d/%d Mesh LOD Pending/Processing", LLMeshRepository::sLODPending, LLMeshRepository::sLODProcessing));
 				ypos += y_inc;
 
+				addText(xpos, ypos, llformat("%.1f/%.1f ms Mesh LOD Fetch/Decode Queue Latency", LLMeshRepository::sLODQueueLatency, LLMeshRepository::sDecodeQueueLatency));
+				ypos += y_inc;
+
 				addText(xpos, ypos, llformat("%.3f/%.3f MB Mesh Cache Read/Write ", LLMeshRepository::sCacheBytesRead/(1024.f*1024.f), LLMeshRepository::sCacheBytesWritten/(1024.f*1024.f)));
 
 				ypos += y_inc;
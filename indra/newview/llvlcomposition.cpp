@@ -45,6 +45,7 @@
 #include "noise.h"
 #include "llregionhandle.h" // for from_region_handle
 #include "llviewercontrol.h"
+#include "llappviewer.h"
 
 
 
@@ -89,11 +90,26 @@ LLVLComposition::LLVLComposition(LLSurface *surfacep, const U32 width, const F32
 	mTexScaleX = 16.f;
 	mTexScaleY = 16.f;
 	mTexturesLoaded = FALSE;
+
+	mDirtyXBegin = mDirtyYBegin = 0;
+	mDirtyXEnd = mDirtyYEnd = 0;
+	mCompositeHandle = LLQueuedThread::nullHandle();
 }
 
 
 LLVLComposition::~LLVLComposition()
 {
+	LLTerrainCompositeThread* threadp = LLAppViewer::getTerrainCompositeThread();
+	if (mCompositeHandle != LLQueuedThread::nullHandle() && threadp)
+	{
+		// The region is going away: drop the request, or release it if it
+		// already finished before seeing the abort.
+		threadp->abortRequest(mCompositeHandle, true);
+		if (threadp->getRequestStatus(mCompositeHandle) == LLQueuedThread::STATUS_COMPLETE)
+		{
+			threadp->completeRequest(mCompositeHandle);
+		}
+	}
 }
 
 
@@ -265,8 +281,6 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	llassert(x >= 0.f);
 	llassert(y >= 0.f);
 
-	LLTimer gen_timer;
-
 	///////////////////////////
 	//
 	// Generate raw data arrays for surface textures
@@ -274,9 +288,6 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	//
 
 	// These have already been validated by generateComposition.
-	U8* st_data[4];
-	S32 st_data_size[4]; // for debugging
-
 	for (S32 i = 0; i < 4; i++)
 	{
 		if (mRawImages[i].isNull())
@@ -306,17 +317,19 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 			{
 				mDetailTextures[i]->destroyRawImage() ;
 			}
+			// The compositor reads them as BASE_SIZE x BASE_SIZE x 3 without checks.
 			if (mDetailTextures[i]->getWidth(ddiscard) != BASE_SIZE ||
 				mDetailTextures[i]->getHeight(ddiscard) != BASE_SIZE ||
-				mDetailTextures[i]->getComponents() != 3)
+				mDetailTextures[i]->getComponents() != 3 ||
+				mRawImages[i]->getWidth() != BASE_SIZE ||
+				mRawImages[i]->getHeight() != BASE_SIZE ||
+				mRawImages[i]->getComponents() != 3)
 			{
 				LLPointer<LLImageRaw> newraw = new LLImageRaw(BASE_SIZE, BASE_SIZE, 3);
 				newraw->composite(mRawImages[i]);
 				mRawImages[i] = newraw; // deletes old
 			}
 		}
-		st_data[i] = mRawImages[i]->getData();
-		st_data_size[i] = mRawImages[i]->getDataSize();
 	}
 
 	///////////////////////////////////////
@@ -345,138 +358,151 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 
 	///////////////////////////////////////////
 	//
-	// Generate target texture information, stride ratios.
+	// Generate target texture information.
 	//
 	//
 
-	LLViewerTexture *texturep;
-	U32 tex_width, tex_height, tex_comps;
-	U32 tex_stride;
-	F32 tex_x_scalef, tex_y_scalef;
-	S32 tex_x_begin, tex_y_begin, tex_x_end, tex_y_end;
-	F32 tex_x_ratiof, tex_y_ratiof;
-
-	texturep = mSurfacep->getSTexture();
-	tex_width = texturep->getWidth();
-	tex_height = texturep->getHeight();
-	tex_comps = texturep->getComponents();
-	tex_stride = tex_width * tex_comps;
-
-	U32 st_comps = 3;
-	U32 st_width = BASE_SIZE;
-	U32 st_height = BASE_SIZE;
-	
-	if (tex_comps != st_comps)
+	LLViewerTexture *texturep = mSurfacep->getSTexture();
+	U32 tex_width = texturep->getWidth();
+	U32 tex_height = texturep->getHeight();
+
+	if (texturep->getComponents() != 3)
 	{
 		llwarns << "Base texture comps != input texture comps" << llendl;
 		return FALSE;
 	}
 
-	tex_x_scalef = (F32)tex_width / (F32)mWidth;
-	tex_y_scalef = (F32)tex_height / (F32)mWidth;
-	tex_x_begin = (S32)((F32)x_begin * tex_x_scalef);
-	tex_y_begin = (S32)((F32)y_begin * tex_y_scalef);
-	tex_x_end = (S32)((F32)x_end * tex_x_scalef);
-	tex_y_end = (S32)((F32)y_end * tex_y_scalef);
+	F32 tex_x_scalef = (F32)tex_width / (F32)mWidth;
+	F32 tex_y_scalef = (F32)tex_height / (F32)mWidth;
+	S32 tex_x_begin = (S32)((F32)x_begin * tex_x_scalef);
+	S32 tex_y_begin = (S32)((F32)y_begin * tex_y_scalef);
+	S32 tex_x_end = (S32)((F32)x_end * tex_x_scalef);
+	S32 tex_y_end = (S32)((F32)y_end * tex_y_scalef);
 
-	tex_x_ratiof = (F32)mWidth*mScale / (F32)tex_width;
-	tex_y_ratiof = (F32)mWidth*mScale / (F32)tex_height;
-
-	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, tex_comps);
-	U8 *rawp = raw->getData();
-
-	F32 tex_width_inv = 1.f/tex_width;
-	F32 tex_height_inv = 1.f/tex_height;
-
-	F32 st_x_stride, st_y_stride;
-	st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
-	st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
-
-	llassert(st_x_stride > 0.f);
-	llassert(st_y_stride > 0.f);
-	////////////////////////////////
-	//
-	// Iterate through the target texture, striding through the
-	// subtextures and interpolating appropriately.
-	//
-	//
+	if (tex_x_begin < tex_x_end && tex_y_begin < tex_y_end)
+	{
+		if (mDirtyXBegin >= mDirtyXEnd || mDirtyYBegin >= mDirtyYEnd)
+		{
+			mDirtyXBegin = tex_x_begin;
+			mDirtyYBegin = tex_y_begin;
+			mDirtyXEnd = tex_x_end;
+			mDirtyYEnd = tex_y_end;
+		}
+		else
+		{
+			mDirtyXBegin = llmin(mDirtyXBegin, tex_x_begin);
+			mDirtyYBegin = llmin(mDirtyYBegin, tex_y_begin);
+			mDirtyXEnd = llmax(mDirtyXEnd, tex_x_end);
+			mDirtyYEnd = llmax(mDirtyYEnd, tex_y_end);
+		}
+	}
 
-	F32 sti, stj;
-	S32 st_offset;
-	sti = (tex_x_begin * st_x_stride) - st_width*(llfloor((tex_x_begin * st_x_stride)/st_width));
-	stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+	for (S32 i = 0; i < 4; i++)
+	{
+		// Un-boost detatil textures (will get re-boosted if rendering in high detail)
+		mDetailTextures[i]->setBoostLevel(LLViewerTexture::BOOST_NONE);
+		mDetailTextures[i]->setMinDiscardLevel(MAX_DISCARD_LEVEL + 1);
+	}
+	
+	return TRUE;
+}
 
-	st_offset = (llfloor(stj * st_width) + llfloor(sti)) * st_comps;
-	for (S32 j = tex_y_begin; j < tex_y_end; j++)
+void LLVLComposition::updateTexture()
+{
+	LLTerrainCompositeThread* threadp = LLAppViewer::getTerrainCompositeThread();
+	if (mCompositeHandle != LLQueuedThread::nullHandle())
 	{
-		U32 offset = j * tex_stride + tex_x_begin * tex_comps;
-		sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
-		for (S32 i = tex_x_begin; i < tex_x_end; i++)
+		LLQueuedThread::status_t status = threadp->getRequestStatus(mCompositeHandle);
+		if (status == LLQueuedThread::STATUS_QUEUED || status == LLQueuedThread::STATUS_INPROGRESS)
 		{
-			S32 tex0, tex1;
-			F32 composition = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
-
-			tex0 = llfloor( composition );
-			tex0 = llclamp(tex0, 0, 3);
-			composition -= tex0;
-			tex1 = tex0 + 1;
-			tex1 = llclamp(tex1, 0, 3);
+			return; // texels marked meanwhile go into the next request
+		}
+		if (status == LLQueuedThread::STATUS_COMPLETE)
+		{
+			LLTerrainCompositeThread::CompositeRequest* req =
+				(LLTerrainCompositeThread::CompositeRequest*)threadp->getRequest(mCompositeHandle);
+			uploadTexture(req->getTarget(), req->getParams());
+		}
+		threadp->completeRequest(mCompositeHandle);
+		mCompositeHandle = LLQueuedThread::nullHandle();
+	}
 
-			F32 xy_int_i, xy_int_j;
+	if (mDirtyXBegin >= mDirtyXEnd || mDirtyYBegin >= mDirtyYEnd)
+	{
+		return;
+	}
 
-			xy_int_i = i * tex_width_inv;
-			xy_int_j = j * tex_height_inv;
+	for (S32 i = 0; i < 4; i++)
+	{
+		if (mRawImages[i].isNull())
+		{
+			return; // detail texture changed, generateTexture() reloads it
+		}
+	}
 
-			st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
-			for (U32 k = 0; k < tex_comps; k++)
-			{
-				// Linearly interpolate based on composition.
-				if (st_offset >= st_data_size[tex0] || st_offset >= st_data_size[tex1])
-				{
-					// SJB: This shouldn't be happening, but does... Rounding error?
-					//llwarns << "offset 0 [" << tex0 << "] =" << st_offset << " >= size=" << st_data_size[tex0] << llendl;
-					//llwarns << "offset 1 [" << tex1 << "] =" << st_offset << " >= size=" << st_data_size[tex1] << llendl;
-				}
-				else
-				{
-					F32 a = *(st_data[tex0] + st_offset);
-					F32 b = *(st_data[tex1] + st_offset);
-					rawp[ offset ] = (U8)lltrunc( a + composition * (b - a) );
-				}
-				offset++;
-				st_offset++;
-			}
+	LLTimer gen_timer;
 
-			sti += st_x_stride;
-			if (sti >= st_width)
-			{
-				sti -= st_width;
-			}
-		}
+	LLViewerTexture *texturep = mSurfacep->getSTexture();
+	U32 tex_width = texturep->getWidth();
+	U32 tex_height = texturep->getHeight();
 
-		stj += st_y_stride;
-		if (stj >= st_height)
+	LLTerrainCompositeThread::Params params;
+	for (S32 i = 0; i < 4; i++)
+	{
+		params.mDetail[i] = mRawImages[i];
+	}
+	params.mDetailSize = BASE_SIZE;
+	params.mComposition.assign(mDatap, mDatap + mWidth*mWidth);
+	params.mCompositionWidth = mWidth;
+	params.mCompositionScaleInv = mScaleInv;
+	params.mTexelRatioX = (F32)mWidth*mScale / (F32)tex_width;
+	params.mTexelRatioY = (F32)mWidth*mScale / (F32)tex_height;
+	params.mDetailStrideX = ((F32)BASE_SIZE / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
+	params.mDetailStrideY = ((F32)BASE_SIZE / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
+	params.mXBegin = mDirtyXBegin;
+	params.mYBegin = mDirtyYBegin;
+	params.mXEnd = mDirtyXEnd;
+	params.mYEnd = mDirtyYEnd;
+	mDirtyXBegin = mDirtyYBegin = 0;
+	mDirtyXEnd = mDirtyYEnd = 0;
+
+	llassert(params.mDetailStrideX > 0.f);
+	llassert(params.mDetailStrideY > 0.f);
+
+	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, 3);
+
+	static const LLCachedControl<bool> composite_thread("TerrainCompositeThread", true);
+	if (threadp && composite_thread)
+	{
+		mCompositeHandle = threadp->composite(params, raw);
+		if (mCompositeHandle != LLQueuedThread::nullHandle())
 		{
-			stj -= st_height;
+			LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
+			return;
 		}
 	}
 
-	if (!texturep->hasGLTexture())
+	LLTerrainCompositeThread::compositeTexels(params, raw->getData(), raw->getWidth());
+	uploadTexture(raw, params);
+	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
+}
+
+void LLVLComposition::uploadTexture(LLImageRaw* raw, const LLTerrainCompositeThread::Params& params)
+{
+	LLViewerTexture *texturep = mSurfacep->getSTexture();
+	if (raw->getWidth() != texturep->getWidth() || raw->getHeight() != texturep->getHeight())
 	{
-		texturep->createGLTexture(0, raw);
+		return; // the terrain texture was recreated meanwhile, its texels are marked again
 	}
-	texturep->setSubImage(raw, tex_x_begin, tex_y_begin, tex_x_end - tex_x_begin, tex_y_end - tex_y_begin);
-	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
-	LLSurface::sTexelsUpdated += (tex_x_end - tex_x_begin) * (tex_y_end - tex_y_begin);
 
-	for (S32 i = 0; i < 4; i++)
+	S32 width = params.mXEnd - params.mXBegin;
+	S32 height = params.mYEnd - params.mYBegin;
+	if (!texturep->hasGLTexture())
 	{
-		// Un-boost detatil textures (will get re-boosted if rendering in high detail)
-		mDetailTextures[i]->setBoostLevel(LLViewerTexture::BOOST_NONE);
-		mDetailTextures[i]->setMinDiscardLevel(MAX_DISCARD_LEVEL + 1);
+		texturep->createGLTexture(0, raw);
 	}
-	
-	return TRUE;
+	texturep->setSubImage(raw, params.mXBegin, params.mYBegin, width, height);
+	LLSurface::sTexelsUpdated += width * height;
 }
 
 LLUUID LLVLComposition::getDetailTextureID(S32 corner)
@@ -35,6 +35,7 @@
 
 #include "llviewerlayer.h"
 #include "llviewertexture.h"
+#include "llterraincompositethread.h"
 
 class LLSurface;
 
@@ -49,8 +50,12 @@ public:
 	// Viewer side hack to generate composition values
 	BOOL generateHeights(const F32 x, const F32 y, const F32 width, const F32 height);
 	BOOL generateComposition();
-	// Generate texture from composition values.
+	// Generate texture from composition values. Only marks the texels,
+	// they are blended and uploaded by updateTexture().
 	BOOL generateTexture(const F32 x, const F32 y, const F32 width, const F32 height);		
+	// Blends the texels marked since the last call, on the terrain composite
+	// thread when there is one, and uploads what the thread has finished.
+	void updateTexture();
 
 	// Use these as indeces ito the get/setters below that use 'corner'
 	enum ECorner
@@ -87,6 +92,15 @@ protected:
 
 	F32 mTexScaleX;
 	F32 mTexScaleY;
+
+	void uploadTexture(LLImageRaw* raw, const LLTerrainCompositeThread::Params& params);
+
+	// Texels of the terrain texture waiting to be blended, end exclusive.
+	S32 mDirtyXBegin;
+	S32 mDirtyYBegin;
+	S32 mDirtyXEnd;
+	S32 mDirtyYEnd;
+	LLQueuedThread::handle_t mCompositeHandle;
 };
 
 #endif //LL_LLVLCOMPOSITION_H
@@ -34,6 +34,9 @@
 
 #include "llvocache.h"
 
+#include "apr_mmap.h"
+
+#include "llapr.h"
 #include "llerror.h"
 #include "llregionhandle.h"
 #include "llviewercontrol.h"
@@ -57,7 +60,8 @@ LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &
 	mCRC(crc),
 	mHitCount(0),
 	mDupeCount(0),
-	mCRCChangeCount(0)
+	mCRCChangeCount(0),
+	mFileOffset(0)
 {
 	mBuffer = new U8[dp.getBufferSize()];
 	mDP.assignBuffer(mBuffer, dp.getBufferSize());
@@ -71,81 +75,37 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mHitCount(0),
 	mDupeCount(0),
 	mCRCChangeCount(0),
+	mFileOffset(0),
 	mBuffer(NULL)
 {
 	mDP.assignBuffer(mBuffer, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
-	: mBuffer(NULL)
+LLVOCacheEntry::LLVOCacheEntry(const LLVOCacheIndexEntry& index, U8* data)
+	:
+	mLocalID(index.mLocalID),
+	mCRC(index.mCRC),
+	mHitCount(index.mHitCount),
+	mDupeCount(index.mDupeCount),
+	mCRCChangeCount(index.mCRCChangeCount),
+	mFileOffset(index.mOffset),
+	mBuffer(NULL)
 {
-	S32 size = -1;
-	BOOL success;
-
-	mDP.assignBuffer(mBuffer, 0);
-	success = check_read(apr_file, &mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_read(apr_file, &mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &size, sizeof(S32));
+	mDP.assignBuffer(data, index.mSize);
+}
 
-	// Corruption in the cache entries
-	if ((size > 10000) || (size < 1))
-	{
-		// We've got a bogus size, skip reading it.
-		// We won't bother seeking, because the rest of this file
-		// is likely bogus, and will be tossed anyway.
-			llwarns << "Bogus cache entry, size " << size << ", aborting!" << llendl;
-			success = FALSE;
-		}
-	}
-	if(success && size > 0)
+LLVOCacheEntry::~LLVOCacheEntry()
+{
+	if (mBuffer)
 	{
-		mBuffer = new U8[size];
-		success = check_read(apr_file, mBuffer, size);
-
-		if(success)
-		{
-			mDP.assignBuffer(mBuffer, size);
-		}
-		else
-		{
-			delete[] mBuffer ;
-			mBuffer = NULL ;
-		}
+		mDP.freeBuffer();
 	}
-
-	if(!success)
+	else
 	{
-		mLocalID = 0;
-		mCRC = 0;
-		mHitCount = 0;
-		mDupeCount = 0;
-		mCRCChangeCount = 0;
-		mBuffer = NULL;
+		mDP.releaseBuffer();
 	}
 }
 
-LLVOCacheEntry::~LLVOCacheEntry()
-{
-	mDP.freeBuffer();
-}
-
 
 // New CRC means the object has changed.
 void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
@@ -156,8 +116,16 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 		mCRC = crc;
 		mHitCount = 0;
 		mCRCChangeCount++;
+		mFileOffset = 0;
 
-		mDP.freeBuffer();
+		if (mBuffer)
+		{
+			mDP.freeBuffer();
+		}
+		else
+		{
+			mDP.releaseBuffer();
+		}
 		mBuffer = new U8[dp.getBufferSize()];
 		mDP.assignBuffer(mBuffer, dp.getBufferSize());
 		mDP = dp;
@@ -193,39 +161,146 @@ void LLVOCacheEntry::dump() const
 		<< llendl;
 }
 
-BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
+void LLVOCacheEntry::getIndexEntry(LLVOCacheIndexEntry& index) const
 {
-	BOOL success;
-	success = check_write(apr_file, (void*)&mLocalID, sizeof(U32));
-	if(success)
+	index.mLocalID = mLocalID;
+	index.mCRC = mCRC;
+	index.mOffset = mFileOffset;
+	index.mSize = mDP.getBufferSize();
+	index.mHitCount = mHitCount;
+	index.mDupeCount = mDupeCount;
+	index.mCRCChangeCount = mCRCChangeCount;
+}
+
+//-------------------------------------------------------------------
+// LLVOCacheFile
+//-------------------------------------------------------------------
+// Region cache files hold a header, the object data and, after the last
+// update, an index sorted by local id. Updates append the new object data
+// and a new index, then point the header at it; the bytes left behind are
+// reclaimed by a background compaction once there are enough of them.
+struct LLVOCacheFileHeader
+{
+	U32 mMagic;
+	LLUUID mCacheID;
+	U32 mIndexOffset;
+	U32 mIndexCount;
+	U32 mGarbage;	// bytes not referenced by the index
+};
+
+static const U32 VOCACHE_FILE_MAGIC = 0x32434f56; // "VOC2"
+static const S32 MAX_OBJECT_DATA_SIZE = 10000;
+static const U32 MIN_COMPACTION_GARBAGE = 64 * 1024;
+
+// Checks the header and the index bounds of a region file.
+static bool read_file_header(const U8* data, S32 size, LLVOCacheFileHeader& header)
+{
+	if (size < (S32)sizeof(LLVOCacheFileHeader))
 	{
-		success = check_write(apr_file, (void*)&mCRC, sizeof(U32));
+		return false;
 	}
-	if(success)
+	memcpy(&header, data, sizeof(LLVOCacheFileHeader));
+
+	return header.mMagic == VOCACHE_FILE_MAGIC &&
+		   header.mIndexOffset >= sizeof(LLVOCacheFileHeader) &&
+		   header.mIndexOffset <= (U32)size &&
+		   header.mIndexCount <= ((U32)size - header.mIndexOffset) / sizeof(LLVOCacheIndexEntry);
+}
+
+// Reads index entry i, false if it doesn't point at valid object data.
+static bool read_index_entry(const U8* data, const LLVOCacheFileHeader& header, U32 i, LLVOCacheIndexEntry& index)
+{
+	memcpy(&index, data + header.mIndexOffset + i * sizeof(LLVOCacheIndexEntry), sizeof(LLVOCacheIndexEntry));
+
+	return index.mLocalID != 0 &&
+		   index.mSize > 0 && index.mSize <= MAX_OBJECT_DATA_SIZE &&
+		   index.mOffset >= sizeof(LLVOCacheFileHeader) &&
+		   index.mOffset < header.mIndexOffset &&
+		   index.mOffset + index.mSize <= header.mIndexOffset;
+}
+
+// Adds the data of the entries that aren't in the file yet (all of them if
+// rewrite_all) and a new index to buffer, which goes at base_offset in the
+// file, and points header at that index.
+static void build_region_update(const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, bool rewrite_all,
+								U32 base_offset, std::vector<U8>& buffer, LLVOCacheFileHeader& header)
+{
+	std::vector<LLVOCacheIndexEntry> index;
+	index.reserve(cache_entry_map.size());
+
+	U32 live_size = 0;
+	for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
 	{
-		success = check_write(apr_file, (void*)&mHitCount, sizeof(S32));
+		const LLVOCacheEntry* entry = iter->second;
+
+		LLVOCacheIndexEntry rec;
+		entry->getIndexEntry(rec);
+		if (rec.mSize <= 0 || rec.mSize > MAX_OBJECT_DATA_SIZE)
+		{
+			continue;
+		}
+
+		if (rewrite_all || !rec.mOffset)
+		{
+			rec.mOffset = base_offset + buffer.size();
+			buffer.insert(buffer.end(), entry->getData(), entry->getData() + rec.mSize);
+		}
+		live_size += rec.mSize;
+		index.push_back(rec);
 	}
-	if(success)
+
+	header.mIndexOffset = base_offset + buffer.size();
+	header.mIndexCount = index.size();
+	header.mGarbage = header.mIndexOffset - sizeof(LLVOCacheFileHeader) - live_size;
+
+	if (!index.empty())
 	{
-		success = check_write(apr_file, (void*)&mDupeCount, sizeof(S32));
+		const U8* index_data = (const U8*)&index[0];
+		buffer.insert(buffer.end(), index_data, index_data + index.size() * sizeof(LLVOCacheIndexEntry));
 	}
-	if(success)
+}
+
+// Read only mapping of a region cache file, kept while its region's cache
+// entries point into it. Main thread only.
+class LLVOCacheFile
+{
+public:
+	LLVOCacheFile() : mMMap(NULL) {}
+	~LLVOCacheFile()
 	{
-		success = check_write(apr_file, (void*)&mCRCChangeCount, sizeof(S32));
+		if (mMMap)
+		{
+			apr_mmap_delete(mMMap);
+		}
 	}
-	if(success)
+
+	bool map(const std::string& filename)
 	{
-		S32 size = mDP.getBufferSize();
-		success = check_write(apr_file, (void*)&size, sizeof(S32));
-	
-		if(success)
+		S32 size = 0;
+		LLAPRFile apr_file(filename, APR_READ|APR_BINARY, &size);
+		if (!apr_file.getFileHandle() || size < (S32)sizeof(LLVOCacheFileHeader))
 		{
-			success = check_write(apr_file, (void*)mBuffer, size);
+			return false;
 		}
+
+		mPool.create();
+		apr_status_t status = apr_mmap_create(&mMMap, apr_file.getFileHandle(), 0, size, APR_MMAP_READ, mPool());
+		if (status != APR_SUCCESS)
+		{
+			ll_apr_warn_status(status);
+			mMMap = NULL;
+			return false;
+		}
+		return true;
 	}
 
-	return success ;
-}
+	U8* getData() const	{ return (U8*)mMMap->mm; }
+	S32 getSize() const	{ return (S32)mMMap->size; }
+
+private:
+	LLAPRPool mPool;
+	apr_mmap_t* mMMap;
+};
 
 //-------------------------------------------------------------------
 //LLVOCache
@@ -271,13 +346,41 @@ LLVOCache::LLVOCache():
 	mInitialized(FALSE),
 	mReadOnly(TRUE),
 	mNumEntries(0),
-	mCacheSize(1)
+	mCacheSize(1),
+	mCompactor(NULL),
+	mCompactorQuitting(false)
 {
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 }
 
 LLVOCache::~LLVOCache()
 {
+	if (mCompactor)
+	{
+		mCompactSignal.lock();
+		mCompactorQuitting = true;
+		mCompactSignal.signal();
+		mCompactSignal.unlock();
+
+		mCompactor->shutdown();
+		delete mCompactor;
+		mCompactor = NULL;
+	}
+
+	for (region_file_map_t::iterator iter = mRegionFiles.begin(); iter != mRegionFiles.end(); ++iter)
+	{
+		delete iter->second;
+	}
+	mRegionFiles.clear();
+
+	for (std::set<U64>::iterator iter = mPendingRemoval.begin(); iter != mPendingRemoval.end(); ++iter)
+	{
+		std::string filename;
+		getObjectCacheFilename(*iter, filename);
+		LLAPRFile::remove(filename);
+	}
+	mPendingRemoval.clear();
+
 	if(mEnabled)
 	{
 		writeCacheHeader();
@@ -315,6 +418,12 @@ void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version)
 	mMetaInfo.mVersion = cache_version;
 	readCacheHeader();	
 
+	if (!mReadOnly)
+	{
+		mCompactor = new Compactor(this);
+		mCompactor->start();
+	}
+
 	if(mMetaInfo.mVersion != cache_version) 
 	{
 		mMetaInfo.mVersion = cache_version ;
@@ -338,6 +447,7 @@ void LLVOCache::removeCache(ELLPath location)
 	}
 
 	llinfos << "about to remove the object cache due to settings." << llendl ;
+	cancelCompactions();
 
 	std::string mask = "*";
 	std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
@@ -359,6 +469,7 @@ void LLVOCache::removeCache()
 	}
 
 	llinfos << "about to remove the object cache due to some error." << llendl ;
+	cancelCompactions();
 
 	std::string mask = "*";
 	llinfos << "Removing cache at " << mObjectCacheDirName << llendl;
@@ -437,9 +548,20 @@ void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 		return ;
 	}
 
-	std::string filename;
-	getObjectCacheFilename(entry->mHandle, filename);
-	LLAPRFile::remove(filename);
+	waitForCompaction(entry->mHandle);
+	mPendingCompaction.erase(entry->mHandle);
+
+	// A mapped file can't be removed on Windows, its region still uses it.
+	if (mRegionFiles.count(entry->mHandle))
+	{
+		mPendingRemoval.insert(entry->mHandle);
+	}
+	else
+	{
+		std::string filename;
+		getObjectCacheFilename(entry->mHandle, filename);
+		LLAPRFile::remove(filename);
+	}
 	entry->mTime = INVALID_TIME ;
 	updateEntry(entry) ; //update the head file.
 }
@@ -603,47 +725,54 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 
-	bool success = true ;
+	if (mRegionFiles.count(handle))
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_READ|APR_BINARY);
-	
-		LLUUID cache_id ;
-		success = check_read(&apr_file, cache_id.mData, UUID_BYTES) ;
-	
-		if(success)
-		{		
-			if(cache_id != id)
+		llwarns << "Cache file for handle " << handle << " is already in use." << llendl;
+		return ;
+	}
+
+	waitForCompaction(handle);
+
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+
+	LLVOCacheFile* file = new LLVOCacheFile();
+	LLVOCacheFileHeader header;
+	bool success = file->map(filename) && read_file_header(file->getData(), file->getSize(), header);
+
+	if (success && header.mCacheID != id)
+	{
+		llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
+		success = false ;
+	}
+
+	if (success)
+	{
+		// The index is sorted, so every entry goes at the end of the map.
+		U8* data = file->getData();
+		for (U32 i = 0; i < header.mIndexCount; ++i)
+		{
+			LLVOCacheIndexEntry index;
+			if (!read_index_entry(data, header, i, index))
 			{
-				llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
+				llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
 				success = false ;
+				break ;
 			}
+			cache_entry_map.insert(cache_entry_map.end(),
+								   std::make_pair(index.mLocalID, new LLVOCacheEntry(index, data + index.mOffset)));
+		}
+	}
 
-			if(success)
-			{
-				S32 num_entries;
-				success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
-	
-				if(success)
-				{
-					for (S32 i = 0; i < num_entries; i++)
-					{
-						LLVOCacheEntry* entry = new LLVOCacheEntry(&apr_file);
-						if (!entry->getLocalID())
-						{
-							llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
-							delete entry ;
-							success = false ;
-							break ;
-						}
-						cache_entry_map[entry->getLocalID()] = entry;
-					}
-				}
-			}
-		}		
+	if (cache_entry_map.empty())
+	{
+		delete file;
 	}
-	
+	else
+	{
+		mRegionFiles[handle] = file;
+	}
+
 	if(!success)
 	{
 		if(cache_entry_map.empty())
@@ -654,6 +783,39 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 
 	return ;
 }
+
+void LLVOCache::releaseRegionFile(U64 handle)
+{
+	region_file_map_t::iterator iter = mRegionFiles.find(handle);
+	if (iter != mRegionFiles.end())
+	{
+		delete iter->second;
+		mRegionFiles.erase(iter);
+	}
+
+	if (mPendingRemoval.erase(handle))
+	{
+		std::string filename;
+		getObjectCacheFilename(handle, filename);
+		LLAPRFile::remove(filename);
+		mPendingCompaction.erase(handle);
+		return;
+	}
+
+	if (mPendingCompaction.erase(handle) && mCompactor)
+	{
+		std::string filename;
+		getObjectCacheFilename(handle, filename);
+
+		mCompactSignal.lock();
+		if (mCompacting.insert(handle).second)
+		{
+			mCompactQueue.push_back(std::make_pair(handle, filename));
+			mCompactSignal.signal();
+		}
+		mCompactSignal.unlock();
+	}
+}
 	
 void LLVOCache::purgeEntries(U32 size)
 {
@@ -684,6 +846,11 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ;
 	}	
 
+	if (mPendingRemoval.count(handle))
+	{	// the file is gone once its region lets go of it, start over next visit
+		return ;
+	}
+
 	HeaderEntryInfo* entry;
 	handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
 	if(iter == mHandleEntryMap.end()) //new entry
@@ -725,26 +892,26 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ; //nothing changed, no need to update.
 	}
 
-	//write to cache file
-	bool success = true ;
+	waitForCompaction(handle);
+
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+
+	//only the new and changed objects need writing if the file is still the one the entries came from
+	bool success;
+	bool needs_compaction = false;
+	if (mRegionFiles.count(handle))
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_CREATE|APR_WRITE|APR_BINARY);
-	
-		success = check_write(&apr_file, (void*)id.mData, UUID_BYTES) ;
+		success = appendToRegionFile(filename, cache_entry_map, needs_compaction);
+	}
+	else
+	{
+		success = writeRegionFile(filename, id, cache_entry_map);
+	}
 
-	
-		if(success)
-		{
-			S32 num_entries = cache_entry_map.size() ;
-			success = check_write(&apr_file, &num_entries, sizeof(S32));
-	
-			for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
-			{
-				success = iter->second->writeToFile(&apr_file) ;
-			}
-		}
+	if (success && needs_compaction)
+	{
+		mPendingCompaction.insert(handle);
 	}
 
 	if(!success)
@@ -756,3 +923,179 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 	return ;
 }
 
+bool LLVOCache::writeRegionFile(const std::string& filename, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map)
+{
+	LLVOCacheFileHeader header;
+	header.mMagic = VOCACHE_FILE_MAGIC;
+	header.mCacheID = id;
+
+	std::vector<U8> buffer(sizeof(LLVOCacheFileHeader));
+	build_region_update(cache_entry_map, true, 0, buffer, header);
+	memcpy(&buffer[0], &header, sizeof(LLVOCacheFileHeader));
+
+	if (LLAPRFile::isExist(filename))
+	{
+		LLAPRFile::remove(filename);
+	}
+	return LLAPRFile::writeEx(filename, &buffer[0], 0, buffer.size()) == (S32)buffer.size();
+}
+
+bool LLVOCache::appendToRegionFile(const std::string& filename, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, bool& needs_compaction)
+{
+	S32 file_size = LLAPRFile::size(filename);
+	LLVOCacheFileHeader header;
+	if (file_size < (S32)sizeof(LLVOCacheFileHeader) ||
+		LLAPRFile::readEx(filename, &header, 0, sizeof(LLVOCacheFileHeader)) != sizeof(LLVOCacheFileHeader) ||
+		header.mMagic != VOCACHE_FILE_MAGIC)
+	{
+		return false;
+	}
+
+	std::vector<U8> buffer;
+	build_region_update(cache_entry_map, false, file_size, buffer, header);
+
+	// The header is written last, until then the file still describes the
+	// previous index.
+	if (!buffer.empty() &&
+		LLAPRFile::writeEx(filename, &buffer[0], file_size, buffer.size()) != (S32)buffer.size())
+	{
+		return false;
+	}
+	if (LLAPRFile::writeEx(filename, &header, 0, sizeof(LLVOCacheFileHeader)) != sizeof(LLVOCacheFileHeader))
+	{
+		return false;
+	}
+
+	U32 live_size = header.mIndexOffset - sizeof(LLVOCacheFileHeader) - header.mGarbage;
+	needs_compaction = header.mGarbage >= MIN_COMPACTION_GARBAGE && header.mGarbage > live_size;
+	return true;
+}
+
+void LLVOCache::waitForCompaction(U64 handle)
+{
+	mCompactSignal.lock();
+	while (mCompacting.count(handle))
+	{
+		mCompactSignal.wait();
+	}
+	mCompactSignal.unlock();
+}
+
+void LLVOCache::cancelCompactions()
+{
+	mPendingCompaction.clear();
+
+	mCompactSignal.lock();
+	for (std::deque<std::pair<U64, std::string> >::iterator iter = mCompactQueue.begin(); iter != mCompactQueue.end(); ++iter)
+	{
+		mCompacting.erase(iter->first);
+	}
+	mCompactQueue.clear();
+
+	// let the one in progress finish
+	while (!mCompacting.empty())
+	{
+		mCompactSignal.wait();
+	}
+	mCompactSignal.unlock();
+}
+
+//static
+bool LLVOCache::compactRegionFile(const std::string& filename)
+{
+	S32 size = LLAPRFile::size(filename);
+	if (size <= 0)
+	{
+		return false;
+	}
+
+	std::vector<U8> data(size);
+	LLVOCacheFileHeader header;
+	if (LLAPRFile::readEx(filename, &data[0], 0, size) != size ||
+		!read_file_header(&data[0], size, header))
+	{
+		return false;
+	}
+
+	std::vector<U8> buffer(sizeof(LLVOCacheFileHeader));
+	std::vector<LLVOCacheIndexEntry> index(header.mIndexCount);
+	for (U32 i = 0; i < header.mIndexCount; ++i)
+	{
+		LLVOCacheIndexEntry& rec = index[i];
+		if (!read_index_entry(&data[0], header, i, rec))
+		{
+			return false;
+		}
+
+		const U8* object_data = &data[rec.mOffset];
+		rec.mOffset = buffer.size();
+		buffer.insert(buffer.end(), object_data, object_data + rec.mSize);
+	}
+
+	header.mIndexOffset = buffer.size();
+	header.mGarbage = 0;
+	if (!index.empty())
+	{
+		const U8* index_data = (const U8*)&index[0];
+		buffer.insert(buffer.end(), index_data, index_data + index.size() * sizeof(LLVOCacheIndexEntry));
+	}
+	memcpy(&buffer[0], &header, sizeof(LLVOCacheFileHeader));
+
+	// Write a copy and swap it in, so a crash never leaves a partial file.
+	std::string temp_filename = filename + ".tmp";
+	if (LLAPRFile::isExist(temp_filename))
+	{
+		LLAPRFile::remove(temp_filename);
+	}
+	if (LLAPRFile::writeEx(temp_filename, &buffer[0], 0, buffer.size()) != (S32)buffer.size() ||
+		!LLAPRFile::rename(temp_filename, filename))
+	{
+		LLAPRFile::remove(temp_filename);
+		return false;
+	}
+
+	llinfos << "Compacted " << filename << " from " << size << " to " << buffer.size() << " bytes" << llendl;
+	return true;
+}
+
+void LLVOCache::compactorLoop()
+{
+	mCompactSignal.lock();
+	while (true)
+	{
+		while (!mCompactorQuitting && mCompactQueue.empty())
+		{
+			mCompactSignal.wait();
+		}
+		if (mCompactorQuitting)
+		{
+			break;
+		}
+
+		std::pair<U64, std::string> job = mCompactQueue.front();
+		mCompactQueue.pop_front();
+		mCompactSignal.unlock();
+
+		if (!compactRegionFile(job.second))
+		{
+			llwarns << "Failed to compact object cache file " << job.second << llendl;
+		}
+
+		mCompactSignal.lock();
+		mCompacting.erase(job.first);
+		mCompactSignal.broadcast();
+	}
+	mCompactSignal.unlock();
+}
+
+LLVOCache::Compactor::Compactor(LLVOCache* cache)
+	: LLThread("VO Cache Compactor"),
+	  mCache(cache)
+{
+}
+
+//virtual
+void LLVOCache::Compactor::run()
+{
+	mCache->compactorLoop();
+}
@@ -37,7 +37,22 @@
 #include "lldatapacker.h"
 #include "lldlinked.h"
 #include "lldir.h"
+#include "llthread.h"
 
+#include <deque>
+
+//---------------------------------------------------------------------------
+// Region cache file index record, one per object, sorted by local id.
+struct LLVOCacheIndexEntry
+{
+	U32 mLocalID;
+	U32 mCRC;
+	U32 mOffset;	// of the object data in the file
+	S32 mSize;
+	S32 mHitCount;
+	S32 mDupeCount;
+	S32 mCRCChangeCount;
+};
 
 //---------------------------------------------------------------------------
 // Cache entries
@@ -47,7 +62,8 @@ class LLVOCacheEntry
 {
 public:
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLAPRFile* apr_file);
+	// Refers to data in a mapped cache file, which must outlive the entry.
+	LLVOCacheEntry(const LLVOCacheIndexEntry& index, U8* data);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
@@ -56,8 +72,13 @@ public:
 	S32 getHitCount() const			{ return mHitCount; }
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
 
+	// Where the data already is in the region cache file, 0 if it isn't.
+	U32 getFileOffset() const		{ return mFileOffset; }
+	const U8* getData() const		{ return mDP.getBuffer(); }
+	S32 getSize() const				{ return mDP.getBufferSize(); }
+	void getIndexEntry(LLVOCacheIndexEntry& index) const;
+
 	void dump() const;
-	BOOL writeToFile(LLAPRFile* apr_file) const;
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
@@ -72,12 +93,16 @@ protected:
 	S32							mHitCount;
 	S32							mDupeCount;
 	S32							mCRCChangeCount;
+	U32							mFileOffset;
 	LLDataPackerBinaryBuffer	mDP;
-	U8							*mBuffer;
+	U8							*mBuffer; // NULL when mDP points into a mapped file
 };
 
+class LLVOCacheFile;
+
 //
-//Note: LLVOCache is not thread-safe
+//Note: LLVOCache is not thread-safe, except for the background compaction
+//of region files which it coordinates itself.
 //
 class LLVOCache
 {
@@ -120,16 +145,22 @@ public:
 	void initCache(ELLPath location, U32 size, U32 cache_version) ;
 	void removeCache(ELLPath location) ;
 
+	// Maps the region file and fills cache_entry_map with entries pointing
+	// into it. The mapping stays alive until releaseRegionFile(handle).
 	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
+	// Appends the new and changed entries and a new index to the region file.
 	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
+	// Call once the entries read from the region file are deleted.
+	void releaseRegionFile(U64 handle) ;
 	void removeEntry(U64 handle) ;
 
 	void setReadOnly(BOOL read_only) {mReadOnly = read_only;} 
 
-private:
-	void setDirNames(ELLPath location);	
 	// determine the cache filename for the region from the region handle	
 	void getObjectCacheFilename(U64 handle, std::string& filename);
+
+private:
+	void setDirNames(ELLPath location);	
 	void removeFromCache(HeaderEntryInfo* entry);
 	void readCacheHeader();
 	void writeCacheHeader();
@@ -138,6 +169,24 @@ private:
 	void removeEntry(HeaderEntryInfo* entry) ;
 	void purgeEntries(U32 size);
 	BOOL updateEntry(const HeaderEntryInfo* entry);
+
+	bool writeRegionFile(const std::string& filename, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map);
+	bool appendToRegionFile(const std::string& filename, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, bool& needs_compaction);
+	void waitForCompaction(U64 handle);
+	void cancelCompactions();
+
+	// Rewrites region files without their dead data, off the main thread.
+	class Compactor : public LLThread
+	{
+	public:
+		Compactor(LLVOCache* cache);
+		/*virtual*/ void run();
+
+	private:
+		LLVOCache* mCache;
+	};
+	void compactorLoop();
+	static bool compactRegionFile(const std::string& filename);
 	
 private:
 	BOOL                 mEnabled;
@@ -151,6 +200,18 @@ private:
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
 
+	typedef std::map<U64, LLVOCacheFile*> region_file_map_t;
+	region_file_map_t    mRegionFiles;		// mapped while their region is loaded
+	std::set<U64>        mPendingCompaction; // compact once unmapped
+	std::set<U64>        mPendingRemoval;	// remove once unmapped
+
+	Compactor*           mCompactor;
+	// protected by mCompactSignal
+	LLCondition          mCompactSignal;
+	std::deque<std::pair<U64, std::string> > mCompactQueue;
+	std::set<U64>        mCompacting;		// queued or being compacted
+	bool                 mCompactorQuitting;
+
 	static LLVOCache* sInstance ;
 public:
 	static LLVOCache* getInstance() ;
@@ -0,0 +1,215 @@
+/**
+ * @file llvolumebuildthread.cpp
+ * @brief Background tessellation of prim LODs and sculpt maps.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llvolumebuildthread.h"
+
+#include "llprimitive.h"
+#include "llvolumemgr.h"
+#include "llvovolume.h"
+
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+
+LLVolumeBuildThread::BuildRequest::BuildRequest(handle_t handle, U32 priority, LLVolumeBuildThread* thread,
+												const LLVolumeParams& params, S32 detail,
+												LLImageRaw* sculpt_image, S32 sculpt_level)
+	: LLQueuedThread::QueuedRequest(handle, priority),
+	  mThread(thread),
+	  mParams(params),
+	  mDetail(detail),
+	  mSculptImage(sculpt_image),
+	  mSculptLevel(sculpt_level)
+{
+}
+
+LLVolumeBuildThread::BuildRequest::~BuildRequest()
+{
+	mVolume = NULL;
+	mSculptImage = NULL;
+}
+
+// Called from the worker thread
+bool LLVolumeBuildThread::BuildRequest::processRequest()
+{
+	mVolume = new LLVolume(mParams, LLVolumeLODGroup::getVolumeScaleFromDetail(mDetail));
+	if (mSculptImage.notNull())
+	{
+		mVolume->sculpt(mSculptImage->getWidth(), mSculptImage->getHeight(), mSculptImage->getComponents(),
+						mSculptImage->getData(), mSculptLevel);
+		mSculptImage = NULL;
+	}
+	return true;
+}
+
+// Called from the worker thread
+void LLVolumeBuildThread::BuildRequest::finishRequest(bool completed)
+{
+	mThread->addCompleted(getHashKey());
+}
+
+//----------------------------------------------------------------------------
+
+LLVolumeBuildThread::LLVolumeBuildThread(bool threaded)
+	: LLQueuedThread("volumebuild", threaded)
+{
+}
+
+LLVolumeBuildThread::~LLVolumeBuildThread()
+{
+}
+
+bool LLVolumeBuildThread::buildLOD(LLVOVolume* vobj, const LLVolumeParams& params, S32 detail)
+{
+	return queueBuild(vobj, NULL, params, detail, NULL, 0);
+}
+
+bool LLVolumeBuildThread::buildSculpt(LLVOVolume* vobj, LLVolume* volume, LLImageRaw* sculpt_image, S32 sculpt_level)
+{
+	if (!sculpt_image || !sculpt_image->getData())
+	{
+		return false; // the placeholder is cheap, build it in place
+	}
+	S32 detail = LLVolumeLODGroup::getVolumeDetailFromScale(volume->getDetail());
+	return queueBuild(vobj, volume, volume->getParams(), detail, sculpt_image, sculpt_level);
+}
+
+bool LLVolumeBuildThread::queueBuild(LLVOVolume* vobj, LLVolume* target, const LLVolumeParams& params, S32 detail,
+									 LLImageRaw* sculpt_image, S32 sculpt_level)
+{
+	key_t key(params, detail);
+	pending_map_t::iterator iter = mPending.find(key);
+	if (iter == mPending.end())
+	{
+		// The sculpt texture keeps changing while it loads, build from a copy
+		LLPointer<LLImageRaw> sculpt_copy;
+		if (sculpt_image)
+		{
+			sculpt_copy = new LLImageRaw(sculpt_image->getData(), sculpt_image->getWidth(),
+										 sculpt_image->getHeight(), sculpt_image->getComponents());
+		}
+
+		handle_t handle = generateHandle();
+		BuildRequest* req = new BuildRequest(handle, LLQueuedThread::PRIORITY_NORMAL, this,
+											 params, detail, sculpt_copy, sculpt_level);
+		if (!addRequest(req))
+		{
+			req->deleteRequest();
+			return false;
+		}
+		iter = mPending.insert(std::make_pair(key, PendingBuild())).first;
+		iter->second.mHandle = handle;
+		iter->second.mTarget = target;
+	}
+
+	std::vector<LLVOVolume*>& objects = iter->second.mObjects;
+	if (std::find(objects.begin(), objects.end(), vobj) == objects.end())
+	{
+		objects.push_back(vobj);
+		++vobj->mVolumeBuildsPending;
+	}
+	return true;
+}
+
+void LLVolumeBuildThread::removeObject(LLVOVolume* vobj)
+{
+	for (pending_map_t::iterator iter = mPending.begin(); iter != mPending.end(); ++iter)
+	{
+		std::vector<LLVOVolume*>& objects = iter->second.mObjects;
+		objects.erase(std::remove(objects.begin(), objects.end(), vobj), objects.end());
+	}
+	vobj->mVolumeBuildsPending = 0;
+}
+
+// Called from the worker thread
+void LLVolumeBuildThread::addCompleted(handle_t handle)
+{
+	LLMutexLock lock(&mCompletedMutex);
+	mCompleted.push_back(handle);
+}
+
+S32 LLVolumeBuildThread::update(F32 max_time_ms)
+{
+	S32 res = LLQueuedThread::update(max_time_ms);
+
+	std::vector<handle_t> completed;
+	{
+		LLMutexLock lock(&mCompletedMutex);
+		completed.swap(mCompleted);
+	}
+
+	for (std::vector<handle_t>::iterator iter = completed.begin(); iter != completed.end(); ++iter)
+	{
+		BuildRequest* req = (BuildRequest*)getRequest(*iter);
+		if (!req)
+		{
+			continue;
+		}
+
+		pending_map_t::iterator pending_iter = mPending.find(key_t(req->getParams(), req->getDetail()));
+		if (pending_iter != mPending.end() && pending_iter->second.mHandle == *iter)
+		{
+			PendingBuild& pending = pending_iter->second;
+			LLVolume* volume = req->getVolume();
+			if (volume)
+			{
+				if (pending.mTarget.notNull())
+				{
+					pending.mTarget->swapSculpt(volume);
+				}
+				else if (LLPrimitive::getVolumeManager()) // gone when draining at shutdown
+				{
+					LLPrimitive::getVolumeManager()->publishVolume(volume, req->getDetail());
+				}
+			}
+
+			bool sculpted = pending.mTarget.notNull();
+			std::vector<LLVOVolume*> objects;
+			objects.swap(pending.mObjects);
+			mPending.erase(pending_iter);
+
+			for (std::vector<LLVOVolume*>::iterator obj_iter = objects.begin(); obj_iter != objects.end(); ++obj_iter)
+			{
+				--(*obj_iter)->mVolumeBuildsPending;
+				(*obj_iter)->notifyVolumeBuilt(sculpted);
+			}
+		}
+
+		// Volumes that were not published are deleted here, on the main thread
+		completeRequest(*iter);
+	}
+
+	return res;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file llvolumebuildthread.h
+ * @brief Background tessellation of prim LODs and sculpt maps.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLVOLUMEBUILDTHREAD_H
+#define LL_LLVOLUMEBUILDTHREAD_H
+
+#include "llimage.h"
+#include "llpointer.h"
+#include "llqueuedthread.h"
+#include "llvolume.h"
+
+#include <map>
+#include <vector>
+
+class LLVOVolume;
+
+// Tessellates prim LODs and sculpt maps off the main thread.
+// Objects keep drawing their current geometry until the new volume is
+// handed to LLVolumeMgr (or swapped into the shared sculpt volume) by
+// update(), which then asks them to rebuild.
+class LLVolumeBuildThread : public LLQueuedThread
+{
+public:
+	class BuildRequest : public LLQueuedThread::QueuedRequest
+	{
+		friend class LLVolumeBuildThread;
+
+	protected:
+		virtual ~BuildRequest(); // use deleteRequest()
+
+	public:
+		BuildRequest(handle_t handle, U32 priority, LLVolumeBuildThread* thread,
+					 const LLVolumeParams& params, S32 detail,
+					 LLImageRaw* sculpt_image, S32 sculpt_level);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		const LLVolumeParams& getParams() const { return mParams; }
+		S32 getDetail() const { return mDetail; }
+		LLVolume* getVolume() const { return mVolume; }
+
+	private:
+		LLVolumeBuildThread* mThread;
+		// input
+		LLVolumeParams mParams;
+		S32 mDetail;
+		LLPointer<LLImageRaw> mSculptImage;
+		S32 mSculptLevel;
+		// output
+		LLPointer<LLVolume> mVolume;
+	};
+
+public:
+	LLVolumeBuildThread(bool threaded = true);
+	virtual ~LLVolumeBuildThread();
+
+	// Queues the build of a prim LOD vobj is waiting for.
+	bool buildLOD(LLVOVolume* vobj, const LLVolumeParams& params, S32 detail);
+	// Queues sculpting a copy of volume, which is swapped into volume when done.
+	bool buildSculpt(LLVOVolume* vobj, LLVolume* volume, LLImageRaw* sculpt_image, S32 sculpt_level);
+	// Called when a waiting object dies.
+	void removeObject(LLVOVolume* vobj);
+
+	// Also hands finished volumes over on the main thread.
+	/*virtual*/ S32 update(F32 max_time_ms);
+
+	S32 getNumPending() const { return (S32)mPending.size(); }
+
+private:
+	bool queueBuild(LLVOVolume* vobj, LLVolume* target, const LLVolumeParams& params, S32 detail,
+					LLImageRaw* sculpt_image, S32 sculpt_level);
+	// Called from the worker thread
+	void addCompleted(handle_t handle);
+
+	typedef std::pair<LLVolumeParams, S32> key_t;
+	struct PendingBuild
+	{
+		handle_t mHandle;
+		LLPointer<LLVolume> mTarget; // sculpt builds only
+		std::vector<LLVOVolume*> mObjects;
+	};
+	typedef std::map<key_t, PendingBuild> pending_map_t;
+	pending_map_t mPending;
+
+	std::vector<handle_t> mCompleted;
+	LLMutex mCompletedMutex;
+};
+
+#endif // LL_LLVOLUMEBUILDTHREAD_H
@@ -50,6 +50,7 @@
 #include "llspatialpartition.h"
 
 F32 LLVOSurfacePatch::sLODFactor = 1.f;
+LLVOSurfacePatch::geometry_map_t LLVOSurfacePatch::sTerrainGeometry;
 
 //============================================================================
 
@@ -308,9 +309,10 @@ void LLVOSurfacePatch::updateFaceSize(S32 idx)
 	
 	if (mLastStride)
 	{
-		getGeomSizesMain(mLastStride, num_vertices, num_indices);
-		getGeomSizesNorth(mLastStride, mLastNorthStride, num_vertices, num_indices);
-		getGeomSizesEast(mLastStride, mLastEastStride, num_vertices, num_indices);
+		const LLTerrainGeometry& geometry = getTerrainGeometry(mPatchp->getSurface()->getGridsPerPatchEdge(),
+															   mLastStride, mLastNorthStride, mLastEastStride);
+		num_vertices = geometry.mPoints.size();
+		num_indices = geometry.mIndices.size();
 	}
 
 	facep->setSize(num_vertices, num_indices);	
@@ -331,47 +333,77 @@ void LLVOSurfacePatch::getGeometry(LLStrider<LLVector3> &verticesp,
 
 	U32 index_offset = facep->getGeomIndex();
 
-	updateMainGeometry(facep, 
-					verticesp,
-					normalsp,
-					texCoords0p,
-					texCoords1p,
-					indicesp,
-					index_offset);
-	updateNorthGeometry(facep, 
-						verticesp,
-						normalsp,
-						texCoords0p,
-						texCoords1p,
-						indicesp,
-						index_offset);
-	updateEastGeometry(facep, 
-						verticesp,
-						normalsp,
-						texCoords0p,
-						texCoords1p,
-						indicesp,
-						index_offset);
+	llassert(mLastStride > 0);
+
+	S32 patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
+	const LLTerrainGeometry& geometry = getTerrainGeometry(patch_size, mLastStride, mLastNorthStride, mLastEastStride);
+
+	// Everything but the position is cached as is, the position only needs
+	// the current origin of the patch in agent space.
+	const LLSurfaceVertex* cachep = mPatchp->getVertexCache();
+	LLVector3 origin_agent = mPatchp->getOriginAgent();
+
+	for (std::vector<U16>::const_iterator iter = geometry.mPoints.begin();
+		 iter != geometry.mPoints.end(); ++iter)
+	{
+		const LLSurfaceVertex& vertex = cachep[*iter];
+		LLVector3* vertexp = verticesp.get();
+		vertexp->mV[VX] = origin_agent.mV[VX] + vertex.mPosition.mV[VX];
+		vertexp->mV[VY] = origin_agent.mV[VY] + vertex.mPosition.mV[VY];
+		vertexp->mV[VZ] = vertex.mPosition.mV[VZ];
+		*(normalsp++) = vertex.mNormal;
+		*(texCoords0p++) = vertex.mTexCoord0;
+		*(texCoords1p++) = vertex.mTexCoord1;
+		verticesp++;
+	}
+
+	for (std::vector<U16>::const_iterator iter = geometry.mIndices.begin();
+		 iter != geometry.mIndices.end(); ++iter)
+	{
+		*(indicesp++) = index_offset + *iter;
+	}
+
+	if (mLastEastStride == mLastStride)
+	{
+		facep->mCenterAgent = (mPatchp->getPointAgent(8, 15) + mPatchp->getPointAgent(8, 16))*0.5f;
+	}
+	else if (mLastEastStride > mLastStride)
+	{
+		facep->mCenterAgent = (mPatchp->getPointAgent(7, 15) + mPatchp->getPointAgent(8, 16))*0.5f;
+	}
+	else
+	{
+		facep->mCenterAgent = (mPatchp->getPointAgent(15, 7) + mPatchp->getPointAgent(16, 8))*0.5f;
+	}
 }
 
-void LLVOSurfacePatch::updateMainGeometry(LLFace *facep,
-										LLStrider<LLVector3> &verticesp,
-										LLStrider<LLVector3> &normalsp,
-										LLStrider<LLVector2> &texCoords0p,
-										LLStrider<LLVector2> &texCoords1p,
-										LLStrider<U16> &indicesp,
-										U32 &index_offset)
+//static
+const LLVOSurfacePatch::LLTerrainGeometry& LLVOSurfacePatch::getTerrainGeometry(S32 patch_size, U32 stride,
+																				U32 north_stride, U32 east_stride)
 {
-	S32 i, j, x, y;
+	// Strides are powers of two no larger than the patch.
+	U32 key = patch_size | (stride << 8) | (north_stride << 16) | (east_stride << 24);
+	geometry_map_t::iterator iter = sTerrainGeometry.find(key);
+	if (iter != sTerrainGeometry.end())
+	{
+		return iter->second;
+	}
 
-	U32 patch_size, render_stride;
-	S32 num_vertices, num_indices;
-	U32 index;
+	LLTerrainGeometry& geometry = sTerrainGeometry[key];
+	buildMainGeometry(geometry, patch_size, stride);
+	buildNorthGeometry(geometry, patch_size, stride, north_stride);
+	buildEastGeometry(geometry, patch_size, stride, east_stride);
+	return geometry;
+}
 
-	llassert(mLastStride > 0);
+//static
+void LLVOSurfacePatch::buildMainGeometry(LLTerrainGeometry& geometry, S32 patch_size, U32 render_stride)
+{
+	S32 i, j, x, y;
 
-	render_stride = mLastStride;
-	patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
+	U32 index;
+	U32 index_offset = geometry.mPoints.size();
+	S32 points_per_edge = patch_size + 1;
 	S32 vert_size = patch_size / render_stride;
 
 	///////////////////////////
@@ -380,102 +412,86 @@ void LLVOSurfacePatch::updateMainGeometry(LLFace *facep,
 	//
 	//
 
-	num_vertices = 0;
-	num_indices = 0;
-	// First, figure out how many vertices we need...
-	getGeomSizesMain(render_stride, num_vertices, num_indices);
-
-	if (num_vertices > 0)
+	if (vert_size < 2)
 	{
-		facep->mCenterAgent = mPatchp->getPointAgent(8, 8);
+		return;
+	}
 
-		// Generate patch points first
-		for (j = 0; j < vert_size; j++)
+	// Generate patch points first
+	for (j = 0; j < vert_size; j++)
+	{
+		for (i = 0; i < vert_size; i++)
 		{
-			for (i = 0; i < vert_size; i++)
-			{
-				x = i * render_stride;
-				y = j * render_stride;
-				mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-				verticesp++;
-				normalsp++;
-				texCoords0p++;
-				texCoords1p++;
-			}
+			x = i * render_stride;
+			y = j * render_stride;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
+	}
 
-		for (j = 0; j < (vert_size - 1); j++)
+	std::vector<U16>& indices = geometry.mIndices;
+	for (j = 0; j < (vert_size - 1); j++)
+	{
+		if (j % 2)
 		{
-			if (j % 2)
+			for (i = (vert_size - 1); i > 0; i--)
 			{
-				for (i = (vert_size - 1); i > 0; i--)
-				{
-					index = (i - 1)+ j*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = (i - 1)+ j*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = i + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = i + (j+1)*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = (i - 1) + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = (i - 1) + (j+1)*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = (i - 1) + j*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = (i - 1) + j*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = i + j*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = i + j*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = i + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
-				}
+				index = i + (j+1)*vert_size;
+				indices.push_back(index_offset + index);
 			}
-			else
+		}
+		else
+		{
+			for (i = 0; i < (vert_size - 1); i++)
 			{
-				for (i = 0; i < (vert_size - 1); i++)
-				{
-					index = i + j*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = i + j*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = (i + 1) + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = (i + 1) + (j+1)*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = i + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = i + (j+1)*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = i + j*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = i + j*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = (i + 1) + j*vert_size;
-					*(indicesp++) = index_offset + index;
+				index = (i + 1) + j*vert_size;
+				indices.push_back(index_offset + index);
 
-					index = (i + 1) + (j + 1)*vert_size;
-					*(indicesp++) = index_offset + index;
-				}
+				index = (i + 1) + (j + 1)*vert_size;
+				indices.push_back(index_offset + index);
 			}
 		}
 	}
-	index_offset += num_vertices;
 }
 
 
-void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
-										LLStrider<LLVector3> &verticesp,
-										LLStrider<LLVector3> &normalsp,
-										LLStrider<LLVector2> &texCoords0p,
-										LLStrider<LLVector2> &texCoords1p,
-										LLStrider<U16> &indicesp,
-										U32 &index_offset)
+//static
+void LLVOSurfacePatch::buildNorthGeometry(LLTerrainGeometry& geometry, S32 patch_size, U32 render_stride,
+										  U32 north_stride)
 {
-	S32 vertex_count = 0;
 	S32 i, x, y;
 
-	S32 num_vertices, num_indices;
-
-	U32 render_stride = mLastStride;
-	S32 patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
+	U32 index_offset = geometry.mPoints.size();
+	S32 points_per_edge = patch_size + 1;
 	S32 length = patch_size / render_stride;
 	S32 half_length = length / 2;
-	U32 north_stride = mLastNorthStride;
+	std::vector<U16>& indices = geometry.mIndices;
 	
 	///////////////////////////
 	//
@@ -486,88 +502,56 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 	// Stride lengths are the same
 	if (north_stride == render_stride)
 	{
-		num_vertices = 2 * length + 1;
-		num_indices = length * 6 - 3;
-
-		facep->mCenterAgent = (mPatchp->getPointAgent(8, 15) + mPatchp->getPointAgent(8, 16))*0.5f;
-
 		// Main patch
 		for (i = 0; i < length; i++)
 		{
 			x = i * render_stride;
-			y = 16 - render_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
-			vertex_count++;
+			y = patch_size - render_stride;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 		// North patch
 		for (i = 0; i <= length; i++)
 		{
 			x = i * render_stride;
-			y = 16;
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
-			vertex_count++;
+			y = patch_size;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 
 		for (i = 0; i < length; i++)
 		{
 			// Generate indices
-			*(indicesp++) = index_offset + i;
-			*(indicesp++) = index_offset + length + i + 1;
-			*(indicesp++) = index_offset + length + i;
+			indices.push_back(index_offset + i);
+			indices.push_back(index_offset + length + i + 1);
+			indices.push_back(index_offset + length + i);
 
 			if (i != length - 1)
 			{
-				*(indicesp++) = index_offset + i;
-				*(indicesp++) = index_offset + i + 1;
-				*(indicesp++) = index_offset + length + i + 1;
+				indices.push_back(index_offset + i);
+				indices.push_back(index_offset + i + 1);
+				indices.push_back(index_offset + length + i + 1);
 			}
 		}
 	}
 	else if (north_stride > render_stride)
 	{
 		// North stride is longer (has less vertices)
-		num_vertices = length + length/2 + 1;
-		num_indices = half_length*9 - 3;
-
-		facep->mCenterAgent = (mPatchp->getPointAgent(7, 15) + mPatchp->getPointAgent(8, 16))*0.5f;
 
 		// Iterate through this patch's points
 		for (i = 0; i < length; i++)
 		{
 			x = i * render_stride;
-			y = 16 - render_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
-			vertex_count++;
+			y = patch_size - render_stride;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 		// Iterate through the north patch's points
 		for (i = 0; i <= length; i+=2)
 		{
 			x = i * render_stride;
-			y = 16;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
-			vertex_count++;
+			y = patch_size;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 
@@ -575,19 +559,19 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 		{
 			if (!(i % 2))
 			{
-				*(indicesp++) = index_offset + i;
-				*(indicesp++) = index_offset + i + 1;
-				*(indicesp++) = index_offset + length + (i/2);
+				indices.push_back(index_offset + i);
+				indices.push_back(index_offset + i + 1);
+				indices.push_back(index_offset + length + (i/2));
 
-				*(indicesp++) = index_offset + i + 1;
-				*(indicesp++) = index_offset + length + (i/2) + 1;
-				*(indicesp++) = index_offset + length + (i/2);
+				indices.push_back(index_offset + i + 1);
+				indices.push_back(index_offset + length + (i/2) + 1);
+				indices.push_back(index_offset + length + (i/2));
 			}
 			else if (i < (length - 1))
 			{
-				*(indicesp++) = index_offset + i;
-				*(indicesp++) = index_offset + i + 1;
-				*(indicesp++) = index_offset + length + (i/2) + 1;
+				indices.push_back(index_offset + i);
+				indices.push_back(index_offset + i + 1);
+				indices.push_back(index_offset + length + (i/2) + 1);
 			}
 		}
 	}
@@ -596,186 +580,134 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 		// North stride is shorter (more vertices)
 		length = patch_size / north_stride;
 		half_length = length / 2;
-		num_vertices = length + half_length + 1;
-		num_indices = 9*half_length - 3;
-
-		facep->mCenterAgent = (mPatchp->getPointAgent(15, 7) + mPatchp->getPointAgent(16, 8))*0.5f;
 
 		// Iterate through this patch's points
 		for (i = 0; i < length; i+=2)
 		{
 			x = i * north_stride;
-			y = 16 - render_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
-			vertex_count++;
+			y = patch_size - render_stride;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 		// Iterate through the north patch's points
 		for (i = 0; i <= length; i++)
 		{
 			x = i * north_stride;
-			y = 16;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
-			vertex_count++;
+			y = patch_size;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 		for (i = 0; i < length; i++)
 		{
 			if (!(i%2))
 			{
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + i/2;
-				*(indicesp++) = index_offset + half_length + i + 1;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + i/2);
+				indices.push_back(index_offset + half_length + i + 1);
 			}
 			else if (i < (length - 2))
 			{
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + i/2;
-				*(indicesp++) = index_offset + i/2 + 1;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + i/2);
+				indices.push_back(index_offset + i/2 + 1);
 
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + i/2 + 1;
-				*(indicesp++) = index_offset + half_length + i + 1;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + i/2 + 1);
+				indices.push_back(index_offset + half_length + i + 1);
 			}
 			else
 			{
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + i/2;
-				*(indicesp++) = index_offset + half_length + i + 1;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + i/2);
+				indices.push_back(index_offset + half_length + i + 1);
 			}
 		}
 	}
-	index_offset += num_vertices;
 }
 
-void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
-										  LLStrider<LLVector3> &verticesp,
-										  LLStrider<LLVector3> &normalsp,
-										  LLStrider<LLVector2> &texCoords0p,
-										  LLStrider<LLVector2> &texCoords1p,
-										  LLStrider<U16> &indicesp,
-										  U32 &index_offset)
+//static
+void LLVOSurfacePatch::buildEastGeometry(LLTerrainGeometry& geometry, S32 patch_size, U32 render_stride,
+										 U32 east_stride)
 {
 	S32 i, x, y;
 
-	S32 num_vertices, num_indices;
-
-	U32 render_stride = mLastStride;
-	S32 patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
+	U32 index_offset = geometry.mPoints.size();
+	S32 points_per_edge = patch_size + 1;
 	S32 length = patch_size / render_stride;
 	S32 half_length = length / 2;
-
-	U32 east_stride = mLastEastStride;
+	std::vector<U16>& indices = geometry.mIndices;
 
 	// Stride lengths are the same
 	if (east_stride == render_stride)
 	{
-		num_vertices = 2 * length + 1;
-		num_indices = length * 6 - 3;
-
-		facep->mCenterAgent = (mPatchp->getPointAgent(8, 15) + mPatchp->getPointAgent(8, 16))*0.5f;
-
 		// Main patch
 		for (i = 0; i < length; i++)
 		{
-			x = 16 - render_stride;
+			x = patch_size - render_stride;
 			y = i * render_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 		// East patch
 		for (i = 0; i <= length; i++)
 		{
-			x = 16;
+			x = patch_size;
 			y = i * render_stride;
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 
 		for (i = 0; i < length; i++)
 		{
 			// Generate indices
-			*(indicesp++) = index_offset + i;
-			*(indicesp++) = index_offset + length + i;
-			*(indicesp++) = index_offset + length + i + 1;
+			indices.push_back(index_offset + i);
+			indices.push_back(index_offset + length + i);
+			indices.push_back(index_offset + length + i + 1);
 
 			if (i != length - 1)
 			{
-				*(indicesp++) = index_offset + i;
-				*(indicesp++) = index_offset + length + i + 1;
-				*(indicesp++) = index_offset + i + 1;
+				indices.push_back(index_offset + i);
+				indices.push_back(index_offset + length + i + 1);
+				indices.push_back(index_offset + i + 1);
 			}
 		}
 	}
 	else if (east_stride > render_stride)
 	{
 		// East stride is longer (has less vertices)
-		num_vertices = length + half_length + 1;
-		num_indices = half_length*9 - 3;
-
-		facep->mCenterAgent = (mPatchp->getPointAgent(7, 15) + mPatchp->getPointAgent(8, 16))*0.5f;
 
 		// Iterate through this patch's points
 		for (i = 0; i < length; i++)
 		{
-			x = 16 - render_stride;
+			x = patch_size - render_stride;
 			y = i * render_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 		// Iterate through the east patch's points
 		for (i = 0; i <= length; i+=2)
 		{
-			x = 16;
+			x = patch_size;
 			y = i * render_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 		for (i = 0; i < length; i++)
 		{
 			if (!(i % 2))
 			{
-				*(indicesp++) = index_offset + i;
-				*(indicesp++) = index_offset + length + (i/2);
-				*(indicesp++) = index_offset + i + 1;
+				indices.push_back(index_offset + i);
+				indices.push_back(index_offset + length + (i/2));
+				indices.push_back(index_offset + i + 1);
 
-				*(indicesp++) = index_offset + i + 1;
-				*(indicesp++) = index_offset + length + (i/2);
-				*(indicesp++) = index_offset + length + (i/2) + 1;
+				indices.push_back(index_offset + i + 1);
+				indices.push_back(index_offset + length + (i/2));
+				indices.push_back(index_offset + length + (i/2) + 1);
 			}
 			else if (i < (length - 1))
 			{
-				*(indicesp++) = index_offset + i;
-				*(indicesp++) = index_offset + length + (i/2) + 1;
-				*(indicesp++) = index_offset + i + 1;
+				indices.push_back(index_offset + i);
+				indices.push_back(index_offset + length + (i/2) + 1);
+				indices.push_back(index_offset + i + 1);
 			}
 		}
 	}
@@ -784,63 +716,48 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 		// East stride is shorter (more vertices)
 		length = patch_size / east_stride;
 		half_length = length / 2;
-		num_vertices = length + length/2 + 1;
-		num_indices = 9*(length/2) - 3;
-
-		facep->mCenterAgent = (mPatchp->getPointAgent(15, 7) + mPatchp->getPointAgent(16, 8))*0.5f;
 
 		// Iterate through this patch's points
 		for (i = 0; i < length; i+=2)
 		{
-			x = 16 - render_stride;
+			x = patch_size - render_stride;
 			y = i * east_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 		// Iterate through the east patch's points
 		for (i = 0; i <= length; i++)
 		{
-			x = 16;
+			x = patch_size;
 			y = i * east_stride;
-
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-			verticesp++;
-			normalsp++;
-			texCoords0p++;
-			texCoords1p++;
+			geometry.mPoints.push_back(x + y*points_per_edge);
 		}
 
 		for (i = 0; i < length; i++)
 		{
 			if (!(i%2))
 			{
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + half_length + i + 1;
-				*(indicesp++) = index_offset + i/2;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + half_length + i + 1);
+				indices.push_back(index_offset + i/2);
 			}
 			else if (i < (length - 2))
 			{
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + i/2 + 1;
-				*(indicesp++) = index_offset + i/2;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + i/2 + 1);
+				indices.push_back(index_offset + i/2);
 
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + half_length + i + 1;
-				*(indicesp++) = index_offset + i/2 + 1;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + half_length + i + 1);
+				indices.push_back(index_offset + i/2 + 1);
 			}
 			else
 			{
-				*(indicesp++) = index_offset + half_length + i;
-				*(indicesp++) = index_offset + half_length + i + 1;
-				*(indicesp++) = index_offset + i/2;
+				indices.push_back(index_offset + half_length + i);
+				indices.push_back(index_offset + half_length + i + 1);
+				indices.push_back(index_offset + i/2);
 			}
 		}
 	}
-	index_offset += num_vertices;
 }
 
 void LLVOSurfacePatch::setPatch(LLSurfacePatch *patchp)
@@ -875,71 +792,6 @@ void LLVOSurfacePatch::dirtyGeom()
 	}
 }
 
-void LLVOSurfacePatch::getGeomSizesMain(const S32 stride, S32 &num_vertices, S32 &num_indices)
-{
-	S32 patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
-
-	// First, figure out how many vertices we need...
-	S32 vert_size = patch_size / stride;
-	if (vert_size >= 2)
-	{
-		num_vertices += vert_size * vert_size;
-		num_indices += 6 * (vert_size - 1)*(vert_size - 1);
-	}
-}
-
-void LLVOSurfacePatch::getGeomSizesNorth(const S32 stride, const S32 north_stride,
-										 S32 &num_vertices, S32 &num_indices)
-{
-	S32 patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
-	S32 length = patch_size / stride;
-	// Stride lengths are the same
-	if (north_stride == stride)
-	{
-		num_vertices += 2 * length + 1;
-		num_indices += length * 6 - 3;
-	}
-	else if (north_stride > stride)
-	{
-		// North stride is longer (has less vertices)
-		num_vertices += length + (length/2) + 1;
-		num_indices += (length/2)*9 - 3;
-	}
-	else
-	{
-		// North stride is shorter (more vertices)
-		length = patch_size / north_stride;
-		num_vertices += length + (length/2) + 1;
-		num_indices += 9*(length/2) - 3;
-	}
-}
-
-void LLVOSurfacePatch::getGeomSizesEast(const S32 stride, const S32 east_stride,
-										S32 &num_vertices, S32 &num_indices)
-{
-	S32 patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
-	S32 length = patch_size / stride;
-	// Stride lengths are the same
-	if (east_stride == stride)
-	{
-		num_vertices += 2 * length + 1;
-		num_indices += length * 6 - 3;
-	}
-	else if (east_stride > stride)
-	{
-		// East stride is longer (has less vertices)
-		num_vertices += length + (length/2) + 1;
-		num_indices += (length/2)*9 - 3;
-	}
-	else
-	{
-		// East stride is shorter (more vertices)
-		length = patch_size / east_stride;
-		num_vertices += length + (length/2) + 1;
-		num_indices += 9*(length/2) - 3;
-	}
-}
-
 BOOL LLVOSurfacePatch::lineSegmentIntersect(const LLVector3& start, const LLVector3& end, S32 face, BOOL pick_transparent, S32 *face_hitp,
 									  LLVector3* intersection,LLVector2* tex_coord, LLVector3* normal, LLVector3* bi_normal)
 	
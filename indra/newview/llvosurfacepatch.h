@@ -36,6 +36,9 @@
 #include "llviewerobject.h"
 #include "llstrider.h"
 
+#include <map>
+#include <vector>
+
 class LLSurfacePatch;
 class LLDrawPool;
 class LLVector2;
@@ -111,33 +114,23 @@ protected:
 	S32				mLastStride;
 	S32				mLastLength;
 
-	void getGeomSizesMain(const S32 stride, S32 &num_vertices, S32 &num_indices);
-	void getGeomSizesNorth(const S32 stride, const S32 north_stride,
-								  S32 &num_vertices, S32 &num_indices);
-	void getGeomSizesEast(const S32 stride, const S32 east_stride,
-								 S32 &num_vertices, S32 &num_indices);
-
-	void updateMainGeometry(LLFace *facep,
-					   LLStrider<LLVector3> &verticesp,
-					   LLStrider<LLVector3> &normalsp,
-					   LLStrider<LLVector2> &texCoords0p,
-					   LLStrider<LLVector2> &texCoords1p,
-					   LLStrider<U16> &indicesp,
-					   U32 &index_offset);
-	void updateNorthGeometry(LLFace *facep,
-					   LLStrider<LLVector3> &verticesp,
-					   LLStrider<LLVector3> &normalsp,
-					   LLStrider<LLVector2> &texCoords0p,
-					   LLStrider<LLVector2> &texCoords1p,
-					   LLStrider<U16> &indicesp,
-					   U32 &index_offset);
-	void updateEastGeometry(LLFace *facep,
-					   LLStrider<LLVector3> &verticesp,
-					   LLStrider<LLVector3> &normalsp,
-					   LLStrider<LLVector2> &texCoords0p,
-					   LLStrider<LLVector2> &texCoords1p,
-					   LLStrider<U16> &indicesp,
-					   U32 &index_offset);
+	// Vertex order and triangles of a patch at one render stride, stitched to
+	// the strides of its north and east neighbours. Shared by all patches.
+	struct LLTerrainGeometry
+	{
+		std::vector<U16> mPoints;	// grid point of each vertex, x + y*(patch size + 1)
+		std::vector<U16> mIndices;
+	};
+	typedef std::map<U32, LLTerrainGeometry> geometry_map_t;
+	static geometry_map_t sTerrainGeometry;
+
+	static const LLTerrainGeometry& getTerrainGeometry(S32 patch_size, U32 stride,
+														U32 north_stride, U32 east_stride);
+	static void buildMainGeometry(LLTerrainGeometry& geometry, S32 patch_size, U32 render_stride);
+	static void buildNorthGeometry(LLTerrainGeometry& geometry, S32 patch_size, U32 render_stride,
+								   U32 north_stride);
+	static void buildEastGeometry(LLTerrainGeometry& geometry, S32 patch_size, U32 render_stride,
+								  U32 east_stride);
 };
 
 #endif // LL_VOSURFACEPATCH_H
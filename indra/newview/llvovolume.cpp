@@ -52,6 +52,7 @@
 #include "lldrawable.h"
 #include "lldrawpoolbump.h"
 #include "llface.h"
+#include "llgeometryworkers.h"
 #include "llspatialpartition.h"
 #include "llhudmanager.h"
 #include "llflexibleobject.h"
@@ -76,6 +77,8 @@
 #include "llvoavatar.h"
 #include "llfloatertools.h"
 #include "llvocache.h"
+#include "llvolumebuildthread.h"
+#include "llappviewer.h"
 
 // [RLVa:KB] - Checked: 2010-04-04 (RLVa-1.2.0d)
 #include "rlvhandler.h"
@@ -116,6 +119,8 @@ LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *re
 	mSculptChanged = FALSE;
 	mSpotLightPriority = 0.f;
 	mIndexInTex = 0;
+	mVolumeBuildsPending = 0;
+	mCompressedUpdate = NULL;
 }
 
 LLVOVolume::~LLVOVolume()
@@ -135,6 +140,11 @@ void LLVOVolume::markDead()
 		{
 			mSculptTexture->removeVolume(this);
 		}
+
+		if (mVolumeBuildsPending)
+		{
+			LLAppViewer::getVolumeBuildThread()->removeObject(this);
+		}
 	}
 	
 	LLViewerObject::markDead();
@@ -144,11 +154,24 @@ void LLVOVolume::markDead()
 // static
 void LLVOVolume::initClass()
 {
+	LLGeometryWorkers::initClass(gSavedSettings.getU32("RenderGeometryThreads"));
 }
 
 // static
 void LLVOVolume::cleanupClass()
 {
+	LLGeometryWorkers::cleanupClass();
+}
+
+//static
+void LLVOVolume::decodeCompressedUpdate(LLDataPacker& dp, U32 pass_flags, CompressedUpdate& update)
+{
+	update.mVolumeParamsValid = LLVolumeMessage::unpackVolumeParams(&update.mVolumeParams, dp);
+	update.mTEsValid = LLPrimitive::parseTEMessage(dp, update.mTEs);
+	if (pass_flags & 0x40)
+	{
+		update.mTextureAnim.unpackTAMessage(dp);
+	}
 }
 
 U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
@@ -234,8 +257,20 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 		// CORY TO DO: Figure out how to get the value here
 		if (update_type != OUT_TERSE_IMPROVED)
 		{
+			const CompressedUpdate* update = mCompressedUpdate;
+			mCompressedUpdate = NULL;
+
 			LLVolumeParams volume_params;
-			BOOL res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
+			BOOL res;
+			if (update)
+			{
+				volume_params = update->mVolumeParams;
+				res = update->mVolumeParamsValid;
+			}
+			else
+			{
+				res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
+			}
 			if (!res)
 			{
 				llwarns << "Bogus volume parameters in object " << getID() << llendl;
@@ -248,7 +283,15 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			{
 				markForUpdate(TRUE);
 			}
-			S32 res2 = unpackTEMessage(*dp);
+			S32 res2;
+			if (update)
+			{
+				res2 = update->mTEsValid ? applyParsedTEMessage(update->mTEs) : TEM_INVALID;
+			}
+			else
+			{
+				res2 = unpackTEMessage(*dp);
+			}
 			if (TEM_INVALID == res2)
 			{
 				// Well, crap, there's something bogus in the data that we're unpacking.
@@ -283,7 +326,14 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 					}
 				}
 				mTexAnimMode = 0;
-				mTextureAnimp->unpackTAMessage(*dp);
+				if (update)
+				{
+					static_cast<LLTextureAnim&>(*mTextureAnimp) = update->mTextureAnim;
+				}
+				else
+				{
+					mTextureAnimp->unpackTAMessage(*dp);
+				}
 			}
 			else if (mTextureAnimp)
 			{
@@ -908,6 +958,38 @@ void LLVOVolume::notifyMeshLoaded()
 	gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_GEOMETRY, TRUE);
 }
 
+void LLVOVolume::notifyVolumeBuilt(bool sculpted)
+{
+	if (isDead() || mDrawable.isNull())
+	{
+		return;
+	}
+
+	if (sculpted)
+	{
+		mSculptChanged = TRUE;
+
+		//notify rebuild any other VOVolumes that reference this sculpty volume
+		if (mSculptTexture.notNull())
+		{
+			for (S32 i = 0; i < mSculptTexture->getNumVolumes(); ++i)
+			{
+				LLVOVolume* volume = (*(mSculptTexture->getVolumeList()))[i];
+				if (volume != this && volume->getVolume() == getVolume())
+				{
+					gPipeline.markRebuild(volume->mDrawable, LLDrawable::REBUILD_GEOMETRY, FALSE);
+				}
+			}
+		}
+	}
+	else
+	{
+		// the LOD we asked for is now cached in the volume manager
+		mLODChanged = TRUE;
+	}
+	gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
+}
+
 // sculpt replaces generate() for sculpted surfaces
 void LLVOVolume::sculpt()
 {	
@@ -945,6 +1027,20 @@ void LLVOVolume::sculpt()
 
 		if (current_discard == discard_level)  // no work to do here
 			return;
+
+		static LLCachedControl<bool> volume_build_thread(gSavedSettings, "VolumeBuildThread");
+		if (volume_build_thread && raw_image && raw_image->getData() && !mVolumeImpl && !getVolume()->isUnique())
+		{
+			if (getVolume()->getNumVolumeFaces() == 0)
+			{
+				// new LOD, draw the placeholder while the map is being meshed
+				getVolume()->sculpt(0, 0, 0, NULL, -1);
+			}
+			if (LLAppViewer::getVolumeBuildThread()->buildSculpt(this, getVolume(), raw_image, discard_level))
+			{
+				return; // swapped in by the build thread, see notifyVolumeBuilt()
+			}
+		}
 		
 		if(!raw_image)
 		{
@@ -1052,6 +1148,24 @@ BOOL LLVOVolume::calcLOD()
 	}
 }
 
+// Hands the tessellation of a new prim LOD to the volume build thread.
+// Returns true if the current LOD should be kept until notifyVolumeBuilt().
+bool LLVOVolume::queueLODBuild()
+{
+	static LLCachedControl<bool> volume_build_thread(gSavedSettings, "VolumeBuildThread");
+	if (!volume_build_thread || isSculpted() || mVolumeImpl || getVolume()->isUnique())
+	{
+		return false; // meshes are streamed, sculpt maps are queued from sculpt()
+	}
+
+	const LLVolumeParams& volume_params = getVolume()->getParams();
+	if (LLPrimitive::getVolumeManager()->hasVolume(volume_params, mLOD))
+	{
+		return false;
+	}
+	return LLAppViewer::getVolumeBuildThread()->buildLOD(this, volume_params, mLOD);
+}
+
 BOOL LLVOVolume::updateLOD()
 {
 	if (mDrawable.isNull())
@@ -1406,6 +1520,13 @@ BOOL LLVOVolume::updateGeometry(LLDrawable *drawable)
 			genBBoxes(FALSE);
 		}
 	}
+	else if (mLODChanged && !mSculptChanged && queueLODBuild())
+	{
+		// Keep drawing the current LOD until the new one has been built
+		compiled = TRUE;
+		LLFastTimer t(FTM_GEN_TRIANGLES);
+		genBBoxes(FALSE);
+	}
 	else if ((mLODChanged) || (mSculptChanged))
 	{
 		LLVolume *old_volumep, *new_volumep;
@@ -2480,7 +2601,7 @@ F32 LLVOVolume::getStreamingCost(S32* bytes, S32* visible_bytes, F32* unscaled_v
 
 	if (isMesh())
 	{	
-		LLSD& header = gMeshRepo.getMeshHeader(getVolume()->getParams().getSculptID());
+		LLMeshHeader& header = gMeshRepo.getMeshHeader(getVolume()->getParams().getSculptID());
 
 		return LLMeshRepository::getStreamingCost(header, radius, bytes, visible_bytes, mLOD, unscaled_value);
 	}
@@ -2490,11 +2611,11 @@ F32 LLVOVolume::getStreamingCost(S32* bytes, S32* visible_bytes, F32* unscaled_v
 		S32 counts[4];
 		LLVolume::getLoDTriangleCounts(volume->getParams(), counts);
 
-		LLSD header;
-		header["lowest_lod"]["size"] = counts[0] * 10;
-		header["low_lod"]["size"] = counts[1] * 10;
-		header["medium_lod"]["size"] = counts[2] * 10;
-		header["high_lod"]["size"] = counts[3] * 10;
+		LLMeshHeader header;
+		header.mSize[LLMeshHeader::LOWEST_LOD] = counts[0] * 10;
+		header.mSize[LLMeshHeader::LOW_LOD] = counts[1] * 10;
+		header.mSize[LLMeshHeader::MEDIUM_LOD] = counts[2] * 10;
+		header.mSize[LLMeshHeader::HIGH_LOD] = counts[3] * 10;
 
 		return LLMeshRepository::getStreamingCost(header, radius, NULL, NULL, -1, unscaled_value);
 	}	
@@ -3091,11 +3212,8 @@ void LLRiggedVolume::update(const LLMeshSkinInfo* skin, LLVOAvatar* avatar, cons
 			delete dst_face.mOctree;
 			dst_face.mOctree = NULL;
 
-			LLVector4a size;
-			size.setSub(dst_face.mExtents[1], dst_face.mExtents[0]);
-			size.splat(size.getLength3().getF32()*0.5f);
-			
-			dst_face.createOctree(1.f);
+			dst_face.destroyBVH();
+			dst_face.createBVH();
 		}
 	}
 }
@@ -3834,6 +3952,8 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 		group->mBuilt = 1.f;
 		
 		std::set<LLVertexBuffer*> mapped_buffers;
+		face_geometry_job_list_t jobs;
+		face_geometry_job_list_t* jobsp = LLGeometryWorkers::getInstance() ? &jobs : NULL;
 
 		for (LLSpatialGroup::element_iter drawable_iter = group->getData().begin(); drawable_iter != group->getData().end(); ++drawable_iter)
 		{
@@ -3860,7 +3980,7 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 						if (buff)
 						{
 							face->getGeometryVolume(*volume, face->getTEOffset(), 
-								vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), face->getGeomIndex());
+								vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), face->getGeomIndex(), false, jobsp);
 
 							if (buff->isLocked())
 							{
@@ -3873,6 +3993,8 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 				drawablep->clearState(LLDrawable::REBUILD_ALL);
 			}
 		}
+
+		runGeometryJobs(jobs);
 		
 		for (std::set<LLVertexBuffer*>::iterator iter = mapped_buffers.begin(); iter != mapped_buffers.end(); ++iter)
 		{
@@ -3916,6 +4038,47 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 	llassert(!group || !group->isState(LLSpatialGroup::NEW_DRAWINFO));
 }
 
+static LLFastTimer::DeclareTimer FTM_VOLUME_GEOM_JOBS("Geometry Jobs");
+
+static void run_face_geometry_job(void* data, U32 index)
+{
+	((LLFaceGeometryJob*) data)[index].run();
+}
+
+// Small batches aren't worth waking the workers for.
+const S32 MIN_PARALLEL_GEOMETRY_VERTICES = 4096;
+
+//static
+void LLVolumeGeometryManager::runGeometryJobs(face_geometry_job_list_t& jobs)
+{
+	if (jobs.empty())
+	{
+		return;
+	}
+
+	LLFastTimer t(FTM_VOLUME_GEOM_JOBS);
+
+	S32 vertices = 0;
+	for (face_geometry_job_list_t::iterator iter = jobs.begin(); iter != jobs.end(); ++iter)
+	{
+		vertices += iter->mCount;
+	}
+
+	LLGeometryWorkers* workers = LLGeometryWorkers::getInstance();
+	if (workers && jobs.size() > 1 && vertices >= MIN_PARALLEL_GEOMETRY_VERTICES)
+	{
+		workers->run(run_face_geometry_job, &jobs[0], jobs.size());
+	}
+	else
+	{
+		for (face_geometry_job_list_t::iterator iter = jobs.begin(); iter != jobs.end(); ++iter)
+		{
+			iter->run();
+		}
+	}
+	jobs.clear();
+}
+
 struct CompareBatchBreakerModified
 {
 	bool operator()(const LLFace* const& lhs, const LLFace* const& rhs)
@@ -3975,6 +4138,9 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 	
 	LLSpatialGroup::buffer_map_t buffer_map;
 
+	face_geometry_job_list_t jobs;
+	face_geometry_job_list_t* jobsp = LLGeometryWorkers::getInstance() ? &jobs : NULL;
+
 	LLViewerTexture* last_tex = NULL;
 	S32 buffer_index = 0;
 
@@ -4193,7 +4359,7 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 					U32 te_idx = facep->getTEOffset();
 
 					facep->getGeometryVolume(*volume, te_idx, 
-						vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), index_offset);
+						vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), index_offset, false, jobsp);
 				}
 			}
 
@@ -4338,6 +4504,7 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 			++face_iter;
 		}
 
+		runGeometryJobs(jobs);
 		buffer->flush();
 	}
 
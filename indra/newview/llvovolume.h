@@ -37,6 +37,7 @@
 #include "llviewertexture.h"
 #include "llframetimer.h"
 #include "llapr.h"
+#include "lltextureanim.h"
 #include "m3math.h"		// LLMatrix3
 #include "m4math.h"		// LLMatrix4
 #include <map>
@@ -165,6 +166,24 @@ public:
 	/*virtual*/ void	parameterChanged(U16 param_type, bool local_origin);
 	/*virtual*/ void	parameterChanged(U16 param_type, LLNetworkData* data, BOOL in_use, bool local_origin);
 
+	// Volume fields of a compressed full update, what follows the
+	// LLViewerObject fields, read ahead of time off the main thread.
+	struct CompressedUpdate
+	{
+		LLVolumeParams mVolumeParams;
+		bool mVolumeParamsValid;
+		LLTEContents mTEs;
+		bool mTEsValid;
+		LLTextureAnim mTextureAnim;	// if pass flags 0x40
+	};
+
+	// dp must be just past LLViewerObject::skipCompressedUpdate(). Thread safe.
+	static void decodeCompressedUpdate(LLDataPacker& dp, U32 pass_flags, CompressedUpdate& update);
+
+	// Has the next compressed processUpdateMessage() take the volume fields
+	// from update rather than dp. Main thread only, update must outlive that call.
+	void setCompressedUpdate(const CompressedUpdate* update) { mCompressedUpdate = update; }
+
 	/*virtual*/ U32		processUpdateMessage(LLMessageSystem *mesgsys,
 											void **user_data,
 											U32 block_num, const EObjectUpdateType update_type,
@@ -260,6 +279,8 @@ public:
 	void setSculptChanged(BOOL has_changed) { mSculptChanged = has_changed; }
 
 	void notifyMeshLoaded();
+	// Called by LLVolumeBuildThread once the LOD or sculpt this object waited for is ready.
+	void notifyVolumeBuilt(bool sculpted);
 	
 	// Returns 'true' iff the media data for this object is in flight
 	bool isMediaDataBeingFetched() const;
@@ -283,6 +304,7 @@ public:
 protected:
 	S32	computeLODDetail(F32	distance, F32 radius);
 	BOOL calcLOD();
+	bool queueLODBuild();
 	LLFace* addFace(S32 face_index);
 	void updateTEData();
 
@@ -297,6 +319,7 @@ public:
 	U8 mTexAnimMode;
 private:
 	friend class LLDrawable;
+	friend class LLVolumeBuildThread;
 	
 	BOOL		mFaceMappingChanged;
 	LLFrameTimer mTextureUpdateTimer;
@@ -312,6 +335,8 @@ private:
 	LLPointer<LLViewerFetchedTexture> mSculptTexture;
 	LLPointer<LLViewerFetchedTexture> mLightTexture;
 	S32 mIndexInTex;
+	S32 mVolumeBuildsPending;
+	const CompressedUpdate* mCompressedUpdate;
 
 	LLPointer<LLRiggedVolume> mRiggedVolume;
 	
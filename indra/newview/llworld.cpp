@@ -132,6 +132,7 @@ void LLWorld::destroyClass()
 		LLViewerRegion* region_to_delete = *region_it++;
 		removeRegion(region_to_delete->getHost());
 	}
+	updateRegionTeardown(0.f);
 	if(LLVOCache::hasInstance())
 	{
 		LLVOCache::getInstance()->destroyClass() ;
@@ -290,10 +291,78 @@ void LLWorld::removeRegion(const LLHost &host)
 	mActiveRegionList.remove(regionp);
 	mCulledRegionList.remove(regionp);
 	mVisibleRegionList.remove(regionp);
-	
-	delete regionp;
+
+	// Out of the region lists, nothing renders or updates the region any
+	// more. Killing its objects is left to updateRegionTeardown(), a few per
+	// frame, so that leaving a crowded region doesn't stall the frame.
+	regionp->detachFromWorld();
+	mTeardownRegions.push_back(RegionTeardown());
+	RegionTeardown& teardown = mTeardownRegions.back();
+	teardown.mRegion = regionp;
+	gObjectList.detachRegionObjects(regionp, teardown.mObjects);
+	llinfos << "Queued " << teardown.mObjects.size() << " objects of " << regionp->getName() << " for teardown" << llendl;
 
 	updateWaterObjects();
+}
+
+static LLFastTimer::DeclareTimer FTM_REGION_TEARDOWN("Region Teardown");
+
+void LLWorld::updateRegionTeardown(F32 max_time)
+{
+	if (mTeardownRegions.empty())
+	{
+		return;
+	}
+
+	LLFastTimer t(FTM_REGION_TEARDOWN);
+	LLTimer timer;
+	S32 killed = 0;
+	while (!mTeardownRegions.empty())
+	{
+		RegionTeardown& teardown = mTeardownRegions.front();
+		std::vector<LLPointer<LLViewerObject> >& objects = teardown.mObjects;
+		while (!objects.empty())
+		{
+			// Killing takes its children along, check the clock every few.
+			if (max_time > 0.f && (++killed % 8) == 0 && timer.getElapsedTimeF32() > max_time)
+			{
+				return;
+			}
+			// The object may have crossed into another region meanwhile.
+			LLViewerObject* objectp = objects.back();
+			if (objectp->getRegion() == teardown.mRegion)
+			{
+				gObjectList.killObject(objectp);
+			}
+			objects.pop_back();
+		}
+
+		llinfos << "Finished teardown of " << teardown.mRegion->getName() << " after "
+				<< teardown.mTimer.getElapsedTimeF32() << "s" << llendl;
+		deleteRegion(teardown.mRegion);
+		mTeardownRegions.pop_front();
+
+		if (max_time > 0.f && timer.getElapsedTimeF32() > max_time)
+		{
+			return;
+		}
+	}
+}
+
+S32 LLWorld::getNumTeardownObjects() const
+{
+	S32 count = 0;
+	for (std::list<RegionTeardown>::const_iterator iter = mTeardownRegions.begin();
+		 iter != mTeardownRegions.end(); ++iter)
+	{
+		count += iter->mObjects.size();
+	}
+	return count;
+}
+
+void LLWorld::deleteRegion(LLViewerRegion* regionp)
+{
+	delete regionp;
 
 	//double check all objects of this region are removed.
 	gObjectList.clearAllMapObjectsInRegion(regionp) ;
@@ -40,10 +40,13 @@
 
 #include "llpatchvertexarray.h"
 
+#include <vector>
+
 #include "llmath.h"
 #include "v3math.h"
 #include "llmemory.h"
 #include "llstring.h"
+#include "lltimer.h"
 #include "llviewerpartsim.h"
 #include "llviewertexture.h"
 #include "llvowater.h"
@@ -76,6 +79,12 @@ public:
 		// hosts are same, or if hosts are different, etc...
 	void			removeRegion(const LLHost &host);
 
+	// Kills the objects of removed regions for up to max_time seconds (<= 0
+	// for no limit) and deletes the regions whose objects are all gone.
+	void			updateRegionTeardown(F32 max_time);
+	S32				getNumTeardownRegions() const	{ return mTeardownRegions.size(); }
+	S32				getNumTeardownObjects() const;
+
 	void	disconnectRegions(); // Send quit messages to all child regions
 
 	LLViewerRegion*			getRegion(const LLHost &host);
@@ -164,6 +173,17 @@ public:
 		const LLVector3d& relative_to = LLVector3d(), F32 radius = FLT_MAX) const;
 
 private:
+	void			deleteRegion(LLViewerRegion* regionp);
+
+	// A region that has left the world but still has live objects.
+	struct RegionTeardown
+	{
+		LLViewerRegion* mRegion;
+		std::vector<LLPointer<LLViewerObject> > mObjects; // killed from the back
+		LLTimer mTimer;
+	};
+	std::list<RegionTeardown> mTeardownRegions;
+
 	region_list_t	mActiveRegionList;
 	region_list_t	mRegionList;
 	region_list_t	mVisibleRegionList;
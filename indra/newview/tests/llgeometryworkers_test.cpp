@@ -0,0 +1,467 @@
+/** 
+ * @file llgeometryworkers_test.cpp
+ * @brief LLGeometryWorkers and LLFaceGeometryJob test cases and benchmark.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llgeometryworkers.h"
+// Dependencies
+#include "llmatrix4a.h"
+#include "llquaternion.h"
+#include "lltimer.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Helpers
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	struct visit_count
+	{
+		std::vector<U32> mVisits;
+	};
+
+	void count_visit(void* data, U32 index)
+	{
+		++((visit_count*) data)->mVisits[index];
+	}
+
+	// Same as the batch function the group rebuild hands to the workers
+	void run_face_job(void* data, U32 index)
+	{
+		((LLFaceGeometryJob*) data)[index].run();
+	}
+
+	// A face worth of vertices on a sphere of the given radius
+	void make_face(LLVector4a* positions, LLVector4a* normals, S32 count, F32 radius)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			F32 u = F_TWO_PI * (i % 64) / 64.f;
+			F32 v = F_PI * (i / 64) / (count / 64 + 1);
+			normals[i].set(sinf(v) * cosf(u), sinf(v) * sinf(u), cosf(v));
+			positions[i].setMul(normals[i], radius);
+		}
+	}
+
+	LLMatrix4 make_mat_vert(S32 seed)
+	{
+		LLMatrix4 mat;
+		mat.initAll(LLVector3(0.5f + seed, 2.f, 1.5f),
+					LLQuaternion(0.3f * seed, LLVector3(0.f, 0.6f, 0.8f)),
+					LLVector3(128.f, 64.f + seed, 22.f));
+		return mat;
+	}
+
+	LLMatrix3 make_mat_normal(S32 seed)
+	{
+		LLMatrix3 mat = LLQuaternion(0.3f * seed, LLVector3(0.f, 0.6f, 0.8f)).getMatrix3();
+		// Inverse transpose of a non uniform scale
+		mat.mMatrix[0][0] *= 2.f;
+		mat.mMatrix[1][1] *= 0.5f;
+		return mat;
+	}
+
+	F32* alloc_dst(S32 count)
+	{
+		return (F32*) ll_aligned_malloc_16(sizeof(F32) * 4 * count);
+	}
+
+	void run_skin_job(void* data, U32 index)
+	{
+		const LLRiggedSkinJob& job = *(const LLRiggedSkinJob*) data;
+		U32 start = index * LLRiggedSkinJob::BATCH_VERTICES;
+		job.run(start, llmin(start + LLRiggedSkinJob::BATCH_VERTICES, job.mCount));
+	}
+
+	// A rigged mesh: vertices and normals on a sphere, up to four joints per
+	// vertex out of joints, some vertices bound to a single joint.
+	struct rigged_mesh
+	{
+		rigged_mesh(U32 count, U32 joints)
+			: mCount(count), mJoints(joints)
+		{
+			mPositions = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+			mNormals = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+			mWeights = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+			make_face(mPositions, mNormals, count, 0.3f);
+			for (U32 i = 0; i < count; ++i)
+			{
+				if (i % 5 == 0)
+				{
+					mWeights[i].set((F32) (i % joints) + 0.999f, 0.f, 0.f, 0.f);
+				}
+				else
+				{
+					mWeights[i].set((F32) (i % joints) + 0.4f, (F32) ((i + 1) % joints) + 0.3f,
+									(F32) ((i + 7) % joints) + 0.2f, (F32) ((i + 3) % joints) + 0.1f);
+				}
+			}
+
+			mPalette.resize(joints);
+			for (U32 j = 0; j < joints; ++j)
+			{
+				mPalette[j].initAll(LLVector3(1.f, 1.f, 1.f),
+									LLQuaternion(0.1f * j, LLVector3(0.f, 0.f, 1.f)),
+									LLVector3(0.f, 0.05f * j, 1.f));
+			}
+			mBindShape.initAll(LLVector3(1.f, 1.f, 1.f), LLQuaternion(0.5f, LLVector3(1.f, 0.f, 0.f)),
+							   LLVector3(0.f, 0.f, 0.2f));
+		}
+		~rigged_mesh()
+		{
+			ll_aligned_free_16(mPositions);
+			ll_aligned_free_16(mNormals);
+			ll_aligned_free_16(mWeights);
+		}
+
+		U32 mCount;
+		U32 mJoints;
+		LLVector4a* mPositions;
+		LLVector4a* mNormals;
+		LLVector4a* mWeights;
+		std::vector<LLMatrix4> mPalette;
+		LLMatrix4 mBindShape;
+	};
+
+	// The skinning loop LLDrawPoolAvatar ran before LLRiggedSkinJob: bind shape
+	// transform of each vertex, then the blend of the unfolded joint matrices.
+	void old_skin_vertices(const rigged_mesh& mesh, LLVector4a* pos, LLVector4a* norm)
+	{
+		LLMatrix4a mp[64];
+		for (U32 j = 0; j < mesh.mJoints; ++j)
+		{
+			mp[j].loadu(mesh.mPalette[j]);
+		}
+		LLMatrix4a bind_shape_matrix;
+		bind_shape_matrix.loadu(mesh.mBindShape);
+
+		for (U32 j = 0; j < mesh.mCount; ++j)
+		{
+			LLMatrix4a final_mat;
+			final_mat.clear();
+
+			S32 idx[4];
+			LLVector4 wght;
+			F32 scale = 0.f;
+			for (U32 k = 0; k < 4; k++)
+			{
+				F32 w = mesh.mWeights[j][k];
+				idx[k] = llclamp((S32) floorf(w), 0, 63);
+				wght[k] = w - floorf(w);
+				scale += wght[k];
+			}
+			wght *= 1.f/scale;
+
+			for (U32 k = 0; k < 4; k++)
+			{
+				LLMatrix4a src;
+				src.setMul(mp[idx[k]], wght[k]);
+				final_mat.add(src);
+			}
+
+			LLVector4a t;
+			bind_shape_matrix.affineTransform(mesh.mPositions[j], t);
+			final_mat.affineTransform(t, pos[j]);
+			bind_shape_matrix.rotate(mesh.mNormals[j], t);
+			final_mat.rotate(t, norm[j]);
+		}
+	}
+
+	LLRiggedSkinJob make_skin_job(const rigged_mesh& mesh, LLMatrix4a* folded, LLVector4a* pos, LLVector4a* norm)
+	{
+		LLRiggedSkinJob::foldBindShape(&mesh.mPalette[0], mesh.mJoints, mesh.mBindShape, folded);
+
+		LLRiggedSkinJob job;
+		job.mPalette = folded;
+		job.mPaletteSize = mesh.mJoints;
+		job.mWeights = mesh.mWeights;
+		job.mPositions = mesh.mPositions;
+		job.mNormals = mesh.mNormals;
+		job.mPosOut = pos;
+		job.mNormOut = norm;
+		job.mCount = mesh.mCount;
+		return job;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	struct geometryworkers_test
+	{
+		~geometryworkers_test()
+		{
+			LLGeometryWorkers::cleanupClass();
+		}
+	};
+	typedef test_group<geometryworkers_test> geometryworkers_t;
+	typedef geometryworkers_t::object geometryworkers_object_t;
+	tut::geometryworkers_t tut_geometryworkers("geometryworkers");
+
+	// every job of every batch runs exactly once
+	template<> template<>
+	void geometryworkers_object_t::test<1>()
+	{
+		LLGeometryWorkers::initClass(0);
+		ensure("no threads, no pool", LLGeometryWorkers::getInstance() == NULL);
+
+		LLGeometryWorkers::initClass(3);
+		LLGeometryWorkers* workers = LLGeometryWorkers::getInstance();
+		ensure("pool started", workers != NULL);
+		ensure_equals("threads", workers->getNumThreads(), 3U);
+
+		visit_count visits;
+		for (U32 batch = 0; batch < 200; ++batch)
+		{
+			U32 count = 1 + batch % 37;
+			visits.mVisits.assign(count, 0);
+			workers->run(count_visit, &visits, count);
+			for (U32 i = 0; i < count; ++i)
+			{
+				ensure_equals("job ran once", visits.mVisits[i], 1U);
+			}
+		}
+	}
+
+	// positions match the scalar transform, with the texture index in w and the padding after them
+	template<> template<>
+	void geometryworkers_object_t::test<2>()
+	{
+		const S32 count = 301;
+		const S32 pad = 3;
+		LLVector4a* positions = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+		LLVector4a* normals = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+		make_face(positions, normals, count, 0.5f);
+
+		LLFaceGeometryJob job;
+		job.mType = LLFaceGeometryJob::POSITION;
+		job.mMatVert = make_mat_vert(1);
+		job.mSrc = positions;
+		job.mDst = alloc_dst(count + pad);
+		job.mCount = count;
+		job.mPadCount = pad;
+		job.mTexIndex = 5.f;
+		job.run();
+
+		for (S32 i = 0; i < count + pad; ++i)
+		{
+			const F32* src = positions[llmin(i, count - 1)].getF32ptr();
+			LLVector3 expected = LLVector3(src[0], src[1], src[2]) * job.mMatVert;
+			const F32* dst = job.mDst + i * 4;
+			ensure_distance("x", dst[0], expected.mV[0], 1e-4f);
+			ensure_distance("y", dst[1], expected.mV[1], 1e-4f);
+			ensure_distance("z", dst[2], expected.mV[2], 1e-4f);
+			ensure_equals("w", dst[3], i < count ? 5.f : 0.f);
+		}
+
+		ll_aligned_free_16(job.mDst);
+		ll_aligned_free_16(positions);
+		ll_aligned_free_16(normals);
+	}
+
+	// normals match the scalar rotation and come out normalized
+	template<> template<>
+	void geometryworkers_object_t::test<3>()
+	{
+		const S32 count = 128;
+		LLVector4a* positions = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+		LLVector4a* normals = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+		make_face(positions, normals, count, 1.f);
+
+		LLFaceGeometryJob job;
+		job.mType = LLFaceGeometryJob::NORMAL;
+		job.mMatNormal = make_mat_normal(2);
+		job.mSrc = normals;
+		job.mDst = alloc_dst(count);
+		job.mCount = count;
+		job.mPadCount = 0;
+		job.run();
+
+		for (S32 i = 0; i < count; ++i)
+		{
+			const F32* src = normals[i].getF32ptr();
+			LLVector3 expected = LLVector3(src[0], src[1], src[2]) * job.mMatNormal;
+			expected.normVec();
+			const F32* dst = job.mDst + i * 4;
+			// normalize3fast() is an estimate
+			ensure_distance("x", dst[0], expected.mV[0], 1e-3f);
+			ensure_distance("y", dst[1], expected.mV[1], 1e-3f);
+			ensure_distance("z", dst[2], expected.mV[2], 1e-3f);
+		}
+
+		ll_aligned_free_16(job.mDst);
+		ll_aligned_free_16(positions);
+		ll_aligned_free_16(normals);
+	}
+
+	// Benchmark: the staging transforms of a busy group rebuild, inline and on
+	// the workers. Logged at INFO level, run with --debug to see the timings.
+	template<> template<>
+	void geometryworkers_object_t::test<4>()
+	{
+		const S32 faces = 256;
+		const S32 count = 2048;
+		LLVector4a* positions = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+		LLVector4a* normals = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * count);
+		make_face(positions, normals, count, 2.f);
+
+		face_geometry_job_list_t jobs;
+		for (S32 i = 0; i < faces; ++i)
+		{
+			LLFaceGeometryJob job;
+			job.mType = i & 1 ? LLFaceGeometryJob::NORMAL : LLFaceGeometryJob::POSITION;
+			job.mMatVert = make_mat_vert(i);
+			job.mMatNormal = make_mat_normal(i);
+			job.mSrc = i & 1 ? normals : positions;
+			job.mCount = count;
+			job.mPadCount = 0;
+			job.mTexIndex = 0.f;
+			jobs.push_back(job);
+		}
+
+		std::vector<F32*> inline_dst(faces);
+		std::vector<F32*> worker_dst(faces);
+		for (S32 i = 0; i < faces; ++i)
+		{
+			inline_dst[i] = alloc_dst(count);
+			worker_dst[i] = alloc_dst(count);
+		}
+
+		LLTimer timer;
+		for (S32 i = 0; i < faces; ++i)
+		{
+			jobs[i].mDst = inline_dst[i];
+			jobs[i].run();
+		}
+		F64 inline_seconds = timer.getElapsedTimeF64();
+
+		LLGeometryWorkers::initClass(3);
+		for (S32 i = 0; i < faces; ++i)
+		{
+			jobs[i].mDst = worker_dst[i];
+		}
+		timer.reset();
+		LLGeometryWorkers::getInstance()->run(run_face_job, &jobs[0], jobs.size());
+		F64 worker_seconds = timer.getElapsedTimeF64();
+
+		llinfos << faces << " faces of " << count << " vertices: inline " << inline_seconds * 1000.0
+				<< " ms, main thread and 3 workers " << worker_seconds * 1000.0 << " ms" << llendl;
+
+		for (S32 i = 0; i < faces; ++i)
+		{
+			ensure("same output", !memcmp(inline_dst[i], worker_dst[i], sizeof(F32) * 4 * count));
+			ll_aligned_free_16(inline_dst[i]);
+			ll_aligned_free_16(worker_dst[i]);
+		}
+		ll_aligned_free_16(positions);
+		ll_aligned_free_16(normals);
+	}
+
+	// skinning with the folded palette matches the old per vertex path
+	template<> template<>
+	void geometryworkers_object_t::test<5>()
+	{
+		rigged_mesh mesh(3000, 24);
+		LLVector4a* old_pos = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * mesh.mCount);
+		LLVector4a* old_norm = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * mesh.mCount);
+		LLVector4a* pos = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * mesh.mCount);
+		LLVector4a* norm = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * mesh.mCount);
+
+		old_skin_vertices(mesh, old_pos, old_norm);
+
+		LLMatrix4a folded[64];
+		LLRiggedSkinJob job = make_skin_job(mesh, folded, pos, norm);
+		LLGeometryWorkers::initClass(2);
+		LLGeometryWorkers::getInstance()->run(run_skin_job, &job,
+			(job.mCount + LLRiggedSkinJob::BATCH_VERTICES - 1) / LLRiggedSkinJob::BATCH_VERTICES);
+
+		for (U32 i = 0; i < mesh.mCount; ++i)
+		{
+			for (U32 k = 0; k < 3; ++k)
+			{
+				ensure_distance("position", pos[i][k], old_pos[i][k], 1e-5f);
+				ensure_distance("normal", norm[i][k], old_norm[i][k], 1e-5f);
+			}
+		}
+
+		ll_aligned_free_16(old_pos);
+		ll_aligned_free_16(old_norm);
+		ll_aligned_free_16(pos);
+		ll_aligned_free_16(norm);
+	}
+
+	// Benchmark: software skinning of typical rigged mesh sizes with the old
+	// per vertex path, the skin job inline and on the workers. Logged at INFO
+	// level, run with --debug to see the timings.
+	template<> template<>
+	void geometryworkers_object_t::test<6>()
+	{
+		const U32 sizes[] = { 2000, 10000, 40000 }; // attachment, clothing, full body
+		LLGeometryWorkers::initClass(3);
+
+		for (U32 s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+		{
+			rigged_mesh mesh(sizes[s], 32);
+			LLVector4a* pos = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * mesh.mCount);
+			LLVector4a* norm = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a) * mesh.mCount);
+			LLMatrix4a folded[64];
+
+			LLTimer timer;
+			old_skin_vertices(mesh, pos, norm);
+			F64 old_seconds = timer.getElapsedTimeF64();
+
+			timer.reset();
+			LLRiggedSkinJob job = make_skin_job(mesh, folded, pos, norm);
+			job.run(0, job.mCount);
+			F64 inline_seconds = timer.getElapsedTimeF64();
+
+			timer.reset();
+			job = make_skin_job(mesh, folded, pos, norm);
+			LLGeometryWorkers::getInstance()->run(run_skin_job, &job,
+				(job.mCount + LLRiggedSkinJob::BATCH_VERTICES - 1) / LLRiggedSkinJob::BATCH_VERTICES);
+			F64 worker_seconds = timer.getElapsedTimeF64();
+
+			llinfos << mesh.mCount << " rigged vertices: old path " << old_seconds * 1000.0 << " ms, skin job "
+					<< inline_seconds * 1000.0 << " ms, on the workers " << worker_seconds * 1000.0 << " ms" << llendl;
+
+			ll_aligned_free_16(pos);
+			ll_aligned_free_16(norm);
+		}
+	}
+}
@@ -0,0 +1,273 @@
+/** 
+ * @file llobjectidmap_test.cpp
+ * @brief LLObjectIDMap test cases and benchmark.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llobjectidmap.h"
+// Dependencies
+#include "lltimer.h"
+
+#include <map>
+
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Helpers
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	// The map only stores the pointers, any distinct addresses will do.
+	char sObjects[50000];
+
+	LLViewerObject* object(U32 index)
+	{
+		return (LLViewerObject*) &sObjects[index];
+	}
+
+	// Same as LLObjectIDMap::getHome() at the initial 1024 slots
+	const U32 INITIAL_CAPACITY = 1024;
+
+	U32 home_of(const LLUUID& id)
+	{
+		return (id.getCRC32() * 2654435761U) >> 22;
+	}
+
+	LLUUID id_at_home(U32 home)
+	{
+		LLUUID id;
+		do
+		{
+			id.generate();
+		}
+		while (home_of(id) != home);
+		return id;
+	}
+}
+
+namespace tut
+{
+	struct objectidmap_test
+	{
+	};
+	typedef test_group<objectidmap_test> objectidmap_t;
+	typedef objectidmap_t::object objectidmap_object_t;
+	tut::objectidmap_t tut_objectidmap("objectidmap");
+
+	// ids with the same home slot all get found, inserting one again replaces it
+	template<> template<>
+	void objectidmap_object_t::test<1>()
+	{
+		LLObjectIDMap map;
+		LLUUID ids[4];
+		for (U32 i = 0; i < 4; ++i)
+		{
+			ids[i] = id_at_home(100);
+			map.insert(ids[i], object(i));
+		}
+		ensure_equals("size", map.size(), 4U);
+		for (U32 i = 0; i < 4; ++i)
+		{
+			ensure("colliding id found", map.find(ids[i]) == object(i));
+		}
+		ensure("missing id at the same home", map.find(id_at_home(100)) == NULL);
+
+		map.insert(ids[2], object(10));
+		ensure_equals("size after replace", map.size(), 4U);
+		ensure("replaced", map.find(ids[2]) == object(10));
+	}
+
+	// erasing from the middle of a probe run keeps the rest of the run reachable,
+	// including entries of the next home pushed along by it
+	template<> template<>
+	void objectidmap_object_t::test<2>()
+	{
+		LLObjectIDMap map;
+		LLUUID run[3] = { id_at_home(200), id_at_home(200), id_at_home(200) };
+		LLUUID next = id_at_home(201);
+		LLUUID after = id_at_home(205);
+		for (U32 i = 0; i < 3; ++i)
+		{
+			map.insert(run[i], object(i));
+		}
+		map.insert(next, object(3));
+		map.insert(after, object(4));
+
+		ensure("erase middle", map.erase(run[1]));
+		ensure("erased", map.find(run[1]) == NULL);
+		ensure("erase twice", !map.erase(run[1]));
+		ensure("first of run", map.find(run[0]) == object(0));
+		ensure("last of run", map.find(run[2]) == object(2));
+		ensure("pushed along", map.find(next) == object(3));
+		ensure("own home", map.find(after) == object(4));
+
+		ensure("erase first", map.erase(run[0]));
+		ensure("last of run after", map.find(run[2]) == object(2));
+		ensure("pushed along after", map.find(next) == object(3));
+		ensure_equals("size", map.size(), 3U);
+	}
+
+	// a run starting at the last slot wraps around to the start of the table
+	template<> template<>
+	void objectidmap_object_t::test<3>()
+	{
+		LLObjectIDMap map;
+		const U32 last = INITIAL_CAPACITY - 1;
+		LLUUID tail[3] = { id_at_home(last), id_at_home(last), id_at_home(last) };
+		LLUUID first = id_at_home(0);
+		for (U32 i = 0; i < 3; ++i)
+		{
+			map.insert(tail[i], object(i));
+		}
+		map.insert(first, object(3));
+		for (U32 i = 0; i < 3; ++i)
+		{
+			ensure("wrapped id found", map.find(tail[i]) == object(i));
+		}
+		ensure("pushed past the wrap", map.find(first) == object(3));
+
+		ensure("erase at the end", map.erase(tail[0]));
+		ensure("wrapped id pulled back", map.find(tail[1]) == object(1));
+		ensure("second wrapped id", map.find(tail[2]) == object(2));
+		ensure("erase across the wrap", map.erase(tail[2]));
+		ensure("first slot id", map.find(first) == object(3));
+		ensure_equals("size", map.size(), 2U);
+	}
+
+	// growing past 11/16 of the slots rehashes without losing anything
+	template<> template<>
+	void objectidmap_object_t::test<4>()
+	{
+		LLObjectIDMap map;
+		const U32 count = INITIAL_CAPACITY * 11 / 16 + 1;
+		std::vector<LLUUID> ids(count * 4);
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			map.insert(ids[i], object(i));
+			if (i == count - 1 || i == ids.size() - 1)
+			{
+				ensure_equals("size", map.size(), i + 1);
+				for (U32 j = 0; j <= i; ++j)
+				{
+					ensure("found after growing", map.find(ids[j]) == object(j));
+				}
+			}
+		}
+
+		for (U32 i = 0; i < ids.size(); i += 2)
+		{
+			ensure("erase", map.erase(ids[i]));
+		}
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ensure("found after erasing", map.find(ids[i]) == (i & 1 ? object(i) : NULL));
+		}
+
+		map.clear();
+		ensure("empty", map.empty());
+		ensure("cleared", map.find(ids[1]) == NULL);
+	}
+
+	// insert, find and erase of 50k objects against the std::map it replaced.
+	// Logged at INFO level, run with --debug to see the timings.
+	template<> template<>
+	void objectidmap_object_t::test<5>()
+	{
+		const U32 count = 50000;
+		std::vector<LLUUID> ids(count);
+		for (U32 i = 0; i < count; ++i)
+		{
+			ids[i].generate();
+		}
+
+		LLTimer timer;
+		std::map<LLUUID, LLViewerObject*> tree;
+		for (U32 i = 0; i < count; ++i)
+		{
+			tree[ids[i]] = object(i);
+		}
+		F64 tree_insert = timer.getElapsedTimeF64();
+		timer.reset();
+		U32 tree_found = 0;
+		for (U32 pass = 0; pass < 10; ++pass)
+		{
+			for (U32 i = 0; i < count; ++i)
+			{
+				tree_found += tree.find(ids[i]) != tree.end();
+			}
+		}
+		F64 tree_find = timer.getElapsedTimeF64();
+		timer.reset();
+		for (U32 i = 0; i < count; ++i)
+		{
+			tree.erase(ids[i]);
+		}
+		F64 tree_erase = timer.getElapsedTimeF64();
+
+		timer.reset();
+		LLObjectIDMap map;
+		for (U32 i = 0; i < count; ++i)
+		{
+			map.insert(ids[i], object(i));
+		}
+		F64 map_insert = timer.getElapsedTimeF64();
+		timer.reset();
+		U32 map_found = 0;
+		for (U32 pass = 0; pass < 10; ++pass)
+		{
+			for (U32 i = 0; i < count; ++i)
+			{
+				map_found += map.find(ids[i]) != NULL;
+			}
+		}
+		F64 map_find = timer.getElapsedTimeF64();
+		timer.reset();
+		for (U32 i = 0; i < count; ++i)
+		{
+			map.erase(ids[i]);
+		}
+		F64 map_erase = timer.getElapsedTimeF64();
+
+		ensure_equals("all found in the tree", tree_found, count * 10);
+		ensure_equals("all found in the map", map_found, count * 10);
+		ensure("all erased", map.empty());
+
+		llinfos << count << " objects, std::map: insert " << tree_insert * 1000.0 << " ms, 10x find "
+				<< tree_find * 1000.0 << " ms, erase " << tree_erase * 1000.0 << " ms; LLObjectIDMap: insert "
+				<< map_insert * 1000.0 << " ms, 10x find " << map_find * 1000.0 << " ms, erase "
+				<< map_erase * 1000.0 << " ms" << llendl;
+	}
+}
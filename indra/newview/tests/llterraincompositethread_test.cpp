@@ -0,0 +1,315 @@
+/** 
+ * @file llterraincompositethread_test.cpp
+ * @brief LLTerrainCompositeThread test cases and benchmark.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llterraincompositethread.h"
+// Dependencies
+#include "llcontrol.h"
+#include "lltimer.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+
+LLControlGroup gSavedSettings("Global"); // read by the J2C codec in llimage
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------
+// Helpers
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	typedef LLTerrainCompositeThread::Params Params;
+
+	// Region layout of LLViewerRegion and LLSurface
+	const S32 COMPOSITION_WIDTH = 256;
+	const S32 TEXTURE_SIZE = 256;
+	const S32 DETAIL_SIZE = 128;
+	const F32 DETAIL_SCALE = 16.f;
+	const S32 PATCH_TEXELS = 16;
+
+	U32 sSeed = 1;
+
+	U8 next_byte()
+	{
+		sSeed = sSeed * 1664525 + 1013904223;
+		return (U8)(sSeed >> 24);
+	}
+
+	// Same setup as LLVLComposition::updateTexture() for a whole region,
+	// with noise detail textures and a composition running past both ends
+	// of [0, 3] so that the clamps get used.
+	void make_params(Params& params)
+	{
+		for (S32 i = 0; i < LLTerrainCompositeThread::DETAIL_COUNT; i++)
+		{
+			params.mDetail[i] = new LLImageRaw(DETAIL_SIZE, DETAIL_SIZE, 3);
+			U8* data = params.mDetail[i]->getData();
+			for (S32 k = 0; k < DETAIL_SIZE * DETAIL_SIZE * 3; k++)
+			{
+				data[k] = next_byte();
+			}
+		}
+		params.mDetailSize = DETAIL_SIZE;
+
+		params.mComposition.resize(COMPOSITION_WIDTH * COMPOSITION_WIDTH);
+		for (S32 y = 0; y < COMPOSITION_WIDTH; y++)
+		{
+			for (S32 x = 0; x < COMPOSITION_WIDTH; x++)
+			{
+				params.mComposition[y * COMPOSITION_WIDTH + x] =
+					1.5f + 2.f * sinf(x * 0.043f) * cosf(y * 0.029f) + (next_byte() - 128) / 512.f;
+			}
+		}
+		params.mCompositionWidth = COMPOSITION_WIDTH;
+		params.mCompositionScaleInv = 1.f;
+		params.mTexelRatioX = (F32)COMPOSITION_WIDTH / (F32)TEXTURE_SIZE;
+		params.mTexelRatioY = (F32)COMPOSITION_WIDTH / (F32)TEXTURE_SIZE;
+		params.mDetailStrideX = ((F32)DETAIL_SIZE / DETAIL_SCALE) * ((F32)COMPOSITION_WIDTH / (F32)TEXTURE_SIZE);
+		params.mDetailStrideY = params.mDetailStrideX;
+		params.mXBegin = 0;
+		params.mYBegin = 0;
+		params.mXEnd = TEXTURE_SIZE;
+		params.mYEnd = TEXTURE_SIZE;
+	}
+
+	// LLViewerLayer::getValueScaled()
+	F32 value_scaled(const Params& params, F32 x, F32 y)
+	{
+		S32 width = params.mCompositionWidth;
+		F32 x_frac = x * params.mCompositionScaleInv;
+		S32 x1 = llfloor(x_frac);
+		x_frac -= x1;
+		F32 y_frac = y * params.mCompositionScaleInv;
+		S32 y1 = llfloor(y_frac);
+		y_frac -= y1;
+		S32 x2 = llclamp(x1 + 1, 0, width - 1);
+		S32 y2 = llclamp(y1 + 1, 0, width - 1);
+		x1 = llclamp(x1, 0, width - 1);
+		y1 = llclamp(y1, 0, width - 1);
+
+		const F32* data = &params.mComposition[0];
+		F32 row1_left = data[y1 * width + x1];
+		F32 row1_right = data[y1 * width + x2];
+		F32 row2_left = data[y2 * width + x1];
+		F32 row2_right = data[y2 * width + x2];
+		F32 row1_interp = row1_left - x_frac * (row1_left - row1_right);
+		F32 row2_interp = row2_left - x_frac * (row2_left - row2_right);
+		return row1_interp - y_frac * (row1_interp - row2_interp);
+	}
+
+	// The blend LLVLComposition::generateTexture() did on the main thread,
+	// one patch of texels per call, before the terrain composite thread.
+	void scalar_blend(const Params& params, U8* rawp, S32 tex_x_begin, S32 tex_y_begin, S32 tex_x_end, S32 tex_y_end)
+	{
+		const U32 st_comps = 3;
+		const U32 st_width = params.mDetailSize;
+		const U32 st_height = params.mDetailSize;
+		const S32 st_data_size = st_width * st_height * st_comps;
+		const U32 tex_stride = TEXTURE_SIZE * st_comps;
+		const F32 st_x_stride = params.mDetailStrideX;
+		const F32 st_y_stride = params.mDetailStrideY;
+
+		F32 sti, stj;
+		S32 st_offset;
+		stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+		for (S32 j = tex_y_begin; j < tex_y_end; j++)
+		{
+			U32 offset = j * tex_stride + tex_x_begin * st_comps;
+			sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
+			for (S32 i = tex_x_begin; i < tex_x_end; i++)
+			{
+				F32 composition = value_scaled(params, i*params.mTexelRatioX, j*params.mTexelRatioY);
+				S32 tex0 = llclamp(llfloor(composition), 0, 3);
+				composition -= tex0;
+				S32 tex1 = llclamp(tex0 + 1, 0, 3);
+
+				st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
+				for (U32 k = 0; k < st_comps; k++)
+				{
+					if (st_offset < st_data_size)
+					{
+						F32 a = *(params.mDetail[tex0]->getData() + st_offset);
+						F32 b = *(params.mDetail[tex1]->getData() + st_offset);
+						rawp[offset] = (U8)lltrunc(a + composition * (b - a));
+					}
+					offset++;
+					st_offset++;
+				}
+
+				sti += st_x_stride;
+				if (sti >= st_width)
+				{
+					sti -= st_width;
+				}
+			}
+
+			stj += st_y_stride;
+			if (stj >= st_height)
+			{
+				stj -= st_height;
+			}
+		}
+	}
+
+	// Stands in for a request LLVLComposition aborted while it ran
+	struct aborted_request : public LLQueuedThread::QueuedRequest
+	{
+		aborted_request() : LLQueuedThread::QueuedRequest(0, LLQueuedThread::PRIORITY_NORMAL, LLQueuedThread::FLAG_ABORT) {}
+		/*virtual*/ bool processRequest() { return true; }
+		void release() { deleteRequest(); }
+	};
+
+	void scalar_blend_region(const Params& params, U8* rawp)
+	{
+		for (S32 y = 0; y < TEXTURE_SIZE; y += PATCH_TEXELS)
+		{
+			for (S32 x = 0; x < TEXTURE_SIZE; x += PATCH_TEXELS)
+			{
+				scalar_blend(params, rawp, x, y, x + PATCH_TEXELS, y + PATCH_TEXELS);
+			}
+		}
+	}
+}
+
+namespace tut
+{
+	struct terraincompositethread_test
+	{
+	};
+	typedef test_group<terraincompositethread_test> terraincompositethread_t;
+	typedef terraincompositethread_t::object terraincompositethread_object_t;
+	tut::terraincompositethread_t tut_terraincompositethread("terraincompositethread");
+
+	// a whole region blends to the same bytes as the old per patch blend
+	template<> template<>
+	void terraincompositethread_object_t::test<1>()
+	{
+		Params params;
+		make_params(params);
+
+		const S32 size = TEXTURE_SIZE * TEXTURE_SIZE * 3;
+		std::vector<U8> expected(size, 0);
+		std::vector<U8> actual(size, 0);
+		scalar_blend_region(params, &expected[0]);
+		ensure("whole region", LLTerrainCompositeThread::compositeTexels(params, &actual[0], TEXTURE_SIZE));
+
+		S32 differences = 0;
+		for (S32 i = 0; i < size; i++)
+		{
+			differences += expected[i] != actual[i];
+		}
+		ensure_equals("bytes different from the scalar blend", differences, 0);
+	}
+
+	// a dirty rectangle that doesn't start on a quad only touches its texels
+	template<> template<>
+	void terraincompositethread_object_t::test<2>()
+	{
+		Params params;
+		make_params(params);
+		params.mXBegin = 37;
+		params.mYBegin = 90;
+		params.mXEnd = 74;
+		params.mYEnd = 107;
+
+		const S32 size = TEXTURE_SIZE * TEXTURE_SIZE * 3;
+		std::vector<U8> expected(size, 0x55);
+		std::vector<U8> actual(size, 0x55);
+		scalar_blend(params, &expected[0], params.mXBegin, params.mYBegin, params.mXEnd, params.mYEnd);
+		LLTerrainCompositeThread::compositeTexels(params, &actual[0], TEXTURE_SIZE);
+		ensure("same bytes as the scalar blend", expected == actual);
+	}
+
+	// a queued request blends into its target, an aborted one stops
+	template<> template<>
+	void terraincompositethread_object_t::test<3>()
+	{
+		LLTerrainCompositeThread thread(false);
+		Params params;
+		make_params(params);
+
+		LLPointer<LLImageRaw> target = new LLImageRaw(TEXTURE_SIZE, TEXTURE_SIZE, 3);
+		LLQueuedThread::handle_t handle = thread.composite(params, target);
+		ensure("queued", handle != LLQueuedThread::nullHandle());
+		while (thread.update(0))
+		{
+		}
+		ensure_equals("completed", (S32)thread.getRequestStatus(handle), (S32)LLQueuedThread::STATUS_COMPLETE);
+
+		std::vector<U8> expected(TEXTURE_SIZE * TEXTURE_SIZE * 3, 0);
+		scalar_blend_region(params, &expected[0]);
+		ensure("target blended", !memcmp(&expected[0], target->getData(), expected.size()));
+		thread.completeRequest(handle);
+
+		aborted_request* aborted = new aborted_request;
+		ensure("aborted request stops", !LLTerrainCompositeThread::compositeTexels(params, target->getData(), TEXTURE_SIZE, aborted));
+		aborted->release();
+	}
+
+	// the old per patch blend of a whole region against compositeTexels().
+	// Logged at INFO level, run with --debug to see the timings.
+	template<> template<>
+	void terraincompositethread_object_t::test<4>()
+	{
+		Params params;
+		make_params(params);
+		const S32 passes = 20;
+		std::vector<U8> raw(TEXTURE_SIZE * TEXTURE_SIZE * 3);
+
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			scalar_blend_region(params, &raw[0]);
+		}
+		F64 scalar_seconds = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			LLTerrainCompositeThread::compositeTexels(params, &raw[0], TEXTURE_SIZE);
+		}
+		F64 composite_seconds = timer.getElapsedTimeF64();
+
+		llinfos << TEXTURE_SIZE << "x" << TEXTURE_SIZE << " terrain texture: per patch blend "
+				<< scalar_seconds * 1000.0 / passes << " ms, compositeTexels "
+				<< composite_seconds * 1000.0 / passes << " ms per region" << llendl;
+	}
+}
@@ -0,0 +1,265 @@
+/** 
+ * @file llvolumebuildthread_test.cpp
+ * @brief LLVolumeBuildThread test cases and benchmark.
+ *
+ * $LicenseInfo:firstyear=2006&license=viewergpl$
+ * 
+ * Copyright (c) 2006-2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llvolumebuildthread.h"
+// Dependencies
+#include "llcontrol.h"
+#include "llprimitive.h"
+#include "../llvovolume.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes: 
+// * The tests queue builds without objects waiting on them, so nothing is
+//   published and no object is notified.
+
+LLVolumeMgr* LLPrimitive::sVolumeManager = NULL;
+BOOL gDebugGL = FALSE;
+U32 gOctreeMaxCapacity = 128;
+LLControlGroup gSavedSettings("Global"); // read by the J2C codec in llimage
+
+void LLVOVolume::notifyVolumeBuilt(bool sculpted)
+{
+}
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	// Queues builds directly, the way buildLOD() and buildSculpt() do for objects.
+	class test_build_thread : public LLVolumeBuildThread
+	{
+	public:
+		test_build_thread(bool threaded) : LLVolumeBuildThread(threaded) {}
+
+		handle_t queue(const LLVolumeParams& params, S32 detail, LLImageRaw* sculpt_image = NULL)
+		{
+			handle_t handle = generateHandle();
+			addRequest(new BuildRequest(handle, LLQueuedThread::PRIORITY_NORMAL, this,
+										params, detail, sculpt_image, 0));
+			return handle;
+		}
+
+		// Waits for the worker without handing the volumes over.
+		void waitForBuilds(const std::vector<handle_t>& handles)
+		{
+			for (std::vector<handle_t>::const_iterator iter = handles.begin(); iter != handles.end(); ++iter)
+			{
+				while (getRequestStatus(*iter) != LLQueuedThread::STATUS_COMPLETE)
+				{
+					LLQueuedThread::update(1);
+					ms_sleep(1);
+				}
+			}
+		}
+
+		LLVolume* getVolume(handle_t handle)
+		{
+			BuildRequest* req = (BuildRequest*)getRequest(handle);
+			return req ? req->getVolume() : NULL;
+		}
+	};
+
+	LLVolumeParams make_prim_params(S32 variant)
+	{
+		LLVolumeParams params;
+		if (variant & 1)
+		{
+			params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+			params.setRatio(1.f, 0.25f);
+		}
+		else
+		{
+			params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+			params.setRatio(1.f, 1.f);
+		}
+		// Distinct shapes so no two builds share a volume
+		params.setTwistEnd((variant % 16) / 16.f);
+		params.setHollow((variant / 16) / 8.f);
+		return params;
+	}
+
+	LLVolumeParams make_sculpt_params()
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setSculptID(LLUUID("b0e6f3e0-6a0c-4e2f-9b1e-3c6a6d1d9a01"), LL_SCULPT_TYPE_SPHERE);
+		return params;
+	}
+
+	LLPointer<LLImageRaw> make_sculpt_map(U16 size)
+	{
+		LLPointer<LLImageRaw> raw = new LLImageRaw(size, size, 3);
+		U8* data = raw->getData();
+		for (U32 y = 0; y < size; ++y)
+		{
+			for (U32 x = 0; x < size; ++x)
+			{
+				F32 u = F_TWO_PI * x / size;
+				F32 v = F_PI * y / (size - 1);
+				*data++ = (U8) (127.5f + 127.f * sinf(v) * cosf(u));
+				*data++ = (U8) (127.5f + 127.f * sinf(v) * sinf(u));
+				*data++ = (U8) (127.5f + 127.f * cosf(v));
+			}
+		}
+		return raw;
+	}
+
+	bool same_geometry(LLVolume* a, LLVolume* b)
+	{
+		if (a->getNumVolumeFaces() != b->getNumVolumeFaces())
+		{
+			return false;
+		}
+		for (S32 i = 0; i < a->getNumVolumeFaces(); ++i)
+		{
+			const LLVolumeFace& fa = a->getVolumeFace(i);
+			const LLVolumeFace& fb = b->getVolumeFace(i);
+			if (fa.mNumVertices != fb.mNumVertices || fa.mNumIndices != fb.mNumIndices ||
+				memcmp(fa.mPositions, fb.mPositions, sizeof(LLVector4a) * fa.mNumVertices) ||
+				memcmp(fa.mIndices, fb.mIndices, sizeof(U16) * fa.mNumIndices))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	struct volumebuildthread_test
+	{
+	};
+	typedef test_group<volumebuildthread_test> volumebuildthread_t;
+	typedef volumebuildthread_t::object volumebuildthread_object_t;
+	tut::volumebuildthread_t tut_volumebuildthread("volumebuildthread");
+
+	// prim LODs built on the thread match the ones built in place, at every detail
+	template<> template<>
+	void volumebuildthread_object_t::test<1>()
+	{
+		test_build_thread thread(false);
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 detail = 0; detail < LLVolumeLODGroup::NUM_LODS; ++detail)
+		{
+			handles.push_back(thread.queue(make_prim_params(detail), detail));
+		}
+		thread.waitForBuilds(handles);
+
+		for (S32 detail = 0; detail < LLVolumeLODGroup::NUM_LODS; ++detail)
+		{
+			LLPointer<LLVolume> expected = new LLVolume(make_prim_params(detail),
+														LLVolumeLODGroup::getVolumeScaleFromDetail(detail));
+			LLVolume* built = thread.getVolume(handles[detail]);
+			ensure("volume built", built != NULL);
+			ensure("same geometry", same_geometry(built, expected));
+		}
+
+		// handing over completes the requests
+		ensure_equals("nothing pending", thread.update(0), 0);
+		ensure("request completed", thread.getVolume(handles[0]) == NULL);
+	}
+
+	// sculpts are built from the map the request was queued with
+	template<> template<>
+	void volumebuildthread_object_t::test<2>()
+	{
+		const S32 detail = LLVolumeLODGroup::NUM_LODS - 1;
+		LLPointer<LLImageRaw> map = make_sculpt_map(64);
+
+		test_build_thread thread(true);
+		std::vector<LLQueuedThread::handle_t> handles;
+		handles.push_back(thread.queue(make_sculpt_params(), detail, map));
+		thread.waitForBuilds(handles);
+
+		LLPointer<LLVolume> expected = new LLVolume(make_sculpt_params(), LLVolumeLODGroup::getVolumeScaleFromDetail(detail));
+		expected->sculpt(map->getWidth(), map->getHeight(), map->getComponents(), map->getData(), 0);
+
+		LLVolume* built = thread.getVolume(handles[0]);
+		ensure("sculpt built", built != NULL);
+		ensure("sculpt geometry", built->getNumVolumeFaces() > 0 && built->getVolumeFace(0).mNumVertices > 0);
+		ensure("same geometry", same_geometry(built, expected));
+		thread.update(0);
+	}
+
+	// Benchmark: a region's worth of highest detail prims, built in place and
+	// on the thread. Logged at INFO level, run with --debug to see the timings.
+	template<> template<>
+	void volumebuildthread_object_t::test<3>()
+	{
+		const S32 count = 128;
+		const S32 detail = LLVolumeLODGroup::NUM_LODS - 1;
+
+		LLTimer timer;
+		for (S32 i = 0; i < count; ++i)
+		{
+			LLPointer<LLVolume> volume = new LLVolume(make_prim_params(i), LLVolumeLODGroup::getVolumeScaleFromDetail(detail));
+		}
+		F64 inline_seconds = timer.getElapsedTimeF64();
+
+		test_build_thread thread(true);
+		std::vector<LLQueuedThread::handle_t> handles;
+		timer.reset();
+		for (S32 i = 0; i < count; ++i)
+		{
+			handles.push_back(thread.queue(make_prim_params(i), detail));
+		}
+		thread.update(1);
+		F64 queue_seconds = timer.getElapsedTimeF64();
+		thread.waitForBuilds(handles);
+		F64 total_seconds = timer.getElapsedTimeF64();
+
+		timer.reset();
+		thread.update(0);
+		F64 handover_seconds = timer.getElapsedTimeF64();
+
+		llinfos << count << " prims at detail " << detail << ": in place " << inline_seconds * 1000.0
+				<< " ms, on the thread " << total_seconds * 1000.0 << " ms, main thread "
+				<< (queue_seconds + handover_seconds) * 1000.0 << " ms" << llendl;
+		for (S32 i = 0; i < count; ++i)
+		{
+			ensure("request completed", thread.getVolume(handles[i]) == NULL);
+		}
+	}
+}